@@ -0,0 +1,122 @@
+import scheme_reliability;
+using namespace sr;
+
+import std;
+using std::string;
+using std::string_view;
+using std::vector;
+using std::stoul;
+using std::println;
+using std::cerr;
+using std::exception;
+
+vector<string> split(const string& value)
+{
+    vector<string> result { };
+    size_t start { 0 };
+    while (start <= value.size())
+    {
+        size_t end { value.find(',', start) };
+        if (end == string::npos)
+            end = value.size();
+        if (end > start)
+            result.push_back(value.substr(start, end - start));
+        start = end + 1;
+    }
+    return result;
+}
+
+string group_name(const vector<string>& group_elements)
+{
+    string result { };
+    for (size_t i = 0; i < group_elements.size(); i++)
+        result += (i == 0 ? "" : " * ") + group_elements[i];
+    return result;
+}
+
+void print_analysis(const ResultAnalysisDto& analysis, bool print_counts)
+{
+    println("=== sum probabilities ===");
+    println("p = {}", analysis.sp);
+    println("q = {}", analysis.sq);
+    println("p + q = {}", analysis.sp + analysis.sq);
+
+    if (analysis.inconsistent_count == 0)
+        println("=== reconfiguration is consistent ===");
+    else
+        println(
+            "=== reconfiguration is inconsistent: {} states, probability = {} ===",
+            analysis.inconsistent_count, analysis.inconsistent_probability
+        );
+
+    println("=== sum fail probability(sv1 | sv2) per element ===");
+    for (const ElementFailureStatisticsDto& element : analysis.elements)
+        println("{}: sv1 = {:.8e}, sv2 = {:.8e}", element.name, element.sv1_fail_probability, element.sv2_fail_probability);
+
+    if (print_counts)
+    {
+        println("=== sum fail count(sv1 | sv2) per element ===");
+        for (const ElementFailureStatisticsDto& element : analysis.elements)
+            println("{}: sv1 = {}, sv2 = {}", element.name, element.sv1_fail_count, element.sv2_fail_count);
+    }
+
+    if (analysis.group_elements.empty())
+        return;
+
+    println("=== sum fail count(sv1 | sv2) per {} state set ===", group_name(analysis.group_elements));
+    for (size_t i = 0; i < analysis.groups.size(); i++)
+    {
+        const MaskGroupStatisticsDto& group { analysis.groups[i] };
+        println(
+            "case {}: sv1 = {}; sv2 = {}; p(sv1) = {:.8e}; p(sv2) = {:.8e}; sp(sv2) = {:.8e}",
+            i, group.sv1_count, group.sv2_count, group.sv1_probability, group.sv2_probability, group.sv2_sp
+        );
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    vector<string> result_paths { };
+    AnalysisOptionsDto options { };
+    bool print_counts { false };
+
+    for (int i = 1; i < argc; i++)
+    {
+        string_view arg { argv[i] };
+        if (arg == "--threads" && i + 1 < argc)
+            options.thread_count = stoul(argv[++i]);
+        else if (arg == "--group" && i + 1 < argc)
+            options.group_elements = split(argv[++i]);
+        else if (arg == "--counts")
+            print_counts = true;
+        else if (!arg.starts_with("--"))
+            result_paths.push_back(string { arg });
+        else
+        {
+            result_paths.clear();
+            break;
+        }
+    }
+
+    if (result_paths.empty())
+    {
+        println(cerr, "usage: sr-analyze <result-dir>... [--threads N] [--group pr1,pr2,pr3] [--counts]");
+        return 1;
+    }
+
+    try
+    {
+        for (const string& result_path : result_paths)
+        {
+            println("\n=== {} ===", result_path);
+            print_analysis(analyze_scheme_result(result_path, options), print_counts);
+        }
+    }
+    catch (const exception& e)
+    {
+        println(cerr, "{}", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,210 @@
+import scheme_reliability;
+using namespace sr;
+
+import std;
+using std::string;
+using std::string_view;
+using std::vector;
+using std::optional;
+using std::stoul;
+using std::println;
+using std::cerr;
+using std::ifstream;
+using std::istringstream;
+using std::getline;
+using std::exception;
+using std::runtime_error;
+using std::format;
+
+struct JobSpec
+{
+    string scheme_path;
+    optional<SchemeType> type;
+};
+
+optional<SchemeType> parse_scheme_type(string_view value)
+{
+    if (value == "greedy")
+        return SchemeType::Greedy;
+    if (value == "brute")
+        return SchemeType::Brute;
+    if (value == "beam")
+        return SchemeType::Beam;
+    return { };
+}
+
+string_view scheme_type_name(SchemeType type)
+{
+    switch (type)
+    {
+    case SchemeType::Brute: return "brute";
+    case SchemeType::Beam: return "beam";
+    default: return "greedy";
+    }
+}
+
+// One job per line: a scheme file and optionally its type; '#' starts a comment.
+vector<JobSpec> read_job_file(const string& job_file_path)
+{
+    ifstream job_file { job_file_path };
+    if (!job_file.is_open())
+        throw runtime_error(format("Error: can't open job file {}", job_file_path));
+
+    vector<JobSpec> specs { };
+    string line { };
+    for (size_t line_number = 1; getline(job_file, line); line_number++)
+    {
+        line = line.substr(0, line.find('#'));
+        istringstream fields { line };
+        string scheme_path { };
+        string type_name { };
+        if (!(fields >> scheme_path))
+            continue;
+
+        JobSpec spec { .scheme_path = scheme_path, .type = { } };
+        if (fields >> type_name)
+        {
+            spec.type = parse_scheme_type(type_name);
+            if (!spec.type.has_value())
+                throw runtime_error(format("Error: {}:{}: unknown scheme type {}", job_file_path, line_number, type_name));
+        }
+        specs.push_back(spec);
+    }
+    return specs;
+}
+
+double seconds(unsigned long long ns)
+{
+    return static_cast<double>(ns) / 1e9;
+}
+
+int main(int argc, char* argv[])
+{
+    vector<JobSpec> specs { };
+    vector<SchemeType> types { };
+    CalculationOptionsDto options { };
+    BatchOptionsDto batch_options { };
+    optional<size_t> beam_width { };
+    bool is_valid { true };
+
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            string_view arg { argv[i] };
+            if (arg == "--threads" && i + 1 < argc)
+                batch_options.thread_count = stoul(argv[++i]);
+            else if (arg == "--active" && i + 1 < argc)
+                batch_options.active_job_count = stoul(argv[++i]);
+            else if (arg == "--types" && i + 1 < argc)
+            {
+                istringstream names { argv[++i] };
+                for (string name { }; getline(names, name, ',');)
+                {
+                    optional<SchemeType> type { parse_scheme_type(name) };
+                    if (type.has_value())
+                        types.push_back(type.value());
+                    else
+                        is_valid = false;
+                }
+            }
+            else if (arg == "--format" && i + 1 < argc)
+            {
+                string_view value { argv[++i] };
+                if (value == "ssv")
+                    options.output_format = OutputFormat::Ssv;
+                else if (value == "bitmap")
+                    options.output_format = OutputFormat::Bitmap;
+                else
+                    is_valid = false;
+            }
+            else if (arg == "--jobs" && i + 1 < argc)
+            {
+                vector<JobSpec> file_specs { read_job_file(argv[++i]) };
+                specs.insert(specs.end(), file_specs.begin(), file_specs.end());
+            }
+            else if (arg == "--cache" && i + 1 < argc)
+                options.result_cache_path = argv[++i];
+            else if (arg == "--beam-width" && i + 1 < argc)
+                beam_width = stoul(argv[++i]);
+            else if (!arg.starts_with("--"))
+                specs.push_back(JobSpec { .scheme_path = string { arg }, .type = { } });
+            else
+                is_valid = false;
+        }
+    }
+    catch (const exception& e)
+    {
+        println(cerr, "{}", e.what());
+        return 1;
+    }
+
+    if (!is_valid || specs.empty())
+    {
+        println(cerr, "usage: sr-batch <scheme-file>... [--jobs FILE] [--types greedy,brute,beam] [--threads N] [--active N]");
+        println(cerr, "                [--format ssv|bitmap] [--beam-width W] [--cache DIR]");
+        return 1;
+    }
+
+    try
+    {
+        // A scheme file without a type of its own runs once per --types entry, each
+        // under its own name so the result directories stay apart.
+        vector<BatchJobDto> jobs { };
+        for (const JobSpec& spec : specs)
+        {
+            DynamicSchemeDto scheme { load_scheme_file(spec.scheme_path) };
+            if (beam_width.has_value())
+                scheme.beam_options.width = beam_width.value();
+
+            vector<SchemeType> job_types { };
+            if (spec.type.has_value())
+                job_types.push_back(spec.type.value());
+            else if (!types.empty())
+                job_types = types;
+            else
+                job_types.push_back(scheme.type);
+
+            for (SchemeType type : job_types)
+            {
+                BatchJobDto job { .scheme = scheme, .options = options };
+                job.scheme.type = type;
+                if (job_types.size() > 1)
+                    job.scheme.scheme_name = format("{}-{}", scheme.scheme_name, scheme_type_name(type));
+                jobs.push_back(job);
+            }
+        }
+
+        BatchRunner runner { batch_options };
+        BatchSummaryDto summary { runner.run(jobs) };
+
+        println("{} jobs on {} threads", summary.jobs.size(), summary.thread_count);
+        println("{:<40} {:<6} {:>22} {:>22} {:>8} {:>8} {:>8} {:>8} {:>8}", "job", "type", "sp", "sq", "start", "setup", "compute", "finish", "worker");
+        bool is_failed { false };
+        for (const BatchJobResultDto& result : summary.jobs)
+        {
+            if (!result.summary.has_value())
+            {
+                println("{:<40} {:<6} failed: {}", result.scheme_name, scheme_type_name(result.type), result.error);
+                is_failed = true;
+                continue;
+            }
+
+            const SchemeReliabilitySummaryDto& job_summary { result.summary.value() };
+            println(
+                "{:<40} {:<6} {:>22.17g} {:>22.17g} {:>8.2f} {:>8.2f} {:>8.2f} {:>8.2f} {:>8.2f}{}{}",
+                result.scheme_name, scheme_type_name(result.type), job_summary.sp, job_summary.sq,
+                seconds(result.start_ns), seconds(result.setup_ns), seconds(result.compute_ns),
+                seconds(result.finish_ns), seconds(result.worker_ns),
+                job_summary.is_cached ? " cached" : "", job_summary.is_partial ? " partial" : ""
+            );
+        }
+        println("time = {:.2f} s, pool utilization = {:.1f}%", seconds(summary.elapsed_ns), 100 * summary.pool_utilization);
+        return is_failed ? 1 : 0;
+    }
+    catch (const exception& e)
+    {
+        println(cerr, "{}", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,291 @@
+export module bench;
+
+import scheme_reliability;
+using namespace sr;
+
+import research;
+
+import std;
+
+using std::string;
+using std::vector;
+using std::span;
+using std::function;
+using std::format;
+using std::println;
+using std::ofstream;
+using std::filesystem::path;
+using std::filesystem::exists, std::filesystem::remove_all;
+using std::runtime_error;
+using std::chrono::steady_clock;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+
+export namespace bench
+{
+    struct BenchmarkConfig
+    {
+        vector<size_t> thread_counts;
+        vector<string> filters;
+        bool include_large;
+        bool keep_results;
+        path output_path;
+    };
+
+    struct BenchmarkRecord
+    {
+        string scheme_name;
+        SchemeType type;
+        size_t thread_count;
+        size_t state_count;
+        double wall_s;
+        double states_per_s;
+        double speedup;
+        bool is_phase_run;
+        PhaseTimingDto phase_timing;
+        double sp;
+        double sq;
+    };
+
+    vector<BenchmarkRecord> run_benchmarks(const BenchmarkConfig& config);
+
+    void write_json_report(const BenchmarkConfig& config, const vector<BenchmarkRecord>& records);
+}
+
+module : private;
+
+namespace bench
+{
+    using SchemeRunner = function<SchemeReliabilitySummaryDto(SchemeType, const CalculationOptionsDto&)>;
+
+    struct BenchmarkCase
+    {
+        string name;
+        size_t all_count;
+        bool is_large;
+        SchemeRunner run;
+        // The dynamic engine doesn't measure phases.
+        bool is_timing_phases { true };
+    };
+
+    template<size_t all_count, size_t processor_count>
+    SchemeRunner make_runner(SchemeDto<all_count, processor_count> scheme)
+    {
+        return [scheme](SchemeType type, const CalculationOptionsDto& options) mutable
+        {
+            scheme.type = type;
+            return calculate_scheme_reliability<all_count, processor_count>(scheme, options);
+        };
+    }
+
+    SchemeRunner make_runner(DynamicSchemeDto scheme)
+    {
+        return [scheme](SchemeType type, const CalculationOptionsDto& options) mutable
+        {
+            scheme.type = type;
+            return calculate_scheme_reliability(scheme, options);
+        };
+    }
+
+    // A generated scheme of the given size with the default generator mix, for the
+    // scaling ladder past the research schemes' processor counts.
+    DynamicSchemeDto generated_scheme(size_t all_count, size_t processor_count)
+    {
+        GeneratorOptionsDto options { };
+        options.element_count = all_count - processor_count;
+        options.processor_count = processor_count;
+        return generate_scheme(options);
+    }
+
+    template<size_t all_count, size_t processor_count>
+    SchemeDto<all_count, processor_count> synthetic_scheme()
+    {
+        constexpr size_t element_count { all_count - processor_count };
+        constexpr double q { 1e-3 };
+
+        SchemeDto<all_count, processor_count> scheme { };
+        scheme.scheme_name = format("synthetic-{}-{}", all_count, processor_count);
+
+        for (size_t i = 0; i < element_count; i++)
+            scheme.elements[i] = ElementDto { .name = format("e{}", i + 1), .p = 1.0 - q, .q = q };
+
+        for (size_t i = 0; i < processor_count; i++)
+        {
+            size_t next { (i + 1) % processor_count };
+            size_t after_next { (i + 2) % processor_count };
+            scheme.processors[i] = ProcessorDto
+            {
+                .name = format("pr{}", i + 1), .p = 1.0 - q, .q = q, .normal_load = 40, .max_load = 80,
+                .transitions =
+                {
+                    { TrUnit { next, 40 } },
+                    { TrUnit { next, 20 }, TrUnit { after_next, 20 } }
+                }
+            };
+        }
+
+        scheme.scheme_function = [](const StateVectorDto<all_count, processor_count>& sv)
+        {
+            for (size_t i = 0; i < processor_count; i++)
+                if (!sv.all[i]) return false;
+            for (size_t i = processor_count; i + 1 < all_count; i += 2)
+                if (!sv.all[i] && !sv.all[i + 1]) return false;
+            if constexpr ((all_count - processor_count) % 2 == 1)
+                return sv.all[all_count - 1];
+            return true;
+        };
+        scheme.brute_options.is_pruning_transitions = true;
+
+        return scheme;
+    }
+
+    vector<BenchmarkCase> benchmark_cases()
+    {
+        return
+        {
+            { "simple", 8, false, make_runner(research::simple_scheme()) },
+            { "synthetic-16-4", 16, false, make_runner(synthetic_scheme<16, 4>()) },
+            { "synthetic-20-4", 20, false, make_runner(synthetic_scheme<20, 4>()) },
+            { "synthetic-24-5", 24, true, make_runner(synthetic_scheme<24, 5>()) },
+            { "generated-20-6", 20, false, make_runner(generated_scheme(20, 6)), false },
+            { "generated-24-8", 24, true, make_runner(generated_scheme(24, 8)), false },
+            { "generated-28-10", 28, true, make_runner(generated_scheme(28, 10)), false },
+            { "s23-original", 23, false, make_runner(research::s23_original_scheme()) },
+            { "s23-77788", 23, false, make_runner(research::s23_rt_7_7_7_8_8_scheme()) },
+            { "s23-77788-modified-connections", 23, false, make_runner(research::s23_rt_7_7_7_8_8_modified_connections_scheme()) },
+            { "s24-d9-right", 24, true, make_runner(research::s24_d9_right_scheme()) },
+            { "s25-d9-d10-right", 25, true, make_runner(research::s25_d9_d10_right_scheme()) },
+            { "s26-final", 26, true, make_runner(research::s26_final_scheme()) },
+            { "s27-d9-d10-c7-right-c8-left", 27, true, make_runner(research::s27_d9_d10_c7_right_c8_left_scheme()) },
+            { "s29-d9-d10-c7-right-c8-left-a4", 29, true, make_runner(research::s29_d9_d10_c7_right_c8_left_a4_scheme()) }
+        };
+    }
+
+    bool is_selected(const BenchmarkConfig& config, const BenchmarkCase& benchmark_case)
+    {
+        if (config.filters.empty())
+            return config.include_large || !benchmark_case.is_large;
+
+        for (const string& filter : config.filters)
+            if (benchmark_case.name.find(filter) != string::npos)
+                return true;
+        return false;
+    }
+
+    BenchmarkRecord run_case(
+        const BenchmarkConfig& config,
+        const BenchmarkCase& benchmark_case,
+        SchemeType type,
+        size_t thread_count,
+        bool is_phase_run
+    ) {
+        CalculationOptionsDto options
+        {
+            .thread_count = thread_count,
+            .measure_phases = is_phase_run
+        };
+
+        steady_clock::time_point start { steady_clock::now() };
+        SchemeReliabilitySummaryDto summary { benchmark_case.run(type, options) };
+        double wall_s { static_cast<double>(duration_cast<nanoseconds>(steady_clock::now() - start).count()) * 1e-9 };
+
+        if (!config.keep_results && exists(summary.result_path))
+            remove_all(summary.result_path);
+
+        return BenchmarkRecord
+        {
+            .scheme_name = benchmark_case.name,
+            .type = type,
+            .thread_count = summary.thread_count,
+            .state_count = summary.state_vector_set_count,
+            .wall_s = wall_s,
+            .states_per_s = static_cast<double>(summary.state_vector_set_count) / wall_s,
+            .speedup = 1.0,
+            .is_phase_run = is_phase_run,
+            .phase_timing = summary.phase_timing,
+            .sp = summary.sp,
+            .sq = summary.sq
+        };
+    }
+
+    vector<BenchmarkRecord> run_benchmarks(const BenchmarkConfig& config)
+    {
+        vector<BenchmarkRecord> records { };
+        for (const BenchmarkCase& benchmark_case : benchmark_cases())
+        {
+            if (!is_selected(config, benchmark_case))
+                continue;
+
+            for (SchemeType type : { SchemeType::Greedy, SchemeType::Brute })
+            {
+                size_t baseline_idx { records.size() };
+                for (size_t thread_count : config.thread_counts)
+                {
+                    BenchmarkRecord record { run_case(config, benchmark_case, type, thread_count, false) };
+                    record.speedup = records.size() == baseline_idx ? 1.0 : records[baseline_idx].wall_s / record.wall_s;
+                    println(
+                        "{} {} threads = {}: {:.3f} s, {:.0f} states/s, speedup = {:.2f}",
+                        record.scheme_name, type == SchemeType::Brute ? "brute" : "greedy",
+                        record.thread_count, record.wall_s, record.states_per_s, record.speedup
+                    );
+                    records.push_back(record);
+                }
+
+                if (benchmark_case.is_timing_phases)
+                    records.push_back(run_case(config, benchmark_case, type, config.thread_counts.front(), true));
+            }
+        }
+        return records;
+    }
+
+    string escape_json(const string& value)
+    {
+        string result { };
+        for (char c : value)
+        {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result;
+    }
+
+    double ns_per_state(unsigned long long phase_ns, size_t state_count)
+    {
+        return state_count == 0 ? 0.0 : static_cast<double>(phase_ns) / static_cast<double>(state_count);
+    }
+
+    void write_json_report(const BenchmarkConfig& config, const vector<BenchmarkRecord>& records)
+    {
+        ofstream report { config.output_path, std::ios::trunc };
+        if (!report.is_open())
+            throw runtime_error(format("Error: can't open report {} for writing", config.output_path.string()));
+
+        report << "{\n  \"records\": [";
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            const BenchmarkRecord& r { records[i] };
+            report << (i == 0 ? "\n" : ",\n");
+            report << format(
+                "    {{ \"scheme\": \"{}\", \"type\": \"{}\", \"threads\": {}, \"states\": {}, "
+                "\"phase_run\": {}, \"wall_s\": {}, \"states_per_s\": {}, \"speedup\": {}, \"sp\": {}, \"sq\": {}",
+                escape_json(r.scheme_name), r.type == SchemeType::Brute ? "brute" : "greedy",
+                r.thread_count, r.state_count, r.is_phase_run, r.wall_s, r.states_per_s, r.speedup, r.sp, r.sq
+            );
+            if (r.is_phase_run)
+            {
+                report << format(
+                    ", \"ns_per_state\": {{ \"enumeration\": {}, \"probability\": {}, \"reconfiguration\": {}, "
+                    "\"evaluation\": {}, \"output\": {} }}",
+                    ns_per_state(r.phase_timing.enumeration_ns, r.state_count),
+                    ns_per_state(r.phase_timing.probability_ns, r.state_count),
+                    ns_per_state(r.phase_timing.reconfiguration_ns, r.state_count),
+                    ns_per_state(r.phase_timing.evaluation_ns, r.state_count),
+                    ns_per_state(r.phase_timing.output_ns, r.state_count)
+                );
+            }
+            report << " }";
+        }
+        report << "\n  ]\n}\n";
+    }
+}
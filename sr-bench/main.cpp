@@ -0,0 +1,71 @@
+import bench;
+
+import std;
+using std::string;
+using std::string_view;
+using std::vector;
+using std::stoul;
+using std::println;
+using std::cerr;
+
+vector<string> split(const string& value)
+{
+    vector<string> result { };
+    size_t start { 0 };
+    while (start <= value.size())
+    {
+        size_t end { value.find(',', start) };
+        if (end == string::npos)
+            end = value.size();
+        if (end > start)
+            result.push_back(value.substr(start, end - start));
+        start = end + 1;
+    }
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    bench::BenchmarkConfig config
+    {
+        .thread_counts = { },
+        .filters = { },
+        .include_large = false,
+        .keep_results = false,
+        .output_path = "bench.json"
+    };
+
+    for (int i = 1; i < argc; i++)
+    {
+        string_view arg { argv[i] };
+        if (arg == "--all")
+            config.include_large = true;
+        else if (arg == "--keep-results")
+            config.keep_results = true;
+        else if (arg == "--threads" && i + 1 < argc)
+            for (const string& count : split(argv[++i]))
+                config.thread_counts.push_back(stoul(count));
+        else if (arg == "--filter" && i + 1 < argc)
+            config.filters = split(argv[++i]);
+        else if (arg == "--output" && i + 1 < argc)
+            config.output_path = argv[++i];
+        else
+        {
+            println(cerr, "usage: sr-bench [--all] [--keep-results] [--threads 1,2,4] [--filter s23,synthetic] [--output bench.json]");
+            return 1;
+        }
+    }
+
+    if (config.thread_counts.empty())
+    {
+        config.thread_counts.push_back(1);
+        if (std::thread::hardware_concurrency() > 1)
+            config.thread_counts.push_back(std::thread::hardware_concurrency());
+    }
+
+    auto records { bench::run_benchmarks(config) };
+    bench::write_json_report(config, records);
+    println("report = {}", config.output_path.string());
+
+    return 0;
+}
@@ -7,6 +7,27 @@ export module scheme_reliability:algorithm;
 import :model;
 using namespace sr_impl::model;
 
+import :metrics;
+using namespace sr_impl::metrics;
+
+import :control;
+using namespace sr_impl::control;
+
+import :trace;
+using namespace sr_impl::trace;
+
+import :sink;
+using namespace sr_impl::sink;
+
+import :transition_table;
+using namespace sr_impl::transition_table;
+
+import :cache;
+using namespace sr_impl::cache;
+
+import :summation;
+using namespace sr_impl::summation;
+
 using namespace moodycamel;
 
 import std;
@@ -16,6 +37,7 @@ using std::vector;
 using std::span;
 using std::stack;
 using std::unordered_map;
+using std::unordered_set;
 using std::optional, std::nullopt;
 using std::pair;
 using std::ofstream;
@@ -23,14 +45,107 @@ using std::filesystem::path;
 using std::filesystem::exists, std::filesystem::remove_all, std::filesystem::create_directory;
 using std::runtime_error;
 using std::unique_ptr, std::make_unique;
+using std::shared_ptr, std::make_shared;
 using std::string;
 using std::format, std::println, std::cerr;
 using std::vformat, std::make_format_args;
 using std::thread;
+using std::atomic;
 using std::move;
+using std::memcpy;
+using std::min, std::max;
+using std::sort, std::stable_sort, std::push_heap, std::pop_heap;
+using std::swap;
+using std::chrono::steady_clock;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
 
 namespace sr_impl::algorithm
 {
+    class PhaseStopwatch
+    {
+    private:
+
+        const bool is_enabled;
+        steady_clock::time_point last;
+
+    public:
+
+        PhaseStopwatch(bool is_enabled):
+            is_enabled { is_enabled },
+            last { }
+        { }
+
+        inline void start()
+        {
+            if (is_enabled)
+                last = steady_clock::now();
+        }
+
+        inline void lap(unsigned long long& phase_ns)
+        {
+            if (!is_enabled)
+                return;
+
+            steady_clock::time_point now { steady_clock::now() };
+            phase_ns += duration_cast<nanoseconds>(now - last).count();
+            last = now;
+        }
+    };
+
+    template<size_t all_count, size_t processor_count>
+    struct ReconfigurationResult
+    {
+        StateVector<all_count, processor_count> sv2;
+        vector<AppliedTransition> transitions;
+    };
+
+    // Loads and transition usage of the states one worker reconfigured, weighted by
+    // state probability; transition_usage follows the scheme's declared tables.
+    template<size_t processor_count>
+    struct LoadStatisticsAccumulator
+    {
+        array<double, processor_count> expected_load { };
+        array<double, processor_count> overload_probability { };
+        array<array<double, LOAD_HISTOGRAM_BIN_COUNT>, processor_count> load_histograms { };
+        array<vector<TransitionUsage>, processor_count> transition_usage { };
+
+        void merge(const LoadStatisticsAccumulator& other)
+        {
+            for (size_t i = 0; i < processor_count; i++)
+            {
+                expected_load[i] += other.expected_load[i];
+                overload_probability[i] += other.overload_probability[i];
+                for (size_t b = 0; b < LOAD_HISTOGRAM_BIN_COUNT; b++)
+                    load_histograms[i][b] += other.load_histograms[i][b];
+                for (size_t t = 0; t < transition_usage[i].size(); t++)
+                {
+                    transition_usage[i][t].state_count += other.transition_usage[i][t].state_count;
+                    transition_usage[i][t].probability += other.transition_usage[i][t].probability;
+                    transition_usage[i][t].successful_probability += other.transition_usage[i][t].successful_probability;
+                }
+            }
+        }
+
+        template<size_t all_count>
+        LoadStatistics make_load_statistics(const Scheme<all_count, processor_count>& scheme) const
+        {
+            LoadStatistics statistics { .processors = { }, .transitions = { } };
+            for (size_t i = 0; i < processor_count; i++)
+            {
+                statistics.processors.push_back(ProcessorLoadStatistics
+                {
+                    .name = scheme.processors[i].name,
+                    .expected_load = expected_load[i],
+                    .overload_probability = overload_probability[i],
+                    .load_histogram = load_histograms[i]
+                });
+                statistics.transitions.insert(statistics.transitions.end(), transition_usage[i].begin(), transition_usage[i].end());
+            }
+            return statistics;
+        }
+    };
+
     template<size_t all_count, size_t processor_count>
     class ReconfigurationTable
     {
@@ -41,23 +156,29 @@ namespace sr_impl::algorithm
 
     protected:
 
+        static constexpr double OVERLOAD_COEFFICIENT { 1e6 };
+
         array<double, processor_count> normal_load;
         array<double, processor_count> max_load;
 
         vector<TransitionSet> table;
+        // The scheme's tables as declared; table may be normalized from them.
+        vector<TransitionSet> declared_table;
 
         ReconfigurationTable(
             const Scheme<all_count, processor_count>& scheme
         ):
             normal_load { },
             max_load { },
-            table(scheme.processors.size())
+            table(scheme.processors.size()),
+            declared_table(scheme.processors.size())
         {
             for (size_t i = 0; i < processor_count; i++)
             {
                 normal_load[i] = scheme.processors[i].normal_load;
                 max_load[i] = scheme.processors[i].max_load;
                 table[i] = scheme.processors[i].transitions;
+                declared_table[i] = scheme.processors[i].transitions;
             }
         }
 
@@ -76,8 +197,105 @@ namespace sr_impl::algorithm
             const StateVector<all_count, processor_count>& sv1
         ) const = 0;
 
+        // Same decision as reconfigure_state, also reporting the transitions it applied;
+        // slower, meant for the handful of states a report explains.
+        virtual ReconfigurationResult<all_count, processor_count> explain_reconfiguration(
+            const StateVector<all_count, processor_count>& sv1
+        ) const = 0;
+
+        bool requires_reconfiguration(
+            const StateVector<all_count, processor_count>& sv1
+        ) const {
+            for (size_t i = 0; i < processor_count; i++)
+                if (sv1.processors[i] == 0 && !table[i].empty())
+                    return true;
+            return false;
+        }
+
+        LoadStatisticsAccumulator<processor_count> make_load_statistics_accumulator() const
+        {
+            LoadStatisticsAccumulator<processor_count> accumulator { };
+            for (size_t i = 0; i < processor_count; i++)
+                for (size_t t = 0; t < declared_table[i].size(); t++)
+                    accumulator.transition_usage[i].push_back(TransitionUsage
+                    {
+                        .processor_idx = i,
+                        .transition_idx = t,
+                        .transition = declared_table[i][t],
+                        .state_count = 0,
+                        .probability = 0,
+                        .successful_probability = 0
+                    });
+            return accumulator;
+        }
+
+        // Same decision as reconfigure_state, adding the state's loads and applied
+        // transitions to accumulator; goes through explain_reconfiguration.
+        StateVector<all_count, processor_count> reconfigure_state_with_statistics(
+            const StateVector<all_count, processor_count>& sv1,
+            double probability,
+            LoadStatisticsAccumulator<processor_count>& accumulator
+        ) const {
+            ReconfigurationResult<all_count, processor_count> result
+            {
+                requires_reconfiguration(sv1)
+                    ? explain_reconfiguration(sv1)
+                    : ReconfigurationResult<all_count, processor_count> { .sv2 = sv1, .transitions = { } }
+            };
+
+            array<double, processor_count> load { };
+            for (size_t i = 0; i < processor_count; i++)
+                load[i] = sv1.processors[i] ? normal_load[i] : 0.0;
+            for (const AppliedTransition& applied : result.transitions)
+            {
+                apply_transition_to_load(applied.transition, load, 1.0);
+                TransitionUsage& usage { accumulator.transition_usage[applied.processor_idx][transition_idx(applied)] };
+                usage.state_count++;
+                usage.probability += probability;
+                if (applied.is_successful)
+                    usage.successful_probability += probability;
+            }
+
+            for (size_t i = 0; i < processor_count; i++)
+            {
+                if (!sv1.processors[i])
+                    continue;
+                double relative_load { load[i] / max_load[i] };
+                size_t bin
+                {
+                    relative_load > 1.0
+                        ? LOAD_HISTOGRAM_BIN_COUNT - 1
+                        : min(LOAD_HISTOGRAM_BIN_COUNT - 2, static_cast<size_t>(relative_load * (LOAD_HISTOGRAM_BIN_COUNT - 1)))
+                };
+                accumulator.load_histograms[i][bin] += probability;
+                if (result.sv2.processors[i])
+                    accumulator.expected_load[i] += probability * load[i];
+                else
+                    accumulator.overload_probability[i] += probability;
+            }
+            return result.sv2;
+        }
+
     protected:
 
+        // Index in declared_table of a transition explain_reconfiguration applied, which
+        // may be a copy. A normalized table keeps the first of identical transitions.
+        size_t transition_idx(const AppliedTransition& applied) const
+        {
+            const TransitionSet& transitions { declared_table[applied.processor_idx] };
+            for (size_t t = 0; t < transitions.size(); t++)
+            {
+                if (transitions[t].size() != applied.transition.size())
+                    continue;
+                bool is_same { true };
+                for (size_t j = 0; j < transitions[t].size() && is_same; j++)
+                    is_same = transitions[t][j].index == applied.transition[j].index && transitions[t][j].load == applied.transition[j].load;
+                if (is_same)
+                    return t;
+            }
+            throw runtime_error("Error: applied transition is not in the reconfiguration table");
+        }
+
         void apply_transition_to_load(
             const Transition& transition,
             array<double, processor_count>& load,
@@ -108,11 +326,31 @@ namespace sr_impl::algorithm
                     return false;
             return true;
         }
+
+        double load_score(
+            const array<double, processor_count>& load, size_t transition_size
+        ) const {
+            double result { 0 };
+            for (size_t i = 0; i < processor_count; i++)
+            {
+                double temp { load[i] / max_load[i] };
+                if (temp > 1.0) temp *= OVERLOAD_COEFFICIENT;
+                result += temp;
+            }
+            result /= static_cast<double>(transition_size);
+            return result;
+        }
     };
 
+    // Searches the failed processors in greedy's order and tries the transitions of
+    // each by greedy's load score, so the first leaf is greedy's choice and a state
+    // greedy already recovers costs a single leaf. Leaves only differ in processor
+    // bits; the masks the scheme function rejected are remembered within the state.
     template<size_t all_count, size_t processor_count>
     class BruteForceReconfigurationTable : public ReconfigurationTable<all_count, processor_count>
     {
+        static_assert(processor_count <= 64, "rejected leaves are tracked as 64-bit processor masks");
+
     private:
 
         const SchemeFunction<all_count, processor_count> scheme_function;
@@ -122,6 +360,10 @@ namespace sr_impl::algorithm
             StateVector<all_count, processor_count> best;
             StateVector<all_count, processor_count> best_zero;
             long long best_zero_active_count;
+            bool is_capturing_transitions;
+            vector<AppliedTransition> best_transitions;
+            vector<AppliedTransition> best_zero_transitions;
+            unordered_set<unsigned long long> rejected_masks;
         };
 
     public:
@@ -131,17 +373,34 @@ namespace sr_impl::algorithm
         ):
             ReconfigurationTable<all_count, processor_count> { scheme },
             scheme_function { scheme.scheme_function }
-        { }
+        {
+            this->table = normalize_transition_table(scheme).table;
+        }
 
         StateVector<all_count, processor_count> reconfigure_state(
             const StateVector<all_count, processor_count>& sv1
         ) const override {
+            return reconfigure(sv1, false).sv2;
+        }
+
+        ReconfigurationResult<all_count, processor_count> explain_reconfiguration(
+            const StateVector<all_count, processor_count>& sv1
+        ) const override {
+            return reconfigure(sv1, true);
+        }
+
+    private:
+
+        ReconfigurationResult<all_count, processor_count> reconfigure(
+            const StateVector<all_count, processor_count>& sv1,
+            bool is_capturing_transitions
+        ) const {
             stack<size_t> failed_processors_indexes { };
-            for (size_t i = 0; i < processor_count; i++)
+            for (size_t i = processor_count; i-- > 0;)
                 if (sv1.processors[i] == 0 && !this->table[i].empty())
                     failed_processors_indexes.push(i);
             if (failed_processors_indexes.empty())
-                return sv1;
+                return { .sv2 = sv1, .transitions = { } };
 
             unordered_map<size_t, const Transition*> applied_transitions { };
             array<double, processor_count> reconfiguration_load { this->normal_load };
@@ -149,7 +408,11 @@ namespace sr_impl::algorithm
             {
                 .best = { },
                 .best_zero = { },
-                .best_zero_active_count = -1
+                .best_zero_active_count = -1,
+                .is_capturing_transitions = is_capturing_transitions,
+                .best_transitions = { },
+                .best_zero_transitions = { },
+                .rejected_masks = { }
             };
             bool is_success
             {
@@ -163,14 +426,12 @@ namespace sr_impl::algorithm
             };
 
             if (is_success)
-                return result.best;
+                return { .sv2 = result.best, .transitions = move(result.best_transitions) };
             else if (result.best_zero_active_count == -1)
-                return sv1;
+                return { .sv2 = sv1, .transitions = { } };
             else
-                return result.best_zero;
+                return { .sv2 = result.best_zero, .transitions = move(result.best_zero_transitions) };
         }
-
-    private:
         
         bool traverse_reconfiguration_tree(
             const StateVector<all_count, processor_count>& sv1,
@@ -200,16 +461,28 @@ namespace sr_impl::algorithm
                     }
                 }
 
+                unsigned long long processor_mask { 0 };
+                for (size_t i = 0; i < processor_count; i++)
+                    if (sv2.processors[i])
+                        processor_mask |= 1ull << i;
+                if (result.rejected_masks.contains(processor_mask))
+                    return false;
+
                 if (scheme_function(sv2))
                 {
+                    if (result.is_capturing_transitions)
+                        result.best_transitions = capture_transitions(sv1, sv2, applied_transitions);
                     result.best = move(sv2);
                     return true;
                 }
                 else
                 {
+                    result.rejected_masks.insert(processor_mask);
                     long long current_active_count { static_cast<long long>(count(sv2.processors.begin(), sv2.processors.end(), true)) };
                     if (current_active_count > result.best_zero_active_count)
                     {
+                        if (result.is_capturing_transitions)
+                            result.best_zero_transitions = capture_transitions(sv1, sv2, applied_transitions);
                         result.best_zero = move(sv2);
                         result.best_zero_active_count = current_active_count;
                     }
@@ -219,39 +492,76 @@ namespace sr_impl::algorithm
 
             size_t current_processor_index { failed_processor_indexes.top() };
             failed_processor_indexes.pop();
-            for (const Transition& transition : this->table[current_processor_index])
+            const TransitionSet& transitions { this->table[current_processor_index] };
+            vector<pair<double, const Transition*>> scored_transitions { score_transitions(sv1, transitions, reconfiguration_load) };
+            for (const auto& [score, transition] : scored_transitions)
             {
-                if (!this->is_transition_valid(sv1, transition))
-                {
-                    if (traverse_reconfiguration_tree(
-                        sv1, failed_processor_indexes, applied_transitions, reconfiguration_load, result
-                    )) return true;
-                    else continue;
-                }
-
-                applied_transitions[current_processor_index] = &transition;
-                this->apply_transition_to_load(transition, reconfiguration_load, 1.0);
+                applied_transitions[current_processor_index] = transition;
+                this->apply_transition_to_load(*transition, reconfiguration_load, 1.0);
 
                 if (traverse_reconfiguration_tree(
                     sv1, failed_processor_indexes,
                     applied_transitions, reconfiguration_load, result
                 )) return true;
 
-                this->apply_transition_to_load(transition, reconfiguration_load, -1.0);
+                this->apply_transition_to_load(*transition, reconfiguration_load, -1.0);
                 applied_transitions.erase(current_processor_index);
             }
+
+            // Every invalid transition leaves the processor failed; that subtree is
+            // searched once, after the valid transitions.
+            if (scored_transitions.size() < transitions.size() &&
+                traverse_reconfiguration_tree(
+                    sv1, failed_processor_indexes, applied_transitions, reconfiguration_load, result
+                )) return true;
+
             failed_processor_indexes.push(current_processor_index);
             return false;
         }
+
+        // Valid transitions by ascending load score; equal scores keep the later
+        // transition first, as greedy's score map does.
+        vector<pair<double, const Transition*>> score_transitions(
+            const StateVector<all_count, processor_count>& sv1,
+            const TransitionSet& transitions,
+            const array<double, processor_count>& reconfiguration_load
+        ) const {
+            vector<pair<double, const Transition*>> result { };
+            for (size_t t = transitions.size(); t-- > 0;)
+            {
+                if (!this->is_transition_valid(sv1, transitions[t]))
+                    continue;
+
+                array<double, processor_count> temp_load { reconfiguration_load };
+                this->apply_transition_to_load(transitions[t], temp_load, 1.0);
+                result.push_back({ this->load_score(temp_load, transitions[t].size()), &transitions[t] });
+            }
+            stable_sort(
+                result.begin(), result.end(),
+                [](const pair<double, const Transition*>& a, const pair<double, const Transition*>& b) { return a.first < b.first; }
+            );
+            return result;
+        }
+
+        vector<AppliedTransition> capture_transitions(
+            const StateVector<all_count, processor_count>& sv1,
+            const StateVector<all_count, processor_count>& sv2,
+            const unordered_map<size_t, const Transition*>& applied_transitions
+        ) const {
+            vector<AppliedTransition> result { };
+            for (size_t i = 0; i < processor_count; i++)
+            {
+                auto it { applied_transitions.find(i) };
+                if (it != applied_transitions.end() && sv1.processors[i] == 0)
+                    result.push_back(AppliedTransition { .processor_idx = i, .transition = *it->second, .is_successful = sv2.processors[i] == 1 });
+            }
+            return result;
+        }
     };
 
     template<size_t all_count, size_t processor_count>
     class GreedyReconfigurationTable : public ReconfigurationTable<all_count, processor_count>
     {
-    private:
-
-        static constexpr double OVERLOAD_COEFFICIENT { 1e6 };
-
     public:
 
         GreedyReconfigurationTable(
@@ -263,6 +573,23 @@ namespace sr_impl::algorithm
         StateVector<all_count, processor_count> reconfigure_state(
             const StateVector<all_count, processor_count>& sv1
         ) const override {
+            return reconfigure(sv1, nullptr);
+        }
+
+        ReconfigurationResult<all_count, processor_count> explain_reconfiguration(
+            const StateVector<all_count, processor_count>& sv1
+        ) const override {
+            vector<AppliedTransition> applied_transitions { };
+            StateVector<all_count, processor_count> sv2 { reconfigure(sv1, &applied_transitions) };
+            return { .sv2 = sv2, .transitions = move(applied_transitions) };
+        }
+
+    private:
+
+        StateVector<all_count, processor_count> reconfigure(
+            const StateVector<all_count, processor_count>& sv1,
+            vector<AppliedTransition>* applied_transitions
+        ) const {
             array<double, processor_count> reconfiguration_load { this->normal_load };
 
             unordered_map<size_t, optional<Transition>> transitions { };
@@ -285,11 +612,17 @@ namespace sr_impl::algorithm
                     sv2.processors[i] = 1;
                 }
             }
+
+            if (applied_transitions != nullptr)
+                for (size_t i = 0; i < processor_count; i++)
+                    if (transitions[i].has_value())
+                        applied_transitions->push_back(
+                            AppliedTransition { .processor_idx = i, .transition = transitions[i].value(), .is_successful = sv2.processors[i] == 1 }
+                        );
+
             return sv2;
         }
 
-    private:
-
         optional<Transition> update_reconfiguration_load(
             const StateVector<all_count, processor_count>& sv,
             array<double, processor_count>& reconfiguration_load,
@@ -305,7 +638,7 @@ namespace sr_impl::algorithm
 
                 this->apply_transition_to_load(transition, temp_load, 1.0);
 
-                double score { load_score(temp_load, transition.size()) };
+                double score { this->load_score(temp_load, transition.size()) };
 
                 score_transition[score] = &transition;
             }
@@ -330,86 +663,461 @@ namespace sr_impl::algorithm
                 return nullopt;
             }
         }
+    };
 
-        double load_score(
-            const array<double, processor_count>& load, size_t transition_size
+    // Keeps the width best partial assignments while walking the failed processors in
+    // greedy's order. Children of the whole beam are ranked by the load score of the
+    // assignment they extend; the best child of the leading node always stays first, so
+    // the leading node follows greedy's choices and the beam never loses a state greedy
+    // keeps. Every complete assignment is a leaf of the brute force search, the first
+    // the scheme function accepts wins, otherwise the one with most working processors.
+    template<size_t all_count, size_t processor_count>
+    class BeamSearchReconfigurationTable : public ReconfigurationTable<all_count, processor_count>
+    {
+    private:
+
+        const SchemeFunction<all_count, processor_count> scheme_function;
+        const BeamOptions options;
+
+        struct BeamNode
+        {
+            array<double, processor_count> load;
+            array<const Transition*, processor_count> applied_transitions;
+        };
+
+        struct BeamChild
+        {
+            size_t node_idx;
+            const Transition* transition;
+            double score;
+        };
+
+    public:
+
+        BeamSearchReconfigurationTable(
+            const Scheme<all_count, processor_count>& scheme
+        ):
+            ReconfigurationTable<all_count, processor_count> { scheme },
+            scheme_function { scheme.scheme_function },
+            options { scheme.beam_options }
+        {
+            if (options.width == 0)
+                throw runtime_error(format("Error: beam width of scheme {} must be positive", scheme.scheme_name));
+        }
+
+        StateVector<all_count, processor_count> reconfigure_state(
+            const StateVector<all_count, processor_count>& sv1
+        ) const override {
+            return reconfigure(sv1, false).sv2;
+        }
+
+        ReconfigurationResult<all_count, processor_count> explain_reconfiguration(
+            const StateVector<all_count, processor_count>& sv1
+        ) const override {
+            return reconfigure(sv1, true);
+        }
+
+    private:
+
+        ReconfigurationResult<all_count, processor_count> reconfigure(
+            const StateVector<all_count, processor_count>& sv1,
+            bool is_capturing_transitions
         ) const {
-            double result { 0 };
+            if (!this->requires_reconfiguration(sv1))
+                return { .sv2 = sv1, .transitions = { } };
+
+            vector<BeamNode> beam { BeamNode { .load = this->normal_load, .applied_transitions = { } } };
+            vector<BeamNode> next_beam { };
+            vector<BeamChild> children { };
+            size_t expanded_node_count { 0 };
             for (size_t i = 0; i < processor_count; i++)
             {
-                double temp { load[i] / this->max_load[i] };
-                if (temp > 1.0) temp *= OVERLOAD_COEFFICIENT;
-                result += temp;
+                if (sv1.processors[i] == 1 || this->table[i].empty())
+                    continue;
+
+                size_t width { expanded_node_count < options.max_expanded_node_count ? options.width : 1 };
+                children.clear();
+                for (size_t n = 0; n < beam.size() && n < width; n++)
+                {
+                    expand_node(sv1, beam[n], n, this->table[i], children);
+                    expanded_node_count += this->table[i].size();
+                }
+
+                // The leading node's best child is the first child of node 0 with the
+                // lowest score, later transitions winning ties as in greedy's score map.
+                size_t leading_child_idx { 0 };
+                for (size_t c = 1; c < children.size() && children[c].node_idx == 0; c++)
+                    if (children[c].score <= children[leading_child_idx].score)
+                        leading_child_idx = c;
+                swap(children[0], children[leading_child_idx]);
+                stable_sort(
+                    children.begin() + 1, children.end(),
+                    [](const BeamChild& a, const BeamChild& b) { return a.score < b.score; }
+                );
+
+                next_beam.clear();
+                for (size_t c = 0; c < children.size() && next_beam.size() < width; c++)
+                {
+                    BeamNode child { beam[children[c].node_idx] };
+                    if (children[c].transition != nullptr)
+                    {
+                        child.applied_transitions[i] = children[c].transition;
+                        this->apply_transition_to_load(*children[c].transition, child.load, 1.0);
+                    }
+                    next_beam.push_back(child);
+                }
+                swap(beam, next_beam);
             }
-            result /= static_cast<double>(transition_size);
+
+            size_t fallback_idx { 0 };
+            long long fallback_active_count { -1 };
+            StateVector<all_count, processor_count> fallback { };
+            for (size_t n = 0; n < beam.size(); n++)
+            {
+                StateVector<all_count, processor_count> sv2 { complete_assignment(sv1, beam[n]) };
+                if (scheme_function(sv2))
+                    return make_result(sv1, sv2, beam[n], is_capturing_transitions);
+
+                long long active_count { static_cast<long long>(count(sv2.processors.begin(), sv2.processors.end(), true)) };
+                if (active_count > fallback_active_count)
+                {
+                    fallback_idx = n;
+                    fallback_active_count = active_count;
+                    fallback = sv2;
+                }
+            }
+            return make_result(sv1, fallback, beam[fallback_idx], is_capturing_transitions);
+        }
+
+        // A node without a valid transition for the processor passes on unchanged.
+        void expand_node(
+            const StateVector<all_count, processor_count>& sv1,
+            const BeamNode& node,
+            size_t node_idx,
+            const TransitionSet& transitions,
+            vector<BeamChild>& children
+        ) const {
+            bool has_valid_transition { false };
+            for (const Transition& transition : transitions)
+            {
+                if (!this->is_transition_valid(sv1, transition))
+                    continue;
+
+                array<double, processor_count> temp_load { node.load };
+                this->apply_transition_to_load(transition, temp_load, 1.0);
+                children.push_back(BeamChild { .node_idx = node_idx, .transition = &transition, .score = this->load_score(temp_load, transition.size()) });
+                has_valid_transition = true;
+            }
+            if (!has_valid_transition)
+                children.push_back(BeamChild { .node_idx = node_idx, .transition = nullptr, .score = this->load_score(node.load, 1) });
+        }
+
+        StateVector<all_count, processor_count> complete_assignment(
+            const StateVector<all_count, processor_count>& sv1,
+            const BeamNode& node
+        ) const {
+            StateVector<all_count, processor_count> sv2 { sv1 };
+            for (size_t i = 0; i < processor_count; i++)
+            {
+                if (sv1.processors[i] == 1 && node.load[i] > this->max_load[i])
+                    sv2.processors[i] = 0;
+                else if (node.applied_transitions[i] != nullptr &&
+                         this->is_transition_successful(sv1, *node.applied_transitions[i], node.load))
+                    sv2.processors[i] = 1;
+            }
+            return sv2;
+        }
+
+        ReconfigurationResult<all_count, processor_count> make_result(
+            const StateVector<all_count, processor_count>& sv1,
+            const StateVector<all_count, processor_count>& sv2,
+            const BeamNode& node,
+            bool is_capturing_transitions
+        ) const {
+            ReconfigurationResult<all_count, processor_count> result { .sv2 = sv2, .transitions = { } };
+            if (is_capturing_transitions)
+                for (size_t i = 0; i < processor_count; i++)
+                    if (node.applied_transitions[i] != nullptr && sv1.processors[i] == 0)
+                        result.transitions.push_back(
+                            AppliedTransition { .processor_idx = i, .transition = *node.applied_transitions[i], .is_successful = sv2.processors[i] == 1 }
+                        );
             return result;
         }
     };
 
+    template<size_t all_count, size_t processor_count>
+    unique_ptr<ReconfigurationTable<all_count, processor_count>> make_reconfiguration_table(
+        const Scheme<all_count, processor_count>& scheme
+    ) {
+        ReconfigurationTable<all_count, processor_count>* reconfiguration_table_memory;
+        if (scheme.type == SchemeType::Brute)
+            reconfiguration_table_memory = new BruteForceReconfigurationTable<all_count, processor_count>(scheme);
+        else if (scheme.type == SchemeType::Beam)
+            reconfiguration_table_memory = new BeamSearchReconfigurationTable<all_count, processor_count>(scheme);
+        else
+            reconfiguration_table_memory = new GreedyReconfigurationTable<all_count, processor_count>(scheme);
+        return unique_ptr<ReconfigurationTable<all_count, processor_count>> { reconfiguration_table_memory };
+    }
+
+    // Evaluates every state with at most max_order failed elements exactly and treats
+    // the rest as unknown. The truncated mass is the Poisson-binomial tail of the
+    // failure count, so the bounds hold without assuming a monotone reconfiguration.
+    template<size_t all_count, size_t processor_count>
+    class ReliabilityBoundEstimator
+    {
+    private:
+
+        const Scheme<all_count, processor_count>& scheme;
+        const ReconfigurationTable<all_count, processor_count>& reconfiguration_table;
+        const BoundOptions options;
+
+        array<double, all_count> p;
+        array<double, all_count> q;
+
+        StateVector<all_count, processor_count> sv1;
+        ReliabilityBounds bounds;
+
+    public:
+
+        ReliabilityBoundEstimator(
+            const Scheme<all_count, processor_count>& scheme,
+            const ReconfigurationTable<all_count, processor_count>& reconfiguration_table,
+            const BoundOptions& options
+        ):
+            scheme { scheme },
+            reconfiguration_table { reconfiguration_table },
+            options { options },
+            p { }, q { },
+            sv1 { },
+            bounds
+            {
+                .max_order = min(options.max_order, all_count),
+                .evaluated_state_count = 0,
+                .sp = 0,
+                .sq = 0,
+                .truncated_probability = 0,
+                .sp_low = 0,
+                .sp_high = 0
+            }
+        {
+            for (size_t i = 0; i < processor_count; i++)
+            {
+                p[i] = scheme.processors[i].p;
+                q[i] = scheme.processors[i].q;
+            }
+            for (size_t i = processor_count; i < all_count; i++)
+            {
+                p[i] = scheme.elements[i - processor_count].p;
+                q[i] = scheme.elements[i - processor_count].q;
+            }
+        }
+
+        ReliabilityBounds estimate()
+        {
+            for (size_t i = 0; i < all_count; i++)
+                sv1.all[i] = true;
+            visit_failures(0, bounds.max_order);
+
+            bounds.truncated_probability = truncated_probability();
+            bounds.sp_low = bounds.sp;
+            bounds.sp_high = min(1.0, bounds.sp + bounds.truncated_probability);
+            return bounds;
+        }
+
+    private:
+
+        void visit_failures(size_t first_idx, size_t remaining)
+        {
+            evaluate_state();
+            if (remaining == 0)
+                return;
+
+            for (size_t i = first_idx; i < all_count; i++)
+            {
+                sv1.all[i] = false;
+                visit_failures(i + 1, remaining - 1);
+                sv1.all[i] = true;
+            }
+        }
+
+        void evaluate_state()
+        {
+            double probability { 1.0 };
+            for (size_t i = 0; i < all_count; i++)
+                probability *= sv1.all[i] ? p[i] : q[i];
+
+            bool scheme_state
+            {
+                reconfiguration_table.requires_reconfiguration(sv1)
+                    ? scheme.scheme_function(reconfiguration_table.reconfigure_state(sv1))
+                    : scheme.scheme_function(sv1)
+            };
+            if (scheme_state)
+                bounds.sp += probability;
+            else
+                bounds.sq += probability;
+            bounds.evaluated_state_count++;
+        }
+
+        // exactly[j] is the mass of states with j failures among the elements seen so far;
+        // tail collects everything beyond max_order without subtracting from the total.
+        double truncated_probability() const
+        {
+            vector<double> exactly(bounds.max_order + 1, 0.0);
+            exactly[0] = 1.0;
+            double tail { 0 };
+            for (size_t i = 0; i < all_count; i++)
+            {
+                tail = tail * (p[i] + q[i]) + exactly[bounds.max_order] * q[i];
+                for (size_t j = bounds.max_order; j > 0; j--)
+                    exactly[j] = exactly[j] * p[i] + exactly[j - 1] * q[i];
+                exactly[0] *= p[i];
+            }
+            return tail;
+        }
+    };
+
+    template<size_t all_count, size_t processor_count>
+    ReliabilityBounds estimate_reliability_bounds(
+        const Scheme<all_count, processor_count>& scheme,
+        const BoundOptions& options
+    ) {
+        unique_ptr<ReconfigurationTable<all_count, processor_count>> reconfiguration_table { make_reconfiguration_table(scheme) };
+        ReliabilityBoundEstimator<all_count, processor_count> estimator { scheme, *reconfiguration_table, options };
+        return estimator.estimate();
+    }
+
+    template<size_t all_count, size_t processor_count>
+    struct FailureCandidate
+    {
+        double probability;
+        StateVector<all_count, processor_count> sv1;
+        StateVector<all_count, processor_count> sv2;
+
+        // Ties are broken by sv1 so the kept set does not depend on thread scheduling.
+        static bool is_more_probable(const FailureCandidate& a, const FailureCandidate& b)
+        {
+            return a.probability > b.probability || (a.probability == b.probability && a.sv1.sv > b.sv1.sv);
+        }
+    };
+
+    template<size_t all_count, size_t processor_count>
+    struct StateVectorChunk
+    {
+        static constexpr size_t MAX_DEPTH { 12 };
+        static constexpr size_t depth { all_count < MAX_DEPTH ? all_count : MAX_DEPTH };
+        static constexpr size_t size { static_cast<size_t>(1) << depth };
+
+        StateVector<all_count, processor_count> prefix;
+        size_t first_state_index;
+    };
+
     template<size_t all_count, size_t processor_count>
     class StateVectorProcessor
     {
     private:
 
-        static constexpr size_t INITIAL_QUEUE_SIZE { 1024 };
+        using Chunk = StateVectorChunk<all_count, processor_count>;
 
+        static constexpr size_t INITIAL_QUEUE_SIZE { 64 };
+
+        const size_t processor_idx;
         const ReconfigurationTable<all_count, processor_count>& reconfiguration_table;
         const span<double> p;
         const span<double> q;
         const SchemeFunction<all_count, processor_count> scheme_function;
-
-        unique_ptr<char[]> buffer;
-        ofstream data_file;
-        bool is_end;
+        const bool measure_phases;
+        const size_t top_failure_state_count;
+        optional<LoadStatisticsAccumulator<processor_count>> load_statistics;
+        RangeSums& range_sums;
+        ConsumerCounters& counters;
+        ProducerCounters& producer_counters;
+        RunControl& run_control;
+        Tracer& tracer;
+
+        unique_ptr<ResultSink<all_count, processor_count>> result_sink;
+        atomic<bool> is_end;
         thread processor_thread;
 
-        ReaderWriterQueue<unique_ptr<StateVector<all_count, processor_count>>> queue;
+        ReaderWriterQueue<Chunk> queue;
         bool is_queue_empty;
 
+        ScoredStateVectorBatch<all_count, processor_count> batch;
+        vector<FailureCandidate<all_count, processor_count>> top_failure_candidates;
+
         SchemeReliabilitySummary scheme_reliability_summary;
 
     public:
 
         StateVectorProcessor(
+            size_t processor_idx,
             const ReconfigurationTable<all_count, processor_count>& reconfiguration_table,
             const span<double> p,
             const span<double> q,
             const SchemeFunction<all_count, processor_count> scheme_function,
-            path data_file_path,
-            size_t buffer_size
+            unique_ptr<ResultSink<all_count, processor_count>> result_sink,
+            bool measure_phases,
+            size_t top_failure_state_count,
+            bool collect_load_statistics,
+            RangeSums& range_sums,
+            WorkerCounters& worker_counters,
+            RunControl& run_control,
+            Tracer& tracer
         ):
+            processor_idx { processor_idx },
             reconfiguration_table { reconfiguration_table },
             p { p }, q { q }, scheme_function { scheme_function },
-            buffer { new char[buffer_size] },
-            data_file { data_file_path, std::ios::binary },
+            measure_phases { measure_phases },
+            top_failure_state_count { top_failure_state_count },
+            load_statistics
+            {
+                collect_load_statistics
+                    ? optional<LoadStatisticsAccumulator<processor_count>> { reconfiguration_table.make_load_statistics_accumulator() }
+                    : nullopt
+            },
+            range_sums { range_sums },
+            counters { worker_counters.consumer },
+            producer_counters { worker_counters.producer },
+            run_control { run_control },
+            tracer { tracer },
+            result_sink { move(result_sink) },
             is_end { false },
             processor_thread { },
             queue(INITIAL_QUEUE_SIZE), is_queue_empty { false },
+            batch(Chunk::size),
+            top_failure_candidates { },
             scheme_reliability_summary
             {
                 .sp = 0, .sq = 0,
                 .state_vector_set_count = 0,
-                .result_path = data_file_path
+                .result_path = this->result_sink->get_path()
             }
+        { }
+
+        inline const SchemeReliabilitySummary& get_scheme_reliability_summary() const
         {
-            if (!data_file.is_open())
-            {
-                string msg { format("Error: can't open data_file {} for writing", data_file_path.string()) };
-                //println(cerr, msg);
-                throw runtime_error(msg);
-            }
+            return scheme_reliability_summary;
+        }
 
-            data_file.rdbuf()->pubsetbuf(buffer.get(), buffer_size);
+        inline const vector<FailureCandidate<all_count, processor_count>>& get_top_failure_candidates() const
+        {
+            return top_failure_candidates;
         }
 
-        inline const SchemeReliabilitySummary& get_scheme_reliability_summary() const
+        inline const optional<LoadStatisticsAccumulator<processor_count>>& get_load_statistics() const
         {
-            return scheme_reliability_summary;
+            return load_statistics;
         }
 
-        void assign_for_processment(const StateVector<all_count, processor_count>& sv)
+        void assign_for_processment(const Chunk& chunk)
         {
-            queue.enqueue(unique_ptr<StateVector<all_count, processor_count>>(new StateVector<all_count, processor_count>(sv)));
+            // try_enqueue fails when the current block is full and the queue has to allocate.
+            if (!queue.try_enqueue(chunk))
+            {
+                producer_counters.enqueue_stalls.add(1);
+                queue.enqueue(chunk);
+            }
+            producer_counters.states_enqueued.add(Chunk::size);
         }
 
         void start()
@@ -418,65 +1126,153 @@ namespace sr_impl::algorithm
             {
                 [this]()
                 {
-                    while (!is_end || !is_queue_empty)
+                    TraceBuffer* trace_buffer { tracer.register_thread(format("worker {}", processor_idx)) };
+                    steady_clock::time_point idle_start { };
+                    while (!run_control.is_stopped())
                     {
-                        unique_ptr<StateVector<all_count, processor_count>> psv { };
-                        if (queue.try_dequeue(psv))
+                        // Every chunk is enqueued before is_end is set, so a failed dequeue after
+                        // observing is_end means the queue has been drained.
+                        bool is_end_observed { is_end.load(std::memory_order_acquire) };
+                        Chunk chunk { };
+                        if (queue.try_dequeue(chunk))
                         {
+                            if (is_queue_empty)
+                                counters.idle_ns.add(duration_cast<nanoseconds>(steady_clock::now() - idle_start).count());
                             is_queue_empty = false;
                         }
+                        else if (is_end_observed)
+                            break;
                         else
                         {
+                            if (!is_queue_empty)
+                                idle_start = steady_clock::now();
                             is_queue_empty = true;
+                            counters.idle_spins.add(1);
+                            run_control.poll();
                             continue;
                         }
 
-                        const StateVector<all_count, processor_count>& sv1 { *psv };
-                        StateVector<all_count, processor_count> sv2 { reconfiguration_table.reconfigure_state(sv1) };
-
-                        bool scheme_state_sv1 { scheme_function(sv1) };
-                        bool scheme_state_sv2 { scheme_function(sv2) };
-                        bool scheme_state { scheme_state_sv1 || scheme_state_sv2 };
-                        double probability { calculate_probability(sv1) };
-
-                        ScoredStateVector<all_count, processor_count> ssv
-                        {
-                            .scheme_state_sv1 = scheme_state_sv1,
-                            .scheme_state_sv2 = scheme_state_sv2,
-                            .scheme_state = scheme_state,
-                            .probability = probability,
-                            .sv1 = sv1.sv,
-                            .sv2 = sv2.sv
-                        };
-                        write_scored_state_vector(ssv);
-
-                        if (scheme_state_sv2)
-                            scheme_reliability_summary.sp += probability;
-                        else
-                            scheme_reliability_summary.sq += probability;
-
-                        scheme_reliability_summary.state_vector_set_count++;
+                        process_chunk(chunk, trace_buffer);
+                        run_control.poll();
                     }
+                    if (is_queue_empty)
+                        counters.idle_ns.add(duration_cast<nanoseconds>(steady_clock::now() - idle_start).count());
+                    result_sink->close();
                 }
             };
         }
 
         void join()
         {
-            is_end = true;
+            is_end.store(true, std::memory_order_release);
             processor_thread.join();
         }
 
     private:
 
-        void write_scored_state_vector(const ScoredStateVector<all_count, processor_count>& ssv)
+        void process_chunk(const Chunk& chunk, TraceBuffer* trace_buffer)
+        {
+            PhaseStopwatch stopwatch { measure_phases };
+            PhaseTiming& phase_timing { scheme_reliability_summary.phase_timing };
+            stopwatch.start();
+            batch.size = Chunk::size;
+            batch.first_state_index = chunk.first_state_index;
+
+            {
+                TraceSpan span { trace_buffer, tracer, "probability batch" };
+                for (size_t k = 0; k < batch.size; k++)
+                {
+                    StateVector<all_count, processor_count>& sv1 { batch.sv1[k] };
+                    sv1 = chunk.prefix;
+                    for (size_t j = 0; j < Chunk::depth; j++)
+                        sv1.all[all_count - Chunk::depth + j] = ((k >> (Chunk::depth - 1 - j)) & 1) == 0;
+                    batch.probability[k] = calculate_probability(sv1);
+                }
+            }
+            stopwatch.lap(phase_timing.probability_ns);
+
+            {
+                TraceSpan span { trace_buffer, tracer, "reconfigure batch" };
+                for (size_t k = 0; k < batch.size; k++)
+                {
+                    const StateVector<all_count, processor_count>& sv1 { batch.sv1[k] };
+                    batch.is_reconfigured[k] = reconfiguration_table.requires_reconfiguration(sv1);
+                    if (load_statistics.has_value())
+                        batch.sv2[k] = reconfiguration_table.reconfigure_state_with_statistics(sv1, batch.probability[k], load_statistics.value());
+                    else
+                        batch.sv2[k] = batch.is_reconfigured[k] ? reconfiguration_table.reconfigure_state(sv1) : sv1;
+                }
+            }
+            stopwatch.lap(phase_timing.reconfiguration_ns);
+
+            {
+                TraceSpan span { trace_buffer, tracer, "evaluate batch" };
+                for (size_t k = 0; k < batch.size; k++)
+                {
+                    batch.scheme_state_sv1[k] = scheme_function(batch.sv1[k]);
+                    batch.scheme_state_sv2[k] = scheme_function(batch.sv2[k]);
+                }
+            }
+            stopwatch.lap(phase_timing.evaluation_ns);
+
+            CompensatedSum chunk_sp { };
+            CompensatedSum chunk_sq { };
+            size_t reconfiguration_noop_count { 0 };
+            size_t reconfiguration_success_count { 0 };
+            for (size_t k = 0; k < batch.size; k++)
+            {
+                if (batch.scheme_state_sv2[k])
+                    chunk_sp.add(batch.probability[k]);
+                else
+                {
+                    chunk_sq.add(batch.probability[k]);
+                    if (top_failure_state_count > 0)
+                        track_failure_state(k);
+                }
+
+                if (!batch.is_reconfigured[k])
+                    reconfiguration_noop_count++;
+                else if (batch.scheme_state_sv2[k])
+                    reconfiguration_success_count++;
+            }
+            size_t bytes_written { 0 };
+            {
+                TraceSpan span { trace_buffer, tracer, "flush buffer" };
+                bytes_written = result_sink->write_batch(batch);
+            }
+            stopwatch.lap(phase_timing.output_ns);
+
+            // The worker's own totals only feed the live metrics, the run's come from range_sums.
+            range_sums.add_chunk(chunk.first_state_index / Chunk::size, chunk_sp, chunk_sq);
+            scheme_reliability_summary.sp += chunk_sp.value();
+            scheme_reliability_summary.sq += chunk_sq.value();
+            scheme_reliability_summary.state_vector_set_count += batch.size;
+            counters.sp.set(scheme_reliability_summary.sp);
+            counters.sq.set(scheme_reliability_summary.sq);
+            counters.reconfiguration_noop_count.add(reconfiguration_noop_count);
+            counters.reconfiguration_success_count.add(reconfiguration_success_count);
+            counters.reconfiguration_best_zero_count.add(batch.size - reconfiguration_noop_count - reconfiguration_success_count);
+            counters.bytes_written.add(bytes_written);
+            counters.states_processed.add(batch.size);
+        }
+
+        // Bounded min-heap: the front is the least probable of the kept states.
+        void track_failure_state(size_t k)
         {
-            data_file.write(reinterpret_cast<const char*>(&ssv.scheme_state_sv1), sizeof(bool));
-            data_file.write(reinterpret_cast<const char*>(&ssv.scheme_state_sv2), sizeof(bool));
-            data_file.write(reinterpret_cast<const char*>(&ssv.scheme_state), sizeof(bool));
-            data_file.write(reinterpret_cast<const char*>(&ssv.probability), sizeof(double));
-            data_file.write(reinterpret_cast<const char*>(ssv.sv1.data()), all_count * sizeof(bool));
-            data_file.write(reinterpret_cast<const char*>(ssv.sv2.data()), all_count * sizeof(bool));
+            using Candidate = FailureCandidate<all_count, processor_count>;
+            if (top_failure_candidates.size() == top_failure_state_count)
+            {
+                if (batch.probability[k] < top_failure_candidates.front().probability)
+                    return;
+                Candidate candidate { .probability = batch.probability[k], .sv1 = batch.sv1[k], .sv2 = batch.sv2[k] };
+                if (!Candidate::is_more_probable(candidate, top_failure_candidates.front()))
+                    return;
+                pop_heap(top_failure_candidates.begin(), top_failure_candidates.end(), Candidate::is_more_probable);
+                top_failure_candidates.back() = candidate;
+            }
+            else
+                top_failure_candidates.push_back(Candidate { .probability = batch.probability[k], .sv1 = batch.sv1[k], .sv2 = batch.sv2[k] });
+            push_heap(top_failure_candidates.begin(), top_failure_candidates.end(), Candidate::is_more_probable);
         }
 
         double calculate_probability(const StateVector<all_count, processor_count>& sv)
@@ -488,6 +1284,80 @@ namespace sr_impl::algorithm
         }
     };
 
+    // One CSV row per sv1/sv2 processor mask pair, a mask listing the processor states
+    // in scheme order. transitions and load are those of the pair's most probable
+    // state; greedy decides on the processor mask alone, so for greedy they hold for
+    // every state of the pair. A transition that didn't bring its processor back ends
+    // in '!'.
+    template<size_t all_count, size_t processor_count>
+    void write_processor_mask_map(
+        const ProcessorMaskMap<all_count, processor_count>& processor_mask_map,
+        const Scheme<all_count, processor_count>& scheme,
+        const ReconfigurationTable<all_count, processor_count>& reconfiguration_table
+    ) {
+        using MaskPair = ProcessorMaskPair<all_count, processor_count>;
+
+        ofstream mask_map_file { processor_mask_map.get_path(), std::ios::trunc };
+        if (!mask_map_file.is_open())
+            throw runtime_error(format("Error: can't open mask map file {} for writing", processor_mask_map.get_path().string()));
+
+        auto format_mask = [](unsigned long long mask)
+        {
+            string text(processor_count, '0');
+            for (size_t i = 0; i < processor_count; i++)
+                if ((mask >> i & 1) != 0)
+                    text[i] = '1';
+            return text;
+        };
+
+        mask_map_file << "sv1,sv2,state_count,probability,sp,sq,transitions,load\n";
+        const auto& pairs { processor_mask_map.get_pairs() };
+        // Descending masks put the all-working mask first, as in the state order.
+        for (size_t sv1_mask = pairs.size(); sv1_mask-- > 0;)
+        {
+            vector<MaskPair> sv1_pairs { pairs[sv1_mask] };
+            sort(sv1_pairs.begin(), sv1_pairs.end(), [](const MaskPair& a, const MaskPair& b) { return a.sv2_mask > b.sv2_mask; });
+            for (const MaskPair& pair : sv1_pairs)
+            {
+                const StateVector<all_count, processor_count>& sv1 { pair.most_probable_sv1 };
+                vector<AppliedTransition> transitions
+                {
+                    reconfiguration_table.requires_reconfiguration(sv1)
+                        ? reconfiguration_table.explain_reconfiguration(sv1).transitions
+                        : vector<AppliedTransition> { }
+                };
+
+                string transitions_text { };
+                array<double, processor_count> load { };
+                for (size_t i = 0; i < processor_count; i++)
+                    load[i] = sv1.processors[i] ? scheme.processors[i].normal_load : 0.0;
+                for (const AppliedTransition& applied : transitions)
+                {
+                    transitions_text += format("{}{}->", transitions_text.empty() ? "" : ";", scheme.processors[applied.processor_idx].name);
+                    for (size_t t = 0; t < applied.transition.size(); t++)
+                    {
+                        const IdxL& increment { applied.transition[t] };
+                        transitions_text += format("{}{}:{}", t == 0 ? "" : "+", scheme.processors[increment.index].name, increment.load);
+                        load[increment.index] += increment.load;
+                    }
+                    if (!applied.is_successful)
+                        transitions_text += "!";
+                }
+
+                string load_text { };
+                for (size_t i = 0; i < processor_count; i++)
+                    load_text += format("{}{}", i == 0 ? "" : ";", load[i]);
+
+                mask_map_file << format(
+                    "{},{},{},{},{},{},{},{}\n",
+                    format_mask(sv1_mask), format_mask(pair.sv2_mask), pair.state_count,
+                    pair.probability.value(), pair.sp.value(), pair.sq.value(),
+                    transitions_text, load_text
+                );
+            }
+        }
+    }
+
     template<size_t all_count, size_t processor_count>
     class SchemeReliabilityCalculator
     {
@@ -498,13 +1368,17 @@ namespace sr_impl::algorithm
 
     private:
 
-        static constexpr size_t BUFFER_SIZE { 8192 };
+        using Chunk = StateVectorChunk<all_count, processor_count>;
 
         const string BINARY_SCORED_STATE_SET_DATA_EXTENSION { "ssv" };
+        const string ARROW_SCORED_STATE_SET_DATA_EXTENSION { "arrow" };
         const string SCHEME_RELIABILITY_ELEMENTS_EXTENSION { "elems" };
 
         const string DATA_FILE_NAME_FORMAT { "{}/{}-{}.{}" };
         const string ELEMENTS_FILE_NAME_FORMAT { "{}/{}.{}" };
+        const string OUTCOME_FILE_NAME_FORMAT { "{}/{}.outcome" };
+        const string MASK_MAP_FILE_NAME_FORMAT { "{}/{}.masks.csv" };
+        const string TRACE_FILE_NAME_FORMAT { "{}/{}.trace.json" };
 
         const size_t full_state_vector_set_size;
 
@@ -512,8 +1386,12 @@ namespace sr_impl::algorithm
         {
             StateVector<all_count, processor_count> current_sv;
             size_t sv_processor_idx;
-            vector<StateVectorProcessor<all_count, processor_count>>& sv_processors;
-            size_t visited_state_vector_count;
+            vector<unique_ptr<StateVectorProcessor<all_count, processor_count>>>& sv_processors;
+            size_t first_state_index;
+            const RangeSums& range_sums;
+            RunControl& run_control;
+            Tracer& tracer;
+            TraceBuffer* trace_buffer;
 
             inline void update_sv_processor_idx()
             {
@@ -528,24 +1406,33 @@ namespace sr_impl::algorithm
         { }
 
         SchemeReliabilitySummary calculate_scheme_reliability(
-            const Scheme<all_count, processor_count>& scheme
+            const Scheme<all_count, processor_count>& scheme,
+            const CalculationOptions& options
         ) {
+            RunControl run_control { options, steady_clock::now() };
+
+            unique_ptr<ReconfigurationTable<all_count, processor_count>> reconfiguration_table { make_reconfiguration_table(scheme) };
+
+            optional<ReliabilityBounds> bounds { };
+            if (options.target_reliability)
+            {
+                ReliabilityBoundEstimator<all_count, processor_count> estimator { scheme, *reconfiguration_table, options.bound_options };
+                bounds = estimator.estimate();
+                optional<bool> meets_target { decide_target_reliability(bounds->sp_low, bounds->sp_high, *options.target_reliability) };
+                if (options.skip_decided_run && meets_target)
+                    return make_decided_summary(*bounds, *meets_target);
+            }
+
+            if (!is_valid_scheme_name(scheme.scheme_name))
+                throw runtime_error(format("Error: scheme name '{}' is not a plain directory name", scheme.scheme_name));
             path scheme_result_path { scheme.scheme_name };
             if (exists(scheme_result_path))
                 remove_all(scheme_result_path);
             create_directory(path(scheme.scheme_name));
 
             write_scheme_reliability_elements_ino(scheme);
-
-            ReconfigurationTable<all_count, processor_count>* reconfiguration_table_memory;
-            if (scheme.type == SchemeType::Brute)
-                reconfiguration_table_memory = new BruteForceReconfigurationTable<all_count, processor_count>(scheme);
-            else
-                reconfiguration_table_memory = new GreedyReconfigurationTable<all_count, processor_count>(scheme);
-            unique_ptr<ReconfigurationTable<all_count, processor_count>> reconfiguration_table { reconfiguration_table_memory };
             
-            auto thread_count { thread::hardware_concurrency() };
-            size_t buffer_size { BUFFER_SIZE };
+            size_t thread_count { options.thread_count == 0 ? thread::hardware_concurrency() : options.thread_count };
             array<double, all_count> p { };
             array<double, all_count> q { };
             for (size_t i = 0; i < processor_count; i++)
@@ -558,26 +1445,65 @@ namespace sr_impl::algorithm
                 p[i] = scheme.elements[i - processor_count].p;
                 q[i] = scheme.elements[i - processor_count].q;
             }
-            vector<StateVectorProcessor<all_count, processor_count>> sv_processors { };
+            double probability_mass { 1.0 };
+            for (size_t i = 0; i < all_count; i++)
+                probability_mass *= p[i] + q[i];
+
+            Tracer tracer { };
+            RangeSums range_sums { full_state_vector_set_size / Chunk::size };
+            vector<WorkerCounters> worker_counters(thread_count);
+            vector<unique_ptr<StateVectorProcessor<all_count, processor_count>>> sv_processors { };
             sv_processors.reserve(thread_count);
+            const string& data_extension
+            {
+                options.output_format == OutputFormat::Arrow
+                    ? ARROW_SCORED_STATE_SET_DATA_EXTENSION
+                    : BINARY_SCORED_STATE_SET_DATA_EXTENSION
+            };
+            shared_ptr<OutcomeBitmapFile> outcome_bitmap_file
+            {
+                options.output_format == OutputFormat::Bitmap
+                    ? make_shared<OutcomeBitmapFile>(
+                        path { vformat(OUTCOME_FILE_NAME_FORMAT, make_format_args(scheme.scheme_name, scheme.scheme_name)) },
+                        all_count, thread_count
+                    )
+                    : nullptr
+            };
+            shared_ptr<ProcessorMaskMap<all_count, processor_count>> processor_mask_map
+            {
+                options.output_format == OutputFormat::MaskMap
+                    ? make_shared<ProcessorMaskMap<all_count, processor_count>>(
+                        path { vformat(MASK_MAP_FILE_NAME_FORMAT, make_format_args(scheme.scheme_name, scheme.scheme_name)) }
+                    )
+                    : nullptr
+            };
             for (size_t i = 0; i < thread_count; i++)
             {
-                sv_processors.push_back(StateVectorProcessor<all_count, processor_count> {
+                path data_file_path
+                {
+                    vformat(
+                        this->DATA_FILE_NAME_FORMAT,
+                        make_format_args(
+                            scheme.scheme_name,
+                            scheme.scheme_name, i,
+                            data_extension
+                        )
+                    )
+                };
+                sv_processors.push_back(make_unique<StateVectorProcessor<all_count, processor_count>>(
+                    i,
                     *reconfiguration_table,
                     p, q,
                     scheme.scheme_function,
-                    path(
-                        vformat(
-                            this->DATA_FILE_NAME_FORMAT,
-                            make_format_args(
-                                scheme.scheme_name,
-                                scheme.scheme_name, i,
-                                this->BINARY_SCORED_STATE_SET_DATA_EXTENSION
-                            )
-                        )
-                    ),
-                    buffer_size
-                });
+                    make_result_sink(options.output_format, data_file_path, scheme, outcome_bitmap_file, processor_mask_map),
+                    options.measure_phases,
+                    options.top_failure_state_count,
+                    options.collect_load_statistics,
+                    range_sums,
+                    worker_counters[i],
+                    run_control,
+                    tracer
+                ));
             }
 
             TraversionState tstate
@@ -585,33 +1511,144 @@ namespace sr_impl::algorithm
                 .current_sv = StateVector<all_count, processor_count>(),
                 .sv_processor_idx = 0,
                 .sv_processors = sv_processors,
-                .visited_state_vector_count = 0
+                .first_state_index = 0,
+                .range_sums = range_sums,
+                .run_control = run_control,
+                .tracer = tracer,
+                .trace_buffer = tracer.register_thread("producer")
+            };
+            MetricsMonitor metrics_monitor { options, worker_counters, full_state_vector_set_size, probability_mass };
+            metrics_monitor.start();
+            for (unique_ptr<StateVectorProcessor<all_count, processor_count>>& sv_processor : sv_processors)
+                sv_processor->start();
+            steady_clock::time_point enumeration_start { steady_clock::now() };
+            if (!run_control.poll())
+                traverse_state_vector_tree(0, tstate);
+            unsigned long long enumeration_ns
+            {
+                static_cast<unsigned long long>(
+                    duration_cast<nanoseconds>(steady_clock::now() - enumeration_start).count()
+                )
             };
-            for (StateVectorProcessor<all_count, processor_count>& sv_processor : sv_processors)
-                sv_processor.start();
-            traverse_state_vector_tree(0, tstate);
-            for (StateVectorProcessor<all_count, processor_count>& sv_processor : sv_processors)
-                sv_processor.join();
+            for (unique_ptr<StateVectorProcessor<all_count, processor_count>>& sv_processor : sv_processors)
+                sv_processor->join();
+            metrics_monitor.stop();
+
+            if (processor_mask_map != nullptr)
+                write_processor_mask_map(*processor_mask_map, scheme, *reconfiguration_table);
+
+            if constexpr (TRACE_ENABLED)
+                tracer.write_chrome_trace(path(vformat(TRACE_FILE_NAME_FORMAT, make_format_args(scheme.scheme_name, scheme.scheme_name))));
 
             SchemeReliabilitySummary result
             {
-                .sp = 0,
-                .sq = 0,
+                .sp = range_sums.total_sp(),
+                .sq = range_sums.total_sq(),
                 .state_vector_set_count = 0,
-                .result_path = scheme_result_path
+                .result_path = scheme_result_path,
+                .thread_count = thread_count,
+                .phase_timing = { .enumeration_ns = enumeration_ns }
             };
-            for (const StateVectorProcessor<all_count, processor_count>& sv_processor : sv_processors)
+            for (const unique_ptr<StateVectorProcessor<all_count, processor_count>>& sv_processor : sv_processors)
+            {
+                const SchemeReliabilitySummary& processor_summary { sv_processor->get_scheme_reliability_summary() };
+                result.state_vector_set_count += processor_summary.state_vector_set_count;
+                result.phase_timing.probability_ns += processor_summary.phase_timing.probability_ns;
+                result.phase_timing.reconfiguration_ns += processor_summary.phase_timing.reconfiguration_ns;
+                result.phase_timing.evaluation_ns += processor_summary.phase_timing.evaluation_ns;
+                result.phase_timing.output_ns += processor_summary.phase_timing.output_ns;
+            }
+
+            if (options.top_failure_state_count > 0)
+                result.top_failure_states = merge_top_failure_states(sv_processors, *reconfiguration_table, options.top_failure_state_count);
+
+            if (options.collect_load_statistics)
+            {
+                LoadStatisticsAccumulator<processor_count> load_statistics { reconfiguration_table->make_load_statistics_accumulator() };
+                for (const unique_ptr<StateVectorProcessor<all_count, processor_count>>& sv_processor : sv_processors)
+                    load_statistics.merge(sv_processor->get_load_statistics().value());
+                result.load_statistics = load_statistics.make_load_statistics(scheme);
+            }
+
+            result.is_partial = result.state_vector_set_count < full_state_vector_set_size;
+            result.sp_low = result.sp;
+            result.sp_high = result.sp;
+            if (result.is_partial)
             {
-                result.sp += sv_processor.get_scheme_reliability_summary().sp;
-                result.sq += sv_processor.get_scheme_reliability_summary().sq;
-                result.state_vector_set_count += sv_processor.get_scheme_reliability_summary().state_vector_set_count;
+                result.unvisited_probability = max(0.0, probability_mass - result.sp - result.sq);
+                result.sp_high = min(1.0, result.sp + result.unvisited_probability);
             }
 
+            result.bounds = bounds;
+            if (options.target_reliability)
+                result.meets_target_reliability = decide_target_reliability(result.sp_low, result.sp_high, *options.target_reliability);
+
             return result;
         }
 
     private:
 
+        static optional<bool> decide_target_reliability(double sp_low, double sp_high, double target_reliability)
+        {
+            if (sp_low >= target_reliability)
+                return true;
+            if (sp_high < target_reliability)
+                return false;
+            return nullopt;
+        }
+
+        // Summary of a run that was never started: the evaluated low-order states stand
+        // in for the visited ones, the truncated mass for the unvisited.
+        SchemeReliabilitySummary make_decided_summary(const ReliabilityBounds& bounds, bool meets_target) const
+        {
+            return SchemeReliabilitySummary
+            {
+                .sp = bounds.sp,
+                .sq = bounds.sq,
+                .state_vector_set_count = bounds.evaluated_state_count,
+                .result_path = { },
+                .thread_count = 0,
+                .phase_timing = { },
+                .is_partial = true,
+                .sp_low = bounds.sp_low,
+                .sp_high = bounds.sp_high,
+                .unvisited_probability = bounds.truncated_probability,
+                .top_failure_states = { },
+                .bounds = bounds,
+                .meets_target_reliability = meets_target,
+                .is_decided_by_bounds = true
+            };
+        }
+
+        vector<FailureState> merge_top_failure_states(
+            const vector<unique_ptr<StateVectorProcessor<all_count, processor_count>>>& sv_processors,
+            const ReconfigurationTable<all_count, processor_count>& reconfiguration_table,
+            size_t top_failure_state_count
+        ) const {
+            using Candidate = FailureCandidate<all_count, processor_count>;
+            vector<Candidate> candidates { };
+            for (const unique_ptr<StateVectorProcessor<all_count, processor_count>>& sv_processor : sv_processors)
+                candidates.insert(candidates.end(), sv_processor->get_top_failure_candidates().begin(), sv_processor->get_top_failure_candidates().end());
+            sort(candidates.begin(), candidates.end(), Candidate::is_more_probable);
+            if (candidates.size() > top_failure_state_count)
+                candidates.erase(candidates.begin() + top_failure_state_count, candidates.end());
+
+            vector<FailureState> result { };
+            for (const Candidate& candidate : candidates)
+            {
+                result.push_back(FailureState
+                {
+                    .probability = candidate.probability,
+                    .sv1 = vector<bool>(candidate.sv1.sv.begin(), candidate.sv1.sv.end()),
+                    .sv2 = vector<bool>(candidate.sv2.sv.begin(), candidate.sv2.sv.end()),
+                    .transitions = reconfiguration_table.requires_reconfiguration(candidate.sv1)
+                        ? reconfiguration_table.explain_reconfiguration(candidate.sv1).transitions
+                        : vector<AppliedTransition> { }
+                });
+            }
+            return result;
+        }
+
         void write_scheme_reliability_elements_ino(
             const Scheme<all_count, processor_count>& scheme
         ) const {
@@ -645,15 +1682,28 @@ namespace sr_impl::algorithm
             }
         }
 
+        // Recurses over the leading elements only; each leaf hands a whole chunk of
+        // Chunk::size states sharing that prefix to one processor. Processors take
+        // turns per range, so every range is summed by a single processor.
         void traverse_state_vector_tree(
             size_t element_idx,
             TraversionState& tstate
         ) const {
-            if (element_idx == tstate.current_sv.all.size())
+            if (tstate.run_control.is_stopped())
+                return;
+
+            if (element_idx == all_count - Chunk::depth)
             {
-                tstate.sv_processors[tstate.sv_processor_idx].assign_for_processment(tstate.current_sv);
-                tstate.update_sv_processor_idx();
-                tstate.visited_state_vector_count++;
+                {
+                    TraceSpan span { tstate.trace_buffer, tstate.tracer, "enumerate chunk" };
+                    tstate.sv_processors[tstate.sv_processor_idx]->assign_for_processment(
+                        Chunk { .prefix = tstate.current_sv, .first_state_index = tstate.first_state_index }
+                    );
+                }
+                if (tstate.range_sums.is_last_chunk_of_range(tstate.first_state_index / Chunk::size))
+                    tstate.update_sv_processor_idx();
+                tstate.first_state_index += Chunk::size;
+                tstate.run_control.poll();
                 return;
             }
             else
@@ -675,9 +1725,13 @@ namespace sr_impl::algorithm
 
     template<size_t all_count, size_t processor_count>
     SchemeReliabilitySummary calculate_scheme_reliability(
-        const Scheme<all_count, processor_count>& scheme
+        const Scheme<all_count, processor_count>& scheme,
+        const CalculationOptions& options
     ) {
-        SchemeReliabilityCalculator<all_count, processor_count> scheme_reliability_calculator { };
-        return scheme_reliability_calculator.calculate_scheme_reliability(scheme);
+        return calculate_with_result_cache(make_cache_key(scheme, options), options, [&scheme, &options]()
+        {
+            SchemeReliabilityCalculator<all_count, processor_count> scheme_reliability_calculator { };
+            return scheme_reliability_calculator.calculate_scheme_reliability(scheme, options);
+        });
     }
 }
@@ -0,0 +1,410 @@
+module;
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+export module scheme_reliability:analysis;
+
+import :model;
+using namespace sr_impl::model;
+
+import std;
+using std::string;
+using std::vector;
+using std::span;
+using std::ifstream;
+using std::filesystem::path;
+using std::filesystem::directory_iterator;
+using std::filesystem::is_directory, std::filesystem::file_size;
+using std::format;
+using std::runtime_error;
+using std::thread;
+using std::atomic, std::memory_order_relaxed;
+using std::getline;
+using std::min;
+using std::memcpy;
+using std::ranges::sort, std::ranges::find;
+
+namespace sr_impl::analysis
+{
+    constexpr size_t MAX_GROUP_ELEMENT_COUNT { 16 };
+
+    // Maps [offset, offset + length) of a file read-only; the mapping starts at the
+    // preceding granularity boundary so any offset may be requested.
+    class MappedFileRange
+    {
+    private:
+
+        const char* view;
+        size_t view_size;
+        size_t view_shift;
+
+    public:
+
+        MappedFileRange(const path& file_path, size_t offset, size_t length):
+            view { nullptr }, view_size { 0 }, view_shift { 0 }
+        {
+            if (length == 0)
+                return;
+
+#if defined(_WIN32)
+            SYSTEM_INFO system_info { };
+            GetSystemInfo(&system_info);
+            size_t granularity { system_info.dwAllocationGranularity };
+            size_t view_offset { offset - offset % granularity };
+            view_shift = offset - view_offset;
+            view_size = length + view_shift;
+
+            HANDLE file { CreateFileW(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+            if (file == INVALID_HANDLE_VALUE)
+                throw runtime_error(format("Error: can't open result file {} for reading", file_path.string()));
+            HANDLE mapping { CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) };
+            CloseHandle(file);
+            if (mapping == nullptr)
+                throw runtime_error(format("Error: can't map result file {}", file_path.string()));
+            view = static_cast<const char*>(
+                MapViewOfFile(mapping, FILE_MAP_READ, static_cast<DWORD>(view_offset >> 32), static_cast<DWORD>(view_offset & 0xffffffff), view_size)
+            );
+            CloseHandle(mapping);
+            if (view == nullptr)
+                throw runtime_error(format("Error: can't map result file {}", file_path.string()));
+#else
+            size_t granularity { static_cast<size_t>(sysconf(_SC_PAGESIZE)) };
+            size_t view_offset { offset - offset % granularity };
+            view_shift = offset - view_offset;
+            view_size = length + view_shift;
+
+            int file { open(file_path.c_str(), O_RDONLY) };
+            if (file < 0)
+                throw runtime_error(format("Error: can't open result file {} for reading", file_path.string()));
+            void* mapping { mmap(nullptr, view_size, PROT_READ, MAP_PRIVATE, file, static_cast<off_t>(view_offset)) };
+            close(file);
+            if (mapping == MAP_FAILED)
+                throw runtime_error(format("Error: can't map result file {}", file_path.string()));
+            madvise(mapping, view_size, MADV_SEQUENTIAL);
+            view = static_cast<const char*>(mapping);
+#endif
+        }
+
+        ~MappedFileRange()
+        {
+            if (view == nullptr)
+                return;
+#if defined(_WIN32)
+            UnmapViewOfFile(view);
+#else
+            munmap(const_cast<char*>(view), view_size);
+#endif
+        }
+
+        MappedFileRange(const MappedFileRange&) = delete;
+        MappedFileRange& operator=(const MappedFileRange&) = delete;
+
+        inline const char* data() const
+        {
+            return view + view_shift;
+        }
+    };
+
+    struct ResultSlice
+    {
+        path file_path;
+        size_t offset;
+        size_t length;
+    };
+
+    struct AnalysisAccumulator
+    {
+        size_t record_count;
+        double sp;
+        double sq;
+        size_t inconsistent_count;
+        double inconsistent_probability;
+        vector<double> sv1_fail_probability;
+        vector<double> sv2_fail_probability;
+        vector<size_t> sv1_fail_count;
+        vector<size_t> sv2_fail_count;
+        vector<size_t> sv1_group_count;
+        vector<size_t> sv2_group_count;
+        vector<double> sv1_group_probability;
+        vector<double> sv2_group_probability;
+        vector<double> sv2_group_sp;
+
+        AnalysisAccumulator(size_t element_count, size_t group_count):
+            record_count { 0 }, sp { 0 }, sq { 0 },
+            inconsistent_count { 0 }, inconsistent_probability { 0 },
+            sv1_fail_probability(element_count), sv2_fail_probability(element_count),
+            sv1_fail_count(element_count), sv2_fail_count(element_count),
+            sv1_group_count(group_count), sv2_group_count(group_count),
+            sv1_group_probability(group_count), sv2_group_probability(group_count),
+            sv2_group_sp(group_count)
+        { }
+
+        void merge(const AnalysisAccumulator& other)
+        {
+            record_count += other.record_count;
+            sp += other.sp;
+            sq += other.sq;
+            inconsistent_count += other.inconsistent_count;
+            inconsistent_probability += other.inconsistent_probability;
+            for (size_t i = 0; i < sv1_fail_probability.size(); i++)
+            {
+                sv1_fail_probability[i] += other.sv1_fail_probability[i];
+                sv2_fail_probability[i] += other.sv2_fail_probability[i];
+                sv1_fail_count[i] += other.sv1_fail_count[i];
+                sv2_fail_count[i] += other.sv2_fail_count[i];
+            }
+            for (size_t i = 0; i < sv1_group_count.size(); i++)
+            {
+                sv1_group_count[i] += other.sv1_group_count[i];
+                sv2_group_count[i] += other.sv2_group_count[i];
+                sv1_group_probability[i] += other.sv1_group_probability[i];
+                sv2_group_probability[i] += other.sv2_group_probability[i];
+                sv2_group_sp[i] += other.sv2_group_sp[i];
+            }
+        }
+    };
+
+    class ResultAnalyzer
+    {
+    private:
+
+        static constexpr size_t SLICE_SIZE { 64 * 1024 * 1024 };
+
+        const string BINARY_SCORED_STATE_SET_DATA_EXTENSION { ".ssv" };
+        const string SCHEME_RELIABILITY_ELEMENTS_EXTENSION { ".elems" };
+
+        const path result_path;
+        const AnalysisOptions options;
+
+        vector<string> element_names;
+        vector<size_t> group_element_indices;
+        size_t record_size;
+
+    public:
+
+        ResultAnalyzer(path result_path, const AnalysisOptions& options):
+            result_path { result_path },
+            options { options },
+            element_names { },
+            group_element_indices { },
+            record_size { 0 }
+        {
+            if (!is_directory(result_path))
+                throw runtime_error(format("Error: result directory {} does not exist", result_path.string()));
+
+            read_element_names();
+            record_size = 3 * sizeof(bool) + sizeof(double) + 2 * element_names.size() * sizeof(bool);
+            resolve_group_elements();
+        }
+
+        ResultAnalysis analyze() const
+        {
+            vector<ResultSlice> slices { collect_slices() };
+            size_t thread_count { options.thread_count == 0 ? thread::hardware_concurrency() : options.thread_count };
+            thread_count = std::max<size_t>(1, min(thread_count, slices.size()));
+
+            size_t group_count { static_cast<size_t>(1) << group_element_indices.size() };
+            vector<AnalysisAccumulator> accumulators(thread_count, AnalysisAccumulator { element_names.size(), group_count });
+            atomic<size_t> next_slice { 0 };
+
+            vector<thread> workers { };
+            workers.reserve(thread_count);
+            for (size_t i = 0; i < thread_count; i++)
+            {
+                workers.emplace_back(
+                    [this, &slices, &next_slice, &accumulator = accumulators[i]]()
+                    {
+                        for (size_t s = next_slice.fetch_add(1, memory_order_relaxed); s < slices.size(); s = next_slice.fetch_add(1, memory_order_relaxed))
+                            analyze_slice(slices[s], accumulator);
+                    }
+                );
+            }
+            for (thread& worker : workers)
+                worker.join();
+
+            AnalysisAccumulator total { element_names.size(), group_count };
+            for (const AnalysisAccumulator& accumulator : accumulators)
+                total.merge(accumulator);
+
+            return make_result(total);
+        }
+
+    private:
+
+        void read_element_names()
+        {
+            path scheme_name { result_path.has_filename() ? result_path.filename() : result_path.parent_path().filename() };
+            path elements_file_path { result_path / (scheme_name.string() + SCHEME_RELIABILITY_ELEMENTS_EXTENSION) };
+            ifstream elements_file { elements_file_path };
+            if (!elements_file.is_open())
+                throw runtime_error(format("Error: can't open elements_file {} for reading", elements_file_path.string()));
+
+            string name { };
+            while (getline(elements_file, name, ','))
+                element_names.push_back(name);
+            if (element_names.empty())
+                throw runtime_error(format("Error: elements_file {} is empty", elements_file_path.string()));
+        }
+
+        void resolve_group_elements()
+        {
+            vector<string> group_elements { options.group_elements };
+            if (group_elements.empty())
+                for (const string& name : element_names)
+                    if (name.starts_with("pr"))
+                        group_elements.push_back(name);
+
+            if (group_elements.size() > MAX_GROUP_ELEMENT_COUNT)
+                throw runtime_error(format("Error: at most {} group elements are supported", MAX_GROUP_ELEMENT_COUNT));
+
+            for (const string& name : group_elements)
+            {
+                auto it { find(element_names, name) };
+                if (it == element_names.end())
+                    throw runtime_error(format("Error: group element {} is not part of the scheme", name));
+                group_element_indices.push_back(static_cast<size_t>(it - element_names.begin()));
+            }
+        }
+
+        vector<ResultSlice> collect_slices() const
+        {
+            vector<path> data_files { };
+            for (const auto& entry : directory_iterator(result_path))
+                if (entry.is_regular_file() && entry.path().extension() == BINARY_SCORED_STATE_SET_DATA_EXTENSION)
+                    data_files.push_back(entry.path());
+            sort(data_files);
+
+            size_t records_per_slice { std::max<size_t>(1, SLICE_SIZE / record_size) };
+            vector<ResultSlice> slices { };
+            for (const path& data_file : data_files)
+            {
+                size_t size { static_cast<size_t>(file_size(data_file)) };
+                if (size % record_size != 0)
+                    throw runtime_error(format("Error: result file {} is truncated", data_file.string()));
+
+                for (size_t offset = 0; offset < size; offset += records_per_slice * record_size)
+                    slices.push_back(ResultSlice { .file_path = data_file, .offset = offset, .length = min(records_per_slice * record_size, size - offset) });
+            }
+            return slices;
+        }
+
+        void analyze_slice(const ResultSlice& slice, AnalysisAccumulator& accumulator) const
+        {
+            MappedFileRange mapped_range { slice.file_path, slice.offset, slice.length };
+            const size_t element_count { element_names.size() };
+            const size_t group_element_count { group_element_indices.size() };
+
+            for (const char* record = mapped_range.data(); record < mapped_range.data() + slice.length; record += record_size)
+            {
+                bool scheme_state_sv1 { record[0] != 0 };
+                bool scheme_state_sv2 { record[1] != 0 };
+                double probability { };
+                memcpy(&probability, record + 3 * sizeof(bool), sizeof(double));
+                const char* sv1 { record + 3 * sizeof(bool) + sizeof(double) };
+                const char* sv2 { sv1 + element_count };
+
+                accumulator.record_count++;
+                if (scheme_state_sv2)
+                    accumulator.sp += probability;
+                else
+                    accumulator.sq += probability;
+
+                if (scheme_state_sv1 && !scheme_state_sv2)
+                {
+                    accumulator.inconsistent_count++;
+                    accumulator.inconsistent_probability += probability;
+                }
+
+                if (!scheme_state_sv1)
+                    for (size_t i = 0; i < element_count; i++)
+                        if (sv1[i] == 0)
+                        {
+                            accumulator.sv1_fail_probability[i] += probability;
+                            accumulator.sv1_fail_count[i]++;
+                        }
+
+                if (!scheme_state_sv2)
+                    for (size_t i = 0; i < element_count; i++)
+                        if (sv2[i] == 0)
+                        {
+                            accumulator.sv2_fail_probability[i] += probability;
+                            accumulator.sv2_fail_count[i]++;
+                        }
+
+                // The first group element is the most significant bit, a failed element sets its bit.
+                size_t sv1_mask { 0 };
+                size_t sv2_mask { 0 };
+                for (size_t g = 0; g < group_element_count; g++)
+                {
+                    sv1_mask = (sv1_mask << 1) | (sv1[group_element_indices[g]] == 0);
+                    sv2_mask = (sv2_mask << 1) | (sv2[group_element_indices[g]] == 0);
+                }
+                accumulator.sv1_group_count[sv1_mask]++;
+                accumulator.sv1_group_probability[sv1_mask] += probability;
+                accumulator.sv2_group_count[sv2_mask]++;
+                accumulator.sv2_group_probability[sv2_mask] += probability;
+                if (scheme_state_sv2)
+                    accumulator.sv2_group_sp[sv2_mask] += probability;
+            }
+        }
+
+        ResultAnalysis make_result(const AnalysisAccumulator& total) const
+        {
+            ResultAnalysis result
+            {
+                .record_count = total.record_count,
+                .sp = total.sp,
+                .sq = total.sq,
+                .inconsistent_count = total.inconsistent_count,
+                .inconsistent_probability = total.inconsistent_probability,
+                .elements = { },
+                .group_elements = { },
+                .groups = { }
+            };
+
+            for (size_t i = 0; i < element_names.size(); i++)
+            {
+                result.elements.push_back(ElementFailureStatistics
+                {
+                    .name = element_names[i],
+                    .sv1_fail_probability = total.sv1_fail_probability[i],
+                    .sv2_fail_probability = total.sv2_fail_probability[i],
+                    .sv1_fail_count = total.sv1_fail_count[i],
+                    .sv2_fail_count = total.sv2_fail_count[i]
+                });
+            }
+
+            for (size_t idx : group_element_indices)
+                result.group_elements.push_back(element_names[idx]);
+
+            for (size_t mask = 0; mask < total.sv1_group_count.size(); mask++)
+            {
+                result.groups.push_back(MaskGroupStatistics
+                {
+                    .failed_mask = mask,
+                    .sv1_count = total.sv1_group_count[mask],
+                    .sv2_count = total.sv2_group_count[mask],
+                    .sv1_probability = total.sv1_group_probability[mask],
+                    .sv2_probability = total.sv2_group_probability[mask],
+                    .sv2_sp = total.sv2_group_sp[mask]
+                });
+            }
+
+            return result;
+        }
+    };
+
+    ResultAnalysis analyze_scheme_result(const path& result_path, const AnalysisOptions& options)
+    {
+        ResultAnalyzer analyzer { result_path, options };
+        return analyzer.analyze();
+    }
+}
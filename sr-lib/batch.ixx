@@ -0,0 +1,305 @@
+export module scheme_reliability:batch;
+
+import :model;
+using namespace sr_impl::model;
+
+import :cache;
+using namespace sr_impl::cache;
+
+import :dynamic;
+using namespace sr_impl::dynamic;
+
+import std;
+using std::vector;
+using std::string;
+using std::unordered_map;
+using std::optional, std::nullopt;
+using std::unique_ptr, std::make_unique;
+using std::thread;
+using std::mutex, std::unique_lock;
+using std::condition_variable;
+using std::exception;
+using std::runtime_error;
+using std::format;
+using std::erase;
+using std::chrono::steady_clock;
+using std::chrono::duration_cast, std::chrono::nanoseconds;
+
+namespace sr_impl::batch
+{
+    // Runs lists of dynamic scheme jobs on one pool kept for the runner's lifetime.
+    // The pool threads only sum ranges: each takes one range of an active job at a
+    // time, going round the active jobs, so a small job's ranges are not queued
+    // behind a large one. The calling thread sets the jobs up and finishes them,
+    // which overlaps their file work with the ranges of the others. Pool thread i
+    // always drives worker i of a job, so a worker is never driven by two threads.
+    class BatchRunner
+    {
+    private:
+
+        struct ActiveJob
+        {
+            size_t job_idx;
+            unique_ptr<DynamicSchemeReliabilityCalculator> calculator;
+            optional<string> cache_key;
+            bool is_exhausted;
+            size_t busy_thread_count;
+            steady_clock::time_point compute_start;
+            steady_clock::time_point compute_end;
+            unsigned long long worker_ns;
+            string error;
+        };
+
+        const size_t thread_count;
+        const size_t active_job_count;
+
+        mutex job_mutex;
+        condition_variable job_available;
+        condition_variable job_computed;
+        vector<ActiveJob*> active_jobs;
+        size_t next_active_job_idx;
+        vector<ActiveJob*> computed_jobs;
+        bool is_stopping;
+
+        vector<thread> threads;
+
+    public:
+
+        BatchRunner(const BatchOptions& options):
+            thread_count { options.thread_count == 0 ? thread::hardware_concurrency() : options.thread_count },
+            active_job_count { options.active_job_count == 0 ? 1 : options.active_job_count },
+            job_mutex { }, job_available { }, job_computed { },
+            active_jobs { }, next_active_job_idx { 0 }, computed_jobs { },
+            is_stopping { false },
+            threads { }
+        {
+            for (size_t i = 0; i < thread_count; i++)
+                threads.emplace_back([this, i]() { work(i); });
+        }
+
+        BatchRunner(const BatchRunner&) = delete;
+        BatchRunner& operator=(const BatchRunner&) = delete;
+
+        ~BatchRunner()
+        {
+            {
+                unique_lock lock { job_mutex };
+                is_stopping = true;
+            }
+            job_available.notify_all();
+            for (thread& pool_thread : threads)
+                pool_thread.join();
+        }
+
+        // One batch at a time. A failed job is reported in its result and doesn't
+        // stop the others.
+        BatchSummary run(const vector<BatchJob>& jobs)
+        {
+            unordered_map<string, size_t> job_indices { };
+            for (size_t i = 0; i < jobs.size(); i++)
+            {
+                auto [it, is_inserted] { job_indices.emplace(jobs[i].scheme.scheme_name, i) };
+                if (!is_inserted)
+                    throw runtime_error(format("Error: batch jobs {} and {} share the result directory {}", it->second, i, jobs[i].scheme.scheme_name));
+            }
+
+            steady_clock::time_point batch_start { steady_clock::now() };
+            auto since_batch_start = [batch_start](steady_clock::time_point time)
+            {
+                return static_cast<unsigned long long>(duration_cast<nanoseconds>(time - batch_start).count());
+            };
+
+            BatchSummary summary { .jobs = { }, .thread_count = thread_count, .elapsed_ns = 0, .pool_utilization = 0 };
+            for (const BatchJob& job : jobs)
+                summary.jobs.push_back(BatchJobResult
+                {
+                    .scheme_name = job.scheme.scheme_name, .type = job.scheme.type,
+                    .summary = nullopt, .error = { },
+                    .start_ns = 0, .end_ns = 0, .setup_ns = 0, .compute_ns = 0, .finish_ns = 0, .worker_ns = 0
+                });
+
+            vector<unique_ptr<ActiveJob>> started_jobs(jobs.size());
+            vector<ActiveJob*> finishable_jobs { };
+            size_t next_job_idx { 0 };
+            size_t computing_job_count { 0 };
+            size_t done_job_count { 0 };
+            while (done_job_count < jobs.size())
+            {
+                bool can_start_job { next_job_idx < jobs.size() && computing_job_count < active_job_count };
+                {
+                    unique_lock lock { job_mutex };
+                    if (!can_start_job && finishable_jobs.empty())
+                        job_computed.wait(lock, [this]() { return !computed_jobs.empty(); });
+                    computing_job_count -= computed_jobs.size();
+                    finishable_jobs.insert(finishable_jobs.end(), computed_jobs.begin(), computed_jobs.end());
+                    computed_jobs.clear();
+                }
+
+                // Setting up first hands the pool new ranges sooner.
+                if (next_job_idx < jobs.size() && computing_job_count < active_job_count)
+                {
+                    size_t job_idx { next_job_idx++ };
+                    BatchJobResult& result { summary.jobs[job_idx] };
+                    steady_clock::time_point setup_start { steady_clock::now() };
+                    result.start_ns = since_batch_start(setup_start);
+                    try
+                    {
+                        started_jobs[job_idx] = start_job(jobs[job_idx], job_idx, result);
+                    }
+                    catch (const exception& e)
+                    {
+                        result.error = e.what();
+                    }
+                    steady_clock::time_point setup_end { steady_clock::now() };
+                    result.setup_ns = since_batch_start(setup_end) - result.start_ns;
+
+                    if (started_jobs[job_idx] == nullptr)
+                    {
+                        result.end_ns = since_batch_start(setup_end);
+                        done_job_count++;
+                        continue;
+                    }
+
+                    started_jobs[job_idx]->compute_start = setup_end;
+                    {
+                        unique_lock lock { job_mutex };
+                        active_jobs.push_back(started_jobs[job_idx].get());
+                    }
+                    computing_job_count++;
+                    job_available.notify_all();
+                    continue;
+                }
+
+                ActiveJob& job { *finishable_jobs.front() };
+                finishable_jobs.erase(finishable_jobs.begin());
+                BatchJobResult& result { summary.jobs[job.job_idx] };
+                result.compute_ns = static_cast<unsigned long long>(duration_cast<nanoseconds>(job.compute_end - job.compute_start).count());
+                result.worker_ns = job.worker_ns;
+                steady_clock::time_point finish_start { steady_clock::now() };
+                finish_job(jobs[job.job_idx], job, result);
+                result.end_ns = since_batch_start(steady_clock::now());
+                result.finish_ns = result.end_ns - since_batch_start(finish_start);
+                started_jobs[job.job_idx].reset();
+                done_job_count++;
+            }
+
+            summary.elapsed_ns = since_batch_start(steady_clock::now());
+            unsigned long long worker_ns { 0 };
+            for (const BatchJobResult& result : summary.jobs)
+                worker_ns += result.worker_ns;
+            if (summary.elapsed_ns > 0 && thread_count > 0)
+                summary.pool_utilization = static_cast<double>(worker_ns) / (static_cast<double>(summary.elapsed_ns) * static_cast<double>(thread_count));
+            return summary;
+        }
+
+    private:
+
+        // nullptr when the result cache already holds the job's summary.
+        unique_ptr<ActiveJob> start_job(const BatchJob& job, size_t job_idx, BatchJobResult& result)
+        {
+            validate_scheme(job.scheme);
+            validate_options(job.options);
+
+            optional<string> cache_key { is_cacheable(job.options) ? optional<string> { make_cache_key(job.scheme, job.options) } : nullopt };
+            if (cache_key.has_value())
+            {
+                optional<SchemeReliabilitySummary> cached_summary { ResultCache { job.options.result_cache_path.value() }.load(cache_key.value()) };
+                if (cached_summary.has_value())
+                {
+                    result.summary = cached_summary;
+                    return nullptr;
+                }
+            }
+
+            unique_ptr<ActiveJob> active_job
+            {
+                make_unique<ActiveJob>(ActiveJob
+                {
+                    .job_idx = job_idx,
+                    .calculator = make_unique<DynamicSchemeReliabilityCalculator>(job.scheme),
+                    .cache_key = cache_key,
+                    .is_exhausted = false,
+                    .busy_thread_count = 0,
+                    .compute_start = { },
+                    .compute_end = { },
+                    .worker_ns = 0,
+                    .error = { }
+                })
+            };
+            active_job->calculator->start_run(job.options, thread_count);
+            return active_job;
+        }
+
+        void finish_job(const BatchJob& job, ActiveJob& active_job, BatchJobResult& result)
+        {
+            try
+            {
+                SchemeReliabilitySummary job_summary { active_job.calculator->finish_run() };
+                if (!active_job.error.empty())
+                {
+                    result.error = active_job.error;
+                    return;
+                }
+                if (active_job.cache_key.has_value())
+                    ResultCache { job.options.result_cache_path.value() }.store(active_job.cache_key.value(), job_summary);
+                result.summary = job_summary;
+            }
+            catch (const exception& e)
+            {
+                result.error = e.what();
+            }
+        }
+
+        void work(size_t worker_idx)
+        {
+            unique_lock lock { job_mutex };
+            while (true)
+            {
+                job_available.wait(lock, [this]() { return is_stopping || !active_jobs.empty(); });
+                if (is_stopping)
+                    return;
+
+                next_active_job_idx %= active_jobs.size();
+                ActiveJob& job { *active_jobs[next_active_job_idx++] };
+                job.busy_thread_count++;
+                lock.unlock();
+
+                steady_clock::time_point range_start { steady_clock::now() };
+                bool has_next_range { false };
+                string error { };
+                try
+                {
+                    has_next_range = job.calculator->process_next_range(worker_idx);
+                }
+                catch (const exception& e)
+                {
+                    error = e.what();
+                }
+                steady_clock::time_point range_end { steady_clock::now() };
+
+                lock.lock();
+                job.worker_ns += static_cast<unsigned long long>(duration_cast<nanoseconds>(range_end - range_start).count());
+                job.busy_thread_count--;
+                if (!error.empty() && job.error.empty())
+                    job.error = error;
+                if (!has_next_range && !job.is_exhausted)
+                {
+                    job.is_exhausted = true;
+                    erase(active_jobs, &job);
+                }
+                if (job.is_exhausted && job.busy_thread_count == 0)
+                {
+                    job.compute_end = range_end;
+                    computed_jobs.push_back(&job);
+                    job_computed.notify_one();
+                }
+            }
+        }
+    };
+
+    BatchSummary run_batch(const vector<BatchJob>& jobs, const BatchOptions& options)
+    {
+        BatchRunner runner { options };
+        return runner.run(jobs);
+    }
+}
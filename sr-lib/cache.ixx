@@ -0,0 +1,311 @@
+export module scheme_reliability:cache;
+
+import :model;
+using namespace sr_impl::model;
+
+import :outcome;
+using namespace sr_impl::outcome;
+
+import std;
+using std::string;
+using std::string_view;
+using std::optional, std::nullopt;
+using std::ifstream, std::ofstream;
+using std::getline;
+using std::filesystem::path;
+using std::filesystem::is_directory, std::filesystem::exists, std::filesystem::create_directories, std::filesystem::rename;
+using std::format;
+using std::vformat, std::make_format_args;
+using std::runtime_error;
+using std::stod, std::stoull;
+
+namespace sr_impl::cache
+{
+    // Part of every key. Bump it with any engine change that alters results, which
+    // the scheme alone can't show, so that entries of older builds are not read.
+    constexpr size_t ENGINE_VERSION { 1 };
+
+    // FNV-1a over a canonical text of everything the result depends on. Doubles are
+    // written in their shortest round-trip form, so equal values hash equally.
+    class Fingerprint
+    {
+    private:
+
+        static constexpr unsigned long long OFFSET_BASIS { 14695981039346656037ull };
+        static constexpr unsigned long long PRIME { 1099511628211ull };
+
+        unsigned long long hash;
+
+    public:
+
+        Fingerprint(): hash { OFFSET_BASIS }
+        {
+            add(ENGINE_VERSION);
+        }
+
+        Fingerprint& add(string_view text)
+        {
+            for (char c : text)
+            {
+                hash ^= static_cast<unsigned char>(c);
+                hash *= PRIME;
+            }
+            hash ^= 0xff;
+            hash *= PRIME;
+            return *this;
+        }
+
+        Fingerprint& add(double value) { return add(format("{}", value)); }
+
+        Fingerprint& add(size_t value) { return add(format("{}", value)); }
+
+        Fingerprint& add(const TransitionSet& transitions)
+        {
+            add(transitions.size());
+            for (const Transition& transition : transitions)
+            {
+                add(transition.size());
+                for (const IdxL& unit : transition)
+                    add(unit.index).add(unit.load);
+            }
+            return *this;
+        }
+
+        Fingerprint& add(const Processor& processor)
+        {
+            add(processor.name).add(processor.p).add(processor.q).add(processor.normal_load).add(processor.max_load);
+            return add(processor.transitions);
+        }
+
+        // Everything of a processor reconfiguration depends on: no p/q.
+        Fingerprint& add_topology(const Processor& processor)
+        {
+            add(processor.name).add(processor.normal_load).add(processor.max_load);
+            return add(processor.transitions);
+        }
+
+        Fingerprint& add(const Element& element) { return add(element.name).add(element.p).add(element.q); }
+
+        Fingerprint& add(const BruteForceOptions& options)
+        {
+            return add(static_cast<size_t>(options.is_pruning_transitions)).add(static_cast<size_t>(options.is_dropping_impossible_transitions));
+        }
+
+        Fingerprint& add(const CalculationOptions& options)
+        {
+            return add(static_cast<size_t>(options.output_format));
+        }
+
+        string key() const { return format("{:016x}", hash); }
+    };
+
+    template<size_t all_count, size_t processor_count>
+    optional<string> make_cache_key(const Scheme<all_count, processor_count>& scheme, const CalculationOptions& options)
+    {
+        if (scheme.scheme_function_version.empty())
+            return nullopt;
+
+        Fingerprint fingerprint { };
+        fingerprint.add(string_view { "scheme" }).add(scheme.scheme_name).add(all_count).add(processor_count);
+        for (const Processor& processor : scheme.processors)
+            fingerprint.add(processor);
+        for (const Element& element : scheme.elements)
+            fingerprint.add(element);
+        fingerprint.add(scheme.scheme_function_version);
+        fingerprint.add(static_cast<size_t>(scheme.type)).add(scheme.beam_options.width).add(scheme.beam_options.max_expanded_node_count);
+        fingerprint.add(scheme.brute_options);
+        fingerprint.add(options);
+        return fingerprint.key();
+    }
+
+    string make_cache_key(const DynamicScheme& scheme, const CalculationOptions& options)
+    {
+        Fingerprint fingerprint { };
+        fingerprint.add(string_view { "dynamic-scheme" }).add(scheme.scheme_name).add(scheme.all_count()).add(scheme.processors.size());
+        for (const Processor& processor : scheme.processors)
+            fingerprint.add(processor);
+        for (const Element& element : scheme.elements)
+            fingerprint.add(element);
+        for (const ExpressionOp& op : scheme.scheme_expression)
+            fingerprint.add(static_cast<size_t>(op.code)).add(op.element_idx);
+        fingerprint.add(static_cast<size_t>(scheme.type)).add(scheme.beam_options.width).add(scheme.beam_options.max_expanded_node_count);
+        fingerprint.add(scheme.brute_options);
+        fingerprint.add(options);
+        return fingerprint.key();
+    }
+
+    // Key of what decides whether each state works after reconfiguration, so it
+    // stays the same when only p/q change.
+    string make_topology_key(const DynamicScheme& scheme)
+    {
+        Fingerprint fingerprint { };
+        fingerprint.add(string_view { "topology" }).add(scheme.all_count()).add(scheme.processors.size());
+        for (const Processor& processor : scheme.processors)
+            fingerprint.add_topology(processor);
+        for (const Element& element : scheme.elements)
+            fingerprint.add(element.name);
+        for (const ExpressionOp& op : scheme.scheme_expression)
+            fingerprint.add(static_cast<size_t>(op.code)).add(op.element_idx);
+        fingerprint.add(static_cast<size_t>(scheme.type)).add(scheme.beam_options.width).add(scheme.beam_options.max_expanded_node_count);
+        fingerprint.add(scheme.brute_options);
+        return fingerprint.key();
+    }
+
+    // Runs asking for more than the plain summary are never cached.
+    bool is_cacheable(const CalculationOptions& options)
+    {
+        return options.result_cache_path.has_value() &&
+               options.top_failure_state_count == 0 &&
+               !options.target_reliability.has_value() &&
+               !options.measure_phases &&
+               !options.collect_load_statistics;
+    }
+
+    // One text file per key holding the summary of a complete run. The key is also
+    // left in the run's result directory: a later run of a scheme with the same name
+    // rewrites that directory, which invalidates the entry.
+    class ResultCache
+    {
+    private:
+
+        const string ENTRY_FILE_NAME_FORMAT { "{}.summary" };
+        const string RESULT_KEY_FILE_NAME { "cache.key" };
+
+        const path cache_path;
+
+    public:
+
+        ResultCache(const path& cache_path): cache_path { cache_path } { }
+
+        optional<SchemeReliabilitySummary> load(const string& key) const
+        {
+            ifstream entry_file { entry_path(key) };
+            if (!entry_file.is_open())
+                return nullopt;
+
+            SchemeReliabilitySummary summary { .sp = 0, .sq = 0, .state_vector_set_count = 0, .result_path = { } };
+            string line { };
+            while (getline(entry_file, line))
+            {
+                size_t separator { line.find(' ') };
+                if (separator == string::npos)
+                    continue;
+                string field { line.substr(0, separator) };
+                string value { line.substr(separator + 1) };
+                if (field == "sp")
+                    summary.sp = stod(value);
+                else if (field == "sq")
+                    summary.sq = stod(value);
+                else if (field == "state_vector_set_count")
+                    summary.state_vector_set_count = stoull(value);
+                else if (field == "result_path")
+                    summary.result_path = path { value };
+                else if (field == "thread_count")
+                    summary.thread_count = stoull(value);
+            }
+
+            if (summary.state_vector_set_count == 0 || !is_directory(summary.result_path))
+                return nullopt;
+
+            ifstream result_key_file { summary.result_path / RESULT_KEY_FILE_NAME };
+            string result_key { };
+            if (!getline(result_key_file, result_key) || result_key != key)
+                return nullopt;
+            summary.sp_low = summary.sp;
+            summary.sp_high = summary.sp;
+            summary.is_cached = true;
+            return summary;
+        }
+
+        void store(const string& key, const SchemeReliabilitySummary& summary) const
+        {
+            if (summary.is_partial)
+                return;
+
+            {
+                ofstream result_key_file { summary.result_path / RESULT_KEY_FILE_NAME };
+                if (!result_key_file.is_open())
+                    throw runtime_error(format("Error: can't open {} for writing", (summary.result_path / RESULT_KEY_FILE_NAME).string()));
+                result_key_file << key << '\n';
+            }
+
+            create_directories(cache_path);
+            path temporary_path { entry_path(key).string() + ".tmp" };
+            {
+                ofstream entry_file { temporary_path };
+                if (!entry_file.is_open())
+                    throw runtime_error(format("Error: can't open cache entry {} for writing", temporary_path.string()));
+                entry_file << format("sp {:.17g}\n", summary.sp);
+                entry_file << format("sq {:.17g}\n", summary.sq);
+                entry_file << format("state_vector_set_count {}\n", summary.state_vector_set_count);
+                entry_file << format("result_path {}\n", summary.result_path.string());
+                entry_file << format("thread_count {}\n", summary.thread_count);
+            }
+            rename(temporary_path, entry_path(key));
+        }
+
+    private:
+
+        path entry_path(const string& key) const
+        {
+            return cache_path / vformat(ENTRY_FILE_NAME_FORMAT, make_format_args(key));
+        }
+    };
+
+    // One outcome bitmap file per topology key, so a scheme whose p/q changed is
+    // re-weighted instead of enumerated again.
+    class OutcomeBitmapCache
+    {
+    private:
+
+        const string ENTRY_FILE_NAME_FORMAT { "{}.outcome" };
+
+        const path cache_path;
+
+    public:
+
+        OutcomeBitmapCache(const path& cache_path): cache_path { cache_path } { }
+
+        optional<OutcomeBitmap> load(const string& key) const
+        {
+            if (!exists(entry_path(key)))
+                return nullopt;
+            return read_outcome_bitmap(entry_path(key));
+        }
+
+        void store(const string& key, const OutcomeBitmap& bitmap) const
+        {
+            create_directories(cache_path);
+            path temporary_path { entry_path(key).string() + ".tmp" };
+            write_outcome_bitmap(temporary_path, bitmap);
+            rename(temporary_path, entry_path(key));
+        }
+
+    private:
+
+        path entry_path(const string& key) const
+        {
+            return cache_path / vformat(ENTRY_FILE_NAME_FORMAT, make_format_args(key));
+        }
+    };
+
+    // Returns the stored summary for key or runs calculate and stores its summary.
+    template<typename Calculate>
+    SchemeReliabilitySummary calculate_with_result_cache(
+        const optional<string>& key,
+        const CalculationOptions& options,
+        Calculate calculate
+    ) {
+        if (!key.has_value() || !is_cacheable(options))
+            return calculate();
+
+        ResultCache result_cache { options.result_cache_path.value() };
+        optional<SchemeReliabilitySummary> cached_summary { result_cache.load(key.value()) };
+        if (cached_summary.has_value())
+            return cached_summary.value();
+
+        SchemeReliabilitySummary summary { calculate() };
+        result_cache.store(key.value(), summary);
+        return summary;
+    }
+}
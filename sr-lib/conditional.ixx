@@ -0,0 +1,286 @@
+export module scheme_reliability:conditional;
+
+import :model;
+using namespace sr_impl::model;
+
+import :control;
+using namespace sr_impl::control;
+
+import :algorithm;
+using namespace sr_impl::algorithm;
+
+import :variants;
+using namespace sr_impl::variants;
+
+import :summation;
+using namespace sr_impl::summation;
+
+import std;
+using std::array;
+using std::vector;
+using std::span;
+using std::string;
+using std::unique_ptr;
+using std::runtime_error;
+using std::format;
+using std::thread;
+using std::atomic;
+using std::min, std::clamp;
+using std::chrono::steady_clock;
+
+namespace sr_impl::conditional
+{
+    // Evaluates a scheme with some elements pinned. The free elements are enumerated
+    // in the calculator's order, the pinned ones either keep their fixed state or, for
+    // a breakdown, are enumerated too and every state is booked under the assignment
+    // of the pinned elements it carries. Only summaries are produced.
+    template<size_t all_count, size_t processor_count>
+    class ConditionalReliabilityCalculator
+    {
+        static constexpr size_t MAX_BREAKDOWN_PINNED_COUNT { 16 };
+        static constexpr size_t MAX_DEPTH { 12 };
+        // Range sum entries over all assignments; a large breakdown gets coarser ranges.
+        static constexpr size_t MAX_RANGE_SUM_COUNT { static_cast<size_t>(1) << 20 };
+
+    private:
+
+        const Scheme<all_count, processor_count>& scheme;
+        unique_ptr<ReconfigurationTable<all_count, processor_count>> reconfiguration_table;
+
+        array<double, all_count> p;
+        array<double, all_count> q;
+
+        vector<size_t> pinned_indices;
+        vector<bool> pinned_states;
+        array<bool, all_count> is_pinned;
+        bool is_breakdown;
+
+        // Element indices enumerated, most significant first.
+        vector<size_t> enumerated_indices;
+        size_t depth;
+        size_t chunk_count;
+
+        struct WorkerState
+        {
+            vector<size_t> state_counts;
+            // The current chunk's sums per assignment and the assignments it touched.
+            vector<CompensatedSum> chunk_sp;
+            vector<CompensatedSum> chunk_sq;
+            vector<bool> is_touched;
+            vector<size_t> touched_indices;
+        };
+
+    public:
+
+        ConditionalReliabilityCalculator(
+            const Scheme<all_count, processor_count>& scheme,
+            span<const string> pinned_names,
+            const vector<bool>& pinned_states,
+            bool is_breakdown
+        ):
+            scheme { scheme },
+            reconfiguration_table { make_reconfiguration_table(scheme) },
+            p { }, q { },
+            pinned_indices { },
+            pinned_states { pinned_states },
+            is_pinned { },
+            is_breakdown { is_breakdown },
+            enumerated_indices { },
+            depth { 0 },
+            chunk_count { 0 }
+        {
+            fill_element_probabilities(scheme, p, q);
+
+            for (const string& name : pinned_names)
+            {
+                size_t idx { element_index(name) };
+                if (is_pinned[idx])
+                    throw runtime_error(format("Error: element {} is pinned twice", name));
+                is_pinned[idx] = true;
+                pinned_indices.push_back(idx);
+            }
+            if (is_breakdown && pinned_indices.size() > MAX_BREAKDOWN_PINNED_COUNT)
+                throw runtime_error(format("Error: a breakdown pins at most {} elements", MAX_BREAKDOWN_PINNED_COUNT));
+
+            for (size_t i = 0; i < all_count; i++)
+                if (is_breakdown || !is_pinned[i])
+                    enumerated_indices.push_back(i);
+            depth = min(enumerated_indices.size(), MAX_DEPTH);
+            chunk_count = static_cast<size_t>(1) << (enumerated_indices.size() - depth);
+        }
+
+        ConditionalBreakdown calculate(const CalculationOptions& options)
+        {
+            RunControl run_control { options, steady_clock::now() };
+            size_t thread_count { options.thread_count == 0 ? thread::hardware_concurrency() : options.thread_count };
+            size_t assignment_count { is_breakdown ? static_cast<size_t>(1) << pinned_indices.size() : 1 };
+
+            vector<WorkerState> workers(thread_count, WorkerState
+            {
+                .state_counts = vector<size_t>(assignment_count, 0),
+                .chunk_sp = vector<CompensatedSum>(assignment_count),
+                .chunk_sq = vector<CompensatedSum>(assignment_count),
+                .is_touched = vector<bool>(assignment_count, false),
+                .touched_indices = { }
+            });
+
+            // Every assignment's table has the same layout, so one cursor serves them all.
+            size_t max_range_count { clamp<size_t>(MAX_RANGE_SUM_COUNT / assignment_count, 1, RangeSums::MAX_RANGE_COUNT) };
+            vector<RangeSums> assignment_sums(assignment_count, RangeSums { chunk_count, max_range_count });
+            atomic<size_t> next_range { 0 };
+            vector<thread> threads { };
+            for (WorkerState& worker : workers)
+                threads.emplace_back([this, &worker, &assignment_sums, &next_range, &run_control]()
+                {
+                    RangeCursor cursor { assignment_sums.front(), next_range };
+                    process_chunks(worker, cursor, assignment_sums, run_control);
+                });
+            for (thread& worker_thread : threads)
+                worker_thread.join();
+
+            return merge_worker_states(workers, assignment_sums);
+        }
+
+    private:
+
+        size_t element_index(const string& name) const
+        {
+            for (size_t i = 0; i < processor_count; i++)
+                if (scheme.processors[i].name == name)
+                    return i;
+            for (size_t i = 0; i < all_count - processor_count; i++)
+                if (scheme.elements[i].name == name)
+                    return processor_count + i;
+            throw runtime_error(format("Error: scheme {} has no element {}", scheme.scheme_name, name));
+        }
+
+        void process_chunks(WorkerState& worker, RangeCursor& cursor, vector<RangeSums>& assignment_sums, RunControl& run_control)
+        {
+            const size_t chunk_size { static_cast<size_t>(1) << depth };
+            const size_t enumerated_count { enumerated_indices.size() };
+
+            StateVector<all_count, processor_count> sv1 { };
+            for (size_t j = 0; j < pinned_indices.size() && !is_breakdown; j++)
+                sv1.all[pinned_indices[j]] = pinned_states[j];
+
+            while (!run_control.poll())
+            {
+                size_t chunk_idx { cursor.next_chunk_idx() };
+                if (chunk_idx >= chunk_count)
+                    break;
+
+                for (size_t k = 0; k < chunk_size; k++)
+                {
+                    size_t state_idx { chunk_idx * chunk_size + k };
+                    for (size_t e = 0; e < enumerated_count; e++)
+                        sv1.all[enumerated_indices[e]] = ((state_idx >> (enumerated_count - 1 - e)) & 1) == 0;
+
+                    // Pinned elements are left out: their probability is the assignment's.
+                    double probability { 1.0 };
+                    size_t assignment_idx { 0 };
+                    for (size_t i = 0; i < all_count; i++)
+                        if (!is_pinned[i])
+                            probability *= sv1.all[i] ? p[i] : q[i];
+                    if (is_breakdown)
+                        for (size_t pinned_idx : pinned_indices)
+                            assignment_idx = assignment_idx << 1 | (sv1.all[pinned_idx] ? 0 : 1);
+
+                    bool is_working
+                    {
+                        reconfiguration_table->requires_reconfiguration(sv1)
+                            ? scheme.scheme_function(reconfiguration_table->reconfigure_state(sv1))
+                            : scheme.scheme_function(sv1)
+                    };
+                    (is_working ? worker.chunk_sp : worker.chunk_sq)[assignment_idx].add(probability);
+                    worker.state_counts[assignment_idx]++;
+                    if (!worker.is_touched[assignment_idx])
+                    {
+                        worker.is_touched[assignment_idx] = true;
+                        worker.touched_indices.push_back(assignment_idx);
+                    }
+                }
+
+                for (size_t assignment_idx : worker.touched_indices)
+                {
+                    assignment_sums[assignment_idx].add_chunk(chunk_idx, worker.chunk_sp[assignment_idx], worker.chunk_sq[assignment_idx]);
+                    worker.chunk_sp[assignment_idx] = { };
+                    worker.chunk_sq[assignment_idx] = { };
+                    worker.is_touched[assignment_idx] = false;
+                }
+                worker.touched_indices.clear();
+            }
+        }
+
+        ConditionalBreakdown merge_worker_states(const vector<WorkerState>& workers, const vector<RangeSums>& assignment_sums) const
+        {
+            const size_t assignment_count { assignment_sums.size() };
+            ConditionalBreakdown result { .pinned_elements = { }, .assignments = { }, .sp = 0, .sq = 0 };
+            CompensatedSum sp { };
+            CompensatedSum sq { };
+            for (size_t idx : pinned_indices)
+                result.pinned_elements.push_back(idx < processor_count ? scheme.processors[idx].name : scheme.elements[idx - processor_count].name);
+
+            // Every assignment holds the same number of free states.
+            const size_t free_state_count { (chunk_count << depth) / assignment_count };
+            for (size_t a = 0; a < assignment_count; a++)
+            {
+                ConditionalReliability assignment
+                {
+                    .assignment = { },
+                    .assignment_probability = 1.0,
+                    .conditional_sp = 0, .conditional_sq = 0,
+                    .sp = 0, .sq = 0,
+                    .state_vector_set_count = 0,
+                    .is_partial = false
+                };
+                for (size_t j = 0; j < pinned_indices.size(); j++)
+                {
+                    bool is_working { is_breakdown ? ((a >> (pinned_indices.size() - 1 - j)) & 1) == 0 : pinned_states[j] };
+                    assignment.assignment.push_back(PinnedElement { .name = result.pinned_elements[j], .is_working = is_working });
+                    assignment.assignment_probability *= is_working ? p[pinned_indices[j]] : q[pinned_indices[j]];
+                }
+                assignment.conditional_sp = assignment_sums[a].total_sp();
+                assignment.conditional_sq = assignment_sums[a].total_sq();
+                for (const WorkerState& worker : workers)
+                    assignment.state_vector_set_count += worker.state_counts[a];
+                assignment.sp = assignment.conditional_sp * assignment.assignment_probability;
+                assignment.sq = assignment.conditional_sq * assignment.assignment_probability;
+                assignment.is_partial = assignment.state_vector_set_count < free_state_count;
+
+                sp.add(assignment.sp);
+                sq.add(assignment.sq);
+                result.assignments.push_back(assignment);
+            }
+            result.sp = sp.value();
+            result.sq = sq.value();
+            return result;
+        }
+    };
+
+    template<size_t all_count, size_t processor_count>
+    ConditionalReliability calculate_conditional_reliability(
+        const Scheme<all_count, processor_count>& scheme,
+        span<const PinnedElement> pinned_elements,
+        const CalculationOptions& options
+    ) {
+        vector<string> names { };
+        vector<bool> states { };
+        for (const PinnedElement& pinned : pinned_elements)
+        {
+            names.push_back(pinned.name);
+            states.push_back(pinned.is_working);
+        }
+        ConditionalReliabilityCalculator<all_count, processor_count> calculator { scheme, names, states, false };
+        return calculator.calculate(options).assignments.front();
+    }
+
+    template<size_t all_count, size_t processor_count>
+    ConditionalBreakdown calculate_conditional_breakdown(
+        const Scheme<all_count, processor_count>& scheme,
+        span<const string> pinned_names,
+        const CalculationOptions& options
+    ) {
+        ConditionalReliabilityCalculator<all_count, processor_count> calculator { scheme, pinned_names, { }, true };
+        return calculator.calculate(options);
+    }
+}
@@ -0,0 +1,61 @@
+export module scheme_reliability:control;
+
+import :model;
+using namespace sr_impl::model;
+
+import std;
+using std::atomic, std::memory_order_relaxed;
+using std::optional, std::nullopt;
+using std::stop_token;
+using std::chrono::steady_clock;
+
+namespace sr_impl::control
+{
+    class RunControl
+    {
+    private:
+
+        const stop_token cancellation_token;
+        const optional<steady_clock::time_point> deadline;
+
+        atomic<bool> is_stop_requested;
+
+    public:
+
+        RunControl(const CalculationOptions& options, steady_clock::time_point start):
+            cancellation_token { options.cancellation_token },
+            deadline
+            {
+                options.time_budget.has_value()
+                    ? optional<steady_clock::time_point> { start + options.time_budget.value() }
+                    : nullopt
+            },
+            is_stop_requested { false }
+        { }
+
+        RunControl(const RunControl&) = delete;
+        RunControl& operator=(const RunControl&) = delete;
+
+        inline bool is_stopped() const
+        {
+            return is_stop_requested.load(memory_order_relaxed);
+        }
+
+        // Checks the cancellation token and the wall-clock budget; cheap enough for
+        // the idle loop, hot loops should call it every few thousand states.
+        bool poll()
+        {
+            if (is_stopped())
+                return true;
+
+            if (cancellation_token.stop_requested() ||
+                (deadline.has_value() && steady_clock::now() >= deadline.value()))
+            {
+                is_stop_requested.store(true, memory_order_relaxed);
+                return true;
+            }
+
+            return false;
+        }
+    };
+}
@@ -0,0 +1,165 @@
+export module scheme_reliability:cutsets;
+
+import :model;
+using namespace sr_impl::model;
+
+import :algorithm;
+using namespace sr_impl::algorithm;
+
+import std;
+using std::array;
+using std::vector;
+using std::string;
+using std::unique_ptr;
+using std::ranges::sort;
+
+namespace sr_impl::cutsets
+{
+    // Walks failure combinations in increasing order and evaluates the reconfigured
+    // state of each. Assuming the reconfigured system is monotone, any superset of a
+    // cut is a cut too, so supersets of cuts already found are skipped unevaluated.
+    template<size_t all_count, size_t processor_count>
+    class MinimalCutSetFinder
+    {
+        static_assert(all_count <= 64, "cut sets are tracked as 64-bit element masks");
+
+    private:
+
+        const Scheme<all_count, processor_count>& scheme;
+        const CutSetOptions options;
+        unique_ptr<ReconfigurationTable<all_count, processor_count>> reconfiguration_table;
+
+        array<string, all_count> names;
+        array<double, all_count> p;
+        array<double, all_count> q;
+
+        vector<unsigned long long> cut_masks;
+        vector<size_t> combination;
+        CutSetReport report;
+
+    public:
+
+        MinimalCutSetFinder(const Scheme<all_count, processor_count>& scheme, const CutSetOptions& options):
+            scheme { scheme },
+            options { options },
+            reconfiguration_table { make_reconfiguration_table(scheme) },
+            names { }, p { }, q { },
+            cut_masks { },
+            combination { },
+            report
+            {
+                .max_order = options.max_order,
+                .evaluated_state_count = 0,
+                .skipped_superset_count = 0,
+                .cut_probability_sum = 0,
+                .cut_sets = { }
+            }
+        {
+            for (size_t i = 0; i < processor_count; i++)
+            {
+                names[i] = scheme.processors[i].name;
+                p[i] = scheme.processors[i].p;
+                q[i] = scheme.processors[i].q;
+            }
+            for (size_t i = processor_count; i < all_count; i++)
+            {
+                names[i] = scheme.elements[i - processor_count].name;
+                p[i] = scheme.elements[i - processor_count].p;
+                q[i] = scheme.elements[i - processor_count].q;
+            }
+        }
+
+        CutSetReport find()
+        {
+            for (size_t order = 0; order <= options.max_order && order <= all_count; order++)
+            {
+                combination.clear();
+                visit_combinations(0, order);
+            }
+
+            sort(
+                report.cut_sets,
+                [](const MinimalCutSet& a, const MinimalCutSet& b) { return a.probability > b.probability; }
+            );
+            return report;
+        }
+
+    private:
+
+        void visit_combinations(size_t first_idx, size_t remaining)
+        {
+            if (remaining == 0)
+            {
+                evaluate_combination();
+                return;
+            }
+
+            for (size_t i = first_idx; i + remaining <= all_count; i++)
+            {
+                combination.push_back(i);
+                visit_combinations(i + 1, remaining - 1);
+                combination.pop_back();
+            }
+        }
+
+        void evaluate_combination()
+        {
+            unsigned long long mask { 0 };
+            for (size_t idx : combination)
+                mask |= 1ull << idx;
+
+            for (unsigned long long cut_mask : cut_masks)
+            {
+                if ((mask & cut_mask) == cut_mask)
+                {
+                    report.skipped_superset_count++;
+                    return;
+                }
+            }
+
+            StateVector<all_count, processor_count> sv1 { };
+            for (size_t i = 0; i < all_count; i++)
+                sv1.all[i] = (mask >> i & 1) == 0;
+
+            StateVector<all_count, processor_count> sv2
+            {
+                reconfiguration_table->requires_reconfiguration(sv1) ? reconfiguration_table->reconfigure_state(sv1) : sv1
+            };
+            report.evaluated_state_count++;
+            if (scheme.scheme_function(sv2))
+                return;
+
+            MinimalCutSet cut_set
+            {
+                .elements = { },
+                .element_indices = combination,
+                .probability = 1.0,
+                .state_probability = 1.0
+            };
+            for (size_t i = 0; i < all_count; i++)
+            {
+                if (mask >> i & 1)
+                {
+                    cut_set.elements.push_back(names[i]);
+                    cut_set.probability *= q[i];
+                    cut_set.state_probability *= q[i];
+                }
+                else
+                    cut_set.state_probability *= p[i];
+            }
+
+            cut_masks.push_back(mask);
+            report.cut_probability_sum += cut_set.probability;
+            report.cut_sets.push_back(cut_set);
+        }
+    };
+
+    template<size_t all_count, size_t processor_count>
+    CutSetReport find_minimal_cut_sets(
+        const Scheme<all_count, processor_count>& scheme,
+        const CutSetOptions& options
+    ) {
+        MinimalCutSetFinder<all_count, processor_count> finder { scheme, options };
+        return finder.find();
+    }
+}
@@ -0,0 +1,1022 @@
+export module scheme_reliability:dynamic;
+
+import :model;
+using namespace sr_impl::model;
+
+import :control;
+using namespace sr_impl::control;
+
+import :transition_table;
+using namespace sr_impl::transition_table;
+
+import :cache;
+using namespace sr_impl::cache;
+
+import :outcome;
+using namespace sr_impl::outcome;
+
+import :summation;
+using namespace sr_impl::summation;
+
+import std;
+using std::array;
+using std::vector;
+using std::pair;
+using std::unordered_set;
+using std::string;
+using std::optional, std::nullopt;
+using std::ofstream;
+using std::filesystem::path;
+using std::filesystem::exists, std::filesystem::remove_all, std::filesystem::create_directory;
+using std::runtime_error;
+using std::format;
+using std::vformat, std::make_format_args;
+using std::thread;
+using std::atomic;
+using std::memcpy;
+using std::min, std::max;
+using std::swap, std::stable_sort;
+using std::move;
+using std::unique_ptr, std::make_unique;
+using std::popcount, std::countr_zero;
+using std::chrono::steady_clock;
+
+namespace sr_impl::dynamic
+{
+    // Bit i is set when element i works; processors occupy the low bits.
+    using PackedState = unsigned long long;
+
+    constexpr size_t MAX_ELEMENT_COUNT { 63 };
+    constexpr size_t MAX_PROCESSOR_COUNT { 32 };
+
+    // Evaluates the postfix scheme expression on 64 states at once: each operand is a
+    // word whose lane l holds the element's state in the l-th state of the word.
+    // Keeps its own stack, so every worker needs its own copy.
+    class PackedExpression
+    {
+    private:
+
+        vector<ExpressionOp> program;
+        vector<PackedState> stack;
+
+    public:
+
+        PackedExpression(const vector<ExpressionOp>& program):
+            program { program },
+            stack(program.size())
+        { }
+
+        template<typename LaneSource>
+        PackedState evaluate_lanes(LaneSource&& element_lanes)
+        {
+            size_t top { 0 };
+            for (const ExpressionOp& op : program)
+            {
+                switch (op.code)
+                {
+                case ExpressionOpCode::Element: stack[top++] = element_lanes(op.element_idx); break;
+                case ExpressionOpCode::True: stack[top++] = ~0ull; break;
+                case ExpressionOpCode::False: stack[top++] = 0; break;
+                case ExpressionOpCode::Not: stack[top - 1] = ~stack[top - 1]; break;
+                case ExpressionOpCode::And: top--; stack[top - 1] &= stack[top]; break;
+                case ExpressionOpCode::Or: top--; stack[top - 1] |= stack[top]; break;
+                }
+            }
+            return stack[0];
+        }
+    };
+
+    // Packed-state port of the greedy, brute force and beam search table decisions.
+    // All only read and change processor bits, so for a fixed processor state the
+    // outcome is a short list of candidate states: the reconfigured state is the first
+    // candidate the scheme function accepts, or the fallback when none does.
+    class PackedReconfigurationTable
+    {
+    private:
+
+        static constexpr double OVERLOAD_COEFFICIENT { 1e6 };
+        // The brute force search tree has a leaf per combination of the failed
+        // processors' valid transitions, so a chunk visits at most this many.
+        static constexpr size_t MAX_VISITED_LEAF_COUNT { 1 << 16 };
+
+        using Loads = array<double, MAX_PROCESSOR_COUNT>;
+
+        const SchemeType type;
+        const BeamOptions beam_options;
+        const size_t processor_count;
+        const PackedState processor_mask;
+        PackedState reconfigurable_mask;
+
+        Loads normal_load;
+        Loads max_load;
+        vector<TransitionSet> table;
+
+        struct BruteForceState
+        {
+            PackedState sv1;
+            Loads load;
+            array<const Transition*, MAX_PROCESSOR_COUNT> applied_transitions;
+        };
+
+        struct BeamNode
+        {
+            Loads load;
+            array<const Transition*, MAX_PROCESSOR_COUNT> applied_transitions;
+        };
+
+        struct BeamChild
+        {
+            size_t node_idx;
+            const Transition* transition;
+            double score;
+        };
+
+    public:
+
+        PackedReconfigurationTable(const DynamicScheme& scheme):
+            type { scheme.type },
+            beam_options { scheme.beam_options },
+            processor_count { scheme.processors.size() },
+            processor_mask { (1ull << scheme.processors.size()) - 1 },
+            reconfigurable_mask { 0 },
+            normal_load { }, max_load { },
+            table(scheme.processors.size())
+        {
+            // Brute force searches the normalized table, as BruteForceReconfigurationTable does.
+            if (type == SchemeType::Brute)
+                table = normalize_transition_table(scheme).table;
+            for (size_t i = 0; i < processor_count; i++)
+            {
+                normal_load[i] = scheme.processors[i].normal_load;
+                max_load[i] = scheme.processors[i].max_load;
+                if (type != SchemeType::Brute)
+                    table[i] = scheme.processors[i].transitions;
+                if (!table[i].empty())
+                    reconfigurable_mask |= 1ull << i;
+            }
+            if (type == SchemeType::Beam && beam_options.width == 0)
+                throw runtime_error(format("Error: beam width of scheme {} must be positive", scheme.scheme_name));
+        }
+
+        inline bool requires_reconfiguration(PackedState sv1) const
+        {
+            return (~sv1 & reconfigurable_mask) != 0;
+        }
+
+        // Greedy picks its transitions without looking at the scheme function, so it
+        // yields a single candidate. Brute force lists every distinct leaf of its
+        // search tree in visiting order; the fallback is the first leaf with the most
+        // working processors, which is what the search keeps when no leaf succeeds.
+        // Beam search lists its final beam the same way. A brute force search cut at
+        // MAX_VISITED_LEAF_COUNT has no fallback: the states none of its leaves accept
+        // go through reconfigure_brute one by one.
+        optional<size_t> collect_candidates(PackedState sv1, vector<PackedState>& candidates) const
+        {
+            candidates.clear();
+            if (!requires_reconfiguration(sv1))
+            {
+                candidates.push_back(sv1);
+                return 0;
+            }
+            if (type == SchemeType::Greedy)
+            {
+                candidates.push_back(reconfigure_greedy(sv1));
+                return 0;
+            }
+            if (type == SchemeType::Beam)
+                return collect_beam_candidates(sv1, candidates);
+
+            BruteForceState state { .sv1 = sv1, .load = normal_load, .applied_transitions = { } };
+            unordered_set<PackedState> listed_candidates { };
+            size_t visited_leaf_count { 0 };
+            size_t fallback_idx { 0 };
+            long long fallback_active_count { -1 };
+            bool is_complete
+            {
+                traverse_reconfiguration_tree(~sv1 & reconfigurable_mask, state, [&](PackedState sv2)
+                {
+                    if (++visited_leaf_count > MAX_VISITED_LEAF_COUNT)
+                        return false;
+                    if (!listed_candidates.insert(sv2).second)
+                        return true;
+
+                    long long active_count { popcount(sv2 & processor_mask) };
+                    if (active_count > fallback_active_count)
+                    {
+                        fallback_idx = candidates.size();
+                        fallback_active_count = active_count;
+                    }
+                    candidates.push_back(sv2);
+                    return true;
+                })
+            };
+            return is_complete ? optional<size_t> { fallback_idx } : nullopt;
+        }
+
+        // The brute force search of a single state: the first leaf is_accepted takes,
+        // or the first leaf with the most working processors.
+        template<typename Acceptor>
+        PackedState reconfigure_brute(PackedState sv1, const Acceptor& is_accepted) const
+        {
+            BruteForceState state { .sv1 = sv1, .load = normal_load, .applied_transitions = { } };
+            optional<PackedState> accepted_sv2 { };
+            PackedState fallback_sv2 { sv1 };
+            long long fallback_active_count { -1 };
+            traverse_reconfiguration_tree(~sv1 & reconfigurable_mask, state, [&](PackedState sv2)
+            {
+                if (is_accepted(sv2))
+                {
+                    accepted_sv2 = sv2;
+                    return false;
+                }
+
+                long long active_count { popcount(sv2 & processor_mask) };
+                if (active_count > fallback_active_count)
+                {
+                    fallback_sv2 = sv2;
+                    fallback_active_count = active_count;
+                }
+                return true;
+            });
+            return accepted_sv2.value_or(fallback_sv2);
+        }
+
+    private:
+
+        static inline bool is_working(PackedState sv, size_t idx)
+        {
+            return (sv >> idx & 1) != 0;
+        }
+
+        void apply_transition_to_load(const Transition& transition, Loads& load, double sign) const
+        {
+            for (const IdxL& increment : transition)
+                load[increment.index] += sign * increment.load;
+        }
+
+        bool is_transition_valid(PackedState sv, const Transition& transition) const
+        {
+            if (transition.empty()) return false;
+            for (const IdxL& t : transition)
+                if (!is_working(sv, t.index)) return false;
+            return true;
+        }
+
+        bool is_transition_successful(PackedState original_sv, const Transition& transition, const Loads& load) const
+        {
+            if (transition.empty()) return false;
+            for (const IdxL& t : transition)
+                if (!is_working(original_sv, t.index) || load[t.index] > max_load[t.index])
+                    return false;
+            return true;
+        }
+
+        PackedState reconfigure_greedy(PackedState sv1) const
+        {
+            Loads load { normal_load };
+            array<const Transition*, MAX_PROCESSOR_COUNT> transitions { };
+            for (size_t i = 0; i < processor_count; i++)
+                if (!is_working(sv1, i) && !table[i].empty())
+                    transitions[i] = update_reconfiguration_load(sv1, load, table[i]);
+
+            PackedState sv2 { sv1 };
+            for (size_t i = 0; i < processor_count; i++)
+            {
+                if (is_working(sv1, i) && load[i] > max_load[i])
+                    sv2 &= ~(1ull << i);
+                else if (transitions[i] != nullptr && !is_working(sv1, i) &&
+                         is_transition_successful(sv1, *transitions[i], load))
+                    sv2 |= 1ull << i;
+            }
+            return sv2;
+        }
+
+        // Port of BeamSearchReconfigurationTable::reconfigure.
+        size_t collect_beam_candidates(PackedState sv1, vector<PackedState>& candidates) const
+        {
+            vector<BeamNode> beam { BeamNode { .load = normal_load, .applied_transitions = { } } };
+            vector<BeamNode> next_beam { };
+            vector<BeamChild> children { };
+            size_t expanded_node_count { 0 };
+            for (size_t i = 0; i < processor_count; i++)
+            {
+                if (is_working(sv1, i) || table[i].empty())
+                    continue;
+
+                size_t width { expanded_node_count < beam_options.max_expanded_node_count ? beam_options.width : 1 };
+                children.clear();
+                for (size_t n = 0; n < beam.size() && n < width; n++)
+                {
+                    expand_beam_node(sv1, beam[n], n, table[i], children);
+                    expanded_node_count += table[i].size();
+                }
+
+                size_t leading_child_idx { 0 };
+                for (size_t c = 1; c < children.size() && children[c].node_idx == 0; c++)
+                    if (children[c].score <= children[leading_child_idx].score)
+                        leading_child_idx = c;
+                swap(children[0], children[leading_child_idx]);
+                stable_sort(
+                    children.begin() + 1, children.end(),
+                    [](const BeamChild& a, const BeamChild& b) { return a.score < b.score; }
+                );
+
+                next_beam.clear();
+                for (size_t c = 0; c < children.size() && next_beam.size() < width; c++)
+                {
+                    BeamNode child { beam[children[c].node_idx] };
+                    if (children[c].transition != nullptr)
+                    {
+                        child.applied_transitions[i] = children[c].transition;
+                        apply_transition_to_load(*children[c].transition, child.load, 1.0);
+                    }
+                    next_beam.push_back(child);
+                }
+                swap(beam, next_beam);
+            }
+
+            size_t fallback_idx { 0 };
+            long long fallback_active_count { -1 };
+            for (const BeamNode& node : beam)
+            {
+                PackedState sv2 { complete_assignment(sv1, node.load, node.applied_transitions) };
+                long long active_count { popcount(sv2 & processor_mask) };
+                if (active_count > fallback_active_count)
+                {
+                    fallback_idx = candidates.size();
+                    fallback_active_count = active_count;
+                }
+                candidates.push_back(sv2);
+            }
+            return fallback_idx;
+        }
+
+        void expand_beam_node(PackedState sv1, const BeamNode& node, size_t node_idx, const TransitionSet& transitions, vector<BeamChild>& children) const
+        {
+            bool has_valid_transition { false };
+            for (const Transition& transition : transitions)
+            {
+                if (!is_transition_valid(sv1, transition))
+                    continue;
+
+                Loads temp_load { node.load };
+                apply_transition_to_load(transition, temp_load, 1.0);
+                children.push_back(BeamChild { .node_idx = node_idx, .transition = &transition, .score = load_score(temp_load, transition.size()) });
+                has_valid_transition = true;
+            }
+            if (!has_valid_transition)
+                children.push_back(BeamChild { .node_idx = node_idx, .transition = nullptr, .score = load_score(node.load, 1) });
+        }
+
+        PackedState complete_assignment(PackedState sv1, const Loads& load, const array<const Transition*, MAX_PROCESSOR_COUNT>& applied_transitions) const
+        {
+            PackedState sv2 { sv1 };
+            for (size_t i = 0; i < processor_count; i++)
+            {
+                if (is_working(sv1, i) && load[i] > max_load[i])
+                    sv2 &= ~(1ull << i);
+                else if (applied_transitions[i] != nullptr && is_transition_successful(sv1, *applied_transitions[i], load))
+                    sv2 |= 1ull << i;
+            }
+            return sv2;
+        }
+
+        // Equal scores keep the later transition, like the score map of the templated table.
+        const Transition* update_reconfiguration_load(PackedState sv, Loads& load, const TransitionSet& transitions) const
+        {
+            const Transition* best_transition { nullptr };
+            double best_score { 0 };
+            for (const Transition& transition : transitions)
+            {
+                if (!is_transition_valid(sv, transition))
+                    continue;
+
+                Loads temp_load { load };
+                apply_transition_to_load(transition, temp_load, 1.0);
+                double score { load_score(temp_load, transition.size()) };
+                if (best_transition == nullptr || score <= best_score)
+                {
+                    best_transition = &transition;
+                    best_score = score;
+                }
+            }
+
+            if (best_transition != nullptr)
+                apply_transition_to_load(*best_transition, load, 1.0);
+            return best_transition;
+        }
+
+        double load_score(const Loads& load, size_t transition_size) const
+        {
+            double result { 0 };
+            for (size_t i = 0; i < processor_count; i++)
+            {
+                double temp { load[i] / max_load[i] };
+                if (temp > 1.0) temp *= OVERLOAD_COEFFICIENT;
+                result += temp;
+            }
+            result /= static_cast<double>(transition_size);
+            return result;
+        }
+
+        // Lowest failed processor first and transitions by ascending load score, as the
+        // templated table searches. visit_leaf gets each leaf's sv2 and returns false
+        // to stop the search, which then returns false as well.
+        template<typename LeafVisitor>
+        bool traverse_reconfiguration_tree(PackedState failed_processors, BruteForceState& state, const LeafVisitor& visit_leaf) const
+        {
+            if (failed_processors == 0)
+                return visit_leaf(complete_assignment(state.sv1, state.load, state.applied_transitions));
+
+            size_t current_idx { static_cast<size_t>(countr_zero(failed_processors)) };
+            PackedState remaining { failed_processors & ~(1ull << current_idx) };
+            const TransitionSet& transitions { table[current_idx] };
+
+            vector<pair<double, const Transition*>> scored_transitions { };
+            for (size_t t = transitions.size(); t-- > 0;)
+            {
+                if (!is_transition_valid(state.sv1, transitions[t]))
+                    continue;
+
+                Loads temp_load { state.load };
+                apply_transition_to_load(transitions[t], temp_load, 1.0);
+                scored_transitions.push_back({ load_score(temp_load, transitions[t].size()), &transitions[t] });
+            }
+            stable_sort(
+                scored_transitions.begin(), scored_transitions.end(),
+                [](const pair<double, const Transition*>& a, const pair<double, const Transition*>& b) { return a.first < b.first; }
+            );
+
+            for (const auto& [score, transition] : scored_transitions)
+            {
+                state.applied_transitions[current_idx] = transition;
+                apply_transition_to_load(*transition, state.load, 1.0);
+                bool is_continuing { traverse_reconfiguration_tree(remaining, state, visit_leaf) };
+                apply_transition_to_load(*transition, state.load, -1.0);
+                state.applied_transitions[current_idx] = nullptr;
+                if (!is_continuing)
+                    return false;
+            }
+            if (scored_transitions.size() < transitions.size())
+                return traverse_reconfiguration_tree(remaining, state, visit_leaf);
+            return true;
+        }
+    };
+
+    // Runtime-sized calculator. States are enumerated in the order of the templated
+    // calculator: the leading elements form a chunk prefix that always covers every
+    // processor, the trailing depth elements are walked inside the chunk. Probabilities
+    // of the trailing part come from a table, reconfiguration candidates are collected
+    // once per chunk and the scheme expression runs 64 states per word.
+    class DynamicSchemeReliabilityCalculator
+    {
+    private:
+
+        static constexpr size_t MAX_DEPTH { 12 };
+        static constexpr size_t LANE_COUNT { 64 };
+
+        static constexpr size_t RECORD_HEADER_SIZE { 3 * sizeof(bool) + sizeof(double) };
+
+        const string DATA_FILE_NAME_FORMAT { "{}/{}-{}.ssv" };
+        const string ELEMENTS_FILE_NAME_FORMAT { "{}/{}.elems" };
+        const string OUTCOME_FILE_NAME_FORMAT { "{}/{}.outcome" };
+
+        const DynamicScheme& scheme;
+        const size_t all_count;
+        const size_t processor_count;
+        const size_t depth;
+        const size_t prefix_count;
+        const size_t chunk_size;
+        const size_t chunk_count;
+        const size_t word_count;
+
+        vector<double> p;
+        vector<double> q;
+
+        vector<PackedState> suffix_states;
+        vector<double> suffix_probabilities;
+        vector<char> suffix_bytes;
+        vector<PackedState> suffix_lanes;
+
+        // What one worker keeps across the chunks of a run. A worker is not tied to a
+        // thread, only to one thread at a time, so a shared pool can drive it.
+        struct WorkerState
+        {
+            PackedExpression scheme_expression;
+            PackedReconfigurationTable reconfiguration_table;
+            RangeCursor cursor;
+            ofstream data_file;
+            vector<char> output_buffer;
+            vector<char> prefix_bytes_sv1;
+            vector<PackedState> candidates;
+            vector<char> candidate_bytes;
+            array<size_t, LANE_COUNT> lane_candidates;
+            size_t state_vector_set_count;
+        };
+
+        struct RunState
+        {
+            RunControl run_control;
+            const bool is_bitmap;
+            RangeSums range_sums;
+            atomic<size_t> next_range;
+            vector<PackedState> chunk_words;
+            vector<unique_ptr<WorkerState>> workers;
+
+            RunState(const CalculationOptions& options, size_t chunk_count, size_t word_count):
+                run_control { options, steady_clock::now() },
+                is_bitmap { options.output_format == OutputFormat::Bitmap },
+                range_sums { chunk_count },
+                next_range { 0 },
+                chunk_words(is_bitmap ? chunk_count * word_count : 0),
+                workers { }
+            { }
+        };
+
+        unique_ptr<RunState> run;
+    public:
+
+        DynamicSchemeReliabilityCalculator(const DynamicScheme& scheme):
+            scheme { scheme },
+            all_count { scheme.all_count() },
+            processor_count { scheme.processors.size() },
+            depth { min(MAX_DEPTH, scheme.all_count() - scheme.processors.size()) },
+            prefix_count { scheme.all_count() - depth },
+            chunk_size { static_cast<size_t>(1) << depth },
+            chunk_count { static_cast<size_t>(1) << (scheme.all_count() - depth) },
+            word_count { (chunk_size + LANE_COUNT - 1) / LANE_COUNT },
+            p(scheme.all_count()), q(scheme.all_count()),
+            suffix_states(chunk_size), suffix_probabilities(chunk_size),
+            suffix_bytes(chunk_size * depth),
+            suffix_lanes(word_count * depth),
+            run { }
+        {
+            for (size_t i = 0; i < processor_count; i++)
+            {
+                p[i] = scheme.processors[i].p;
+                q[i] = scheme.processors[i].q;
+            }
+            for (size_t i = processor_count; i < all_count; i++)
+            {
+                p[i] = scheme.elements[i - processor_count].p;
+                q[i] = scheme.elements[i - processor_count].q;
+            }
+
+            for (size_t k = 0; k < chunk_size; k++)
+            {
+                suffix_states[k] = 0;
+                suffix_probabilities[k] = 1.0;
+                for (size_t j = 0; j < depth; j++)
+                {
+                    size_t idx { prefix_count + j };
+                    bool is_working { ((k >> (depth - 1 - j)) & 1) == 0 };
+                    if (is_working)
+                        suffix_states[k] |= 1ull << idx;
+                    suffix_probabilities[k] *= is_working ? p[idx] : q[idx];
+                    suffix_bytes[k * depth + j] = is_working;
+                    if (is_working)
+                        suffix_lanes[(k / LANE_COUNT) * depth + j] |= 1ull << (k % LANE_COUNT);
+                }
+            }
+        }
+
+        SchemeReliabilitySummary calculate_scheme_reliability(const CalculationOptions& options)
+        {
+            size_t thread_count { options.thread_count == 0 ? thread::hardware_concurrency() : options.thread_count };
+            start_run(options, thread_count);
+            run_workers(thread_count);
+            return finish_run();
+        }
+
+        // Same enumeration and decisions as a run, keeping only scheme_state_sv2.
+        OutcomeBitmap calculate_outcome_bitmap(size_t thread_count)
+        {
+            if (thread_count == 0)
+                thread_count = thread::hardware_concurrency();
+
+            run = make_unique<RunState>(CalculationOptions { .output_format = OutputFormat::Bitmap }, chunk_count, word_count);
+            add_workers(thread_count, false);
+            run_workers(thread_count);
+            OutcomeBitmap bitmap { assemble_outcome_bitmap(move(run->chunk_words)) };
+            run.reset();
+            return bitmap;
+        }
+
+        // A run taken apart for a pool shared between runs: start_run creates the result
+        // directory and the workers' files, process_next_range has one worker sum a
+        // whole range and finish_run writes what is left and totals the run. Only the
+        // ranges need the pool's threads.
+        void start_run(const CalculationOptions& options, size_t worker_count)
+        {
+            if (options.output_format != OutputFormat::Ssv && options.output_format != OutputFormat::Bitmap)
+                throw runtime_error("Error: dynamic schemes are written in the ssv or bitmap format only");
+            if (options.output_format == OutputFormat::Bitmap)
+                check_outcome_element_count(all_count);
+
+            path scheme_result_path { scheme.scheme_name };
+            if (exists(scheme_result_path))
+                remove_all(scheme_result_path);
+            create_directory(scheme_result_path);
+            write_scheme_reliability_elements_info();
+
+            run = make_unique<RunState>(options, chunk_count, word_count);
+            add_workers(worker_count, !run->is_bitmap);
+        }
+
+        // false once every range has been claimed or the run is stopped.
+        bool process_next_range(size_t worker_idx)
+        {
+            WorkerState& worker { *run->workers[worker_idx] };
+            while (!run->run_control.poll())
+            {
+                size_t chunk_idx { worker.cursor.next_chunk_idx() };
+                if (chunk_idx >= chunk_count)
+                    return false;
+
+                if (run->is_bitmap)
+                    process_outcome_chunk(worker, chunk_idx);
+                else
+                    process_chunk(worker, chunk_idx);
+                if (run->range_sums.is_last_chunk_of_range(chunk_idx))
+                    return true;
+            }
+            return false;
+        }
+
+        SchemeReliabilitySummary finish_run()
+        {
+            for (unique_ptr<WorkerState>& worker : run->workers)
+                if (worker->data_file.is_open())
+                    worker->data_file.close();
+
+            path scheme_result_path { scheme.scheme_name };
+            SchemeReliabilitySummary result
+            {
+                .sp = run->range_sums.total_sp(),
+                .sq = run->range_sums.total_sq(),
+                .state_vector_set_count = 0,
+                .result_path = scheme_result_path,
+                .thread_count = run->workers.size()
+            };
+            for (const unique_ptr<WorkerState>& worker : run->workers)
+                result.state_vector_set_count += worker->state_vector_set_count;
+
+            // A stopped run's unvisited states would read as down.
+            if (run->is_bitmap && result.state_vector_set_count == chunk_size * chunk_count)
+            {
+                path outcome_file_path { vformat(OUTCOME_FILE_NAME_FORMAT, make_format_args(scheme.scheme_name, scheme.scheme_name)) };
+                write_outcome_bitmap(outcome_file_path, assemble_outcome_bitmap(move(run->chunk_words)));
+            }
+            run.reset();
+
+            double probability_mass { 1.0 };
+            for (size_t i = 0; i < all_count; i++)
+                probability_mass *= p[i] + q[i];
+
+            result.is_partial = result.state_vector_set_count < chunk_size * chunk_count;
+            result.sp_low = result.sp;
+            result.sp_high = result.sp;
+            if (result.is_partial)
+            {
+                result.unvisited_probability = max(0.0, probability_mass - result.sp - result.sq);
+                result.sp_high = min(1.0, result.sp + result.unvisited_probability);
+            }
+            return result;
+        }
+
+    private:
+
+        void add_workers(size_t worker_count, bool is_written)
+        {
+            for (size_t i = 0; i < worker_count; i++)
+            {
+                ofstream data_file { };
+                if (is_written)
+                {
+                    path data_file_path { vformat(DATA_FILE_NAME_FORMAT, make_format_args(scheme.scheme_name, scheme.scheme_name, i)) };
+                    data_file.open(data_file_path, std::ios::binary);
+                    if (!data_file.is_open())
+                        throw runtime_error(format("Error: can't open data_file {} for writing", data_file_path.string()));
+                }
+
+                run->workers.push_back(make_unique<WorkerState>(WorkerState
+                {
+                    .scheme_expression = PackedExpression { scheme.scheme_expression },
+                    .reconfiguration_table = PackedReconfigurationTable { scheme },
+                    .cursor = RangeCursor { run->range_sums, run->next_range },
+                    .data_file = move(data_file),
+                    .output_buffer = vector<char>(is_written ? chunk_size * record_size() : 0),
+                    .prefix_bytes_sv1 = vector<char>(prefix_count),
+                    .candidates = { },
+                    .candidate_bytes = { },
+                    .lane_candidates = { },
+                    .state_vector_set_count = 0
+                }));
+            }
+        }
+
+        void run_workers(size_t thread_count)
+        {
+            vector<thread> threads { };
+            for (size_t i = 0; i < thread_count; i++)
+                threads.emplace_back([this, i]()
+                {
+                    while (process_next_range(i))
+                    { }
+                });
+            for (thread& worker_thread : threads)
+                worker_thread.join();
+        }
+
+        size_t record_size() const
+        {
+            return RECORD_HEADER_SIZE + 2 * all_count * sizeof(bool);
+        }
+
+        // chunk_words holds word_count words per chunk; a chunk narrower than a word
+        // shares it with its neighbours.
+        OutcomeBitmap assemble_outcome_bitmap(vector<PackedState> chunk_words) const
+        {
+            if (chunk_size >= LANE_COUNT)
+                return OutcomeBitmap { .all_count = all_count, .words = move(chunk_words) };
+
+            OutcomeBitmap bitmap { .all_count = all_count, .words = vector<PackedState>((chunk_size * chunk_count + LANE_COUNT - 1) / LANE_COUNT) };
+            for (size_t c = 0; c < chunk_count; c++)
+                bitmap.words[c * chunk_size / LANE_COUNT] |= chunk_words[c] << (c * chunk_size % LANE_COUNT);
+            return bitmap;
+        }
+
+        void process_chunk(WorkerState& worker, size_t chunk_idx)
+        {
+            const size_t record_size { this->record_size() };
+
+            PackedState prefix_sv1 { 0 };
+            double prefix_probability { 1.0 };
+            for (size_t i = 0; i < prefix_count; i++)
+            {
+                bool is_working { ((chunk_idx >> (prefix_count - 1 - i)) & 1) == 0 };
+                if (is_working)
+                    prefix_sv1 |= 1ull << i;
+                prefix_probability *= is_working ? p[i] : q[i];
+                worker.prefix_bytes_sv1[i] = is_working;
+            }
+
+            CompensatedSum chunk_sp { };
+            CompensatedSum chunk_sq { };
+            optional<size_t> fallback_idx { worker.reconfiguration_table.collect_candidates(prefix_sv1, worker.candidates) };
+            size_t listed_count { worker.candidates.size() };
+            worker.candidate_bytes.clear();
+            update_candidate_bytes(worker);
+
+            for (size_t w = 0; w < word_count; w++)
+            {
+                size_t lane_count { min(LANE_COUNT, chunk_size - w * LANE_COUNT) };
+                PackedState valid_lanes { lane_count == LANE_COUNT ? ~0ull : (1ull << lane_count) - 1 };
+                PackedState scheme_state_sv1 { evaluate_word(worker.scheme_expression, prefix_sv1, w) };
+                PackedState scheme_state_sv2
+                {
+                    reconfigure_word(
+                        worker, prefix_sv1, w, valid_lanes, scheme_state_sv1,
+                        listed_count, fallback_idx, &worker.lane_candidates
+                    )
+                };
+                update_candidate_bytes(worker);
+
+                for (size_t l = 0; l < lane_count; l++)
+                {
+                    size_t k { w * LANE_COUNT + l };
+                    double probability { prefix_probability * suffix_probabilities[k] };
+                    bool state_sv1 { (scheme_state_sv1 >> l & 1) != 0 };
+                    bool state_sv2 { (scheme_state_sv2 >> l & 1) != 0 };
+                    bool scheme_state { state_sv1 || state_sv2 };
+
+                    char* record { worker.output_buffer.data() + k * record_size };
+                    char* record_sv1 { record + RECORD_HEADER_SIZE };
+                    char* record_sv2 { record_sv1 + all_count };
+                    memcpy(record, &state_sv1, sizeof(bool));
+                    memcpy(record + sizeof(bool), &state_sv2, sizeof(bool));
+                    memcpy(record + 2 * sizeof(bool), &scheme_state, sizeof(bool));
+                    memcpy(record + 3 * sizeof(bool), &probability, sizeof(double));
+                    memcpy(record_sv1, worker.prefix_bytes_sv1.data(), prefix_count);
+                    memcpy(record_sv1 + prefix_count, suffix_bytes.data() + k * depth, depth);
+                    memcpy(record_sv2, worker.candidate_bytes.data() + worker.lane_candidates[l] * prefix_count, prefix_count);
+                    memcpy(record_sv2 + prefix_count, suffix_bytes.data() + k * depth, depth);
+
+                    if (state_sv2)
+                        chunk_sp.add(probability);
+                    else
+                        chunk_sq.add(probability);
+                }
+            }
+
+            worker.data_file.write(worker.output_buffer.data(), static_cast<std::streamsize>(worker.output_buffer.size()));
+            run->range_sums.add_chunk(chunk_idx, chunk_sp, chunk_sq);
+            worker.state_vector_set_count += chunk_size;
+        }
+
+        // process_chunk without the records: scheme_state_sv2 goes to chunk_words.
+        void process_outcome_chunk(WorkerState& worker, size_t chunk_idx)
+        {
+            PackedState prefix_sv1 { 0 };
+            double prefix_probability { 1.0 };
+            for (size_t i = 0; i < prefix_count; i++)
+            {
+                bool is_working { ((chunk_idx >> (prefix_count - 1 - i)) & 1) == 0 };
+                if (is_working)
+                    prefix_sv1 |= 1ull << i;
+                prefix_probability *= is_working ? p[i] : q[i];
+            }
+
+            CompensatedSum chunk_sp { };
+            CompensatedSum chunk_sq { };
+            optional<size_t> fallback_idx { worker.reconfiguration_table.collect_candidates(prefix_sv1, worker.candidates) };
+            size_t listed_count { worker.candidates.size() };
+            for (size_t w = 0; w < word_count; w++)
+            {
+                size_t lane_count { min(LANE_COUNT, chunk_size - w * LANE_COUNT) };
+                PackedState valid_lanes { lane_count == LANE_COUNT ? ~0ull : (1ull << lane_count) - 1 };
+                PackedState scheme_state_sv1 { evaluate_word(worker.scheme_expression, prefix_sv1, w) };
+                PackedState scheme_state_sv2
+                {
+                    reconfigure_word(worker, prefix_sv1, w, valid_lanes, scheme_state_sv1, listed_count, fallback_idx, nullptr)
+                };
+                run->chunk_words[chunk_idx * word_count + w] = scheme_state_sv2;
+
+                for (size_t l = 0; l < lane_count; l++)
+                {
+                    double probability { prefix_probability * suffix_probabilities[w * LANE_COUNT + l] };
+                    if ((scheme_state_sv2 >> l & 1) != 0)
+                        chunk_sp.add(probability);
+                    else
+                        chunk_sq.add(probability);
+                }
+            }
+            run->range_sums.add_chunk(chunk_idx, chunk_sp, chunk_sq);
+            worker.state_vector_set_count += chunk_size;
+        }
+
+        // Lanes of the word accepted by the first of the listed candidates the scheme
+        // function accepts; lane_candidates, when given, receives each lane's candidate
+        // or the fallback. Without a fallback the list was cut short, so every lane it
+        // leaves undecided searches on its own and its sv2 is appended to the candidates.
+        PackedState reconfigure_word(
+            WorkerState& worker,
+            PackedState prefix_sv1,
+            size_t word_idx,
+            PackedState valid_lanes,
+            PackedState scheme_state_sv1,
+            size_t listed_count,
+            optional<size_t> fallback_idx,
+            array<size_t, LANE_COUNT>* lane_candidates
+        ) const {
+            const vector<PackedState>& candidates { worker.candidates };
+            PackedState scheme_state_sv2 { 0 };
+            PackedState undecided_lanes { valid_lanes };
+            for (size_t c = 0; c < listed_count && undecided_lanes != 0; c++)
+            {
+                PackedState accepted_lanes
+                {
+                    (candidates[c] == prefix_sv1 ? scheme_state_sv1 : evaluate_word(worker.scheme_expression, candidates[c], word_idx)) & undecided_lanes
+                };
+                if (lane_candidates != nullptr)
+                    for (PackedState lanes { accepted_lanes }; lanes != 0; lanes &= lanes - 1)
+                        (*lane_candidates)[countr_zero(lanes)] = c;
+                scheme_state_sv2 |= accepted_lanes;
+                undecided_lanes &= ~accepted_lanes;
+            }
+
+            if (fallback_idx.has_value())
+            {
+                if (lane_candidates != nullptr)
+                    for (PackedState lanes { undecided_lanes }; lanes != 0; lanes &= lanes - 1)
+                        (*lane_candidates)[countr_zero(lanes)] = fallback_idx.value();
+                return scheme_state_sv2;
+            }
+
+            for (PackedState lanes { undecided_lanes }; lanes != 0; lanes &= lanes - 1)
+            {
+                size_t lane { static_cast<size_t>(countr_zero(lanes)) };
+                PackedState suffix_sv1 { suffix_states[word_idx * LANE_COUNT + lane] };
+                PackedState sv2
+                {
+                    worker.reconfiguration_table.reconfigure_brute(prefix_sv1, [this, &worker, suffix_sv1](PackedState candidate)
+                    {
+                        return evaluate_state(worker.scheme_expression, candidate | suffix_sv1);
+                    })
+                };
+                if (evaluate_state(worker.scheme_expression, sv2 | suffix_sv1))
+                    scheme_state_sv2 |= 1ull << lane;
+                if (lane_candidates != nullptr)
+                {
+                    (*lane_candidates)[lane] = worker.candidates.size();
+                    worker.candidates.push_back(sv2);
+                }
+            }
+            return scheme_state_sv2;
+        }
+
+        // Extends candidate_bytes over the candidates appended since the last call.
+        void update_candidate_bytes(WorkerState& worker) const
+        {
+            size_t byte_candidate_count { worker.candidate_bytes.size() / prefix_count };
+            worker.candidate_bytes.resize(worker.candidates.size() * prefix_count);
+            for (size_t c = byte_candidate_count; c < worker.candidates.size(); c++)
+                for (size_t i = 0; i < prefix_count; i++)
+                    worker.candidate_bytes[c * prefix_count + i] = (worker.candidates[c] >> i & 1) != 0;
+        }
+
+        bool evaluate_state(PackedExpression& scheme_expression, PackedState sv) const
+        {
+            return scheme_expression.evaluate_lanes([sv](size_t i) { return (sv >> i & 1) != 0 ? ~0ull : 0ull; }) != 0;
+        }
+
+        PackedState evaluate_word(PackedExpression& scheme_expression, PackedState prefix, size_t word_idx) const
+        {
+            const PackedState* lanes { suffix_lanes.data() + word_idx * depth };
+            return scheme_expression.evaluate_lanes([this, prefix, lanes](size_t i)
+            {
+                if (i < prefix_count)
+                    return (prefix >> i & 1) != 0 ? ~0ull : 0ull;
+                return lanes[i - prefix_count];
+            });
+        }
+
+        void write_scheme_reliability_elements_info() const
+        {
+            path element_file_path { vformat(ELEMENTS_FILE_NAME_FORMAT, make_format_args(scheme.scheme_name, scheme.scheme_name)) };
+            ofstream elements_file { element_file_path, std::ios::trunc };
+            if (!elements_file.is_open())
+                throw runtime_error(format("Error: can't open elements_file {} for writing", element_file_path.string()));
+
+            for (const Processor& element : scheme.processors)
+                elements_file << element.name << ",";
+
+            elements_file << scheme.elements.front().name;
+            for (auto it = scheme.elements.begin() + 1; it != scheme.elements.end(); it++)
+                elements_file << "," << it->name;
+        }
+    };
+
+    // The dynamic engine honors the thread count, the output format, cancellation,
+    // the time budget and the result cache; the rest of the options are templated
+    // engine features, refused here rather than silently left out of the summary.
+    void validate_options(const CalculationOptions& options)
+    {
+        if (options.measure_phases)
+            throw runtime_error("Error: dynamic schemes don't measure phases");
+        if (options.top_failure_state_count != 0)
+            throw runtime_error("Error: dynamic schemes don't track top failure states");
+        if (options.target_reliability.has_value() || options.skip_decided_run)
+            throw runtime_error("Error: dynamic schemes don't run the bound pre-pass");
+        if (options.collect_load_statistics)
+            throw runtime_error("Error: dynamic schemes don't collect load statistics");
+        if (options.metrics_callback || !options.metrics_path.empty())
+            throw runtime_error("Error: dynamic schemes don't report metrics");
+        if (options.progress_callback)
+            throw runtime_error("Error: dynamic schemes don't report progress");
+    }
+
+    void validate_scheme(const DynamicScheme& scheme)
+    {
+        if (scheme.all_count() > MAX_ELEMENT_COUNT)
+            throw runtime_error(format("Error: dynamic schemes support up to {} elements", MAX_ELEMENT_COUNT));
+        if (scheme.processors.size() > MAX_PROCESSOR_COUNT)
+            throw runtime_error(format("Error: dynamic schemes support up to {} processors", MAX_PROCESSOR_COUNT));
+        if (scheme.processors.empty() || scheme.elements.empty())
+            throw runtime_error("Error: dynamic scheme needs processors and at least one other element");
+        if (!is_valid_scheme_name(scheme.scheme_name))
+            throw runtime_error(format("Error: scheme name '{}' is not a plain directory name", scheme.scheme_name));
+    }
+
+    SchemeReliabilitySummary calculate_scheme_reliability(
+        const DynamicScheme& scheme,
+        const CalculationOptions& options
+    ) {
+        validate_scheme(scheme);
+        validate_options(options);
+
+        return calculate_with_result_cache(make_cache_key(scheme, options), options, [&scheme, &options]()
+        {
+            DynamicSchemeReliabilityCalculator calculator { scheme };
+            return calculator.calculate_scheme_reliability(options);
+        });
+    }
+
+    // With cache_path, the bitmap is kept under the scheme's topology key.
+    OutcomeBitmap calculate_outcome_bitmap(const DynamicScheme& scheme, size_t thread_count, const optional<path>& cache_path)
+    {
+        validate_scheme(scheme);
+        check_outcome_element_count(scheme.all_count());
+
+        optional<string> key { cache_path.has_value() ? optional<string> { make_topology_key(scheme) } : nullopt };
+        if (key.has_value())
+            if (optional<OutcomeBitmap> cached_bitmap { OutcomeBitmapCache { cache_path.value() }.load(key.value()) })
+                return cached_bitmap.value();
+
+        DynamicSchemeReliabilityCalculator calculator { scheme };
+        OutcomeBitmap bitmap { calculator.calculate_outcome_bitmap(thread_count) };
+        if (key.has_value())
+            OutcomeBitmapCache { cache_path.value() }.store(key.value(), bitmap);
+        return bitmap;
+    }
+}
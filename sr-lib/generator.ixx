@@ -0,0 +1,267 @@
+export module scheme_reliability:generator;
+
+import :model;
+using namespace sr_impl::model;
+
+import :dynamic;
+using namespace sr_impl::dynamic;
+
+import std;
+using std::string;
+using std::vector;
+using std::mt19937_64;
+using std::format;
+using std::runtime_error;
+using std::pow, std::round;
+using std::stod;
+using std::swap;
+using std::min;
+using std::popcount;
+
+namespace sr_impl::generator
+{
+    constexpr size_t MAX_GATE_INPUT_COUNT { 4 };
+    // A k-of-n gate is written out as the or of its k-subsets.
+    constexpr size_t MAX_K_OF_N_INPUT_COUNT { 5 };
+    constexpr size_t MAX_TRANSITION_TARGET_COUNT { 3 };
+    constexpr double LOAD_STEP { 5 };
+
+    // Draws straight from mt19937_64, whose output sequence the standard fixes; the
+    // std distributions are implementation-defined and would change the schemes
+    // between standard libraries.
+    class SchemeRandom
+    {
+    private:
+
+        mt19937_64 engine;
+
+    public:
+
+        SchemeRandom(unsigned long long seed):
+            engine { seed }
+        { }
+
+        size_t index(size_t count)
+        {
+            return static_cast<size_t>(engine() % count);
+        }
+
+        double unit()
+        {
+            return static_cast<double>(engine() >> 11) * 0x1.0p-53;
+        }
+
+        // Rounded to two significant digits, as q is given in the research schemes,
+        // which also hides last-bit differences between pow implementations.
+        double log_uniform(double min_value, double max_value)
+        {
+            return stod(format("{:.1e}", min_value * pow(max_value / min_value, unit())));
+        }
+    };
+
+    class SchemeGenerator
+    {
+    private:
+
+        const GeneratorOptions options;
+
+        SchemeRandom random;
+        DynamicScheme scheme;
+
+    public:
+
+        SchemeGenerator(const GeneratorOptions& options):
+            options { options },
+            random { options.seed },
+            scheme { .scheme_name = { }, .elements = { }, .processors = { }, .scheme_expression = { }, .type = options.type }
+        {
+            if (options.element_count == 0 || options.processor_count == 0)
+                throw runtime_error("Error: generated scheme needs processors and at least one other element");
+            if (options.element_count + options.processor_count > MAX_ELEMENT_COUNT)
+                throw runtime_error(format("Error: generated scheme can't have more than {} elements", MAX_ELEMENT_COUNT));
+            if (options.processor_count > MAX_PROCESSOR_COUNT)
+                throw runtime_error(format("Error: generated scheme can't have more than {} processors", MAX_PROCESSOR_COUNT));
+            if (options.transitions_per_processor > 0 && options.processor_count < 2)
+                throw runtime_error("Error: transitions need at least two processors");
+            if (options.min_q <= 0 || options.max_q >= 1 || options.min_q > options.max_q)
+                throw runtime_error("Error: generator q range must satisfy 0 < min_q <= max_q < 1");
+            if (options.load_headroom < 0)
+                throw runtime_error("Error: generator load headroom can't be negative");
+            if (options.series_weight < 0 || options.parallel_weight < 0 || options.k_of_n_weight < 0
+                || options.series_weight + options.parallel_weight + options.k_of_n_weight <= 0)
+                throw runtime_error("Error: generator gate weights must be non-negative and not all zero");
+        }
+
+        DynamicScheme generate()
+        {
+            scheme.scheme_name = options.scheme_name.empty()
+                ? format("generated-{}-{}-s{}", options.element_count + options.processor_count, options.processor_count, options.seed)
+                : options.scheme_name;
+
+            for (size_t i = 0; i < options.processor_count; i++)
+            {
+                double q { random.log_uniform(options.min_q, options.max_q) };
+                double normal_load { LOAD_STEP * static_cast<double>(4 + random.index(9)) };
+                scheme.processors.push_back(Processor
+                {
+                    .name = format("pr{}", i + 1),
+                    .p = 1.0 - q,
+                    .q = q,
+                    .normal_load = normal_load,
+                    .max_load = round(normal_load * (1.0 + options.load_headroom)),
+                    .transitions = { }
+                });
+            }
+            for (size_t i = 0; i < options.processor_count; i++)
+                for (size_t t = 0; t < options.transitions_per_processor; t++)
+                    scheme.processors[i].transitions.push_back(make_transition(i));
+
+            for (size_t i = 0; i < options.element_count; i++)
+            {
+                double q { random.log_uniform(options.min_q, options.max_q) };
+                scheme.elements.push_back(Element { .name = format("e{}", i + 1), .p = 1.0 - q, .q = q });
+            }
+
+            // Every processor is required, as in the research schemes: the transitions
+            // are what keep a failed one's load served.
+            for (size_t i = 0; i < options.processor_count; i++)
+            {
+                scheme.scheme_expression.push_back({ .code = ExpressionOpCode::Element, .element_idx = i });
+                if (i > 0)
+                    scheme.scheme_expression.push_back({ .code = ExpressionOpCode::And, .element_idx = 0 });
+            }
+            add_gate_tree(options.processor_count, options.element_count, options.expression_depth);
+            scheme.scheme_expression.push_back({ .code = ExpressionOpCode::And, .element_idx = 0 });
+
+            return scheme;
+        }
+
+    private:
+
+        // Hands the failed processor's normal load to up to MAX_TRANSITION_TARGET_COUNT
+        // distinct other processors, in LOAD_STEP units.
+        Transition make_transition(size_t processor_idx)
+        {
+            vector<size_t> others { };
+            for (size_t i = 0; i < options.processor_count; i++)
+                if (i != processor_idx)
+                    others.push_back(i);
+
+            size_t target_count { 1 + random.index(min(MAX_TRANSITION_TARGET_COUNT, others.size())) };
+            for (size_t i = 0; i < target_count; i++)
+                swap(others[i], others[i + random.index(others.size() - i)]);
+
+            size_t unit_count { static_cast<size_t>(scheme.processors[processor_idx].normal_load / LOAD_STEP) };
+            Transition transition { };
+            for (size_t i = 0; i < target_count; i++)
+            {
+                size_t units { unit_count / target_count + (i < unit_count % target_count ? 1 : 0) };
+                transition.push_back(IdxL { .index = others[i], .load = LOAD_STEP * static_cast<double>(units) });
+            }
+            return transition;
+        }
+
+        // Elements [first, first + count) under depth levels of gates: each gate splits
+        // its elements evenly over the fewest inputs that still reach single elements
+        // on the last level. k-of-n gates only sit on elements, so the expansion stays
+        // linear in the element count; elsewhere their weight goes unused.
+        void add_gate_tree(size_t first, size_t count, size_t depth)
+        {
+            if (count == 1 || depth == 0)
+            {
+                add_gate(first, count, ExpressionOpCode::And);
+                return;
+            }
+
+            size_t input_count { count };
+            if (depth > 1)
+            {
+                input_count = 2;
+                while (input_count < MAX_GATE_INPUT_COUNT && pow(static_cast<double>(input_count), static_cast<double>(depth)) < static_cast<double>(count))
+                    input_count++;
+                input_count = min(input_count, count);
+            }
+
+            if (input_count == count)
+            {
+                bool is_k_of_n_allowed { count >= 3 && count <= MAX_K_OF_N_INPUT_COUNT };
+                double k_of_n_weight { is_k_of_n_allowed ? options.k_of_n_weight : 0 };
+                double total_weight { options.series_weight + options.parallel_weight + k_of_n_weight };
+                if (total_weight <= 0)
+                {
+                    add_gate(first, count, ExpressionOpCode::And);
+                    return;
+                }
+
+                double choice { random.unit() * total_weight };
+                if (choice < options.series_weight)
+                    add_gate(first, count, ExpressionOpCode::And);
+                else if (choice < options.series_weight + options.parallel_weight)
+                    add_gate(first, count, ExpressionOpCode::Or);
+                else
+                    add_k_of_n_gate(first, count, 2 + random.index(count - 2));
+                return;
+            }
+
+            ExpressionOpCode code { choose_series_or_parallel() };
+            size_t next { first };
+            for (size_t i = 0; i < input_count; i++)
+            {
+                size_t input_size { count / input_count + (i < count % input_count ? 1 : 0) };
+                add_gate_tree(next, input_size, depth - 1);
+                if (i > 0)
+                    scheme.scheme_expression.push_back({ .code = code, .element_idx = 0 });
+                next += input_size;
+            }
+        }
+
+        ExpressionOpCode choose_series_or_parallel()
+        {
+            double total_weight { options.series_weight + options.parallel_weight };
+            if (total_weight <= 0)
+                return ExpressionOpCode::And;
+            return random.unit() * total_weight < options.series_weight ? ExpressionOpCode::And : ExpressionOpCode::Or;
+        }
+
+        void add_gate(size_t first, size_t count, ExpressionOpCode code)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                scheme.scheme_expression.push_back({ .code = ExpressionOpCode::Element, .element_idx = first + i });
+                if (i > 0)
+                    scheme.scheme_expression.push_back({ .code = code, .element_idx = 0 });
+            }
+        }
+
+        // At least k of elements [first, first + count) work.
+        void add_k_of_n_gate(size_t first, size_t count, size_t k)
+        {
+            bool is_first_term { true };
+            for (unsigned long long mask = 0; mask < (1ull << count); mask++)
+            {
+                if (static_cast<size_t>(popcount(mask)) != k)
+                    continue;
+
+                bool is_first_input { true };
+                for (size_t i = 0; i < count; i++)
+                {
+                    if ((mask >> i & 1) == 0)
+                        continue;
+                    scheme.scheme_expression.push_back({ .code = ExpressionOpCode::Element, .element_idx = first + i });
+                    if (!is_first_input)
+                        scheme.scheme_expression.push_back({ .code = ExpressionOpCode::And, .element_idx = 0 });
+                    is_first_input = false;
+                }
+                if (!is_first_term)
+                    scheme.scheme_expression.push_back({ .code = ExpressionOpCode::Or, .element_idx = 0 });
+                is_first_term = false;
+            }
+        }
+    };
+
+    DynamicScheme generate_scheme(const GeneratorOptions& options)
+    {
+        SchemeGenerator generator { options };
+        return generator.generate();
+    }
+}
@@ -0,0 +1,348 @@
+module;
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#endif
+
+export module scheme_reliability:metrics;
+
+import :model;
+using namespace sr_impl::model;
+
+import std;
+using std::atomic, std::memory_order_relaxed;
+using std::vector;
+using std::string;
+using std::ofstream, std::ifstream;
+using std::filesystem::path;
+using std::mutex, std::unique_lock, std::condition_variable;
+using std::thread;
+using std::format;
+using std::runtime_error;
+using std::chrono::steady_clock;
+using std::chrono::duration;
+using std::chrono::milliseconds;
+using std::max, std::min;
+
+namespace sr_impl::metrics
+{
+    class RelaxedCounter
+    {
+    private:
+
+        atomic<size_t> value;
+
+    public:
+
+        RelaxedCounter():
+            value { 0 }
+        { }
+
+        // Single writer: a relaxed load/store pair avoids a locked read-modify-write in the hot loop.
+        inline void add(size_t increment)
+        {
+            value.store(value.load(memory_order_relaxed) + increment, memory_order_relaxed);
+        }
+
+        inline size_t get() const
+        {
+            return value.load(memory_order_relaxed);
+        }
+    };
+
+    class RelaxedDouble
+    {
+    private:
+
+        atomic<double> value;
+
+    public:
+
+        RelaxedDouble():
+            value { 0 }
+        { }
+
+        inline void set(double new_value)
+        {
+            value.store(new_value, memory_order_relaxed);
+        }
+
+        inline double get() const
+        {
+            return value.load(memory_order_relaxed);
+        }
+    };
+
+    struct alignas(64) ProducerCounters
+    {
+        RelaxedCounter states_enqueued;
+        RelaxedCounter enqueue_stalls;
+    };
+
+    struct alignas(64) ConsumerCounters
+    {
+        RelaxedCounter states_processed;
+        RelaxedCounter idle_spins;
+        RelaxedCounter idle_ns;
+        RelaxedCounter reconfiguration_noop_count;
+        RelaxedCounter reconfiguration_success_count;
+        RelaxedCounter reconfiguration_best_zero_count;
+        RelaxedCounter bytes_written;
+        RelaxedDouble sp;
+        RelaxedDouble sq;
+    };
+
+    struct WorkerCounters
+    {
+        ProducerCounters producer;
+        ConsumerCounters consumer;
+    };
+
+    size_t current_rss_bytes()
+    {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters { };
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return static_cast<size_t>(counters.WorkingSetSize);
+        return 0;
+#elif defined(__linux__)
+        ifstream statm { "/proc/self/statm" };
+        size_t total_pages { 0 };
+        size_t resident_pages { 0 };
+        if (!(statm >> total_pages >> resident_pages))
+            return 0;
+        return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+        return 0;
+#endif
+    }
+
+    string metrics_snapshot_to_json(const MetricsSnapshot& snapshot)
+    {
+        string workers { };
+        for (size_t i = 0; i < snapshot.workers.size(); i++)
+        {
+            const WorkerMetrics& worker { snapshot.workers[i] };
+            workers += format(
+                "{}{{\"states_processed\":{},\"queue_depth\":{},\"enqueue_stalls\":{},\"idle_spins\":{},\"idle_s\":{}}}",
+                i == 0 ? "" : ",",
+                worker.states_processed, worker.queue_depth, worker.enqueue_stalls, worker.idle_spins, worker.idle_s
+            );
+        }
+
+        return format(
+            "{{\"elapsed_s\":{},\"state_vector_set_count\":{},\"states_processed\":{},\"states_per_s\":{},"
+            "\"queue_depth\":{},\"enqueue_stalls\":{},\"idle_s\":{},"
+            "\"reconfiguration\":{{\"noop\":{},\"success\":{},\"best_zero\":{}}},"
+            "\"bytes_written\":{},\"rss_bytes\":{},\"workers\":[{}]}}",
+            snapshot.elapsed_s, snapshot.state_vector_set_count, snapshot.states_processed, snapshot.states_per_s,
+            snapshot.queue_depth, snapshot.enqueue_stalls, snapshot.idle_s,
+            snapshot.reconfiguration_noop_count, snapshot.reconfiguration_success_count,
+            snapshot.reconfiguration_best_zero_count,
+            snapshot.bytes_written, snapshot.rss_bytes, workers
+        );
+    }
+
+    class MetricsMonitor
+    {
+    private:
+
+        const MetricsCallback callback;
+        const path metrics_path;
+        const ProgressCallback progress_callback;
+        const milliseconds interval;
+
+        const vector<WorkerCounters>& worker_counters;
+        const size_t state_vector_set_count;
+        const double probability_mass;
+
+        ofstream metrics_file;
+        steady_clock::time_point start_time;
+        steady_clock::time_point last_snapshot_time;
+        size_t last_states_processed;
+
+        mutex monitor_mutex;
+        condition_variable monitor_cv;
+        bool is_end;
+        thread monitor_thread;
+
+    public:
+
+        MetricsMonitor(
+            const CalculationOptions& options,
+            const vector<WorkerCounters>& worker_counters,
+            size_t state_vector_set_count,
+            double probability_mass
+        ):
+            callback { options.metrics_callback },
+            metrics_path { options.metrics_path },
+            progress_callback { options.progress_callback },
+            interval { options.report_interval },
+            worker_counters { worker_counters },
+            state_vector_set_count { state_vector_set_count },
+            probability_mass { probability_mass },
+            metrics_file { },
+            start_time { }, last_snapshot_time { }, last_states_processed { 0 },
+            monitor_mutex { }, monitor_cv { }, is_end { false }, monitor_thread { }
+        {
+            if (!metrics_path.empty())
+            {
+                metrics_file.open(metrics_path, std::ios::trunc);
+                if (!metrics_file.is_open())
+                    throw runtime_error(format("Error: can't open metrics_file {} for writing", metrics_path.string()));
+            }
+        }
+
+        ~MetricsMonitor()
+        {
+            if (monitor_thread.joinable())
+                stop();
+        }
+
+        MetricsMonitor(const MetricsMonitor&) = delete;
+        MetricsMonitor& operator=(const MetricsMonitor&) = delete;
+
+        inline bool is_enabled() const
+        {
+            return callback || !metrics_path.empty() || progress_callback;
+        }
+
+        void start()
+        {
+            start_time = steady_clock::now();
+            last_snapshot_time = start_time;
+            if (!is_enabled())
+                return;
+
+            monitor_thread = thread
+            {
+                [this]()
+                {
+                    unique_lock<mutex> lock { monitor_mutex };
+                    while (!monitor_cv.wait_for(lock, interval, [this]() { return is_end; }))
+                    {
+                        lock.unlock();
+                        publish(take_snapshot());
+                        lock.lock();
+                    }
+                }
+            };
+        }
+
+        void stop()
+        {
+            if (!monitor_thread.joinable())
+                return;
+
+            {
+                unique_lock<mutex> lock { monitor_mutex };
+                is_end = true;
+            }
+            monitor_cv.notify_all();
+            monitor_thread.join();
+
+            publish(take_snapshot());
+        }
+
+        MetricsSnapshot take_snapshot()
+        {
+            steady_clock::time_point now { steady_clock::now() };
+
+            MetricsSnapshot snapshot
+            {
+                .elapsed_s = duration<double>(now - start_time).count(),
+                .state_vector_set_count = state_vector_set_count,
+                .states_processed = 0,
+                .states_per_s = 0,
+                .queue_depth = 0,
+                .enqueue_stalls = 0,
+                .idle_s = 0,
+                .reconfiguration_noop_count = 0,
+                .reconfiguration_success_count = 0,
+                .reconfiguration_best_zero_count = 0,
+                .bytes_written = 0,
+                .rss_bytes = current_rss_bytes(),
+                .workers = { }
+            };
+            snapshot.workers.reserve(worker_counters.size());
+
+            for (const WorkerCounters& counters : worker_counters)
+            {
+                size_t states_processed { counters.consumer.states_processed.get() };
+                size_t states_enqueued { counters.producer.states_enqueued.get() };
+                WorkerMetrics worker
+                {
+                    .states_processed = states_processed,
+                    .queue_depth = states_enqueued > states_processed ? states_enqueued - states_processed : 0,
+                    .enqueue_stalls = counters.producer.enqueue_stalls.get(),
+                    .idle_spins = counters.consumer.idle_spins.get(),
+                    .idle_s = static_cast<double>(counters.consumer.idle_ns.get()) * 1e-9
+                };
+
+                snapshot.states_processed += worker.states_processed;
+                snapshot.queue_depth += worker.queue_depth;
+                snapshot.enqueue_stalls += worker.enqueue_stalls;
+                snapshot.idle_s += worker.idle_s;
+                snapshot.reconfiguration_noop_count += counters.consumer.reconfiguration_noop_count.get();
+                snapshot.reconfiguration_success_count += counters.consumer.reconfiguration_success_count.get();
+                snapshot.reconfiguration_best_zero_count += counters.consumer.reconfiguration_best_zero_count.get();
+                snapshot.bytes_written += counters.consumer.bytes_written.get();
+                snapshot.workers.push_back(worker);
+            }
+
+            double interval_s { duration<double>(now - last_snapshot_time).count() };
+            if (interval_s > 0)
+                snapshot.states_per_s = static_cast<double>(snapshot.states_processed - last_states_processed) / interval_s;
+            last_snapshot_time = now;
+            last_states_processed = snapshot.states_processed;
+
+            return snapshot;
+        }
+
+        Progress take_progress(const MetricsSnapshot& snapshot) const
+        {
+            Progress progress
+            {
+                .fraction_done = static_cast<double>(snapshot.states_processed) / static_cast<double>(state_vector_set_count),
+                .elapsed_s = snapshot.elapsed_s,
+                .eta_s = 0,
+                .sp = 0,
+                .sq = 0,
+                .unvisited_probability = 0,
+                .states_processed = snapshot.states_processed,
+                .state_vector_set_count = state_vector_set_count
+            };
+
+            for (const WorkerCounters& counters : worker_counters)
+            {
+                progress.sp += counters.consumer.sp.get();
+                progress.sq += counters.consumer.sq.get();
+            }
+            progress.unvisited_probability = max(0.0, probability_mass - progress.sp - progress.sq);
+
+            if (snapshot.states_processed > 0)
+            {
+                double remaining_states { static_cast<double>(state_vector_set_count - min(state_vector_set_count, snapshot.states_processed)) };
+                progress.eta_s = snapshot.elapsed_s * remaining_states / static_cast<double>(snapshot.states_processed);
+            }
+
+            return progress;
+        }
+
+    private:
+
+        void publish(const MetricsSnapshot& snapshot)
+        {
+            if (callback)
+                callback(snapshot);
+            if (metrics_file.is_open())
+                metrics_file << metrics_snapshot_to_json(snapshot) << '\n' << std::flush;
+            if (progress_callback)
+                progress_callback(take_progress(snapshot));
+        }
+    };
+}
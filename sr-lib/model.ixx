@@ -7,6 +7,9 @@ using std::array;
 using std::span;
 using std::function;
 using std::filesystem::path;
+using std::chrono::milliseconds;
+using std::optional;
+using std::stop_token;
 
 namespace sr_impl::model
 {
@@ -73,7 +76,34 @@ namespace sr_impl::model
     template <size_t all_count, size_t processor_count>
     using SchemeFunction = function<bool(const StateVector<all_count, processor_count>&)>;
 
-    enum class SchemeType { Greedy, Brute };
+    enum class SchemeType { Greedy, Brute, Beam };
+
+    // Beam search keeps the width best partial transition assignments per failed
+    // processor, ranked by load score. Once max_expanded_node_count assignments were
+    // scored for a state, only the greedy choice is followed further.
+    struct BeamOptions
+    {
+        size_t width { 4 };
+        size_t max_expanded_node_count { 1024 };
+    };
+
+    // Brute force drops duplicate and dominated transitions, which keeps its results
+    // only for a monotone scheme function. A dynamic scheme prunes by default and clears
+    // it on its own when the expression has a negation; a templated scheme can't look
+    // into its lambda, so it prunes only when the caller sets is_pruning_transitions.
+    // is_dropping_impossible_transitions also replaces the transitions that overload
+    // a target from its normal load alone, or target the failed processor itself, by
+    // "leave the processor failed", which may recover states the declared table loses.
+    struct BruteForceOptions
+    {
+        bool is_pruning_transitions { true };
+        bool is_dropping_impossible_transitions { false };
+    };
+
+    // Ssv: packed records read by the notebook; Arrow: Arrow IPC file (Feather v2);
+    // Bitmap: one OutcomeBitmap file per run, scheme_state_sv2 only; MaskMap: one CSV
+    // row per sv1/sv2 processor mask pair, no per-state records.
+    enum class OutputFormat { Ssv, Arrow, Bitmap, MaskMap };
 
     template<size_t all_count, size_t processor_count>
     struct Scheme
@@ -90,6 +120,104 @@ namespace sr_impl::model
 
         SchemeFunction<all_count, processor_count> scheme_function;
         SchemeType type;
+        BeamOptions beam_options { };
+        BruteForceOptions brute_options { .is_pruning_transitions = false };
+        // Stands for scheme_function in the result cache key, which can't look into a
+        // lambda; bump it when the function changes. Empty keeps the scheme uncached.
+        string scheme_function_version { };
+    };
+
+    // A run removes and recreates the directory named after its scheme, so the name
+    // must stay a single path component.
+    inline bool is_valid_scheme_name(const string& scheme_name)
+    {
+        return !scheme_name.empty() && scheme_name != "." && scheme_name != ".." &&
+               scheme_name.find_first_of("/\\:") == string::npos;
+    }
+
+    struct AppliedTransition
+    {
+        size_t processor_idx;
+        Transition transition;
+        bool is_successful;
+    };
+
+    enum class TransitionRemovalReason { Impossible, Duplicate, Dominated };
+
+    struct RemovedTransition
+    {
+        size_t processor_idx;
+        // Position in the processor's table as declared.
+        size_t transition_idx;
+        Transition transition;
+        TransitionRemovalReason reason;
+    };
+
+    struct TransitionNormalizationReport
+    {
+        size_t transition_count;
+        size_t kept_transition_count;
+        vector<RemovedTransition> removed_transitions;
+    };
+
+    struct FailureState
+    {
+        double probability;
+        vector<bool> sv1;
+        vector<bool> sv2;
+        vector<AppliedTransition> transitions;
+    };
+
+    enum class ExpressionOpCode { Element, And, Or, Not, True, False };
+
+    struct ExpressionOp
+    {
+        ExpressionOpCode code;
+        size_t element_idx;
+    };
+
+    // Runtime-sized counterpart of Scheme, loaded from a scheme file. Element indices
+    // follow the templated layout: processors first, then the remaining elements.
+    struct DynamicScheme
+    {
+        string scheme_name;
+
+        vector<Element> elements;
+        vector<Processor> processors;
+
+        // Scheme function in postfix order over element indices.
+        vector<ExpressionOp> scheme_expression;
+        SchemeType type;
+        BeamOptions beam_options { };
+        BruteForceOptions brute_options { };
+
+        size_t all_count() const
+        {
+            return processors.size() + elements.size();
+        }
+    };
+
+    // Parameters of a synthetic DynamicScheme. The scheme function is every processor
+    // and'ed with a random gate tree of expression_depth levels over the elements; a
+    // gate is chosen by the series/parallel/k_of_n weights. max_load is normal_load
+    // scaled by 1 + load_headroom. The same options and seed give the same scheme on
+    // every platform.
+    struct GeneratorOptions
+    {
+        string scheme_name { };
+        size_t element_count { 12 };
+        size_t processor_count { 4 };
+        size_t transitions_per_processor { 2 };
+        double load_headroom { 0.5 };
+        size_t expression_depth { 3 };
+        double series_weight { 1 };
+        double parallel_weight { 1 };
+        double k_of_n_weight { 1 };
+        // q is drawn log-uniformly from [min_q, max_q].
+        double min_q { 1e-5 };
+        double max_q { 1e-3 };
+        SchemeType type { SchemeType::Greedy };
+        unsigned long long seed { 1 };
     };
 
     template<size_t all_count, size_t processor_count>
@@ -113,11 +241,354 @@ namespace sr_impl::model
         }
     };
 
+    struct WorkerMetrics
+    {
+        size_t states_processed;
+        size_t queue_depth;
+        size_t enqueue_stalls;
+        size_t idle_spins;
+        double idle_s;
+    };
+
+    struct MetricsSnapshot
+    {
+        double elapsed_s;
+        size_t state_vector_set_count;
+        size_t states_processed;
+        double states_per_s;
+        size_t queue_depth;
+        size_t enqueue_stalls;
+        double idle_s;
+        size_t reconfiguration_noop_count;
+        size_t reconfiguration_success_count;
+        size_t reconfiguration_best_zero_count;
+        size_t bytes_written;
+        size_t rss_bytes;
+        vector<WorkerMetrics> workers;
+    };
+
+    using MetricsCallback = function<void(const MetricsSnapshot&)>;
+
+    struct Progress
+    {
+        double fraction_done;
+        double elapsed_s;
+        double eta_s;
+        double sp;
+        double sq;
+        double unvisited_probability;
+        size_t states_processed;
+        size_t state_vector_set_count;
+    };
+
+    using ProgressCallback = function<void(const Progress&)>;
+
+    struct BoundOptions
+    {
+        // States with up to max_order failed elements are evaluated exactly.
+        size_t max_order { 3 };
+    };
+
+    struct ReliabilityBounds
+    {
+        size_t max_order;
+        size_t evaluated_state_count;
+        double sp;
+        double sq;
+        // Probability of every state with more than max_order failed elements.
+        double truncated_probability;
+        double sp_low;
+        double sp_high;
+    };
+
+    struct CalculationOptions
+    {
+        size_t thread_count { 0 };
+        bool measure_phases { false };
+        OutputFormat output_format { OutputFormat::Ssv };
+        // Keep the K most probable states with scheme_state_sv2 == false; 0 disables.
+        size_t top_failure_state_count { 0 };
+        // Enables the bound pre-pass; the run is skipped when skip_decided_run is set
+        // and the bounds alone decide whether sp reaches the target.
+        optional<double> target_reliability { };
+        BoundOptions bound_options { };
+        bool skip_decided_run { false };
+
+        MetricsCallback metrics_callback { };
+        path metrics_path { };
+        ProgressCallback progress_callback { };
+        milliseconds report_interval { 1000 };
+
+        stop_token cancellation_token { };
+        optional<milliseconds> time_budget { };
+
+        // Complete runs are stored here under a fingerprint of the scheme and the
+        // options shaping the output; a run with a stored result returns it as long
+        // as its result directory is still there.
+        optional<path> result_cache_path { };
+
+        // Fills SchemeReliabilitySummary::load_statistics; every reconfigured state
+        // then reports its transitions, which slows the reconfiguration phase down.
+        bool collect_load_statistics { false };
+    };
+
+    struct PhaseTiming
+    {
+        unsigned long long enumeration_ns { 0 };
+        unsigned long long probability_ns { 0 };
+        unsigned long long reconfiguration_ns { 0 };
+        unsigned long long evaluation_ns { 0 };
+        unsigned long long output_ns { 0 };
+    };
+
+    // Ten bins of 0.1 * max_load up to max_load, then one for overload.
+    constexpr size_t LOAD_HISTOGRAM_BIN_COUNT { 11 };
+
+    struct ProcessorLoadStatistics
+    {
+        string name;
+        // Probability-weighted load carried after reconfiguration, 0 while down.
+        double expected_load;
+        // Working in sv1 and switched off in sv2 because its load exceeds max_load.
+        double overload_probability;
+        // Probability of each relative load bin, over the states the processor works in sv1.
+        array<double, LOAD_HISTOGRAM_BIN_COUNT> load_histogram;
+    };
+
+    struct TransitionUsage
+    {
+        size_t processor_idx;
+        // Position in the processor's table as declared.
+        size_t transition_idx;
+        Transition transition;
+        size_t state_count;
+        double probability;
+        // Part of probability where the transition brought its processor back.
+        double successful_probability;
+    };
+
+    struct LoadStatistics
+    {
+        vector<ProcessorLoadStatistics> processors;
+        // Every transition of the scheme's tables as declared, unused ones included.
+        vector<TransitionUsage> transitions;
+    };
+
     struct SchemeReliabilitySummary
     {
         double sp;
         double sq;
         size_t state_vector_set_count;
         path result_path;
+        size_t thread_count { 0 };
+        PhaseTiming phase_timing { };
+        bool is_partial { false };
+        double sp_low { 0 };
+        double sp_high { 0 };
+        double unvisited_probability { 0 };
+        vector<FailureState> top_failure_states { };
+        optional<ReliabilityBounds> bounds { };
+        optional<bool> meets_target_reliability { };
+        bool is_decided_by_bounds { false };
+        bool is_cached { false };
+        optional<LoadStatistics> load_statistics { };
+    };
+
+    struct VariantDisagreement
+    {
+        size_t first_variant_idx;
+        size_t second_variant_idx;
+        size_t state_count;
+        double probability;
+    };
+
+    struct MultiVariantSummary
+    {
+        // One summary per variant, in the order the variants were given.
+        vector<SchemeReliabilitySummary> variants;
+        // States where at least two variants disagree on scheme_state_sv2.
+        size_t disagreement_state_count;
+        double disagreement_probability;
+        vector<VariantDisagreement> pairwise_disagreements;
+    };
+
+    struct PinnedElement
+    {
+        string name;
+        bool is_working;
+    };
+
+    struct ConditionalReliability
+    {
+        vector<PinnedElement> assignment;
+        double assignment_probability;
+        // Given the assignment; they sum to 1 when every free state was visited.
+        double conditional_sp;
+        double conditional_sq;
+        // Joint with the assignment, the conditional values times assignment_probability.
+        double sp;
+        double sq;
+        size_t state_vector_set_count;
+        bool is_partial;
+    };
+
+    struct ConditionalBreakdown
+    {
+        vector<string> pinned_elements;
+        // Assignment i fails pinned element j when bit (k - 1 - j) of i is set, k being
+        // the pinned element count, so entry 0 has every pinned element working.
+        vector<ConditionalReliability> assignments;
+        double sp;
+        double sq;
+    };
+
+    struct DivergentProcessorMask
+    {
+        // Processor states of sv1 shared by the divergent states.
+        vector<bool> processors;
+        size_t state_count;
+        double probability;
+    };
+
+    struct StrategyComparison
+    {
+        SchemeReliabilitySummary greedy;
+        SchemeReliabilitySummary brute;
+        // States that brute force keeps working and greedy does not.
+        size_t divergent_state_count;
+        double divergent_probability;
+        size_t skipped_brute_count;
+        vector<DivergentProcessorMask> top_divergent_masks;
+    };
+
+    struct AnalysisOptions
+    {
+        size_t thread_count { 0 };
+        // Elements whose joint state groups the breakdown; empty selects every "pr*" element.
+        vector<string> group_elements { };
+    };
+
+    struct ElementFailureStatistics
+    {
+        string name;
+        double sv1_fail_probability;
+        double sv2_fail_probability;
+        size_t sv1_fail_count;
+        size_t sv2_fail_count;
+    };
+
+    struct MaskGroupStatistics
+    {
+        size_t failed_mask;
+        size_t sv1_count;
+        size_t sv2_count;
+        double sv1_probability;
+        double sv2_probability;
+        double sv2_sp;
+    };
+
+    struct ResultAnalysis
+    {
+        size_t record_count;
+        double sp;
+        double sq;
+        size_t inconsistent_count;
+        double inconsistent_probability;
+        vector<ElementFailureStatistics> elements;
+        vector<string> group_elements;
+        vector<MaskGroupStatistics> groups;
+    };
+
+    struct CutSetOptions
+    {
+        size_t max_order { 2 };
+    };
+
+    struct MinimalCutSet
+    {
+        vector<string> elements;
+        vector<size_t> element_indices;
+        // Probability that every element of the cut is failed.
+        double probability;
+        // Probability of the state where exactly the cut elements are failed.
+        double state_probability;
+    };
+
+    struct CutSetReport
+    {
+        size_t max_order;
+        size_t evaluated_state_count;
+        size_t skipped_superset_count;
+        // Rare-event approximation of sq: the sum of cut probabilities.
+        double cut_probability_sum;
+        vector<MinimalCutSet> cut_sets;
+    };
+
+    // Bit s % 64 of words[s / 64] is set when state s works after reconfiguration.
+    // Depends on the topology and the scheme function only, not on p/q.
+    struct OutcomeBitmap
+    {
+        size_t all_count;
+        vector<unsigned long long> words;
+    };
+
+    struct ReweightedReliability
+    {
+        double sp;
+        double sq;
+    };
+
+    // Per element, sp with the element working and with it failed, every other
+    // element at its p/q; their difference is the element's Birnbaum importance.
+    struct ReweightedImportance
+    {
+        double sp;
+        double sq;
+        vector<double> sp_working;
+        vector<double> sp_failed;
+    };
+
+    struct BatchJob
+    {
+        DynamicScheme scheme;
+        // thread_count is not used, every job runs on the batch's pool.
+        CalculationOptions options { };
+    };
+
+    struct BatchOptions
+    {
+        // Threads of the pool shared by every job; 0 means hardware_concurrency.
+        size_t thread_count { 0 };
+        // Jobs whose ranges the pool takes turns on. The next job is set up and a
+        // computed one finished while these run.
+        size_t active_job_count { 2 };
+    };
+
+    struct BatchJobResult
+    {
+        string scheme_name;
+        SchemeType type;
+        // Empty when the job failed, error then tells why.
+        optional<SchemeReliabilitySummary> summary;
+        string error;
+        // start_ns and end_ns count from the batch start.
+        unsigned long long start_ns;
+        unsigned long long end_ns;
+        unsigned long long setup_ns;
+        // From handing the job to the pool to its last range.
+        unsigned long long compute_ns;
+        unsigned long long finish_ns;
+        // Pool thread time spent on the job's ranges.
+        unsigned long long worker_ns;
+    };
+
+    struct BatchSummary
+    {
+        // In the order the jobs were given.
+        vector<BatchJobResult> jobs;
+        size_t thread_count;
+        unsigned long long elapsed_ns;
+        // Share of the pool's thread time spent on ranges.
+        double pool_utilization;
     };
 }
@@ -0,0 +1,358 @@
+export module scheme_reliability:outcome;
+
+import :model;
+using namespace sr_impl::model;
+
+import std;
+using std::array;
+using std::vector;
+using std::span;
+using std::string_view;
+using std::ifstream, std::ofstream;
+using std::filesystem::path;
+using std::streamsize;
+using std::format;
+using std::runtime_error;
+using std::min;
+using std::fill;
+
+namespace sr_impl::outcome
+{
+    // 2^34 bits take 2 GB.
+    constexpr size_t MAX_OUTCOME_ELEMENT_COUNT { 34 };
+
+    void check_outcome_element_count(size_t all_count)
+    {
+        if (all_count > MAX_OUTCOME_ELEMENT_COUNT)
+            throw runtime_error(format("Error: outcome bitmaps support up to {} elements", MAX_OUTCOME_ELEMENT_COUNT));
+    }
+
+    // Sums the probabilities of the working and the failed states of an outcome
+    // bitmap for the given p/q, without any reconfiguration. A bitmap word covers the
+    // six trailing elements, so its 64 state probabilities share the weight of the
+    // leading elements and split into eight per-byte tables over the trailing six.
+    // Words with every state up or every state down, the bulk of any real scheme,
+    // take the whole word's probability without looking at single bits.
+    class OutcomeReweighter
+    {
+    private:
+
+        static constexpr size_t WORD_ELEMENT_COUNT { 6 };
+        static constexpr size_t MAX_SPLIT_ELEMENT_COUNT { 12 };
+
+        const OutcomeBitmap& bitmap;
+        const span<const double> p;
+        const span<const double> q;
+        const size_t all_count;
+
+        array<array<double, 256>, 8> byte_probabilities;
+
+    public:
+
+        OutcomeReweighter(const OutcomeBitmap& bitmap, span<const double> p, span<const double> q):
+            bitmap { bitmap }, p { p }, q { q }, all_count { bitmap.all_count }, byte_probabilities { }
+        {
+            if (p.size() != all_count || q.size() != all_count)
+                throw runtime_error(format("Error: expected p and q for {} elements", all_count));
+            if (bitmap.words.size() != ((1ull << all_count) + 63) / 64)
+                throw runtime_error("Error: outcome bitmap size doesn't match its element count");
+        }
+
+        ReweightedReliability reweight()
+        {
+            if (all_count < WORD_ELEMENT_COUNT)
+                return reweight_states();
+
+            // Trailing six elements: bit b of a word is the state with those elements
+            // failed where b has its bits set, the last element being bit 0.
+            array<double, 64> lane_probabilities { };
+            for (size_t b = 0; b < 64; b++)
+                lane_probabilities[b] = state_probability(b, all_count - WORD_ELEMENT_COUNT, WORD_ELEMENT_COUNT);
+            double word_probability { fill_byte_probabilities(lane_probabilities, byte_probabilities) };
+
+            // Leading elements: word index = high part, then low part.
+            size_t word_element_count { all_count - WORD_ELEMENT_COUNT };
+            size_t low_count { min(word_element_count, MAX_SPLIT_ELEMENT_COUNT) };
+            size_t high_count { word_element_count - low_count };
+            vector<double> low_probabilities(1ull << low_count);
+            for (size_t l = 0; l < low_probabilities.size(); l++)
+                low_probabilities[l] = state_probability(l, high_count, low_count);
+
+            ReweightedReliability result { .sp = 0, .sq = 0 };
+            for (size_t h = 0; h < (1ull << high_count); h++)
+            {
+                double high_probability { state_probability(h, 0, high_count) };
+                const unsigned long long* words { bitmap.words.data() + (h << low_count) };
+                double sp { 0 };
+                double sq { 0 };
+                for (size_t l = 0; l < low_probabilities.size(); l++)
+                {
+                    unsigned long long word { words[l] };
+                    if (word == 0)
+                    {
+                        sq += low_probabilities[l] * word_probability;
+                        continue;
+                    }
+                    if (word == ~0ull)
+                    {
+                        sp += low_probabilities[l] * word_probability;
+                        continue;
+                    }
+
+                    double word_sp { 0 };
+                    double word_sq { 0 };
+                    for (size_t byte_idx = 0; byte_idx < 8; byte_idx++)
+                    {
+                        word_sp += byte_probabilities[byte_idx][(word >> (8 * byte_idx)) & 0xff];
+                        word_sq += byte_probabilities[byte_idx][(~word >> (8 * byte_idx)) & 0xff];
+                    }
+                    sp += low_probabilities[l] * word_sp;
+                    sq += low_probabilities[l] * word_sq;
+                }
+                result.sp += high_probability * sp;
+                result.sq += high_probability * sq;
+            }
+            return result;
+        }
+
+        // The same pass, also summing the working states' probabilities without each
+        // element's own factor, split by whether the element works in the state. An
+        // element's factor is left out where its group's weight is taken: per lane by
+        // extra byte tables, per low part by the word's sp, per high part by the sp
+        // of its words.
+        ReweightedImportance reweight_importance()
+        {
+            ReweightedImportance result
+            {
+                .sp = 0, .sq = 0,
+                .sp_working = vector<double>(all_count, 0.0), .sp_failed = vector<double>(all_count, 0.0)
+            };
+            if (all_count < WORD_ELEMENT_COUNT)
+                return reweight_importance_states(result);
+
+            size_t lane_first { all_count - WORD_ELEMENT_COUNT };
+            array<double, 64> lane_probabilities { };
+            for (size_t b = 0; b < 64; b++)
+                lane_probabilities[b] = state_probability(b, lane_first, WORD_ELEMENT_COUNT);
+            double word_probability { fill_byte_probabilities(lane_probabilities, byte_probabilities) };
+
+            // Entry 2k + 1 sums the lanes with trailing element k failed, 2k those with
+            // it working.
+            vector<array<array<double, 256>, 8>> conditional_byte_probabilities(2 * WORD_ELEMENT_COUNT);
+            array<double, 2 * WORD_ELEMENT_COUNT> conditional_word_probability { };
+            for (size_t k = 0; k < WORD_ELEMENT_COUNT; k++)
+                for (size_t is_failed = 0; is_failed < 2; is_failed++)
+                {
+                    for (size_t b = 0; b < 64; b++)
+                        lane_probabilities[b] =
+                            ((b >> (WORD_ELEMENT_COUNT - 1 - k)) & 1) == is_failed
+                                ? state_probability_without(b, lane_first, WORD_ELEMENT_COUNT, k)
+                                : 0.0;
+                    conditional_word_probability[2 * k + is_failed] = fill_byte_probabilities(lane_probabilities, conditional_byte_probabilities[2 * k + is_failed]);
+                }
+
+            size_t word_element_count { all_count - WORD_ELEMENT_COUNT };
+            size_t low_count { min(word_element_count, MAX_SPLIT_ELEMENT_COUNT) };
+            size_t high_count { word_element_count - low_count };
+            vector<double> low_probabilities(1ull << low_count);
+            vector<vector<double>> low_probabilities_without(low_count, vector<double>(1ull << low_count));
+            for (size_t l = 0; l < low_probabilities.size(); l++)
+            {
+                low_probabilities[l] = state_probability(l, high_count, low_count);
+                for (size_t j = 0; j < low_count; j++)
+                    low_probabilities_without[j][l] = state_probability_without(l, high_count, low_count, j);
+            }
+
+            vector<double> low_sums(2 * low_count);
+            for (size_t h = 0; h < (1ull << high_count); h++)
+            {
+                const unsigned long long* words { bitmap.words.data() + (h << low_count) };
+                double sp { 0 };
+                double sq { 0 };
+                array<double, 2 * WORD_ELEMENT_COUNT> lane_sums { };
+                fill(low_sums.begin(), low_sums.end(), 0.0);
+                for (size_t l = 0; l < low_probabilities.size(); l++)
+                {
+                    unsigned long long word { words[l] };
+                    if (word == 0)
+                    {
+                        sq += low_probabilities[l] * word_probability;
+                        continue;
+                    }
+
+                    double word_sp { word_probability };
+                    if (word == ~0ull)
+                    {
+                        for (size_t c = 0; c < lane_sums.size(); c++)
+                            lane_sums[c] += low_probabilities[l] * conditional_word_probability[c];
+                    }
+                    else
+                    {
+                        word_sp = 0;
+                        double word_sq { 0 };
+                        for (size_t byte_idx = 0; byte_idx < 8; byte_idx++)
+                        {
+                            word_sp += byte_probabilities[byte_idx][(word >> (8 * byte_idx)) & 0xff];
+                            word_sq += byte_probabilities[byte_idx][(~word >> (8 * byte_idx)) & 0xff];
+                        }
+                        sq += low_probabilities[l] * word_sq;
+                        for (size_t c = 0; c < lane_sums.size(); c++)
+                        {
+                            double word_conditional_sp { 0 };
+                            for (size_t byte_idx = 0; byte_idx < 8; byte_idx++)
+                                word_conditional_sp += conditional_byte_probabilities[c][byte_idx][(word >> (8 * byte_idx)) & 0xff];
+                            lane_sums[c] += low_probabilities[l] * word_conditional_sp;
+                        }
+                    }
+                    sp += low_probabilities[l] * word_sp;
+                    for (size_t j = 0; j < low_count; j++)
+                        low_sums[2 * j + ((l >> (low_count - 1 - j)) & 1)] += low_probabilities_without[j][l] * word_sp;
+                }
+
+                double high_probability { state_probability(h, 0, high_count) };
+                result.sp += high_probability * sp;
+                result.sq += high_probability * sq;
+                for (size_t k = 0; k < WORD_ELEMENT_COUNT; k++)
+                {
+                    result.sp_working[lane_first + k] += high_probability * lane_sums[2 * k];
+                    result.sp_failed[lane_first + k] += high_probability * lane_sums[2 * k + 1];
+                }
+                for (size_t j = 0; j < low_count; j++)
+                {
+                    result.sp_working[high_count + j] += high_probability * low_sums[2 * j];
+                    result.sp_failed[high_count + j] += high_probability * low_sums[2 * j + 1];
+                }
+                for (size_t i = 0; i < high_count; i++)
+                {
+                    vector<double>& sums { ((h >> (high_count - 1 - i)) & 1) != 0 ? result.sp_failed : result.sp_working };
+                    sums[i] += state_probability_without(h, 0, high_count, i) * sp;
+                }
+            }
+            return result;
+        }
+
+    private:
+
+        // Per byte of a word, the summed lane probabilities of every bit pattern; returns
+        // the whole word's sum.
+        static double fill_byte_probabilities(const array<double, 64>& lane_probabilities, array<array<double, 256>, 8>& tables)
+        {
+            for (size_t byte_idx = 0; byte_idx < 8; byte_idx++)
+                for (size_t value = 0; value < 256; value++)
+                {
+                    double sum { 0 };
+                    for (size_t k = 0; k < 8; k++)
+                        if ((value >> k & 1) != 0)
+                            sum += lane_probabilities[byte_idx * 8 + k];
+                    tables[byte_idx][value] = sum;
+                }
+            double word_probability { 0 };
+            for (size_t byte_idx = 0; byte_idx < 8; byte_idx++)
+                word_probability += tables[byte_idx][0xff];
+            return word_probability;
+        }
+
+        // Probability of elements [first, first + count) where bit (count - 1 - j) of
+        // state marks element first + j as failed.
+        double state_probability(size_t state, size_t first, size_t count) const
+        {
+            double probability { 1.0 };
+            for (size_t j = 0; j < count; j++)
+                probability *= ((state >> (count - 1 - j)) & 1) != 0 ? q[first + j] : p[first + j];
+            return probability;
+        }
+
+        // The same without the factor of element first + skipped.
+        double state_probability_without(size_t state, size_t first, size_t count, size_t skipped) const
+        {
+            double probability { 1.0 };
+            for (size_t j = 0; j < count; j++)
+                if (j != skipped)
+                    probability *= ((state >> (count - 1 - j)) & 1) != 0 ? q[first + j] : p[first + j];
+            return probability;
+        }
+
+        ReweightedImportance reweight_importance_states(ReweightedImportance result) const
+        {
+            for (size_t s = 0; s < (1ull << all_count); s++)
+            {
+                if ((bitmap.words[s / 64] >> (s % 64) & 1) == 0)
+                {
+                    result.sq += state_probability(s, 0, all_count);
+                    continue;
+                }
+                result.sp += state_probability(s, 0, all_count);
+                for (size_t i = 0; i < all_count; i++)
+                {
+                    vector<double>& sums { ((s >> (all_count - 1 - i)) & 1) != 0 ? result.sp_failed : result.sp_working };
+                    sums[i] += state_probability_without(s, 0, all_count, i);
+                }
+            }
+            return result;
+        }
+
+        ReweightedReliability reweight_states() const
+        {
+            ReweightedReliability result { .sp = 0, .sq = 0 };
+            for (size_t s = 0; s < (1ull << all_count); s++)
+            {
+                double probability { state_probability(s, 0, all_count) };
+                if ((bitmap.words[s / 64] >> (s % 64) & 1) != 0)
+                    result.sp += probability;
+                else
+                    result.sq += probability;
+            }
+            return result;
+        }
+    };
+
+    // Little-endian file: the magic, all_count as 8 bytes, then the words. Only
+    // complete runs are written, since an unvisited state would read as down.
+    constexpr string_view OUTCOME_FILE_MAGIC { "SROUTCM1" };
+
+    void write_outcome_bitmap(const path& file_path, const OutcomeBitmap& bitmap)
+    {
+        ofstream file { file_path, std::ios::binary | std::ios::trunc };
+        if (!file.is_open())
+            throw runtime_error(format("Error: can't open outcome file {} for writing", file_path.string()));
+
+        unsigned long long all_count { bitmap.all_count };
+        file.write(OUTCOME_FILE_MAGIC.data(), static_cast<streamsize>(OUTCOME_FILE_MAGIC.size()));
+        file.write(reinterpret_cast<const char*>(&all_count), sizeof(all_count));
+        file.write(reinterpret_cast<const char*>(bitmap.words.data()), static_cast<streamsize>(bitmap.words.size() * sizeof(unsigned long long)));
+        if (!file)
+            throw runtime_error(format("Error: can't write outcome file {}", file_path.string()));
+    }
+
+    OutcomeBitmap read_outcome_bitmap(const path& file_path)
+    {
+        ifstream file { file_path, std::ios::binary };
+        if (!file.is_open())
+            throw runtime_error(format("Error: can't open outcome file {}", file_path.string()));
+
+        array<char, OUTCOME_FILE_MAGIC.size()> magic { };
+        unsigned long long all_count { 0 };
+        file.read(magic.data(), static_cast<streamsize>(magic.size()));
+        file.read(reinterpret_cast<char*>(&all_count), sizeof(all_count));
+        if (!file || string_view { magic.data(), magic.size() } != OUTCOME_FILE_MAGIC || all_count > MAX_OUTCOME_ELEMENT_COUNT)
+            throw runtime_error(format("Error: {} is not an outcome file", file_path.string()));
+
+        OutcomeBitmap bitmap { .all_count = static_cast<size_t>(all_count), .words = vector<unsigned long long>(((1ull << all_count) + 63) / 64) };
+        file.read(reinterpret_cast<char*>(bitmap.words.data()), static_cast<streamsize>(bitmap.words.size() * sizeof(unsigned long long)));
+        if (!file)
+            throw runtime_error(format("Error: outcome file {} is truncated", file_path.string()));
+        return bitmap;
+    }
+
+    ReweightedReliability reweight_outcome_bitmap(const OutcomeBitmap& bitmap, span<const double> p, span<const double> q)
+    {
+        OutcomeReweighter reweighter { bitmap, p, q };
+        return reweighter.reweight();
+    }
+
+    ReweightedImportance reweight_outcome_importance(const OutcomeBitmap& bitmap, span<const double> p, span<const double> q)
+    {
+        OutcomeReweighter reweighter { bitmap, p, q };
+        return reweighter.reweight_importance();
+    }
+}
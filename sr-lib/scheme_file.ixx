@@ -0,0 +1,531 @@
+export module scheme_reliability:scheme_file;
+
+import :model;
+using namespace sr_impl::model;
+
+import std;
+using std::string;
+using std::string_view;
+using std::vector;
+using std::optional, std::nullopt;
+using std::unordered_map;
+using std::ifstream, std::ofstream;
+using std::istringstream;
+using std::stringstream;
+using std::getline;
+using std::filesystem::path;
+using std::format;
+using std::runtime_error;
+using std::from_chars, std::errc;
+using std::isalnum, std::isspace;
+
+namespace sr_impl::scheme_file
+{
+    // Line-oriented scheme description, one declaration per line, '#' starts a comment:
+    //
+    //   scheme s23-original
+    //   type greedy
+    //   beam width=4 budget=1024
+    //   brute prune=1 drop_impossible=0
+    //   processor pr1 q=1.2e-4 normal=50 max=80
+    //   transition pr1 pr2:25 pr3:25
+    //   element a1 q=1.2e-4
+    //   function ((d1 | d2) & c1 | (d2 | d3) & c2) & (b1 | b2)
+    //
+    // p defaults to 1 - q; the beam line is only read by 'type beam' and the brute
+    // line by 'type brute'. A transition line adds one transition to the processor's
+    // table; targets are processor names with the load they take over. Every function line is one factor of the scheme
+    // function; '&' / '*' bind tighter than '|' / '+', '!' negates.
+    class SchemeFileParser
+    {
+    private:
+
+        struct PendingTransition
+        {
+            size_t line_no;
+            string processor_name;
+            vector<string> targets;
+        };
+
+        struct PendingFunction
+        {
+            size_t line_no;
+            string text;
+        };
+
+        const string source_name;
+
+        DynamicScheme scheme;
+        vector<PendingTransition> transitions;
+        vector<PendingFunction> functions;
+        unordered_map<string, size_t> element_indices;
+
+        size_t line_no;
+
+    public:
+
+        SchemeFileParser(string_view source_name):
+            source_name { source_name },
+            scheme { .scheme_name = { }, .elements = { }, .processors = { }, .scheme_expression = { }, .type = SchemeType::Greedy },
+            transitions { },
+            functions { },
+            element_indices { },
+            line_no { 0 }
+        { }
+
+        DynamicScheme parse(string_view text)
+        {
+            istringstream input { string { text } };
+            string line { };
+            while (getline(input, line))
+            {
+                line_no++;
+                parse_line(line);
+            }
+
+            if (scheme.scheme_name.empty())
+                throw error(0, "missing 'scheme' declaration");
+            if (scheme.processors.empty())
+                throw error(0, "scheme has no processors");
+            if (scheme.elements.empty())
+                throw error(0, "scheme has no elements besides processors");
+            if (functions.empty())
+                throw error(0, "missing 'function' declaration");
+
+            // Processors take the leading indices, as in Scheme<all_count, processor_count>.
+            for (size_t i = 0; i < scheme.processors.size(); i++)
+                element_indices[scheme.processors[i].name] = i;
+            for (size_t i = 0; i < scheme.elements.size(); i++)
+                element_indices[scheme.elements[i].name] = scheme.processors.size() + i;
+            if (element_indices.size() != scheme.all_count())
+                throw error(0, "element names must be unique");
+
+            for (const PendingTransition& transition : transitions)
+                resolve_transition(transition);
+            for (size_t i = 0; i < functions.size(); i++)
+            {
+                compile_function(functions[i]);
+                if (i > 0)
+                    scheme.scheme_expression.push_back({ .code = ExpressionOpCode::And, .element_idx = 0 });
+            }
+
+            return scheme;
+        }
+
+    private:
+
+        runtime_error error(size_t error_line_no, string_view message) const
+        {
+            if (error_line_no == 0)
+                return runtime_error(format("{}: {}", source_name, message));
+            return runtime_error(format("{}:{}: {}", source_name, error_line_no, message));
+        }
+
+        void parse_line(string_view line)
+        {
+            size_t comment { line.find('#') };
+            if (comment != string_view::npos)
+                line = line.substr(0, comment);
+
+            vector<string> words { split_words(line) };
+            if (words.empty())
+                return;
+
+            const string& keyword { words[0] };
+            if (keyword == "function")
+            {
+                size_t start { line.find("function") + string_view { "function" }.size() };
+                functions.push_back({ .line_no = line_no, .text = string { line.substr(start) } });
+            }
+            else if (keyword == "scheme")
+            {
+                expect_word_count(words, 2);
+                if (!is_valid_scheme_name(words[1]))
+                    throw error(line_no, format("scheme name '{}' is not a plain directory name", words[1]));
+                scheme.scheme_name = words[1];
+            }
+            else if (keyword == "type")
+            {
+                expect_word_count(words, 2);
+                if (words[1] == "greedy")
+                    scheme.type = SchemeType::Greedy;
+                else if (words[1] == "brute")
+                    scheme.type = SchemeType::Brute;
+                else if (words[1] == "beam")
+                    scheme.type = SchemeType::Beam;
+                else
+                    throw error(line_no, format("unknown scheme type '{}'", words[1]));
+            }
+            else if (keyword == "beam")
+            {
+                unordered_map<string, double> values { parse_values(words, 1) };
+                for (const auto& [key, value] : values)
+                {
+                    if (key == "width")
+                        scheme.beam_options.width = static_cast<size_t>(value);
+                    else if (key == "budget")
+                        scheme.beam_options.max_expanded_node_count = static_cast<size_t>(value);
+                    else
+                        throw error(line_no, format("unknown beam option '{}'", key));
+                }
+            }
+            else if (keyword == "brute")
+            {
+                unordered_map<string, double> values { parse_values(words, 1) };
+                for (const auto& [key, value] : values)
+                {
+                    if (key == "prune")
+                        scheme.brute_options.is_pruning_transitions = value != 0;
+                    else if (key == "drop_impossible")
+                        scheme.brute_options.is_dropping_impossible_transitions = value != 0;
+                    else
+                        throw error(line_no, format("unknown brute option '{}'", key));
+                }
+            }
+            else if (keyword == "element")
+            {
+                if (words.size() < 3)
+                    throw error(line_no, "expected 'element <name> q=<q> [p=<p>]'");
+                unordered_map<string, double> values { parse_values(words, 2) };
+                double q { required_value(values, "q") };
+                scheme.elements.push_back(Element { .name = words[1], .p = optional_value(values, "p").value_or(1.0 - q), .q = q });
+            }
+            else if (keyword == "processor")
+            {
+                if (words.size() < 5)
+                    throw error(line_no, "expected 'processor <name> q=<q> [p=<p>] normal=<load> max=<load>'");
+                unordered_map<string, double> values { parse_values(words, 2) };
+                double q { required_value(values, "q") };
+                scheme.processors.push_back(Processor
+                {
+                    .name = words[1],
+                    .p = optional_value(values, "p").value_or(1.0 - q),
+                    .q = q,
+                    .normal_load = required_value(values, "normal"),
+                    .max_load = required_value(values, "max"),
+                    .transitions = { }
+                });
+            }
+            else if (keyword == "transition")
+            {
+                if (words.size() < 3)
+                    throw error(line_no, "expected 'transition <processor> <processor>:<load>...'");
+                transitions.push_back({ .line_no = line_no, .processor_name = words[1], .targets = { words.begin() + 2, words.end() } });
+            }
+            else
+                throw error(line_no, format("unknown declaration '{}'", keyword));
+        }
+
+        void expect_word_count(const vector<string>& words, size_t count) const
+        {
+            if (words.size() != count)
+                throw error(line_no, format("'{}' expects {} argument(s)", words[0], count - 1));
+        }
+
+        unordered_map<string, double> parse_values(const vector<string>& words, size_t first) const
+        {
+            unordered_map<string, double> values { };
+            for (size_t i = first; i < words.size(); i++)
+            {
+                size_t separator { words[i].find('=') };
+                if (separator == string::npos)
+                    throw error(line_no, format("expected <key>=<value>, got '{}'", words[i]));
+                values[words[i].substr(0, separator)] = parse_number(words[i].substr(separator + 1), line_no);
+            }
+            return values;
+        }
+
+        double required_value(const unordered_map<string, double>& values, const string& key) const
+        {
+            optional<double> value { optional_value(values, key) };
+            if (!value.has_value())
+                throw error(line_no, format("missing '{}='", key));
+            return value.value();
+        }
+
+        optional<double> optional_value(const unordered_map<string, double>& values, const string& key) const
+        {
+            auto it { values.find(key) };
+            return it == values.end() ? nullopt : optional<double> { it->second };
+        }
+
+        double parse_number(string_view text, size_t number_line_no) const
+        {
+            double value { 0 };
+            auto [end, ec] { from_chars(text.data(), text.data() + text.size(), value) };
+            if (ec != errc { } || end != text.data() + text.size())
+                throw error(number_line_no, format("invalid number '{}'", text));
+            return value;
+        }
+
+        size_t processor_index(const string& name, size_t reference_line_no) const
+        {
+            auto it { element_indices.find(name) };
+            if (it == element_indices.end() || it->second >= scheme.processors.size())
+                throw error(reference_line_no, format("unknown processor '{}'", name));
+            return it->second;
+        }
+
+        void resolve_transition(const PendingTransition& pending)
+        {
+            Transition transition { };
+            for (const string& target : pending.targets)
+            {
+                size_t separator { target.find(':') };
+                if (separator == string::npos)
+                    throw error(pending.line_no, format("expected <processor>:<load>, got '{}'", target));
+                transition.push_back(IdxL
+                {
+                    .index = processor_index(target.substr(0, separator), pending.line_no),
+                    .load = parse_number(string_view { target }.substr(separator + 1), pending.line_no)
+                });
+            }
+            scheme.processors[processor_index(pending.processor_name, pending.line_no)].transitions.push_back(transition);
+        }
+
+        static vector<string> split_words(string_view line)
+        {
+            vector<string> words { };
+            stringstream stream { string { line } };
+            string word { };
+            while (stream >> word)
+                words.push_back(word);
+            return words;
+        }
+
+        // Recursive descent over: or := and ('|' and)*; and := unary ('&' unary)*;
+        // unary := '!' unary | name | '(' or ')'. Emits postfix ops.
+        class ExpressionCompiler
+        {
+        private:
+
+            const SchemeFileParser& parser;
+            const PendingFunction& function;
+            vector<ExpressionOp>& program;
+            size_t position;
+
+        public:
+
+            ExpressionCompiler(const SchemeFileParser& parser, const PendingFunction& function, vector<ExpressionOp>& program):
+                parser { parser }, function { function }, program { program }, position { 0 }
+            { }
+
+            void compile()
+            {
+                parse_or();
+                skip_spaces();
+                if (position != function.text.size())
+                    throw parser.error(function.line_no, format("unexpected '{}' in function", function.text[position]));
+            }
+
+        private:
+
+            void parse_or()
+            {
+                parse_and();
+                while (accept('|') || accept('+'))
+                {
+                    parse_and();
+                    program.push_back({ .code = ExpressionOpCode::Or, .element_idx = 0 });
+                }
+            }
+
+            void parse_and()
+            {
+                parse_unary();
+                while (accept('&') || accept('*'))
+                {
+                    parse_unary();
+                    program.push_back({ .code = ExpressionOpCode::And, .element_idx = 0 });
+                }
+            }
+
+            void parse_unary()
+            {
+                if (accept('!'))
+                {
+                    parse_unary();
+                    program.push_back({ .code = ExpressionOpCode::Not, .element_idx = 0 });
+                }
+                else if (accept('('))
+                {
+                    parse_or();
+                    if (!accept(')'))
+                        throw parser.error(function.line_no, "expected ')' in function");
+                }
+                else
+                    parse_name();
+            }
+
+            void parse_name()
+            {
+                skip_spaces();
+                size_t start { position };
+                while (position < function.text.size() && is_name_char(function.text[position]))
+                    position++;
+                if (start == position)
+                    throw parser.error(function.line_no, "expected element name in function");
+
+                string name { function.text.substr(start, position - start) };
+                if (name == "1" || name == "0")
+                {
+                    program.push_back({ .code = name == "1" ? ExpressionOpCode::True : ExpressionOpCode::False, .element_idx = 0 });
+                    return;
+                }
+                auto it { parser.element_indices.find(name) };
+                if (it == parser.element_indices.end())
+                    throw parser.error(function.line_no, format("unknown element '{}' in function", name));
+                program.push_back({ .code = ExpressionOpCode::Element, .element_idx = it->second });
+            }
+
+            bool accept(char c)
+            {
+                skip_spaces();
+                if (position < function.text.size() && function.text[position] == c)
+                {
+                    position++;
+                    return true;
+                }
+                return false;
+            }
+
+            void skip_spaces()
+            {
+                while (position < function.text.size() && isspace(static_cast<unsigned char>(function.text[position])))
+                    position++;
+            }
+
+            static bool is_name_char(char c)
+            {
+                return isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.' || c == '-';
+            }
+        };
+
+        void compile_function(const PendingFunction& function)
+        {
+            ExpressionCompiler compiler { *this, function, scheme.scheme_expression };
+            compiler.compile();
+        }
+    };
+
+    DynamicScheme parse_scheme(string_view text, string_view source_name)
+    {
+        SchemeFileParser parser { source_name };
+        return parser.parse(text);
+    }
+
+    DynamicScheme load_scheme_file(const path& scheme_file_path)
+    {
+        ifstream scheme_file { scheme_file_path };
+        if (!scheme_file.is_open())
+            throw runtime_error(format("Error: can't open scheme file {}", scheme_file_path.string()));
+
+        stringstream text { };
+        text << scheme_file.rdbuf();
+        return parse_scheme(text.str(), scheme_file_path.string());
+    }
+
+    // Infix text of the postfix scheme expression, parenthesised only where the
+    // parser's precedence and left associativity need it, so it parses back to the
+    // same ops.
+    string format_expression(const DynamicScheme& scheme)
+    {
+        enum Precedence { Or, And, Unary };
+        struct Term
+        {
+            string text;
+            Precedence precedence;
+        };
+        auto wrap = [](const Term& term, Precedence min_precedence)
+        {
+            return term.precedence >= min_precedence ? term.text : format("({})", term.text);
+        };
+
+        vector<Term> stack { };
+        for (const ExpressionOp& op : scheme.scheme_expression)
+        {
+            switch (op.code)
+            {
+            case ExpressionOpCode::Element:
+                stack.push_back({ op.element_idx < scheme.processors.size()
+                    ? scheme.processors[op.element_idx].name
+                    : scheme.elements[op.element_idx - scheme.processors.size()].name, Unary });
+                break;
+            case ExpressionOpCode::True: stack.push_back({ "1", Unary }); break;
+            case ExpressionOpCode::False: stack.push_back({ "0", Unary }); break;
+            case ExpressionOpCode::Not: stack.back() = { format("!{}", wrap(stack.back(), Unary)), Unary }; break;
+            case ExpressionOpCode::And:
+            case ExpressionOpCode::Or:
+            {
+                Precedence precedence { op.code == ExpressionOpCode::And ? And : Or };
+                Term right { stack.back() };
+                stack.pop_back();
+                stack.back() = Term
+                {
+                    format("{} {} {}", wrap(stack.back(), precedence), precedence == And ? '*' : '+', wrap(right, static_cast<Precedence>(precedence + 1))),
+                    precedence
+                };
+                break;
+            }
+            }
+        }
+        if (stack.size() != 1)
+            throw runtime_error(format("Error: scheme {} has a malformed scheme expression", scheme.scheme_name));
+        return stack.front().text;
+    }
+
+    // Scheme file text that parse_scheme reads back into the same scheme.
+    string format_scheme(const DynamicScheme& scheme)
+    {
+        string text { format("scheme {}\n", scheme.scheme_name) };
+        switch (scheme.type)
+        {
+        case SchemeType::Brute:
+            text += format(
+                "type brute\nbrute prune={:d} drop_impossible={:d}\n",
+                scheme.brute_options.is_pruning_transitions, scheme.brute_options.is_dropping_impossible_transitions
+            );
+            break;
+        case SchemeType::Beam:
+            text += format("type beam\nbeam width={} budget={}\n", scheme.beam_options.width, scheme.beam_options.max_expanded_node_count);
+            break;
+        default: text += "type greedy\n"; break;
+        }
+
+        text += "\n";
+        for (const Processor& processor : scheme.processors)
+            text += format(
+                "processor {} q={}{} normal={} max={}\n",
+                processor.name, processor.q, processor.p == 1.0 - processor.q ? "" : format(" p={}", processor.p),
+                processor.normal_load, processor.max_load
+            );
+
+        text += "\n";
+        for (const Processor& processor : scheme.processors)
+            for (const Transition& transition : processor.transitions)
+            {
+                text += format("transition {}", processor.name);
+                for (const IdxL& target : transition)
+                    text += format(" {}:{}", scheme.processors[target.index].name, target.load);
+                text += "\n";
+            }
+
+        text += "\n";
+        for (const Element& element : scheme.elements)
+            text += format("element {} q={}{}\n", element.name, element.q, element.p == 1.0 - element.q ? "" : format(" p={}", element.p));
+
+        text += format("\nfunction {}\n", format_expression(scheme));
+        return text;
+    }
+
+    void write_scheme_file(const path& scheme_file_path, const DynamicScheme& scheme)
+    {
+        ofstream scheme_file { scheme_file_path, std::ios::trunc };
+        if (!scheme_file.is_open())
+            throw runtime_error(format("Error: can't open scheme file {} for writing", scheme_file_path.string()));
+
+        scheme_file << format_scheme(scheme);
+        if (!scheme_file)
+            throw runtime_error(format("Error: can't write scheme file {}", scheme_file_path.string()));
+    }
+}
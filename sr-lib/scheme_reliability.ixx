@@ -1,7 +1,26 @@
 export module scheme_reliability;
 
 import :model;
+import :metrics;
+import :control;
+import :summation;
+import :trace;
+import :sink;
 import :algorithm;
+import :cutsets;
+import :variants;
+import :analysis;
+import :scheme_file;
+import :generator;
+import :dynamic;
+import :transition_table;
+import :cache;
+import :conditional;
+import :outcome;
+import :whatif;
+import :batch;
+
+import std;
 
 export namespace sr
 {
@@ -21,14 +40,228 @@ export namespace sr
     template<size_t all_count, size_t processor_count>
     using SchemeDto = sr_impl::model::Scheme<all_count, processor_count>;
 
+    using DynamicSchemeDto = sr_impl::model::DynamicScheme;
+    using ExpressionOpDto = sr_impl::model::ExpressionOp;
+    using sr_impl::model::ExpressionOpCode;
+    using GeneratorOptionsDto = sr_impl::model::GeneratorOptions;
+
     using SchemeType = sr_impl::model::SchemeType;
+    using BeamOptionsDto = sr_impl::model::BeamOptions;
+    using BruteForceOptionsDto = sr_impl::model::BruteForceOptions;
+    using OutputFormat = sr_impl::model::OutputFormat;
 
     using SchemeReliabilitySummaryDto = sr_impl::model::SchemeReliabilitySummary;
+    using PhaseTimingDto = sr_impl::model::PhaseTiming;
+    using CalculationOptionsDto = sr_impl::model::CalculationOptions;
+
+    using WorkerMetricsDto = sr_impl::model::WorkerMetrics;
+    using MetricsSnapshotDto = sr_impl::model::MetricsSnapshot;
+    using sr_impl::model::MetricsCallback;
+
+    using AppliedTransitionDto = sr_impl::model::AppliedTransition;
+    using FailureStateDto = sr_impl::model::FailureState;
+
+    using ProcessorLoadStatisticsDto = sr_impl::model::ProcessorLoadStatistics;
+    using TransitionUsageDto = sr_impl::model::TransitionUsage;
+    using LoadStatisticsDto = sr_impl::model::LoadStatistics;
+    using sr_impl::model::LOAD_HISTOGRAM_BIN_COUNT;
+
+    using BoundOptionsDto = sr_impl::model::BoundOptions;
+    using ReliabilityBoundsDto = sr_impl::model::ReliabilityBounds;
+
+    using ProgressDto = sr_impl::model::Progress;
+    using sr_impl::model::ProgressCallback;
+
+    using VariantDisagreementDto = sr_impl::model::VariantDisagreement;
+    using MultiVariantSummaryDto = sr_impl::model::MultiVariantSummary;
+
+    using PinnedElementDto = sr_impl::model::PinnedElement;
+    using ConditionalReliabilityDto = sr_impl::model::ConditionalReliability;
+    using ConditionalBreakdownDto = sr_impl::model::ConditionalBreakdown;
+
+    using DivergentProcessorMaskDto = sr_impl::model::DivergentProcessorMask;
+    using StrategyComparisonDto = sr_impl::model::StrategyComparison;
+
+    using AnalysisOptionsDto = sr_impl::model::AnalysisOptions;
+    using ElementFailureStatisticsDto = sr_impl::model::ElementFailureStatistics;
+    using MaskGroupStatisticsDto = sr_impl::model::MaskGroupStatistics;
+    using ResultAnalysisDto = sr_impl::model::ResultAnalysis;
+
+    using sr_impl::model::TransitionRemovalReason;
+    using RemovedTransitionDto = sr_impl::model::RemovedTransition;
+    using TransitionNormalizationReportDto = sr_impl::model::TransitionNormalizationReport;
+
+    using CutSetOptionsDto = sr_impl::model::CutSetOptions;
+    using MinimalCutSetDto = sr_impl::model::MinimalCutSet;
+    using CutSetReportDto = sr_impl::model::CutSetReport;
+
+    using OutcomeBitmapDto = sr_impl::model::OutcomeBitmap;
+    using ReweightedReliabilityDto = sr_impl::model::ReweightedReliability;
+    using ReweightedImportanceDto = sr_impl::model::ReweightedImportance;
+
+    using BatchJobDto = sr_impl::model::BatchJob;
+    using BatchOptionsDto = sr_impl::model::BatchOptions;
+    using BatchJobResultDto = sr_impl::model::BatchJobResult;
+    using BatchSummaryDto = sr_impl::model::BatchSummary;
+
+    using WhatIfSession = sr_impl::whatif::WhatIfSession;
+    using BatchRunner = sr_impl::batch::BatchRunner;
 
     template<size_t all_count, size_t processor_count>
     inline SchemeReliabilitySummaryDto calculate_scheme_reliability(
-        const SchemeDto<all_count, processor_count> scheme_dto
+        const SchemeDto<all_count, processor_count> scheme_dto,
+        const CalculationOptionsDto& options_dto = { }
+    ) {
+        return sr_impl::algorithm::calculate_scheme_reliability<all_count, processor_count>(scheme_dto, options_dto);
+    }
+
+    template<size_t all_count, size_t processor_count>
+    inline MultiVariantSummaryDto calculate_scheme_variants_reliability(
+        const std::vector<SchemeDto<all_count, processor_count>>& variant_dtos,
+        const CalculationOptionsDto& options_dto = { }
+    ) {
+        return sr_impl::variants::calculate_scheme_variants_reliability<all_count, processor_count>(variant_dtos, options_dto);
+    }
+
+    template<size_t all_count, size_t processor_count>
+    inline StrategyComparisonDto compare_reconfiguration_strategies(
+        const SchemeDto<all_count, processor_count>& scheme_dto,
+        const CalculationOptionsDto& options_dto = { },
+        size_t top_mask_count = 10
+    ) {
+        return sr_impl::variants::compare_reconfiguration_strategies<all_count, processor_count>(scheme_dto, options_dto, top_mask_count);
+    }
+
+    // Reliability given the pinned elements' states, enumerating only the free elements.
+    template<size_t all_count, size_t processor_count>
+    inline ConditionalReliabilityDto calculate_conditional_reliability(
+        const SchemeDto<all_count, processor_count>& scheme_dto,
+        const std::vector<PinnedElementDto>& pinned_element_dtos,
+        const CalculationOptionsDto& options_dto = { }
+    ) {
+        return sr_impl::conditional::calculate_conditional_reliability<all_count, processor_count>(scheme_dto, pinned_element_dtos, options_dto);
+    }
+
+    // Conditional reliability for every assignment of the pinned elements, in one pass.
+    template<size_t all_count, size_t processor_count>
+    inline ConditionalBreakdownDto calculate_conditional_breakdown(
+        const SchemeDto<all_count, processor_count>& scheme_dto,
+        const std::vector<std::string>& pinned_element_names,
+        const CalculationOptionsDto& options_dto = { }
+    ) {
+        return sr_impl::conditional::calculate_conditional_breakdown<all_count, processor_count>(scheme_dto, pinned_element_names, options_dto);
+    }
+
+    inline SchemeReliabilitySummaryDto calculate_scheme_reliability(
+        const DynamicSchemeDto& scheme_dto,
+        const CalculationOptionsDto& options_dto = { }
+    ) {
+        return sr_impl::dynamic::calculate_scheme_reliability(scheme_dto, options_dto);
+    }
+
+    // Whether each state works after reconfiguration, for re-weighting with other p/q.
+    // With cache_path, a bitmap of the same topology is read back instead of enumerated.
+    inline OutcomeBitmapDto calculate_outcome_bitmap(
+        const DynamicSchemeDto& scheme_dto,
+        size_t thread_count = 0,
+        const std::optional<std::filesystem::path>& cache_path = std::nullopt
+    ) {
+        return sr_impl::dynamic::calculate_outcome_bitmap(scheme_dto, thread_count, cache_path);
+    }
+
+    inline OutcomeBitmapDto read_outcome_bitmap(const std::filesystem::path& outcome_file_path)
+    {
+        return sr_impl::outcome::read_outcome_bitmap(outcome_file_path);
+    }
+
+    inline void write_outcome_bitmap(const std::filesystem::path& outcome_file_path, const OutcomeBitmapDto& bitmap_dto)
+    {
+        sr_impl::outcome::write_outcome_bitmap(outcome_file_path, bitmap_dto);
+    }
+
+    // sp/sq of the bitmap's states for other p/q, skipping reconfiguration.
+    inline ReweightedReliabilityDto reweight_outcome_bitmap(
+        const OutcomeBitmapDto& bitmap_dto,
+        std::span<const double> p,
+        std::span<const double> q
+    ) {
+        return sr_impl::outcome::reweight_outcome_bitmap(bitmap_dto, p, q);
+    }
+
+    // The same in one pass, with sp conditioned on each element working and failed.
+    inline ReweightedImportanceDto reweight_outcome_importance(
+        const OutcomeBitmapDto& bitmap_dto,
+        std::span<const double> p,
+        std::span<const double> q
+    ) {
+        return sr_impl::outcome::reweight_outcome_importance(bitmap_dto, p, q);
+    }
+
+    inline DynamicSchemeDto parse_scheme(std::string_view text, std::string_view source_name = "<scheme>")
+    {
+        return sr_impl::scheme_file::parse_scheme(text, source_name);
+    }
+
+    inline DynamicSchemeDto load_scheme_file(const std::filesystem::path& scheme_file_path)
+    {
+        return sr_impl::scheme_file::load_scheme_file(scheme_file_path);
+    }
+
+    inline std::string format_scheme(const DynamicSchemeDto& scheme_dto)
+    {
+        return sr_impl::scheme_file::format_scheme(scheme_dto);
+    }
+
+    inline void write_scheme_file(const std::filesystem::path& scheme_file_path, const DynamicSchemeDto& scheme_dto)
+    {
+        sr_impl::scheme_file::write_scheme_file(scheme_file_path, scheme_dto);
+    }
+
+    // Synthetic scheme for scaling studies, reproducible from the options' seed.
+    inline DynamicSchemeDto generate_scheme(const GeneratorOptionsDto& options_dto)
+    {
+        return sr_impl::generator::generate_scheme(options_dto);
+    }
+
+    // Every job on one pool, taking turns on the ranges of the active jobs.
+    inline BatchSummaryDto run_batch(const std::vector<BatchJobDto>& job_dtos, const BatchOptionsDto& options_dto = { })
+    {
+        return sr_impl::batch::run_batch(job_dtos, options_dto);
+    }
+
+    template<size_t all_count, size_t processor_count>
+    inline ReliabilityBoundsDto estimate_reliability_bounds(
+        const SchemeDto<all_count, processor_count> scheme_dto,
+        const BoundOptionsDto& options_dto = { }
+    ) {
+        return sr_impl::algorithm::estimate_reliability_bounds<all_count, processor_count>(scheme_dto, options_dto);
+    }
+
+    // Reports what the brute force search prunes from the scheme's transition tables.
+    template<size_t all_count, size_t processor_count>
+    inline TransitionNormalizationReportDto normalize_transition_table(
+        const SchemeDto<all_count, processor_count>& scheme_dto
+    ) {
+        return sr_impl::transition_table::normalize_transition_table(scheme_dto).report;
+    }
+
+    inline TransitionNormalizationReportDto normalize_transition_table(const DynamicSchemeDto& scheme_dto)
+    {
+        return sr_impl::transition_table::normalize_transition_table(scheme_dto).report;
+    }
+
+    template<size_t all_count, size_t processor_count>
+    inline CutSetReportDto find_minimal_cut_sets(
+        const SchemeDto<all_count, processor_count> scheme_dto,
+        const CutSetOptionsDto& options_dto = { }
+    ) {
+        return sr_impl::cutsets::find_minimal_cut_sets<all_count, processor_count>(scheme_dto, options_dto);
+    }
+
+    inline ResultAnalysisDto analyze_scheme_result(
+        const std::filesystem::path& result_path,
+        const AnalysisOptionsDto& options_dto = { }
     ) {
-        return sr_impl::algorithm::calculate_scheme_reliability<all_count, processor_count>(scheme_dto);
+        return sr_impl::analysis::analyze_scheme_result(result_path, options_dto);
     }
 }
@@ -0,0 +1,863 @@
+export module scheme_reliability:sink;
+
+import :model;
+using namespace sr_impl::model;
+
+import :outcome;
+using namespace sr_impl::outcome;
+
+import :summation;
+using namespace sr_impl::summation;
+
+import std;
+using std::array;
+using std::vector;
+using std::span;
+using std::string;
+using std::ofstream;
+using std::filesystem::path;
+using std::unique_ptr, std::make_unique;
+using std::shared_ptr;
+using std::atomic, std::atomic_ref, std::memory_order_relaxed, std::memory_order_acq_rel;
+using std::mutex, std::lock_guard;
+using std::format;
+using std::runtime_error;
+using std::memcpy;
+using std::max;
+using std::uint8_t, std::uint16_t, std::uint32_t, std::int16_t, std::int32_t, std::int64_t;
+
+namespace sr_impl::sink
+{
+    template<size_t all_count, size_t processor_count>
+    struct ScoredStateVectorBatch
+    {
+        vector<StateVector<all_count, processor_count>> sv1;
+        vector<StateVector<all_count, processor_count>> sv2;
+        vector<double> probability;
+        vector<char> is_reconfigured;
+        vector<char> scheme_state_sv1;
+        vector<char> scheme_state_sv2;
+        size_t size;
+        // Index of sv1[0]; the batch covers consecutive states.
+        size_t first_state_index;
+
+        ScoredStateVectorBatch(size_t capacity):
+            sv1(capacity), sv2(capacity),
+            probability(capacity),
+            is_reconfigured(capacity),
+            scheme_state_sv1(capacity), scheme_state_sv2(capacity),
+            size { 0 },
+            first_state_index { 0 }
+        { }
+    };
+
+    template<size_t all_count, size_t processor_count>
+    class ResultSink
+    {
+    public:
+
+        virtual ~ResultSink() = default;
+
+        virtual const path& get_path() const = 0;
+
+        // Returns the number of bytes appended to the file.
+        virtual size_t write_batch(const ScoredStateVectorBatch<all_count, processor_count>& batch) = 0;
+
+        virtual void close() = 0;
+    };
+
+    template<size_t all_count, size_t processor_count>
+    class SsvResultSink : public ResultSink<all_count, processor_count>
+    {
+    private:
+
+        static constexpr size_t SCORED_STATE_VECTOR_RECORD_SIZE { 3 * sizeof(bool) + sizeof(double) + 2 * all_count * sizeof(bool) };
+
+        const path data_file_path;
+        ofstream data_file;
+        vector<char> output_buffer;
+
+    public:
+
+        SsvResultSink(path data_file_path):
+            data_file_path { data_file_path },
+            data_file { data_file_path, std::ios::binary },
+            output_buffer { }
+        {
+            if (!data_file.is_open())
+            {
+                string msg { format("Error: can't open data_file {} for writing", data_file_path.string()) };
+                //println(cerr, msg);
+                throw runtime_error(msg);
+            }
+        }
+
+        const path& get_path() const override
+        {
+            return data_file_path;
+        }
+
+        size_t write_batch(const ScoredStateVectorBatch<all_count, processor_count>& batch) override
+        {
+            output_buffer.resize(batch.size * SCORED_STATE_VECTOR_RECORD_SIZE);
+            for (size_t k = 0; k < batch.size; k++)
+            {
+                char* record { output_buffer.data() + k * SCORED_STATE_VECTOR_RECORD_SIZE };
+                bool scheme_state_sv1 { batch.scheme_state_sv1[k] != 0 };
+                bool scheme_state_sv2 { batch.scheme_state_sv2[k] != 0 };
+                bool scheme_state { scheme_state_sv1 || scheme_state_sv2 };
+                memcpy(record, &scheme_state_sv1, sizeof(bool));
+                memcpy(record + sizeof(bool), &scheme_state_sv2, sizeof(bool));
+                memcpy(record + 2 * sizeof(bool), &scheme_state, sizeof(bool));
+                memcpy(record + 3 * sizeof(bool), &batch.probability[k], sizeof(double));
+                memcpy(record + 3 * sizeof(bool) + sizeof(double), batch.sv1[k].sv.data(), all_count * sizeof(bool));
+                memcpy(record + 3 * sizeof(bool) + sizeof(double) + all_count * sizeof(bool), batch.sv2[k].sv.data(), all_count * sizeof(bool));
+            }
+            data_file.write(output_buffer.data(), static_cast<std::streamsize>(output_buffer.size()));
+            return output_buffer.size();
+        }
+
+        void close() override
+        {
+            data_file.close();
+        }
+    };
+
+    // Minimal front-to-back FlatBuffers writer: children are always written after the
+    // object that references them, so every uoffset points forward and is patched in place.
+    class FlatBufferBuilder
+    {
+    private:
+
+        vector<char> bytes;
+
+    public:
+
+        FlatBufferBuilder():
+            bytes(sizeof(uint32_t), 0)
+        { }
+
+        inline const vector<char>& data() const
+        {
+            return bytes;
+        }
+
+        void pad_to(size_t alignment, size_t extra = 0)
+        {
+            while ((bytes.size() + extra) % alignment != 0)
+                bytes.push_back(0);
+        }
+
+        void put_zeros(size_t count)
+        {
+            bytes.resize(bytes.size() + count, 0);
+        }
+
+        template<typename T>
+        size_t put(T value)
+        {
+            size_t position { bytes.size() };
+            bytes.resize(position + sizeof(T));
+            memcpy(bytes.data() + position, &value, sizeof(T));
+            return position;
+        }
+
+        template<typename T>
+        void set(size_t position, T value)
+        {
+            memcpy(bytes.data() + position, &value, sizeof(T));
+        }
+
+        void patch_offset(size_t field_position, size_t target_position)
+        {
+            set<uint32_t>(field_position, static_cast<uint32_t>(target_position - field_position));
+        }
+
+        void set_root(size_t table_position)
+        {
+            patch_offset(0, table_position);
+        }
+
+        size_t add_string(const string& value)
+        {
+            pad_to(sizeof(uint32_t));
+            size_t position { put<uint32_t>(static_cast<uint32_t>(value.size())) };
+            bytes.insert(bytes.end(), value.begin(), value.end());
+            bytes.push_back(0);
+            return position;
+        }
+
+        // Vector of structs made of 8-byte words; the element data must be 8-aligned.
+        size_t add_struct_vector(span<const int64_t> words, size_t words_per_struct)
+        {
+            pad_to(sizeof(int64_t), sizeof(uint32_t));
+            size_t position { put<uint32_t>(static_cast<uint32_t>(words.size() / words_per_struct)) };
+            for (int64_t word : words)
+                put<int64_t>(word);
+            return position;
+        }
+
+        // Vector of uoffsets; element i lives at position + 4 + 4 * i and is patched later.
+        size_t add_offset_vector(size_t count)
+        {
+            pad_to(sizeof(uint32_t));
+            size_t position { put<uint32_t>(static_cast<uint32_t>(count)) };
+            for (size_t i = 0; i < count; i++)
+                put<uint32_t>(0);
+            return position;
+        }
+    };
+
+    class FlatBufferTable
+    {
+    private:
+
+        struct Field
+        {
+            uint16_t id;
+            size_t size;
+            int64_t value;
+        };
+
+        vector<Field> fields;
+        vector<size_t> field_positions;
+
+    public:
+
+        FlatBufferTable():
+            fields { }, field_positions { }
+        { }
+
+        template<typename T>
+        FlatBufferTable& add_scalar(uint16_t id, T value)
+        {
+            fields.push_back(Field { .id = id, .size = sizeof(T), .value = static_cast<int64_t>(value) });
+            return *this;
+        }
+
+        FlatBufferTable& add_offset(uint16_t id)
+        {
+            fields.push_back(Field { .id = id, .size = sizeof(uint32_t), .value = 0 });
+            return *this;
+        }
+
+        // Writes the vtable followed by the table; returns the table position.
+        size_t write(FlatBufferBuilder& builder)
+        {
+            size_t field_count { 0 };
+            for (const Field& field : fields)
+                field_count = max<size_t>(field_count, field.id + 1);
+
+            // Larger fields first, each aligned relative to the 8-aligned table start.
+            vector<size_t> order(fields.size());
+            for (size_t i = 0; i < order.size(); i++)
+                order[i] = i;
+            std::ranges::stable_sort(order, [this](size_t a, size_t b) { return fields[a].size > fields[b].size; });
+
+            vector<uint16_t> field_offsets(fields.size());
+            size_t table_size { sizeof(int32_t) };
+            for (size_t i : order)
+            {
+                table_size = (table_size + fields[i].size - 1) / fields[i].size * fields[i].size;
+                field_offsets[i] = static_cast<uint16_t>(table_size);
+                table_size += fields[i].size;
+            }
+
+            builder.pad_to(sizeof(uint16_t));
+            size_t vtable_position { builder.put<uint16_t>(static_cast<uint16_t>(sizeof(uint16_t) * (2 + field_count))) };
+            builder.put<uint16_t>(static_cast<uint16_t>(table_size));
+            vector<uint16_t> vtable(field_count, 0);
+            for (size_t i = 0; i < fields.size(); i++)
+                vtable[fields[i].id] = field_offsets[i];
+            for (uint16_t entry : vtable)
+                builder.put<uint16_t>(entry);
+
+            builder.pad_to(sizeof(int64_t));
+            size_t table_position { builder.put<int32_t>(static_cast<int32_t>(0)) };
+            builder.set<int32_t>(table_position, static_cast<int32_t>(table_position - vtable_position));
+            builder.put_zeros(table_size - sizeof(int32_t));
+
+            field_positions.assign(field_count, 0);
+            for (size_t i = 0; i < fields.size(); i++)
+            {
+                size_t position { table_position + field_offsets[i] };
+                field_positions[fields[i].id] = position;
+                switch (fields[i].size)
+                {
+                case 1: builder.set<uint8_t>(position, static_cast<uint8_t>(fields[i].value)); break;
+                case 2: builder.set<uint16_t>(position, static_cast<uint16_t>(fields[i].value)); break;
+                case 4: builder.set<uint32_t>(position, static_cast<uint32_t>(fields[i].value)); break;
+                default: builder.set<int64_t>(position, fields[i].value); break;
+                }
+            }
+
+            return table_position;
+        }
+
+        inline size_t field_position(uint16_t id) const
+        {
+            return field_positions[id];
+        }
+    };
+
+    // Apache Arrow IPC file (Feather v2): one record batch per worker chunk, boolean
+    // columns as bitmaps and no validity buffers.
+    template<size_t all_count, size_t processor_count>
+    class ArrowResultSink : public ResultSink<all_count, processor_count>
+    {
+    private:
+
+        static constexpr int16_t METADATA_VERSION_V5 { 4 };
+        static constexpr uint8_t MESSAGE_HEADER_SCHEMA { 1 };
+        static constexpr uint8_t MESSAGE_HEADER_RECORD_BATCH { 3 };
+        static constexpr uint8_t TYPE_FLOATING_POINT { 3 };
+        static constexpr uint8_t TYPE_BOOL { 6 };
+        static constexpr int16_t PRECISION_DOUBLE { 2 };
+        static constexpr uint32_t CONTINUATION_MARKER { 0xFFFFFFFF };
+        static constexpr size_t PROBABILITY_COLUMN_IDX { 3 };
+        static constexpr size_t COLUMN_COUNT { 4 + 2 * all_count };
+        static constexpr char MAGIC[] { "ARROW1" };
+
+        struct Column
+        {
+            string name;
+            bool is_probability;
+        };
+
+        struct Block
+        {
+            int64_t offset;
+            int64_t metadata_length;
+            int64_t body_length;
+        };
+
+        const path data_file_path;
+        ofstream data_file;
+        vector<Column> columns;
+        vector<Block> blocks;
+        size_t file_offset;
+
+        size_t cached_batch_size;
+        vector<char> batch_metadata;
+        vector<char> batch_body;
+
+    public:
+
+        ArrowResultSink(path data_file_path, const Scheme<all_count, processor_count>& scheme):
+            data_file_path { data_file_path },
+            data_file { data_file_path, std::ios::binary },
+            columns { },
+            blocks { },
+            file_offset { 0 },
+            cached_batch_size { 0 },
+            batch_metadata { }, batch_body { }
+        {
+            if (!data_file.is_open())
+            {
+                string msg { format("Error: can't open data_file {} for writing", data_file_path.string()) };
+                //println(cerr, msg);
+                throw runtime_error(msg);
+            }
+
+            vector<string> element_names { };
+            for (const Processor& processor : scheme.processors)
+                element_names.push_back(processor.name);
+            for (const Element& element : scheme.elements)
+                element_names.push_back(element.name);
+
+            columns.push_back(Column { .name = "scheme_state_sv1", .is_probability = false });
+            columns.push_back(Column { .name = "scheme_state_sv2", .is_probability = false });
+            columns.push_back(Column { .name = "scheme_state", .is_probability = false });
+            columns.push_back(Column { .name = "probability", .is_probability = true });
+            for (const string& name : element_names)
+                columns.push_back(Column { .name = name + "_sv1", .is_probability = false });
+            for (const string& name : element_names)
+                columns.push_back(Column { .name = name + "_sv2", .is_probability = false });
+
+            write_bytes(MAGIC, 6);
+            write_padding(8);
+
+            FlatBufferBuilder builder { };
+            FlatBufferTable message { };
+            message
+                .add_scalar<int16_t>(0, METADATA_VERSION_V5)
+                .add_scalar<uint8_t>(1, MESSAGE_HEADER_SCHEMA)
+                .add_offset(2)
+                .add_scalar<int64_t>(3, 0);
+            builder.set_root(message.write(builder));
+            builder.patch_offset(message.field_position(2), write_schema(builder));
+            write_message(builder.data(), { });
+        }
+
+        const path& get_path() const override
+        {
+            return data_file_path;
+        }
+
+        size_t write_batch(const ScoredStateVectorBatch<all_count, processor_count>& batch) override
+        {
+            if (batch.size == 0)
+                return 0;
+
+            size_t bitmap_size { padded_size((batch.size + 7) / 8) };
+            size_t probability_size { padded_size(batch.size * sizeof(double)) };
+            if (batch.size != cached_batch_size)
+            {
+                batch_metadata = make_record_batch_metadata(batch.size, bitmap_size, probability_size);
+                batch_body.assign((COLUMN_COUNT - 1) * bitmap_size + probability_size, 0);
+                cached_batch_size = batch.size;
+            }
+
+            char* body { batch_body.data() };
+            fill_bitmap(body, batch.size, [&batch](size_t k) { return batch.scheme_state_sv1[k] != 0; });
+            fill_bitmap(body + bitmap_size, batch.size, [&batch](size_t k) { return batch.scheme_state_sv2[k] != 0; });
+            fill_bitmap(body + 2 * bitmap_size, batch.size, [&batch](size_t k) { return batch.scheme_state_sv1[k] != 0 || batch.scheme_state_sv2[k] != 0; });
+            memcpy(body + 3 * bitmap_size, batch.probability.data(), batch.size * sizeof(double));
+            char* element_bitmaps { body + 3 * bitmap_size + probability_size };
+            for (size_t j = 0; j < all_count; j++)
+            {
+                fill_bitmap(element_bitmaps + j * bitmap_size, batch.size, [&batch, j](size_t k) { return batch.sv1[k].sv[j]; });
+                fill_bitmap(element_bitmaps + (all_count + j) * bitmap_size, batch.size, [&batch, j](size_t k) { return batch.sv2[k].sv[j]; });
+            }
+
+            size_t start_offset { file_offset };
+            write_message(batch_metadata, batch_body);
+            return file_offset - start_offset;
+        }
+
+        void close() override
+        {
+            if (!data_file.is_open())
+                return;
+
+            // End-of-stream marker, then the footer that indexes every record batch.
+            write_value<uint32_t>(CONTINUATION_MARKER);
+            write_value<int32_t>(0);
+
+            FlatBufferBuilder builder { };
+            FlatBufferTable footer { };
+            footer
+                .add_scalar<int16_t>(0, METADATA_VERSION_V5)
+                .add_offset(1)
+                .add_offset(2)
+                .add_offset(3);
+            builder.set_root(footer.write(builder));
+            builder.patch_offset(footer.field_position(1), write_schema(builder));
+            builder.patch_offset(footer.field_position(2), builder.add_struct_vector({ }, 3));
+            vector<int64_t> block_words { };
+            for (const Block& block : blocks)
+            {
+                block_words.push_back(block.offset);
+                block_words.push_back(block.metadata_length);
+                block_words.push_back(block.body_length);
+            }
+            builder.patch_offset(footer.field_position(3), builder.add_struct_vector(block_words, 3));
+
+            write_bytes(builder.data().data(), builder.data().size());
+            write_value<int32_t>(static_cast<int32_t>(builder.data().size()));
+            write_bytes(MAGIC, 6);
+            data_file.close();
+        }
+
+    private:
+
+        static size_t padded_size(size_t size)
+        {
+            return (size + 7) / 8 * 8;
+        }
+
+        template<typename Predicate>
+        static void fill_bitmap(char* bitmap, size_t size, Predicate predicate)
+        {
+            for (size_t byte = 0; byte < (size + 7) / 8; byte++)
+            {
+                uint8_t bits { 0 };
+                for (size_t bit = 0; bit < 8 && byte * 8 + bit < size; bit++)
+                    bits |= static_cast<uint8_t>(predicate(byte * 8 + bit) ? 1 : 0) << bit;
+                bitmap[byte] = static_cast<char>(bits);
+            }
+        }
+
+        size_t write_schema(FlatBufferBuilder& builder) const
+        {
+            FlatBufferTable schema { };
+            schema
+                .add_scalar<int16_t>(0, 0)
+                .add_offset(1);
+            size_t schema_position { schema.write(builder) };
+
+            size_t fields_position { builder.add_offset_vector(columns.size()) };
+            builder.patch_offset(schema.field_position(1), fields_position);
+            for (size_t i = 0; i < columns.size(); i++)
+            {
+                FlatBufferTable field { };
+                field
+                    .add_offset(0)
+                    .add_scalar<uint8_t>(1, 0)
+                    .add_scalar<uint8_t>(2, columns[i].is_probability ? TYPE_FLOATING_POINT : TYPE_BOOL)
+                    .add_offset(3)
+                    .add_offset(5);
+                size_t field_position { field.write(builder) };
+                builder.patch_offset(fields_position + sizeof(uint32_t) * (i + 1), field_position);
+
+                builder.patch_offset(field.field_position(0), builder.add_string(columns[i].name));
+
+                FlatBufferTable type { };
+                if (columns[i].is_probability)
+                    type.add_scalar<int16_t>(0, PRECISION_DOUBLE);
+                builder.patch_offset(field.field_position(3), type.write(builder));
+
+                builder.patch_offset(field.field_position(5), builder.add_offset_vector(0));
+            }
+
+            return schema_position;
+        }
+
+        vector<char> make_record_batch_metadata(size_t batch_size, size_t bitmap_size, size_t probability_size) const
+        {
+            FlatBufferBuilder builder { };
+            FlatBufferTable message { };
+            message
+                .add_scalar<int16_t>(0, METADATA_VERSION_V5)
+                .add_scalar<uint8_t>(1, MESSAGE_HEADER_RECORD_BATCH)
+                .add_offset(2)
+                .add_scalar<int64_t>(3, static_cast<int64_t>((COLUMN_COUNT - 1) * bitmap_size + probability_size));
+            builder.set_root(message.write(builder));
+
+            FlatBufferTable record_batch { };
+            record_batch
+                .add_scalar<int64_t>(0, static_cast<int64_t>(batch_size))
+                .add_offset(1)
+                .add_offset(2);
+            builder.patch_offset(message.field_position(2), record_batch.write(builder));
+
+            vector<int64_t> nodes { };
+            vector<int64_t> buffers { };
+            int64_t body_offset { 0 };
+            for (size_t i = 0; i < COLUMN_COUNT; i++)
+            {
+                int64_t data_size { static_cast<int64_t>(i == PROBABILITY_COLUMN_IDX ? probability_size : bitmap_size) };
+                nodes.insert(nodes.end(), { static_cast<int64_t>(batch_size), 0 });
+                buffers.insert(buffers.end(), { body_offset, 0, body_offset, data_size });
+                body_offset += data_size;
+            }
+            builder.patch_offset(record_batch.field_position(1), builder.add_struct_vector(nodes, 2));
+            builder.patch_offset(record_batch.field_position(2), builder.add_struct_vector(buffers, 2));
+
+            return builder.data();
+        }
+
+        void write_message(const vector<char>& metadata, const vector<char>& body)
+        {
+            size_t metadata_size { padded_size(metadata.size()) };
+            Block block
+            {
+                .offset = static_cast<int64_t>(file_offset),
+                .metadata_length = static_cast<int64_t>(2 * sizeof(uint32_t) + metadata_size),
+                .body_length = static_cast<int64_t>(body.size())
+            };
+
+            write_value<uint32_t>(CONTINUATION_MARKER);
+            write_value<int32_t>(static_cast<int32_t>(metadata_size));
+            write_bytes(metadata.data(), metadata.size());
+            write_padding(8);
+            write_bytes(body.data(), body.size());
+
+            if (!body.empty())
+                blocks.push_back(block);
+        }
+
+        template<typename T>
+        void write_value(T value)
+        {
+            write_bytes(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        void write_bytes(const char* data, size_t size)
+        {
+            data_file.write(data, static_cast<std::streamsize>(size));
+            file_offset += size;
+        }
+
+        void write_padding(size_t alignment)
+        {
+            static constexpr array<char, 8> ZEROS { };
+            write_bytes(ZEROS.data(), (alignment - file_offset % alignment) % alignment);
+        }
+    };
+
+    // The bitmap of one run, shared by the sinks of all its workers; the last sink to
+    // close writes the file, unless the run was stopped before visiting every state.
+    class OutcomeBitmapFile
+    {
+    private:
+
+        const path file_path;
+        OutcomeBitmap bitmap;
+        atomic<size_t> open_sink_count;
+        atomic<unsigned long long> visited_state_count;
+
+    public:
+
+        OutcomeBitmapFile(path file_path, size_t all_count, size_t sink_count):
+            file_path { file_path },
+            bitmap { .all_count = all_count, .words = { } },
+            open_sink_count { sink_count },
+            visited_state_count { 0 }
+        {
+            check_outcome_element_count(all_count);
+            bitmap.words.resize(((1ull << all_count) + 63) / 64);
+        }
+
+        const path& get_path() const
+        {
+            return file_path;
+        }
+
+        // Chunks narrower than a word share it with other workers' chunks.
+        void set_states(size_t first_state_index, span<const char> scheme_state_sv2)
+        {
+            unsigned long long word { 0 };
+            for (size_t k = 0; k < scheme_state_sv2.size(); k++)
+            {
+                size_t state_index { first_state_index + k };
+                if (scheme_state_sv2[k])
+                    word |= 1ull << (state_index % 64);
+                if (state_index % 64 == 63 || k + 1 == scheme_state_sv2.size())
+                {
+                    if (word != 0)
+                        atomic_ref<unsigned long long> { bitmap.words[state_index / 64] }.fetch_or(word, memory_order_relaxed);
+                    word = 0;
+                }
+            }
+            visited_state_count.fetch_add(scheme_state_sv2.size(), memory_order_relaxed);
+        }
+
+        void close()
+        {
+            if (open_sink_count.fetch_sub(1, memory_order_acq_rel) == 1 && visited_state_count.load(memory_order_relaxed) == 1ull << bitmap.all_count)
+                write_outcome_bitmap(file_path, bitmap);
+        }
+    };
+
+    template<size_t all_count, size_t processor_count>
+    class BitmapResultSink : public ResultSink<all_count, processor_count>
+    {
+    private:
+
+        shared_ptr<OutcomeBitmapFile> outcome_bitmap_file;
+
+    public:
+
+        BitmapResultSink(shared_ptr<OutcomeBitmapFile> outcome_bitmap_file):
+            outcome_bitmap_file { outcome_bitmap_file }
+        { }
+
+        const path& get_path() const override
+        {
+            return outcome_bitmap_file->get_path();
+        }
+
+        size_t write_batch(const ScoredStateVectorBatch<all_count, processor_count>& batch) override
+        {
+            outcome_bitmap_file->set_states(batch.first_state_index, span<const char> { batch.scheme_state_sv2.data(), batch.size });
+            // The file is written once, on close.
+            return 0;
+        }
+
+        void close() override
+        {
+            outcome_bitmap_file->close();
+        }
+    };
+
+    // States sharing an sv1 processor mask that were reconfigured to the same sv2
+    // processor mask; most_probable_sv1 stands for the pair in reports.
+    template<size_t all_count, size_t processor_count>
+    struct ProcessorMaskPair
+    {
+        unsigned long long sv2_mask;
+        size_t state_count;
+        CompensatedSum probability;
+        CompensatedSum sp;
+        CompensatedSum sq;
+        double most_probable_probability;
+        StateVector<all_count, processor_count> most_probable_sv1;
+
+        void add(const ProcessorMaskPair& other)
+        {
+            state_count += other.state_count;
+            probability.add(other.probability);
+            sp.add(other.sp);
+            sq.add(other.sq);
+            if (other.most_probable_probability > most_probable_probability ||
+                (other.most_probable_probability == most_probable_probability && other.most_probable_sv1.sv > most_probable_sv1.sv))
+            {
+                most_probable_probability = other.most_probable_probability;
+                most_probable_sv1 = other.most_probable_sv1;
+            }
+        }
+    };
+
+    // Processor mask aggregates of one run, shared by the sinks of all its workers:
+    // each sink collects its own pairs and merges them on close. The run writes the
+    // map once its workers are done, since the report needs the reconfiguration table.
+    template<size_t all_count, size_t processor_count>
+    class ProcessorMaskMap
+    {
+    public:
+
+        static constexpr size_t MAX_PROCESSOR_COUNT { 20 };
+
+        // Indexed by sv1 mask, bit i set when processor i works.
+        using Pairs = vector<vector<ProcessorMaskPair<all_count, processor_count>>>;
+
+    private:
+
+        const path file_path;
+        Pairs pairs;
+        mutex pairs_mutex;
+
+    public:
+
+        ProcessorMaskMap(path file_path):
+            file_path { file_path },
+            pairs { make_pairs() },
+            pairs_mutex { }
+        { }
+
+        const path& get_path() const
+        {
+            return file_path;
+        }
+
+        // Only valid after every sink has closed.
+        const Pairs& get_pairs() const
+        {
+            return pairs;
+        }
+
+        static Pairs make_pairs()
+        {
+            if (processor_count > MAX_PROCESSOR_COUNT)
+                throw runtime_error(format("Error: mask maps support up to {} processors", MAX_PROCESSOR_COUNT));
+            return Pairs(static_cast<size_t>(1) << processor_count);
+        }
+
+        static unsigned long long processor_mask(const StateVector<all_count, processor_count>& sv)
+        {
+            unsigned long long mask { 0 };
+            for (size_t i = 0; i < processor_count; i++)
+                if (sv.processors[i])
+                    mask |= 1ull << i;
+            return mask;
+        }
+
+        static void add_state(
+            Pairs& worker_pairs,
+            const StateVector<all_count, processor_count>& sv1,
+            const StateVector<all_count, processor_count>& sv2,
+            double probability,
+            bool scheme_state_sv2
+        ) {
+            ProcessorMaskPair<all_count, processor_count> state
+            {
+                .sv2_mask = processor_mask(sv2),
+                .state_count = 1,
+                .probability = { },
+                .sp = { },
+                .sq = { },
+                .most_probable_probability = probability,
+                .most_probable_sv1 = sv1
+            };
+            state.probability.add(probability);
+            (scheme_state_sv2 ? state.sp : state.sq).add(probability);
+            add_pair(worker_pairs[processor_mask(sv1)], state);
+        }
+
+        void merge(const Pairs& worker_pairs)
+        {
+            lock_guard<mutex> lock { pairs_mutex };
+            for (size_t sv1_mask = 0; sv1_mask < worker_pairs.size(); sv1_mask++)
+                for (const ProcessorMaskPair<all_count, processor_count>& pair : worker_pairs[sv1_mask])
+                    add_pair(pairs[sv1_mask], pair);
+        }
+
+    private:
+
+        // A mask reaches only a handful of sv2 masks, a linear search is enough.
+        static void add_pair(vector<ProcessorMaskPair<all_count, processor_count>>& sv1_pairs, const ProcessorMaskPair<all_count, processor_count>& pair)
+        {
+            for (ProcessorMaskPair<all_count, processor_count>& sv1_pair : sv1_pairs)
+            {
+                if (sv1_pair.sv2_mask == pair.sv2_mask)
+                {
+                    sv1_pair.add(pair);
+                    return;
+                }
+            }
+            sv1_pairs.push_back(pair);
+        }
+    };
+
+    template<size_t all_count, size_t processor_count>
+    class MaskMapResultSink : public ResultSink<all_count, processor_count>
+    {
+    private:
+
+        using MaskMap = ProcessorMaskMap<all_count, processor_count>;
+
+        shared_ptr<MaskMap> processor_mask_map;
+        typename MaskMap::Pairs pairs;
+
+    public:
+
+        MaskMapResultSink(shared_ptr<MaskMap> processor_mask_map):
+            processor_mask_map { processor_mask_map },
+            pairs { MaskMap::make_pairs() }
+        { }
+
+        const path& get_path() const override
+        {
+            return processor_mask_map->get_path();
+        }
+
+        size_t write_batch(const ScoredStateVectorBatch<all_count, processor_count>& batch) override
+        {
+            for (size_t k = 0; k < batch.size; k++)
+                MaskMap::add_state(pairs, batch.sv1[k], batch.sv2[k], batch.probability[k], batch.scheme_state_sv2[k]);
+            return 0;
+        }
+
+        void close() override
+        {
+            processor_mask_map->merge(pairs);
+        }
+    };
+
+    // Bitmap and mask map sinks write into the run's shared file instead of data_file_path.
+    template<size_t all_count, size_t processor_count>
+    unique_ptr<ResultSink<all_count, processor_count>> make_result_sink(
+        OutputFormat output_format,
+        const path& data_file_path,
+        const Scheme<all_count, processor_count>& scheme,
+        const shared_ptr<OutcomeBitmapFile>& outcome_bitmap_file = nullptr,
+        const shared_ptr<ProcessorMaskMap<all_count, processor_count>>& processor_mask_map = nullptr
+    ) {
+        if (output_format == OutputFormat::Arrow)
+            return make_unique<ArrowResultSink<all_count, processor_count>>(data_file_path, scheme);
+        if (output_format == OutputFormat::Bitmap)
+        {
+            if (outcome_bitmap_file == nullptr)
+                throw runtime_error("Error: bitmap output needs the run's outcome bitmap file");
+            return make_unique<BitmapResultSink<all_count, processor_count>>(outcome_bitmap_file);
+        }
+        if (output_format == OutputFormat::MaskMap)
+        {
+            if (processor_mask_map == nullptr)
+                throw runtime_error("Error: mask map output needs the run's processor mask map");
+            return make_unique<MaskMapResultSink<all_count, processor_count>>(processor_mask_map);
+        }
+        return make_unique<SsvResultSink<all_count, processor_count>>(data_file_path);
+    }
+}
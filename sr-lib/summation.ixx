@@ -0,0 +1,140 @@
+export module scheme_reliability:summation;
+
+import std;
+using std::vector;
+using std::atomic, std::memory_order_relaxed;
+using std::fabs;
+using std::min, std::max;
+
+namespace sr_impl::summation
+{
+    // Neumaier's variant of Kahan summation: the low-order bits each addition drops
+    // are collected in compensation and added back when the value is read.
+    struct CompensatedSum
+    {
+        double sum { 0 };
+        double compensation { 0 };
+
+        inline void add(double value)
+        {
+            double total { sum + value };
+            if (fabs(sum) >= fabs(value))
+                compensation += (sum - total) + value;
+            else
+                compensation += (value - total) + sum;
+            sum = total;
+        }
+
+        inline void add(const CompensatedSum& other)
+        {
+            add(other.sum);
+            compensation += other.compensation;
+        }
+
+        inline double value() const
+        {
+            return sum + compensation;
+        }
+    };
+
+    // sp/sq of a run kept per fixed state range: a range is a run of consecutive
+    // chunks that one worker sums in state order, and the ranges are reduced pairwise
+    // in index order. Neither step depends on which worker took which range, so the
+    // totals are bit-identical for any thread count. Large schemes put several chunks
+    // into a range to keep the table at max_range_count entries; tables sharing one
+    // cursor must be built with the same chunk_count and max_range_count.
+    class RangeSums
+    {
+    public:
+
+        static constexpr size_t MAX_RANGE_COUNT { static_cast<size_t>(1) << 16 };
+
+        const size_t chunk_count;
+        const size_t chunks_per_range;
+        const size_t range_count;
+
+    private:
+
+        vector<CompensatedSum> sp;
+        vector<CompensatedSum> sq;
+
+    public:
+
+        RangeSums(size_t chunk_count, size_t max_range_count = MAX_RANGE_COUNT):
+            chunk_count { chunk_count },
+            chunks_per_range { max<size_t>(1, (chunk_count + max_range_count - 1) / max_range_count) },
+            range_count { (chunk_count + chunks_per_range - 1) / chunks_per_range },
+            sp(range_count), sq(range_count)
+        { }
+
+        inline size_t range_idx(size_t chunk_idx) const
+        {
+            return chunk_idx / chunks_per_range;
+        }
+
+        inline bool is_last_chunk_of_range(size_t chunk_idx) const
+        {
+            return (chunk_idx + 1) % chunks_per_range == 0 || chunk_idx + 1 == chunk_count;
+        }
+
+        // Only the worker that owns the chunk's range may call this, in chunk order.
+        inline void add_chunk(size_t chunk_idx, const CompensatedSum& chunk_sp, const CompensatedSum& chunk_sq)
+        {
+            sp[range_idx(chunk_idx)].add(chunk_sp);
+            sq[range_idx(chunk_idx)].add(chunk_sq);
+        }
+
+        double total_sp() const
+        {
+            return pairwise_sum(sp, 0, range_count);
+        }
+
+        double total_sq() const
+        {
+            return pairwise_sum(sq, 0, range_count);
+        }
+
+    private:
+
+        static double pairwise_sum(const vector<CompensatedSum>& sums, size_t first, size_t count)
+        {
+            if (count == 1)
+                return sums[first].value();
+            size_t half { count / 2 };
+            return pairwise_sum(sums, first, half) + pairwise_sum(sums, first + half, count - half);
+        }
+    };
+
+    // A worker's view of a shared chunk counter that hands out whole ranges: chunks
+    // come one at a time, a new range is claimed when the current one is used up.
+    class RangeCursor
+    {
+    private:
+
+        const RangeSums& range_sums;
+        atomic<size_t>& next_range;
+
+        size_t next_chunk;
+        size_t end_chunk;
+
+    public:
+
+        RangeCursor(const RangeSums& range_sums, atomic<size_t>& next_range):
+            range_sums { range_sums }, next_range { next_range }, next_chunk { 0 }, end_chunk { 0 }
+        { }
+
+        // chunk_count once every range has been claimed.
+        size_t next_chunk_idx()
+        {
+            if (next_chunk == end_chunk)
+            {
+                size_t range_idx { next_range.fetch_add(1, memory_order_relaxed) };
+                if (range_idx >= range_sums.range_count)
+                    return range_sums.chunk_count;
+                next_chunk = range_idx * range_sums.chunks_per_range;
+                end_chunk = min(range_sums.chunk_count, next_chunk + range_sums.chunks_per_range);
+            }
+            return next_chunk++;
+        }
+    };
+}
@@ -0,0 +1,183 @@
+module;
+
+// Build with SR_TRACE defined (CMake -DSR_TRACE=ON, MSBuild /p:SrTrace=true) to record pipeline
+// spans; without it every span compiles to nothing.
+#if defined(SR_TRACE)
+#define SR_TRACE_ENABLED true
+#else
+#define SR_TRACE_ENABLED false
+#endif
+
+export module scheme_reliability:trace;
+
+import std;
+using std::atomic, std::memory_order_relaxed, std::memory_order_release, std::memory_order_acquire;
+using std::string;
+using std::vector;
+using std::unique_ptr, std::make_unique;
+using std::mutex, std::lock_guard;
+using std::ofstream;
+using std::filesystem::path;
+using std::format;
+using std::runtime_error;
+using std::min;
+using std::move;
+using std::chrono::steady_clock;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+
+namespace sr_impl::trace
+{
+    constexpr bool TRACE_ENABLED { SR_TRACE_ENABLED };
+
+    struct TraceEvent
+    {
+        const char* name;
+        unsigned long long start_ns;
+        unsigned long long duration_ns;
+    };
+
+    class TraceBuffer
+    {
+    private:
+
+        static constexpr size_t CAPACITY { 1 << 17 };
+
+        const string thread_name;
+        unique_ptr<TraceEvent[]> events;
+        atomic<size_t> head;
+
+    public:
+
+        TraceBuffer(string thread_name):
+            thread_name { move(thread_name) },
+            events { new TraceEvent[CAPACITY] },
+            head { 0 }
+        { }
+
+        inline const string& get_thread_name() const
+        {
+            return thread_name;
+        }
+
+        // Single producer ring: the owning thread overwrites the oldest spans once the buffer is full.
+        inline void push(const TraceEvent& event)
+        {
+            size_t current { head.load(memory_order_relaxed) };
+            events[current & (CAPACITY - 1)] = event;
+            head.store(current + 1, memory_order_release);
+        }
+
+        template<typename Action>
+        void for_each_event(Action action) const
+        {
+            size_t end { head.load(memory_order_acquire) };
+            size_t begin { end - min(end, CAPACITY) };
+            for (size_t i = begin; i < end; i++)
+                action(events[i & (CAPACITY - 1)]);
+        }
+    };
+
+    class Tracer
+    {
+    private:
+
+        const steady_clock::time_point origin;
+
+        mutex buffers_mutex;
+        vector<unique_ptr<TraceBuffer>> buffers;
+
+    public:
+
+        Tracer():
+            origin { steady_clock::now() },
+            buffers_mutex { },
+            buffers { }
+        { }
+
+        Tracer(const Tracer&) = delete;
+        Tracer& operator=(const Tracer&) = delete;
+
+        TraceBuffer* register_thread(string thread_name)
+        {
+            if constexpr (!TRACE_ENABLED)
+                return nullptr;
+
+            lock_guard<mutex> lock { buffers_mutex };
+            buffers.push_back(make_unique<TraceBuffer>(move(thread_name)));
+            return buffers.back().get();
+        }
+
+        inline unsigned long long now_ns() const
+        {
+            return static_cast<unsigned long long>(duration_cast<nanoseconds>(steady_clock::now() - origin).count());
+        }
+
+        // Call after every traced thread has been joined.
+        void write_chrome_trace(const path& trace_path)
+        {
+            if constexpr (!TRACE_ENABLED)
+                return;
+
+            ofstream trace_file { trace_path, std::ios::trunc };
+            if (!trace_file.is_open())
+                throw runtime_error(format("Error: can't open trace_file {} for writing", trace_path.string()));
+
+            lock_guard<mutex> lock { buffers_mutex };
+            trace_file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+            bool is_first { true };
+            for (size_t tid = 0; tid < buffers.size(); tid++)
+            {
+                trace_file << format(
+                    "{}\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+                    is_first ? "" : ",", tid, buffers[tid]->get_thread_name()
+                );
+                is_first = false;
+
+                buffers[tid]->for_each_event(
+                    [&trace_file, tid](const TraceEvent& event)
+                    {
+                        trace_file << format(
+                            ",\n{{\"name\":\"{}\",\"cat\":\"sr\",\"ph\":\"X\",\"pid\":0,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                            event.name, tid,
+                            static_cast<double>(event.start_ns) * 1e-3,
+                            static_cast<double>(event.duration_ns) * 1e-3
+                        );
+                    }
+                );
+            }
+            trace_file << "\n]}\n";
+        }
+    };
+
+    class TraceSpan
+    {
+    private:
+
+        TraceBuffer* const buffer;
+        const Tracer& tracer;
+        const char* const name;
+        const unsigned long long start_ns;
+
+    public:
+
+        TraceSpan(TraceBuffer* buffer, const Tracer& tracer, const char* name):
+            buffer { buffer },
+            tracer { tracer },
+            name { name },
+            start_ns { TRACE_ENABLED ? tracer.now_ns() : 0 }
+        { }
+
+        ~TraceSpan()
+        {
+            if constexpr (TRACE_ENABLED)
+            {
+                unsigned long long end_ns { tracer.now_ns() };
+                buffer->push(TraceEvent { .name = name, .start_ns = start_ns, .duration_ns = end_ns - start_ns });
+            }
+        }
+
+        TraceSpan(const TraceSpan&) = delete;
+        TraceSpan& operator=(const TraceSpan&) = delete;
+    };
+}
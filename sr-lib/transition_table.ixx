@@ -0,0 +1,196 @@
+export module scheme_reliability:transition_table;
+
+import :model;
+using namespace sr_impl::model;
+
+import std;
+using std::vector;
+using std::span;
+using std::find_if;
+using std::sort;
+
+namespace sr_impl::transition_table
+{
+    struct NormalizedTransitionTable
+    {
+        vector<TransitionSet> table;
+        TransitionNormalizationReport report;
+    };
+
+    // Shrinks the transition tables the brute force search branches over without
+    // changing which states it recovers, as long as the scheme function is monotone:
+    //  - identical transitions, as per-target loads, and empty transitions are kept once;
+    //  - a transition is dominated by another over the same targets with no larger
+    //    loads, or over a subset of its targets once the table holds an empty
+    //    transition, so the search never loses the option to leave the processor
+    //    failed. The dominating one is valid whenever the dominated one is, loads no
+    //    processor more and succeeds whenever the dominated one does.
+    // With is_dropping_impossible_transitions, an impossible transition (a target
+    // overloaded from its normal load alone, or the failed processor itself as a
+    // target) is replaced by one empty transition, taken as "leave the processor
+    // failed" in every state. Applied, such a transition switches its target off, so
+    // this may recover states the declared table loses.
+    class TransitionTableNormalizer
+    {
+    private:
+
+        const span<const Processor> processors;
+        const BruteForceOptions options;
+
+        NormalizedTransitionTable result;
+
+    public:
+
+        TransitionTableNormalizer(span<const Processor> processors, const BruteForceOptions& options):
+            processors { processors },
+            options { options },
+            result { .table = { }, .report = { .transition_count = 0, .kept_transition_count = 0, .removed_transitions = { } } }
+        { }
+
+        NormalizedTransitionTable normalize()
+        {
+            for (size_t i = 0; i < processors.size(); i++)
+                result.table.push_back(normalize_processor(i));
+            return result;
+        }
+
+    private:
+
+        TransitionSet normalize_processor(size_t processor_idx)
+        {
+            const TransitionSet& transitions { processors[processor_idx].transitions };
+            result.report.transition_count += transitions.size();
+            if (!options.is_pruning_transitions && !options.is_dropping_impossible_transitions)
+            {
+                result.report.kept_transition_count += transitions.size();
+                return transitions;
+            }
+
+            vector<bool> is_kept(transitions.size(), true);
+            bool has_placeholder { false };
+            for (size_t t = 0; t < transitions.size(); t++)
+            {
+                if (transitions[t].empty())
+                {
+                    if (has_placeholder)
+                        remove(processor_idx, t, TransitionRemovalReason::Duplicate, is_kept);
+                    has_placeholder = true;
+                }
+                else if (options.is_dropping_impossible_transitions && is_impossible(processor_idx, transitions[t]))
+                {
+                    remove(processor_idx, t, TransitionRemovalReason::Impossible, is_kept);
+                    has_placeholder = true;
+                }
+            }
+
+            if (options.is_pruning_transitions)
+            {
+                vector<Transition> target_loads { };
+                for (const Transition& transition : transitions)
+                    target_loads.push_back(merge_targets(transition));
+
+                for (size_t t = 0; t < transitions.size(); t++)
+                    for (size_t u = 0; u < t && is_kept[t]; u++)
+                        if (is_kept[u] && !transitions[t].empty() && dominates(target_loads[u], target_loads[t]) && dominates(target_loads[t], target_loads[u]))
+                            remove(processor_idx, t, TransitionRemovalReason::Duplicate, is_kept);
+
+                for (size_t t = 0; t < transitions.size(); t++)
+                    for (size_t u = 0; u < transitions.size() && is_kept[t]; u++)
+                        if (u != t && is_kept[u] && !transitions[u].empty() && dominates(target_loads[u], target_loads[t]) &&
+                            (has_placeholder || target_loads[u].size() == target_loads[t].size()))
+                            remove(processor_idx, t, TransitionRemovalReason::Dominated, is_kept);
+            }
+
+            TransitionSet normalized { };
+            for (size_t t = 0; t < transitions.size(); t++)
+                if (is_kept[t] && !transitions[t].empty())
+                    normalized.push_back(transitions[t]);
+            // A table left with the placeholder alone never reconfigures the processor.
+            if (has_placeholder && !normalized.empty())
+                normalized.push_back(Transition { });
+
+            result.report.kept_transition_count += normalized.size();
+            return normalized;
+        }
+
+        bool is_impossible(size_t processor_idx, const Transition& transition) const
+        {
+            for (const IdxL& unit : transition)
+                if (unit.index == processor_idx ||
+                    processors[unit.index].normal_load + unit.load > processors[unit.index].max_load)
+                    return true;
+            return false;
+        }
+
+        // One unit per target, sorted by index, with the loads of its repeats summed,
+        // which is how a transition loads its targets.
+        static Transition merge_targets(const Transition& transition)
+        {
+            Transition merged { };
+            for (const IdxL& unit : transition)
+            {
+                auto it { find_if(merged.begin(), merged.end(), [&unit](const IdxL& other) { return other.index == unit.index; }) };
+                if (it == merged.end())
+                    merged.push_back(unit);
+                else
+                    it->load += unit.load;
+            }
+            sort(merged.begin(), merged.end(), [](const IdxL& a, const IdxL& b) { return a.index < b.index; });
+            return merged;
+        }
+
+        // Every target of a is a target of b taking at least the same load, so a is
+        // valid and successful whenever b is and loads no processor more. Both are
+        // merged per target.
+        static bool dominates(const Transition& a, const Transition& b)
+        {
+            if (a.size() > b.size())
+                return false;
+            for (const IdxL& unit : a)
+            {
+                bool is_covered { false };
+                for (const IdxL& other : b)
+                    if (other.index == unit.index && unit.load <= other.load)
+                        is_covered = true;
+                if (!is_covered)
+                    return false;
+            }
+            return true;
+        }
+
+        void remove(size_t processor_idx, size_t transition_idx, TransitionRemovalReason reason, vector<bool>& is_kept)
+        {
+            is_kept[transition_idx] = false;
+            result.report.removed_transitions.push_back(RemovedTransition
+            {
+                .processor_idx = processor_idx,
+                .transition_idx = transition_idx,
+                .transition = processors[processor_idx].transitions[transition_idx],
+                .reason = reason
+            });
+        }
+    };
+
+    NormalizedTransitionTable normalize_transition_table(span<const Processor> processors, const BruteForceOptions& options)
+    {
+        TransitionTableNormalizer normalizer { processors, options };
+        return normalizer.normalize();
+    }
+
+    template<size_t all_count, size_t processor_count>
+    NormalizedTransitionTable normalize_transition_table(const Scheme<all_count, processor_count>& scheme)
+    {
+        return normalize_transition_table(scheme.processors, scheme.brute_options);
+    }
+
+    // Dominance only holds for a monotone scheme function, so an expression with a
+    // negation is never pruned.
+    NormalizedTransitionTable normalize_transition_table(const DynamicScheme& scheme)
+    {
+        BruteForceOptions options { scheme.brute_options };
+        for (const ExpressionOp& op : scheme.scheme_expression)
+            if (op.code == ExpressionOpCode::Not)
+                options.is_pruning_transitions = false;
+        return normalize_transition_table(scheme.processors, options);
+    }
+}
@@ -0,0 +1,701 @@
+export module scheme_reliability:variants;
+
+import :model;
+using namespace sr_impl::model;
+
+import :control;
+using namespace sr_impl::control;
+
+import :sink;
+using namespace sr_impl::sink;
+
+import :algorithm;
+using namespace sr_impl::algorithm;
+
+import :summation;
+using namespace sr_impl::summation;
+
+import std;
+using std::array;
+using std::vector;
+using std::span;
+using std::string;
+using std::unique_ptr;
+using std::shared_ptr, std::make_shared;
+using std::ofstream;
+using std::filesystem::path;
+using std::filesystem::exists, std::filesystem::remove_all, std::filesystem::create_directory;
+using std::runtime_error;
+using std::format;
+using std::vformat, std::make_format_args;
+using std::thread;
+using std::atomic;
+using std::min, std::max, std::clamp;
+using std::move;
+using std::chrono::steady_clock;
+
+namespace sr_impl::variants
+{
+    // Fills sv1 and probability with the Chunk::size states of one chunk, in the
+    // order of the calculator's producer.
+    template<size_t all_count, size_t processor_count>
+    void enumerate_chunk_states(
+        size_t chunk_idx,
+        const array<double, all_count>& p,
+        const array<double, all_count>& q,
+        vector<StateVector<all_count, processor_count>>& sv1,
+        vector<double>& probability
+    ) {
+        using Chunk = StateVectorChunk<all_count, processor_count>;
+        for (size_t k = 0; k < Chunk::size; k++)
+        {
+            size_t state_idx { chunk_idx * Chunk::size + k };
+            double state_probability { 1.0 };
+            for (size_t i = 0; i < all_count; i++)
+            {
+                sv1[k].all[i] = ((state_idx >> (all_count - 1 - i)) & 1) == 0;
+                state_probability *= sv1[k].all[i] ? p[i] : q[i];
+            }
+            probability[k] = state_probability;
+        }
+    }
+
+    template<size_t all_count, size_t processor_count>
+    void fill_element_probabilities(
+        const Scheme<all_count, processor_count>& scheme,
+        array<double, all_count>& p,
+        array<double, all_count>& q
+    ) {
+        for (size_t i = 0; i < processor_count; i++)
+        {
+            p[i] = scheme.processors[i].p;
+            q[i] = scheme.processors[i].q;
+        }
+        for (size_t i = processor_count; i < all_count; i++)
+        {
+            p[i] = scheme.elements[i - processor_count].p;
+            q[i] = scheme.elements[i - processor_count].q;
+        }
+    }
+
+    // Marks a summary partial when fewer than state_count states were visited.
+    template<size_t all_count>
+    void finish_summary(
+        SchemeReliabilitySummary& summary,
+        size_t state_count,
+        const array<double, all_count>& p,
+        const array<double, all_count>& q
+    ) {
+        double probability_mass { 1.0 };
+        for (size_t i = 0; i < all_count; i++)
+            probability_mass *= p[i] + q[i];
+
+        summary.is_partial = summary.state_vector_set_count < state_count;
+        summary.sp_low = summary.sp;
+        summary.sp_high = summary.sp;
+        if (summary.is_partial)
+        {
+            summary.unvisited_probability = max(0.0, probability_mass - summary.sp - summary.sq);
+            summary.sp_high = min(1.0, summary.sp + summary.unvisited_probability);
+        }
+    }
+
+    // Evaluates several schemes over the same elements in one enumeration: each state
+    // and its probability are produced once, then reconfigured and scored by every
+    // variant. Variants may differ in transition tables, loads, scheme function and
+    // type; names and p/q of every element must match.
+    template<size_t all_count, size_t processor_count>
+    class MultiVariantReliabilityCalculator
+    {
+    private:
+
+        using Chunk = StateVectorChunk<all_count, processor_count>;
+
+        const string BINARY_SCORED_STATE_SET_DATA_EXTENSION { "ssv" };
+        const string ARROW_SCORED_STATE_SET_DATA_EXTENSION { "arrow" };
+        const string DATA_FILE_NAME_FORMAT { "{}/{}-{}.{}" };
+        const string ELEMENTS_FILE_NAME_FORMAT { "{}/{}.elems" };
+        const string OUTCOME_FILE_NAME_FORMAT { "{}/{}.outcome" };
+        const string MASK_MAP_FILE_NAME_FORMAT { "{}/{}.masks.csv" };
+
+        static constexpr size_t chunk_count { static_cast<size_t>(1) << (all_count - Chunk::depth) };
+
+        const span<const Scheme<all_count, processor_count>> variants;
+
+        array<double, all_count> p;
+        array<double, all_count> q;
+
+        vector<unique_ptr<ReconfigurationTable<all_count, processor_count>>> reconfiguration_tables;
+
+        struct WorkerState
+        {
+            vector<unique_ptr<ResultSink<all_count, processor_count>>> result_sinks;
+            vector<ScoredStateVectorBatch<all_count, processor_count>> batches;
+            vector<SchemeReliabilitySummary> summaries;
+            // Per variant pair, a < b, in (a, b) order.
+            vector<size_t> pairwise_state_counts;
+            vector<CompensatedSum> chunk_pairwise_probabilities;
+            size_t disagreement_state_count;
+            CompensatedSum chunk_disagreement_probability;
+        };
+
+        // Tables sharing the cursor: one per variant, one per variant pair and the
+        // disagreement one, kept within MAX_RANGE_SUM_COUNT entries together.
+        static constexpr size_t MAX_RANGE_SUM_COUNT { static_cast<size_t>(1) << 20 };
+
+    public:
+
+        MultiVariantReliabilityCalculator(span<const Scheme<all_count, processor_count>> variants):
+            variants { variants },
+            p { }, q { },
+            reconfiguration_tables { }
+        {
+            if (variants.empty())
+                throw runtime_error("Error: no scheme variants to evaluate");
+
+            const Scheme<all_count, processor_count>& first { variants.front() };
+            for (size_t v = 1; v < variants.size(); v++)
+            {
+                const Scheme<all_count, processor_count>& variant { variants[v] };
+                for (size_t i = 0; i < processor_count; i++)
+                    if (!is_same_element(first.processors[i].name, first.processors[i].p, first.processors[i].q,
+                                         variant.processors[i].name, variant.processors[i].p, variant.processors[i].q))
+                        throw element_mismatch(variant, first.processors[i].name);
+                for (size_t i = 0; i < all_count - processor_count; i++)
+                    if (!is_same_element(first.elements[i].name, first.elements[i].p, first.elements[i].q,
+                                         variant.elements[i].name, variant.elements[i].p, variant.elements[i].q))
+                        throw element_mismatch(variant, first.elements[i].name);
+                for (size_t u = 0; u < v; u++)
+                    if (variants[u].scheme_name == variant.scheme_name)
+                        throw runtime_error(format("Error: scheme variants share the name {}", variant.scheme_name));
+            }
+
+            fill_element_probabilities(first, p, q);
+            for (const Scheme<all_count, processor_count>& variant : variants)
+                reconfiguration_tables.push_back(make_reconfiguration_table(variant));
+        }
+
+        MultiVariantSummary calculate(const CalculationOptions& options)
+        {
+            RunControl run_control { options, steady_clock::now() };
+            size_t thread_count { options.thread_count == 0 ? thread::hardware_concurrency() : options.thread_count };
+            const string& data_extension
+            {
+                options.output_format == OutputFormat::Arrow
+                    ? ARROW_SCORED_STATE_SET_DATA_EXTENSION
+                    : BINARY_SCORED_STATE_SET_DATA_EXTENSION
+            };
+
+            for (const Scheme<all_count, processor_count>& variant : variants)
+                if (!is_valid_scheme_name(variant.scheme_name))
+                    throw runtime_error(format("Error: scheme name '{}' is not a plain directory name", variant.scheme_name));
+            for (const Scheme<all_count, processor_count>& variant : variants)
+            {
+                path scheme_result_path { variant.scheme_name };
+                if (exists(scheme_result_path))
+                    remove_all(scheme_result_path);
+                create_directory(scheme_result_path);
+                write_scheme_elements_info(variant);
+            }
+
+            vector<shared_ptr<OutcomeBitmapFile>> outcome_bitmap_files { };
+            for (const Scheme<all_count, processor_count>& variant : variants)
+                outcome_bitmap_files.push_back(
+                    options.output_format == OutputFormat::Bitmap
+                        ? make_shared<OutcomeBitmapFile>(
+                            path { vformat(OUTCOME_FILE_NAME_FORMAT, make_format_args(variant.scheme_name, variant.scheme_name)) },
+                            all_count, thread_count
+                        )
+                        : nullptr
+                );
+
+            vector<shared_ptr<ProcessorMaskMap<all_count, processor_count>>> processor_mask_maps { };
+            for (const Scheme<all_count, processor_count>& variant : variants)
+                processor_mask_maps.push_back(
+                    options.output_format == OutputFormat::MaskMap
+                        ? make_shared<ProcessorMaskMap<all_count, processor_count>>(
+                            path { vformat(MASK_MAP_FILE_NAME_FORMAT, make_format_args(variant.scheme_name, variant.scheme_name)) }
+                        )
+                        : nullptr
+                );
+
+            vector<WorkerState> workers(thread_count);
+            for (size_t w = 0; w < thread_count; w++)
+            {
+                WorkerState& worker { workers[w] };
+                for (size_t v = 0; v < variants.size(); v++)
+                {
+                    const Scheme<all_count, processor_count>& variant { variants[v] };
+                    path data_file_path
+                    {
+                        vformat(DATA_FILE_NAME_FORMAT, make_format_args(variant.scheme_name, variant.scheme_name, w, data_extension))
+                    };
+                    worker.result_sinks.push_back(make_result_sink(options.output_format, data_file_path, variant, outcome_bitmap_files[v], processor_mask_maps[v]));
+                    worker.batches.emplace_back(Chunk::size);
+                    worker.summaries.push_back(SchemeReliabilitySummary
+                    {
+                        .sp = 0, .sq = 0,
+                        .state_vector_set_count = 0,
+                        .result_path = path { variant.scheme_name },
+                        .thread_count = thread_count
+                    });
+                }
+                worker.pairwise_state_counts.assign(pair_count(), 0);
+                worker.chunk_pairwise_probabilities.assign(pair_count(), CompensatedSum { });
+                worker.disagreement_state_count = 0;
+                worker.chunk_disagreement_probability = { };
+            }
+
+            size_t max_range_count { clamp<size_t>(MAX_RANGE_SUM_COUNT / (variants.size() + pair_count() + 1), 1, RangeSums::MAX_RANGE_COUNT) };
+            vector<RangeSums> variant_sums(variants.size(), RangeSums { chunk_count, max_range_count });
+            // Only the sp side of these is used: the probability of the disagreeing states.
+            vector<RangeSums> pairwise_sums(pair_count(), RangeSums { chunk_count, max_range_count });
+            RangeSums disagreement_sums { chunk_count, max_range_count };
+            atomic<size_t> next_range { 0 };
+            vector<thread> threads { };
+            for (WorkerState& worker : workers)
+                threads.emplace_back([this, &worker, &variant_sums, &pairwise_sums, &disagreement_sums, &next_range, &run_control]()
+                {
+                    RangeCursor cursor { variant_sums.front(), next_range };
+                    process_chunks(worker, cursor, variant_sums, pairwise_sums, disagreement_sums, run_control);
+                });
+            for (thread& worker_thread : threads)
+                worker_thread.join();
+
+            for (size_t v = 0; v < variants.size(); v++)
+                if (processor_mask_maps[v] != nullptr)
+                    write_processor_mask_map(*processor_mask_maps[v], variants[v], *reconfiguration_tables[v]);
+
+            return merge_worker_states(workers, variant_sums, pairwise_sums, disagreement_sums);
+        }
+
+    private:
+
+        size_t pair_count() const
+        {
+            return variants.size() * (variants.size() - 1) / 2;
+        }
+
+        static bool is_same_element(const string& a_name, double a_p, double a_q, const string& b_name, double b_p, double b_q)
+        {
+            return a_name == b_name && a_p == b_p && a_q == b_q;
+        }
+
+        static runtime_error element_mismatch(const Scheme<all_count, processor_count>& variant, const string& name)
+        {
+            return runtime_error(format("Error: variant {} differs from the first variant at element {}", variant.scheme_name, name));
+        }
+
+        void process_chunks(
+            WorkerState& worker,
+            RangeCursor& cursor,
+            vector<RangeSums>& variant_sums,
+            vector<RangeSums>& pairwise_sums,
+            RangeSums& disagreement_sums,
+            RunControl& run_control
+        ) {
+            const size_t variant_count { variants.size() };
+            vector<StateVector<all_count, processor_count>> sv1(Chunk::size);
+            vector<double> probability(Chunk::size);
+
+            while (!run_control.poll())
+            {
+                size_t chunk_idx { cursor.next_chunk_idx() };
+                if (chunk_idx >= chunk_count)
+                    break;
+
+                enumerate_chunk_states(chunk_idx, p, q, sv1, probability);
+
+                for (size_t v = 0; v < variant_count; v++)
+                {
+                    const ReconfigurationTable<all_count, processor_count>& reconfiguration_table { *reconfiguration_tables[v] };
+                    const SchemeFunction<all_count, processor_count>& scheme_function { variants[v].scheme_function };
+                    ScoredStateVectorBatch<all_count, processor_count>& batch { worker.batches[v] };
+                    SchemeReliabilitySummary& summary { worker.summaries[v] };
+
+                    CompensatedSum chunk_sp { };
+                    CompensatedSum chunk_sq { };
+                    batch.size = Chunk::size;
+                    batch.first_state_index = chunk_idx * Chunk::size;
+                    for (size_t k = 0; k < Chunk::size; k++)
+                    {
+                        batch.sv1[k] = sv1[k];
+                        batch.probability[k] = probability[k];
+                        batch.is_reconfigured[k] = reconfiguration_table.requires_reconfiguration(sv1[k]);
+                        batch.sv2[k] = batch.is_reconfigured[k] ? reconfiguration_table.reconfigure_state(sv1[k]) : sv1[k];
+                        batch.scheme_state_sv1[k] = scheme_function(batch.sv1[k]);
+                        batch.scheme_state_sv2[k] = batch.is_reconfigured[k] ? scheme_function(batch.sv2[k]) : batch.scheme_state_sv1[k];
+
+                        if (batch.scheme_state_sv2[k])
+                            chunk_sp.add(probability[k]);
+                        else
+                            chunk_sq.add(probability[k]);
+                    }
+                    variant_sums[v].add_chunk(chunk_idx, chunk_sp, chunk_sq);
+                    worker.result_sinks[v]->write_batch(batch);
+                    summary.state_vector_set_count += Chunk::size;
+                }
+
+                count_disagreements(worker);
+                for (size_t pair = 0; pair < pair_count(); pair++)
+                {
+                    pairwise_sums[pair].add_chunk(chunk_idx, worker.chunk_pairwise_probabilities[pair], CompensatedSum { });
+                    worker.chunk_pairwise_probabilities[pair] = { };
+                }
+                disagreement_sums.add_chunk(chunk_idx, worker.chunk_disagreement_probability, CompensatedSum { });
+                worker.chunk_disagreement_probability = { };
+            }
+
+            for (unique_ptr<ResultSink<all_count, processor_count>>& result_sink : worker.result_sinks)
+                result_sink->close();
+        }
+
+        void count_disagreements(WorkerState& worker) const
+        {
+            const size_t variant_count { variants.size() };
+            for (size_t k = 0; k < Chunk::size; k++)
+            {
+                bool is_disagreement { false };
+                size_t pair { 0 };
+                for (size_t a = 0; a < variant_count; a++)
+                {
+                    for (size_t b = a + 1; b < variant_count; b++, pair++)
+                    {
+                        if (worker.batches[a].scheme_state_sv2[k] == worker.batches[b].scheme_state_sv2[k])
+                            continue;
+                        worker.pairwise_state_counts[pair]++;
+                        worker.chunk_pairwise_probabilities[pair].add(worker.batches[a].probability[k]);
+                        is_disagreement = true;
+                    }
+                }
+                if (is_disagreement)
+                {
+                    worker.disagreement_state_count++;
+                    worker.chunk_disagreement_probability.add(worker.batches[0].probability[k]);
+                }
+            }
+        }
+
+        MultiVariantSummary merge_worker_states(
+            const vector<WorkerState>& workers,
+            const vector<RangeSums>& variant_sums,
+            const vector<RangeSums>& pairwise_sums,
+            const RangeSums& disagreement_sums
+        ) const {
+            const size_t variant_count { variants.size() };
+            MultiVariantSummary result
+            {
+                .variants = workers.front().summaries,
+                .disagreement_state_count = 0,
+                .disagreement_probability = disagreement_sums.total_sp(),
+                .pairwise_disagreements = { }
+            };
+            for (size_t v = 0; v < variant_count; v++)
+            {
+                result.variants[v].sp = variant_sums[v].total_sp();
+                result.variants[v].sq = variant_sums[v].total_sq();
+                result.variants[v].state_vector_set_count = 0;
+            }
+
+            for (const WorkerState& worker : workers)
+            {
+                for (size_t v = 0; v < variant_count; v++)
+                {
+                    result.variants[v].state_vector_set_count += worker.summaries[v].state_vector_set_count;
+                }
+                result.disagreement_state_count += worker.disagreement_state_count;
+            }
+
+            for (SchemeReliabilitySummary& summary : result.variants)
+                finish_summary(summary, chunk_count * Chunk::size, p, q);
+
+            size_t pair { 0 };
+            for (size_t a = 0; a < variant_count; a++)
+            {
+                for (size_t b = a + 1; b < variant_count; b++, pair++)
+                {
+                    VariantDisagreement disagreement
+                    {
+                        .first_variant_idx = a,
+                        .second_variant_idx = b,
+                        .state_count = 0,
+                        .probability = pairwise_sums[pair].total_sp()
+                    };
+                    for (const WorkerState& worker : workers)
+                        disagreement.state_count += worker.pairwise_state_counts[pair];
+                    result.pairwise_disagreements.push_back(disagreement);
+                }
+            }
+            return result;
+        }
+
+        void write_scheme_elements_info(const Scheme<all_count, processor_count>& scheme) const
+        {
+            path element_file_path { vformat(ELEMENTS_FILE_NAME_FORMAT, make_format_args(scheme.scheme_name, scheme.scheme_name)) };
+            ofstream elements_file { element_file_path, std::ios::trunc };
+            if (!elements_file.is_open())
+                throw runtime_error(format("Error: can't open elements_file {} for writing", element_file_path.string()));
+
+            for (const Processor& element : scheme.processors)
+                elements_file << element.name << ",";
+
+            elements_file << scheme.elements.front().name;
+            for (auto it = scheme.elements.begin() + 1; it != scheme.elements.end(); it++)
+                elements_file << "," << it->name;
+        }
+    };
+
+    // Runs the greedy and the brute force table on every state of one enumeration.
+    // Greedy's choice of transitions is one of the leaves brute force searches, so a
+    // state greedy keeps working is working under brute force as well; brute force
+    // only runs on the states greedy loses.
+    template<size_t all_count, size_t processor_count>
+    class ReconfigurationStrategyComparator
+    {
+        static_assert(processor_count <= 20, "divergence is tallied per processor mask");
+
+    private:
+
+        using Chunk = StateVectorChunk<all_count, processor_count>;
+
+        static constexpr size_t chunk_count { static_cast<size_t>(1) << (all_count - Chunk::depth) };
+        static constexpr size_t mask_count { static_cast<size_t>(1) << processor_count };
+
+        const Scheme<all_count, processor_count>& scheme;
+
+        array<double, all_count> p;
+        array<double, all_count> q;
+
+        GreedyReconfigurationTable<all_count, processor_count> greedy_table;
+        BruteForceReconfigurationTable<all_count, processor_count> brute_table;
+
+        struct WorkerState
+        {
+            SchemeReliabilitySummary greedy;
+            SchemeReliabilitySummary brute;
+            size_t skipped_brute_count;
+            vector<size_t> divergent_state_counts;
+            // The current chunk's divergent probability per mask and the masks it touched.
+            vector<CompensatedSum> chunk_divergent_probabilities;
+            vector<bool> is_touched;
+            vector<size_t> touched_masks;
+        };
+
+        // The divergent probability of one mask within one chunk. A range's list is
+        // filled in chunk order by the worker that claimed the range, so the lists
+        // reduce in the same order for any thread count; divergence is rare, so they
+        // stay far smaller than a table per mask.
+        struct ChunkDivergence
+        {
+            size_t mask;
+            CompensatedSum probability;
+        };
+
+    public:
+
+        ReconfigurationStrategyComparator(const Scheme<all_count, processor_count>& scheme):
+            scheme { scheme },
+            p { }, q { },
+            greedy_table { scheme },
+            brute_table { scheme }
+        {
+            fill_element_probabilities(scheme, p, q);
+        }
+
+        StrategyComparison compare(const CalculationOptions& options, size_t top_mask_count)
+        {
+            RunControl run_control { options, steady_clock::now() };
+            size_t thread_count { options.thread_count == 0 ? thread::hardware_concurrency() : options.thread_count };
+
+            vector<WorkerState> workers(thread_count, WorkerState
+            {
+                .greedy = { .sp = 0, .sq = 0, .state_vector_set_count = 0, .result_path = { }, .thread_count = thread_count },
+                .brute = { .sp = 0, .sq = 0, .state_vector_set_count = 0, .result_path = { }, .thread_count = thread_count },
+                .skipped_brute_count = 0,
+                .divergent_state_counts = vector<size_t>(mask_count, 0),
+                .chunk_divergent_probabilities = vector<CompensatedSum>(mask_count),
+                .is_touched = vector<bool>(mask_count, false),
+                .touched_masks = { }
+            });
+
+            RangeSums greedy_sums { chunk_count };
+            RangeSums brute_sums { chunk_count };
+            vector<vector<ChunkDivergence>> range_divergences(greedy_sums.range_count);
+            atomic<size_t> next_range { 0 };
+            vector<thread> threads { };
+            for (WorkerState& worker : workers)
+                threads.emplace_back([this, &worker, &greedy_sums, &brute_sums, &range_divergences, &next_range, &run_control]()
+                {
+                    RangeCursor cursor { greedy_sums, next_range };
+                    process_chunks(worker, cursor, greedy_sums, brute_sums, range_divergences, run_control);
+                });
+            for (thread& worker_thread : threads)
+                worker_thread.join();
+
+            return merge_worker_states(workers, greedy_sums, brute_sums, range_divergences, top_mask_count);
+        }
+
+    private:
+
+        void process_chunks(
+            WorkerState& worker,
+            RangeCursor& cursor,
+            RangeSums& greedy_sums,
+            RangeSums& brute_sums,
+            vector<vector<ChunkDivergence>>& range_divergences,
+            RunControl& run_control
+        ) {
+            vector<StateVector<all_count, processor_count>> sv1(Chunk::size);
+            vector<double> probability(Chunk::size);
+
+            while (!run_control.poll())
+            {
+                size_t chunk_idx { cursor.next_chunk_idx() };
+                if (chunk_idx >= chunk_count)
+                    break;
+
+                enumerate_chunk_states(chunk_idx, p, q, sv1, probability);
+                CompensatedSum greedy_sp { };
+                CompensatedSum greedy_sq { };
+                CompensatedSum brute_sp { };
+                CompensatedSum brute_sq { };
+                for (size_t k = 0; k < Chunk::size; k++)
+                {
+                    bool is_reconfigured { greedy_table.requires_reconfiguration(sv1[k]) };
+                    bool greedy_state
+                    {
+                        is_reconfigured ? scheme.scheme_function(greedy_table.reconfigure_state(sv1[k])) : scheme.scheme_function(sv1[k])
+                    };
+
+                    bool brute_state { greedy_state };
+                    if (!is_reconfigured || greedy_state)
+                        worker.skipped_brute_count += is_reconfigured ? 1 : 0;
+                    else
+                        brute_state = scheme.scheme_function(brute_table.reconfigure_state(sv1[k]));
+
+                    (greedy_state ? greedy_sp : greedy_sq).add(probability[k]);
+                    (brute_state ? brute_sp : brute_sq).add(probability[k]);
+                    if (greedy_state != brute_state)
+                    {
+                        size_t mask { processor_mask(sv1[k]) };
+                        worker.divergent_state_counts[mask]++;
+                        worker.chunk_divergent_probabilities[mask].add(probability[k]);
+                        if (!worker.is_touched[mask])
+                        {
+                            worker.is_touched[mask] = true;
+                            worker.touched_masks.push_back(mask);
+                        }
+                    }
+                }
+                greedy_sums.add_chunk(chunk_idx, greedy_sp, greedy_sq);
+                brute_sums.add_chunk(chunk_idx, brute_sp, brute_sq);
+                vector<ChunkDivergence>& divergences { range_divergences[greedy_sums.range_idx(chunk_idx)] };
+                for (size_t mask : worker.touched_masks)
+                {
+                    divergences.push_back(ChunkDivergence { .mask = mask, .probability = worker.chunk_divergent_probabilities[mask] });
+                    worker.chunk_divergent_probabilities[mask] = { };
+                    worker.is_touched[mask] = false;
+                }
+                worker.touched_masks.clear();
+                worker.greedy.state_vector_set_count += Chunk::size;
+                worker.brute.state_vector_set_count += Chunk::size;
+            }
+        }
+
+        static size_t processor_mask(const StateVector<all_count, processor_count>& sv)
+        {
+            size_t mask { 0 };
+            for (size_t i = 0; i < processor_count; i++)
+                if (sv.processors[i])
+                    mask |= static_cast<size_t>(1) << i;
+            return mask;
+        }
+
+        StrategyComparison merge_worker_states(
+            const vector<WorkerState>& workers,
+            const RangeSums& greedy_sums,
+            const RangeSums& brute_sums,
+            const vector<vector<ChunkDivergence>>& range_divergences,
+            size_t top_mask_count
+        ) const {
+            StrategyComparison result
+            {
+                .greedy = workers.front().greedy,
+                .brute = workers.front().brute,
+                .divergent_state_count = 0,
+                .divergent_probability = 0,
+                .skipped_brute_count = 0,
+                .top_divergent_masks = { }
+            };
+            result.greedy.sp = greedy_sums.total_sp();
+            result.greedy.sq = greedy_sums.total_sq();
+            result.brute.sp = brute_sums.total_sp();
+            result.brute.sq = brute_sums.total_sq();
+            result.greedy.state_vector_set_count = 0;
+            result.brute.state_vector_set_count = 0;
+
+            vector<DivergentProcessorMask> masks(mask_count);
+            for (size_t mask = 0; mask < mask_count; mask++)
+            {
+                masks[mask].processors.resize(processor_count);
+                for (size_t i = 0; i < processor_count; i++)
+                    masks[mask].processors[i] = (mask >> i & 1) != 0;
+            }
+
+            for (const WorkerState& worker : workers)
+            {
+                result.greedy.state_vector_set_count += worker.greedy.state_vector_set_count;
+                result.brute.state_vector_set_count += worker.brute.state_vector_set_count;
+                result.skipped_brute_count += worker.skipped_brute_count;
+                for (size_t mask = 0; mask < mask_count; mask++)
+                {
+                    masks[mask].state_count += worker.divergent_state_counts[mask];
+                    result.divergent_state_count += worker.divergent_state_counts[mask];
+                }
+            }
+
+            vector<CompensatedSum> mask_probabilities(mask_count);
+            for (const vector<ChunkDivergence>& divergences : range_divergences)
+                for (const ChunkDivergence& divergence : divergences)
+                    mask_probabilities[divergence.mask].add(divergence.probability);
+            CompensatedSum divergent_probability { };
+            for (size_t mask = 0; mask < mask_count; mask++)
+            {
+                masks[mask].probability = mask_probabilities[mask].value();
+                divergent_probability.add(mask_probabilities[mask]);
+            }
+            result.divergent_probability = divergent_probability.value();
+            finish_summary(result.greedy, chunk_count * Chunk::size, p, q);
+            finish_summary(result.brute, chunk_count * Chunk::size, p, q);
+
+            std::erase_if(masks, [](const DivergentProcessorMask& mask) { return mask.state_count == 0; });
+            std::sort(
+                masks.begin(), masks.end(),
+                [](const DivergentProcessorMask& a, const DivergentProcessorMask& b) { return a.probability > b.probability; }
+            );
+            if (masks.size() > top_mask_count)
+                masks.resize(top_mask_count);
+            result.top_divergent_masks = move(masks);
+            return result;
+        }
+    };
+
+    template<size_t all_count, size_t processor_count>
+    StrategyComparison compare_reconfiguration_strategies(
+        const Scheme<all_count, processor_count>& scheme,
+        const CalculationOptions& options,
+        size_t top_mask_count
+    ) {
+        ReconfigurationStrategyComparator<all_count, processor_count> comparator { scheme };
+        return comparator.compare(options, top_mask_count);
+    }
+
+    template<size_t all_count, size_t processor_count>
+    MultiVariantSummary calculate_scheme_variants_reliability(
+        span<const Scheme<all_count, processor_count>> variants,
+        const CalculationOptions& options
+    ) {
+        MultiVariantReliabilityCalculator<all_count, processor_count> calculator { variants };
+        return calculator.calculate(options);
+    }
+}
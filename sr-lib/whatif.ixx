@@ -0,0 +1,701 @@
+export module scheme_reliability:whatif;
+
+import :model;
+using namespace sr_impl::model;
+
+import :scheme_file;
+using namespace sr_impl::scheme_file;
+
+import :dynamic;
+using namespace sr_impl::dynamic;
+
+import :outcome;
+using namespace sr_impl::outcome;
+
+import :cache;
+using namespace sr_impl::cache;
+
+import std;
+using std::string;
+using std::string_view;
+using std::optional, std::nullopt;
+using std::vector;
+using std::deque;
+using std::unordered_map;
+using std::shared_ptr, std::make_shared;
+using std::mutex, std::lock_guard;
+using std::filesystem::path;
+using std::filesystem::file_time_type, std::filesystem::last_write_time;
+using std::error_code;
+using std::exception;
+using std::format;
+using std::runtime_error;
+using std::from_chars, std::errc;
+using std::isspace;
+using std::min;
+using std::chrono::steady_clock;
+using std::chrono::duration;
+using std::milli;
+
+namespace sr_impl::whatif
+{
+    // Just enough JSON for query lines: objects, arrays, strings, numbers and literals.
+    struct JsonValue
+    {
+        enum class Kind { Null, Boolean, Number, String, Array, Object };
+
+        Kind kind { Kind::Null };
+        bool boolean { false };
+        double number { 0 };
+        string text { };
+        // Array items, or the values of the object members named by keys.
+        vector<JsonValue> items { };
+        vector<string> keys { };
+
+        const JsonValue* find(string_view key) const
+        {
+            for (size_t i = 0; i < keys.size(); i++)
+                if (keys[i] == key)
+                    return &items[i];
+            return nullptr;
+        }
+
+        double as_number(string_view what) const
+        {
+            if (kind != Kind::Number)
+                throw runtime_error(format("Error: {} must be a number", what));
+            return number;
+        }
+
+        const string& as_string(string_view what) const
+        {
+            if (kind != Kind::String)
+                throw runtime_error(format("Error: {} must be a string", what));
+            return text;
+        }
+    };
+
+    class JsonReader
+    {
+    private:
+
+        // Queries are flat; the cap keeps a hostile line from exhausting the stack.
+        static constexpr size_t MAX_DEPTH { 32 };
+
+        const string_view text;
+        size_t position;
+        size_t depth;
+
+    public:
+
+        JsonReader(string_view text): text { text }, position { 0 }, depth { 0 } { }
+
+        JsonValue read()
+        {
+            JsonValue value { read_value() };
+            skip_spaces();
+            if (position != text.size())
+                throw error("unexpected trailing characters");
+            return value;
+        }
+
+    private:
+
+        runtime_error error(string_view message) const
+        {
+            return runtime_error(format("Error: invalid JSON at {}: {}", position, message));
+        }
+
+        JsonValue read_value()
+        {
+            skip_spaces();
+            if (position == text.size())
+                throw error("unexpected end");
+
+            char c { text[position] };
+            if ((c == '{' || c == '[') && depth == MAX_DEPTH)
+                throw error(format("nested deeper than {} levels", MAX_DEPTH));
+            if (c == '{')
+            {
+                depth++;
+                JsonValue value { read_object() };
+                depth--;
+                return value;
+            }
+            if (c == '[')
+            {
+                depth++;
+                JsonValue value { read_array() };
+                depth--;
+                return value;
+            }
+            if (c == '"')
+                return JsonValue { .kind = JsonValue::Kind::String, .text = read_string() };
+            if (accept_literal("true"))
+                return JsonValue { .kind = JsonValue::Kind::Boolean, .boolean = true };
+            if (accept_literal("false"))
+                return JsonValue { .kind = JsonValue::Kind::Boolean, .boolean = false };
+            if (accept_literal("null"))
+                return JsonValue { };
+            return read_number();
+        }
+
+        JsonValue read_object()
+        {
+            JsonValue value { .kind = JsonValue::Kind::Object };
+            position++;
+            skip_spaces();
+            if (accept('}'))
+                return value;
+            do
+            {
+                skip_spaces();
+                if (position == text.size() || text[position] != '"')
+                    throw error("expected member name");
+                value.keys.push_back(read_string());
+                skip_spaces();
+                if (!accept(':'))
+                    throw error("expected ':'");
+                value.items.push_back(read_value());
+                skip_spaces();
+            } while (accept(','));
+            if (!accept('}'))
+                throw error("expected ',' or '}'");
+            return value;
+        }
+
+        JsonValue read_array()
+        {
+            JsonValue value { .kind = JsonValue::Kind::Array };
+            position++;
+            skip_spaces();
+            if (accept(']'))
+                return value;
+            do
+            {
+                value.items.push_back(read_value());
+                skip_spaces();
+            } while (accept(','));
+            if (!accept(']'))
+                throw error("expected ',' or ']'");
+            return value;
+        }
+
+        string read_string()
+        {
+            string result { };
+            position++;
+            while (position < text.size() && text[position] != '"')
+            {
+                char c { text[position++] };
+                if (c != '\\')
+                {
+                    result += c;
+                    continue;
+                }
+                if (position == text.size())
+                    break;
+                char escaped { text[position++] };
+                switch (escaped)
+                {
+                case 'n': result += '\n'; break;
+                case 't': result += '\t'; break;
+                case 'r': result += '\r'; break;
+                case 'b': result += '\b'; break;
+                case 'f': result += '\f'; break;
+                case 'u': result += read_code_point(); break;
+                default: result += escaped; break;
+                }
+            }
+            if (!accept('"'))
+                throw error("unterminated string");
+            return result;
+        }
+
+        // Element names are ASCII; anything wider is rejected.
+        char read_code_point()
+        {
+            unsigned int code { 0 };
+            auto [end, ec] { from_chars(text.data() + position, text.data() + min(position + 4, text.size()), code, 16) };
+            if (ec != errc { } || end != text.data() + position + 4 || code > 0x7f)
+                throw error("unsupported \\u escape");
+            position += 4;
+            return static_cast<char>(code);
+        }
+
+        JsonValue read_number()
+        {
+            size_t start { position };
+            while (position < text.size() && string_view { "+-0123456789.eE" }.find(text[position]) != string_view::npos)
+                position++;
+            double number { 0 };
+            auto [end, ec] { from_chars(text.data() + start, text.data() + position, number) };
+            if (start == position || ec != errc { } || end != text.data() + position)
+                throw error("expected a value");
+            return JsonValue { .kind = JsonValue::Kind::Number, .number = number };
+        }
+
+        bool accept(char c)
+        {
+            if (position < text.size() && text[position] == c)
+            {
+                position++;
+                return true;
+            }
+            return false;
+        }
+
+        bool accept_literal(string_view literal)
+        {
+            if (text.substr(position, literal.size()) != literal)
+                return false;
+            position += literal.size();
+            return true;
+        }
+
+        void skip_spaces()
+        {
+            while (position < text.size() && isspace(static_cast<unsigned char>(text[position])))
+                position++;
+        }
+    };
+
+    JsonValue parse_json(string_view text)
+    {
+        JsonReader reader { text };
+        return reader.read();
+    }
+
+    string escape_json(string_view text)
+    {
+        string result { };
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                result += format("\\{}", c);
+            else if (static_cast<unsigned char>(c) < 0x20)
+                result += format("\\u{:04x}", static_cast<unsigned int>(c));
+            else
+                result += c;
+        }
+        return result;
+    }
+
+    // Answers what-if queries against one scheme file, one JSON object per line:
+    //
+    //   {"query": "reliability", "q": {"a1": 1e-3}, "failed": ["pr2"], "max_load": {"pr1": 70}}
+    //   {"query": "importance", "working": ["c1"]}
+    //   {"query": "info"}
+    //   {"query": "reload"}
+    //
+    // "p" / "q" set an element's probabilities, the other one defaulting to the
+    // complement; "failed" / "working" pin elements; "normal_load", "max_load" and
+    // "type" change the topology. Outcome bitmaps of the file's topology and of the
+    // last few variants asked for stay in memory, so a p/q question only re-weights a
+    // bitmap and a new topology is enumerated once, outside the session lock. The
+    // per-element sums of the last few importance queries are kept as well. The scheme
+    // file is reloaded when its modification time changes, keeping the bitmaps whose
+    // topology it still has; a file that no longer parses leaves the old scheme in place.
+    class WhatIfSession
+    {
+    private:
+
+        static constexpr size_t MAX_TOPOLOGY_COUNT { 8 };
+        static constexpr size_t MAX_IMPORTANCE_COUNT { 16 };
+
+        struct LoadedScheme
+        {
+            DynamicScheme scheme;
+            unordered_map<string, size_t> element_indices;
+            vector<double> p;
+            vector<double> q;
+        };
+
+        struct Topology
+        {
+            string key;
+            shared_ptr<const OutcomeBitmap> bitmap;
+            double build_ms;
+        };
+
+        struct WhatIf
+        {
+            DynamicScheme scheme;
+            vector<double> p;
+            vector<double> q;
+        };
+
+        struct Importance
+        {
+            string topology_key;
+            vector<double> p;
+            vector<double> q;
+            shared_ptr<const ReweightedImportance> importance;
+        };
+
+        const path scheme_file_path;
+        const size_t thread_count;
+        // Where bitmaps are kept across sessions under their topology keys, if anywhere.
+        const optional<path> cache_path;
+
+        mutex reload_mutex;
+        mutex state_mutex;
+
+        shared_ptr<const LoadedScheme> loaded;
+        // The file's own topology first, then variants from oldest to newest.
+        deque<Topology> topologies;
+        // Newest last.
+        deque<Importance> importances;
+        file_time_type loaded_file_time;
+        size_t generation;
+        string reload_error;
+
+    public:
+
+        WhatIfSession(const path& scheme_file_path, size_t thread_count = 0, const optional<path>& cache_path = nullopt):
+            scheme_file_path { scheme_file_path },
+            thread_count { thread_count },
+            cache_path { cache_path },
+            loaded { },
+            topologies { },
+            importances { },
+            loaded_file_time { last_write_time(scheme_file_path) },
+            generation { 1 },
+            reload_error { }
+        {
+            loaded = load();
+            topologies.push_back(build_topology(loaded->scheme));
+        }
+
+        // Reloads the scheme file when it changed since the last attempt, or always
+        // when forced. Returns whether a new scheme was loaded.
+        bool refresh(bool is_forced = false)
+        {
+            lock_guard<mutex> reload_lock { reload_mutex };
+
+            error_code ec { };
+            file_time_type file_time { last_write_time(scheme_file_path, ec) };
+            if (ec)
+                return false;
+            {
+                lock_guard<mutex> lock { state_mutex };
+                if (file_time == loaded_file_time && !is_forced)
+                    return false;
+            }
+
+            try
+            {
+                // A change of p/q only keeps every bitmap; a known topology moves first.
+                shared_ptr<const LoadedScheme> next { load() };
+                string key { make_topology_key(next->scheme) };
+                optional<Topology> base { };
+                {
+                    lock_guard<mutex> lock { state_mutex };
+                    base = take_topology(key);
+                }
+                if (!base.has_value())
+                    base = build_topology(next->scheme);
+
+                lock_guard<mutex> lock { state_mutex };
+                loaded = next;
+                if (optional<Topology> known { take_topology(key) })
+                    base = known;
+                topologies.push_front(base.value());
+                if (topologies.size() > MAX_TOPOLOGY_COUNT)
+                    topologies.erase(topologies.begin() + 1);
+                loaded_file_time = file_time;
+                generation++;
+                reload_error.clear();
+                return true;
+            }
+            catch (const exception& e)
+            {
+                lock_guard<mutex> lock { state_mutex };
+                loaded_file_time = file_time;
+                reload_error = e.what();
+                return false;
+            }
+        }
+
+        // One JSON request in, one single-line JSON response out; errors are answered
+        // with {"ok": false, "error": ...} and leave the session as it was.
+        string answer(string_view request_text)
+        {
+            steady_clock::time_point start { steady_clock::now() };
+            try
+            {
+                JsonValue request { parse_json(request_text) };
+                if (request.kind != JsonValue::Kind::Object)
+                    throw runtime_error("Error: a query must be a JSON object");
+                const JsonValue* query_value { request.find("query") };
+                string query { query_value == nullptr ? "reliability" : query_value->as_string("query") };
+
+                refresh(query == "reload");
+
+                // The scheme is held by its own pointer, so a reload in between doesn't
+                // change it under the query.
+                shared_ptr<const LoadedScheme> scheme { };
+                {
+                    lock_guard<mutex> lock { state_mutex };
+                    scheme = loaded;
+                }
+
+                string members { };
+                if (query == "info" || query == "reload")
+                    members = info_members();
+                else if (query == "reliability")
+                    members = answer_reliability(*scheme, request);
+                else if (query == "importance")
+                    members = answer_importance(*scheme, request);
+                else
+                    throw runtime_error(format("Error: unknown query '{}'", query));
+
+                lock_guard<mutex> lock { state_mutex };
+                if (!reload_error.empty())
+                    members += format(",\"reload_error\":\"{}\"", escape_json(reload_error));
+                return format(
+                    "{{\"ok\":true,\"query\":\"{}\",{},\"elapsed_ms\":{}}}",
+                    escape_json(query), members, duration<double, milli>(steady_clock::now() - start).count()
+                );
+            }
+            catch (const exception& e)
+            {
+                return format("{{\"ok\":false,\"error\":\"{}\"}}", escape_json(e.what()));
+            }
+        }
+
+    private:
+
+        shared_ptr<const LoadedScheme> load() const
+        {
+            DynamicScheme scheme { load_scheme_file(scheme_file_path) };
+            validate_scheme(scheme);
+
+            LoadedScheme next { .scheme = scheme, .element_indices = { }, .p = { }, .q = { } };
+            for (size_t i = 0; i < scheme.processors.size(); i++)
+            {
+                next.element_indices[scheme.processors[i].name] = i;
+                next.p.push_back(scheme.processors[i].p);
+                next.q.push_back(scheme.processors[i].q);
+            }
+            for (size_t i = 0; i < scheme.elements.size(); i++)
+            {
+                next.element_indices[scheme.elements[i].name] = scheme.processors.size() + i;
+                next.p.push_back(scheme.elements[i].p);
+                next.q.push_back(scheme.elements[i].q);
+            }
+            return make_shared<const LoadedScheme>(next);
+        }
+
+        Topology build_topology(const DynamicScheme& scheme) const
+        {
+            steady_clock::time_point start { steady_clock::now() };
+            shared_ptr<const OutcomeBitmap> bitmap { make_shared<const OutcomeBitmap>(calculate_outcome_bitmap(scheme, thread_count, cache_path)) };
+            return Topology
+            {
+                .key = make_topology_key(scheme),
+                .bitmap = bitmap,
+                .build_ms = duration<double, milli>(steady_clock::now() - start).count()
+            };
+        }
+
+        optional<Topology> take_topology(const string& key)
+        {
+            for (auto it = topologies.begin(); it != topologies.end(); it++)
+                if (it->key == key)
+                {
+                    Topology topology { *it };
+                    topologies.erase(it);
+                    return topology;
+                }
+            return nullopt;
+        }
+
+        // The bitmap of the what-if topology and whether it had to be enumerated. The
+        // enumeration runs unlocked, as in refresh; of two queries building the same
+        // topology, the first one stored is kept.
+        Topology find_topology(const DynamicScheme& scheme, bool& is_built)
+        {
+            string key { make_topology_key(scheme) };
+            {
+                lock_guard<mutex> lock { state_mutex };
+                if (optional<Topology> known { find_known_topology(key) })
+                {
+                    is_built = false;
+                    return known.value();
+                }
+            }
+
+            Topology topology { build_topology(scheme) };
+            is_built = true;
+            lock_guard<mutex> lock { state_mutex };
+            if (optional<Topology> known { find_known_topology(key) })
+                return known.value();
+            topologies.push_back(topology);
+            if (topologies.size() > MAX_TOPOLOGY_COUNT)
+                topologies.erase(topologies.begin() + 1);
+            return topology;
+        }
+
+        optional<Topology> find_known_topology(const string& key) const
+        {
+            for (const Topology& topology : topologies)
+                if (topology.key == key)
+                    return topology;
+            return nullopt;
+        }
+
+        static size_t element_index(const LoadedScheme& scheme, const string& name)
+        {
+            auto it { scheme.element_indices.find(name) };
+            if (it == scheme.element_indices.end())
+                throw runtime_error(format("Error: unknown element '{}'", name));
+            return it->second;
+        }
+
+        static size_t processor_index(const LoadedScheme& scheme, const string& name)
+        {
+            size_t idx { element_index(scheme, name) };
+            if (idx >= scheme.scheme.processors.size())
+                throw runtime_error(format("Error: '{}' is not a processor", name));
+            return idx;
+        }
+
+        static const JsonValue* find_member(const JsonValue& request, string_view key, JsonValue::Kind kind)
+        {
+            const JsonValue* value { request.find(key) };
+            if (value != nullptr && value->kind != kind)
+                throw runtime_error(format("Error: '{}' must be an {}", key, kind == JsonValue::Kind::Object ? "object" : "array"));
+            return value;
+        }
+
+        static WhatIf apply_what_if(const LoadedScheme& scheme, const JsonValue& request)
+        {
+            WhatIf what_if { .scheme = scheme.scheme, .p = scheme.p, .q = scheme.q };
+
+            if (const JsonValue* values { find_member(request, "p", JsonValue::Kind::Object) })
+                for (size_t i = 0; i < values->keys.size(); i++)
+                {
+                    size_t idx { element_index(scheme, values->keys[i]) };
+                    what_if.p[idx] = values->items[i].as_number("p");
+                    what_if.q[idx] = 1.0 - what_if.p[idx];
+                }
+            if (const JsonValue* values { find_member(request, "q", JsonValue::Kind::Object) })
+                for (size_t i = 0; i < values->keys.size(); i++)
+                {
+                    size_t idx { element_index(scheme, values->keys[i]) };
+                    what_if.q[idx] = values->items[i].as_number("q");
+                    what_if.p[idx] = 1.0 - what_if.q[idx];
+                }
+            if (const JsonValue* names { find_member(request, "failed", JsonValue::Kind::Array) })
+                for (const JsonValue& name : names->items)
+                {
+                    size_t idx { element_index(scheme, name.as_string("failed element")) };
+                    what_if.p[idx] = 0.0;
+                    what_if.q[idx] = 1.0;
+                }
+            if (const JsonValue* names { find_member(request, "working", JsonValue::Kind::Array) })
+                for (const JsonValue& name : names->items)
+                {
+                    size_t idx { element_index(scheme, name.as_string("working element")) };
+                    what_if.p[idx] = 1.0;
+                    what_if.q[idx] = 0.0;
+                }
+
+            if (const JsonValue* loads { find_member(request, "normal_load", JsonValue::Kind::Object) })
+                for (size_t i = 0; i < loads->keys.size(); i++)
+                    what_if.scheme.processors[processor_index(scheme, loads->keys[i])].normal_load = loads->items[i].as_number("normal_load");
+            if (const JsonValue* loads { find_member(request, "max_load", JsonValue::Kind::Object) })
+                for (size_t i = 0; i < loads->keys.size(); i++)
+                    what_if.scheme.processors[processor_index(scheme, loads->keys[i])].max_load = loads->items[i].as_number("max_load");
+            if (const JsonValue* type { request.find("type") })
+            {
+                const string& name { type->as_string("type") };
+                if (name == "greedy")
+                    what_if.scheme.type = SchemeType::Greedy;
+                else if (name == "brute")
+                    what_if.scheme.type = SchemeType::Brute;
+                else if (name == "beam")
+                    what_if.scheme.type = SchemeType::Beam;
+                else
+                    throw runtime_error(format("Error: unknown scheme type '{}'", name));
+            }
+            return what_if;
+        }
+
+        string answer_reliability(const LoadedScheme& scheme, const JsonValue& request)
+        {
+            WhatIf what_if { apply_what_if(scheme, request) };
+            bool is_built { false };
+            Topology topology { find_topology(what_if.scheme, is_built) };
+            ReweightedReliability reliability { reweight_outcome_bitmap(*topology.bitmap, what_if.p, what_if.q) };
+            return format("\"sp\":{},\"sq\":{},\"topology_built\":{}", reliability.sp, reliability.sq, is_built);
+        }
+
+        // Birnbaum importance of every element: sp with the element working minus sp
+        // with it failed, under the query's what-if. One pass over the bitmap yields
+        // every element's sums.
+        string answer_importance(const LoadedScheme& scheme, const JsonValue& request)
+        {
+            WhatIf what_if { apply_what_if(scheme, request) };
+            bool is_built { false };
+            Topology topology { find_topology(what_if.scheme, is_built) };
+            shared_ptr<const ReweightedImportance> importance { find_importance(topology, what_if) };
+
+            string elements { };
+            for (size_t i = 0; i < what_if.p.size(); i++)
+            {
+                const string& name
+                {
+                    i < what_if.scheme.processors.size()
+                        ? what_if.scheme.processors[i].name
+                        : what_if.scheme.elements[i - what_if.scheme.processors.size()].name
+                };
+                double sp_working { importance->sp_working[i] };
+                double sp_failed { importance->sp_failed[i] };
+                elements += format(
+                    "{}{{\"name\":\"{}\",\"birnbaum\":{},\"sp_working\":{},\"sp_failed\":{}}}",
+                    i == 0 ? "" : ",", escape_json(name), sp_working - sp_failed, sp_working, sp_failed
+                );
+            }
+            return format("\"sp\":{},\"sq\":{},\"topology_built\":{},\"elements\":[{}]", importance->sp, importance->sq, is_built, elements);
+        }
+
+        shared_ptr<const ReweightedImportance> find_importance(const Topology& topology, const WhatIf& what_if)
+        {
+            auto is_same = [&topology, &what_if](const Importance& entry)
+            {
+                return entry.topology_key == topology.key && entry.p == what_if.p && entry.q == what_if.q;
+            };
+            {
+                lock_guard<mutex> lock { state_mutex };
+                for (const Importance& entry : importances)
+                    if (is_same(entry))
+                        return entry.importance;
+            }
+
+            shared_ptr<const ReweightedImportance> importance
+            {
+                make_shared<const ReweightedImportance>(reweight_outcome_importance(*topology.bitmap, what_if.p, what_if.q))
+            };
+            lock_guard<mutex> lock { state_mutex };
+            importances.push_back(Importance { .topology_key = topology.key, .p = what_if.p, .q = what_if.q, .importance = importance });
+            if (importances.size() > MAX_IMPORTANCE_COUNT)
+                importances.pop_front();
+            return importance;
+        }
+
+        string info_members()
+        {
+            lock_guard<mutex> lock { state_mutex };
+            const DynamicScheme& scheme { loaded->scheme };
+            return format(
+                "\"scheme\":\"{}\",\"path\":\"{}\",\"generation\":{},\"all_count\":{},\"processor_count\":{},"
+                "\"state_count\":{},\"topology_count\":{},\"bitmap_build_ms\":{}",
+                escape_json(scheme.scheme_name), escape_json(scheme_file_path.string()), generation,
+                scheme.all_count(), scheme.processors.size(), 1ull << scheme.all_count(),
+                topologies.size(), topologies.front().build_ms
+            );
+        }
+    };
+}
@@ -1,10 +1,23 @@
 import research;
 
 import std;
-using std::print;
+using std::print, std::println;
+using std::string_view;
+using std::cerr;
 
-int main()
+int main(int argc, char* argv[])
 {
+    for (int i = 1; i < argc; i++)
+    {
+        string_view arg { argv[i] };
+        if (arg == "--cache" && i + 1 < argc)
+            research::use_result_cache(argv[++i]);
+        else
+        {
+            println(cerr, "usage: sr-research [--cache DIR]");
+            return 1;
+        }
+    }
     print("\n=== original s23 ===\n");
     research::s23_original();
 
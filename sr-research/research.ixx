@@ -8,6 +8,8 @@ import std;
 using std::function;
 using std::string;
 using std::span;
+using std::optional;
+using std::filesystem::path;
 using std::format;
 using std::println, std::print;
 using std::chrono::high_resolution_clock;
@@ -16,6 +18,19 @@ using std::chrono::seconds;
 
 export namespace research
 {
+    SchemeDto<8, 4> simple_scheme();
+    SchemeDto<23, 5> s23_original_scheme();
+    SchemeDto<23, 5> s23_rt_7_7_7_8_8_scheme();
+    SchemeDto<23, 5> s23_rt_7_7_7_8_8_modified_connections_scheme();
+    SchemeDto<24, 5> s24_d9_right_scheme();
+    SchemeDto<25, 5> s25_d9_d10_right_scheme();
+    SchemeDto<27, 5> s27_d9_d10_c7_right_c8_left_scheme();
+    SchemeDto<29, 5> s29_d9_d10_c7_right_c8_left_a4_scheme();
+    SchemeDto<26, 5> s26_final_scheme();
+
+    // Off by default: a cached summary is only as fresh as SCHEME_FUNCTION_VERSION.
+    void use_result_cache(const path& cache_path);
+
     void simple();
     void s23_original();
     void s23_rt_7_7_7_8_8();
@@ -37,6 +52,10 @@ namespace research
 
         static const string BINARY_SCORED_STATE_SET_DATA_EXTENSION;
         static const string SCHEME_RELIABILITY_ELEMENTS_EXTENSION;
+        // Shared by every scheme function below; bump it after changing any of them.
+        static const string SCHEME_FUNCTION_VERSION;
+
+        static optional<path> result_cache_path;
 
         Utils() = delete;
 
@@ -45,6 +64,8 @@ namespace research
             println("path = {}", sr.result_path.string());
             println("sp = {}, sq = {}", sr.sp, sr.sq);
             println("state count = {}", sr.state_vector_set_count);
+            if (sr.is_cached)
+                println("cached result");
         }
 
         template<typename T>
@@ -65,10 +86,18 @@ namespace research
         static void process_scheme(const SchemeDto<all_count, processor_count>& scheme)
         {
             print("\nScheme type = {}\n", scheme.type == SchemeType::Brute ? "brute" : "greedy");
+            SchemeDto<all_count, processor_count> versioned_scheme { scheme };
+            versioned_scheme.scheme_function_version = SCHEME_FUNCTION_VERSION;
             auto result
             {
                 Utils::execution_time<SchemeReliabilitySummaryDto>(
-                    [&scheme]() { return calculate_scheme_reliability<all_count, processor_count>(scheme); }
+                    [&versioned_scheme]()
+                    {
+                        return sr::calculate_scheme_reliability<all_count, processor_count>(
+                            versioned_scheme,
+                            CalculationOptionsDto { .result_cache_path = result_cache_path }
+                        );
+                    }
                 )
             };
             Utils::dump_text_summary(result);
@@ -77,6 +106,13 @@ namespace research
 
     const string Utils::BINARY_SCORED_STATE_SET_DATA_EXTENSION { "ssv" };
     const string Utils::SCHEME_RELIABILITY_ELEMENTS_EXTENSION { "ens" };
+    const string Utils::SCHEME_FUNCTION_VERSION { "1" };
+    optional<path> Utils::result_cache_path { };
+
+    void use_result_cache(const path& cache_path)
+    {
+        Utils::result_cache_path = cache_path;
+    }
 
     constexpr double qpr { 1.2e-4 };
     constexpr double qpa { 1.2e-4 };
@@ -92,13 +128,14 @@ namespace research
     constexpr double ppd { 1.0 - qpd };
     constexpr double ppm { 1.0 - qpm };
 
-    void simple()
+    SchemeDto<8, 4> simple_scheme()
     {
         constexpr size_t all_count { 8 };
         constexpr size_t processor_count { 4 };
 
-        SchemeDto<all_count, processor_count> scheme
+        return SchemeDto<all_count, processor_count>
         {
+            .scheme_name = "simple",
             .elements =
             {
                 ElementDto { .name = "c1", .p = 0.8, .q = 0.2 },
@@ -132,8 +169,15 @@ namespace research
             .scheme_function = [](const StateVectorDto<all_count, processor_count>& sv)
             {
                 return sv.all[0] && sv.all[1] && (sv.all[2] || sv.all[3]) && sv.all[4] && (sv.all[5] || sv.all[6]) && sv.all[7];
-            }
+            },
+            // A monotone series/parallel function, so brute force may prune transitions.
+            .brute_options = { .is_pruning_transitions = true }
         };
+    }
+
+    void simple()
+    {
+        auto scheme { simple_scheme() };
 
         scheme.scheme_name = "simple-greedy";
         scheme.type = SchemeType::Greedy;
@@ -144,13 +188,14 @@ namespace research
         Utils::process_scheme(scheme);
     }
 
-    void s23_original()
+    SchemeDto<23, 5> s23_original_scheme()
     {
         constexpr size_t all_count { 23 };
         constexpr size_t processor_count { 5 };
 
-        SchemeDto<all_count, processor_count> scheme
+        return SchemeDto<all_count, processor_count>
         {
+            .scheme_name = "s23-original",
             .elements =
             {
                 ElementDto { .name = "a1", .p = ppa, .q = qpa },
@@ -212,8 +257,14 @@ namespace research
                 bool f6 = s[5] * s[6] * (s[21] + s[22]);
 
                 return f1 * f2 * f3 * f4 * f5 * f6;
-            }
+            },
+            .brute_options = { .is_pruning_transitions = true }
         };
+    }
+
+    void s23_original()
+    {
+        auto scheme { s23_original_scheme() };
 
         scheme.scheme_name = "s23-original-greedy";
         scheme.type = SchemeType::Greedy;
@@ -224,13 +275,14 @@ namespace research
         Utils::process_scheme(scheme);
     }
 
-    void s23_rt_7_7_7_8_8()
+    SchemeDto<23, 5> s23_rt_7_7_7_8_8_scheme()
     {
         constexpr size_t all_count { 23 };
         constexpr size_t processor_count { 5 };
 
-        SchemeDto<all_count, processor_count> scheme
+        return SchemeDto<all_count, processor_count>
         {
+            .scheme_name = "s23-77788",
             .elements =
             {
                 ElementDto { .name = "a1", .p = ppa, .q = qpa },
@@ -339,8 +391,14 @@ namespace research
                 bool f6 = s[5] * s[6] * (s[21] + s[22]);
 
                 return f1 * f2 * f3 * f4 * f5 * f6;
-            }
+            },
+            .brute_options = { .is_pruning_transitions = true }
         };
+    }
+
+    void s23_rt_7_7_7_8_8()
+    {
+        auto scheme { s23_rt_7_7_7_8_8_scheme() };
 
         scheme.scheme_name = "s23-77788-greedy";
         scheme.type = SchemeType::Greedy;
@@ -351,13 +409,14 @@ namespace research
         Utils::process_scheme(scheme);
     }
 
-    void s23_rt_7_7_7_8_8_modified_connections()
+    SchemeDto<23, 5> s23_rt_7_7_7_8_8_modified_connections_scheme()
     {
         constexpr size_t all_count { 23 };
         constexpr size_t processor_count { 5 };
 
-        SchemeDto<all_count, processor_count> scheme
+        return SchemeDto<all_count, processor_count>
         {
+            .scheme_name = "s23-77788-modified-connections",
             .elements =
             {
                 ElementDto { .name = "a1", .p = ppa, .q = qpa },
@@ -465,8 +524,14 @@ namespace research
                 bool f6 = s[5] * s[6] * (s[21] + s[22]);
 
                 return f1 * f3 * f4 * f5 * f6;
-            }
+            },
+            .brute_options = { .is_pruning_transitions = true }
         };
+    }
+
+    void s23_rt_7_7_7_8_8_modified_connections()
+    {
+        auto scheme { s23_rt_7_7_7_8_8_modified_connections_scheme() };
 
         scheme.scheme_name = "s23-77788-modified-connections-greedy";
         scheme.type = SchemeType::Greedy;
@@ -477,13 +542,14 @@ namespace research
         Utils::process_scheme(scheme);
     }
 
-    void s24_d9_right()
+    SchemeDto<24, 5> s24_d9_right_scheme()
     {
         constexpr size_t all_count { 24 };
         constexpr size_t processor_count { 5 };
 
-        SchemeDto<all_count, processor_count> scheme
+        return SchemeDto<all_count, processor_count>
         {
+            .scheme_name = "s24-d9-right",
             .elements =
             {
                 ElementDto { .name = "a1", .p = ppa, .q = qpa },
@@ -592,8 +658,14 @@ namespace research
                 bool f6 = s[5] * s[6] * (s[21] + s[22]);
 
                 return f1 * f3 * f4 * f5 * f6;
-            }
+            },
+            .brute_options = { .is_pruning_transitions = true }
         };
+    }
+
+    void s24_d9_right()
+    {
+        auto scheme { s24_d9_right_scheme() };
 
         scheme.scheme_name = "s24-d9-right-greedy";
         scheme.type = SchemeType::Greedy;
@@ -604,13 +676,14 @@ namespace research
         Utils::process_scheme(scheme);
     }
 
-    void s25_d9_d10_right()
+    SchemeDto<25, 5> s25_d9_d10_right_scheme()
     {
         constexpr size_t all_count { 25 };
         constexpr size_t processor_count { 5 };
 
-        SchemeDto<all_count, processor_count> scheme
+        return SchemeDto<all_count, processor_count>
         {
+            .scheme_name = "s25-d9-d10-right",
             .elements =
             {
                 ElementDto { .name = "a1", .p = ppa, .q = qpa },
@@ -720,8 +793,14 @@ namespace research
                 bool f6 = s[5] * s[6] * (s[21] + s[22]);
 
                 return f1 * f3 * f4 * f5 * f6;
-            }
+            },
+            .brute_options = { .is_pruning_transitions = true }
         };
+    }
+
+    void s25_d9_d10_right()
+    {
+        auto scheme { s25_d9_d10_right_scheme() };
 
         scheme.scheme_name = "s25-d9-d10-right-greedy";
         scheme.type = SchemeType::Greedy;
@@ -732,13 +811,14 @@ namespace research
         Utils::process_scheme(scheme);
     }
 
-    void s27_d9_d10_c7_right_c8_left()
+    SchemeDto<27, 5> s27_d9_d10_c7_right_c8_left_scheme()
     {
         constexpr size_t all_count { 27 };
         constexpr size_t processor_count { 5 };
 
-        SchemeDto<all_count, processor_count> scheme
+        return SchemeDto<all_count, processor_count>
         {
+            .scheme_name = "s27-d9-d10-c7-right-c8-left",
             .elements =
             {
                 ElementDto { .name = "a1", .p = ppa, .q = qpa },
@@ -850,8 +930,14 @@ namespace research
                 bool f6 = s[5] * s[6] * (s[21] + s[22]);
 
                 return f1 * f3 * f4 * f5 * f6;
-            }
+            },
+            .brute_options = { .is_pruning_transitions = true }
         };
+    }
+
+    void s27_d9_d10_c7_right_c8_left()
+    {
+        auto scheme { s27_d9_d10_c7_right_c8_left_scheme() };
 
         scheme.scheme_name = "s27-d9-d10-c7-right-c8-left-greedy";
         scheme.type = SchemeType::Greedy;
@@ -862,13 +948,14 @@ namespace research
         Utils::process_scheme(scheme);
     }
 
-    void s29_d9_d10_c7_right_c8_left_a4()
+    SchemeDto<29, 5> s29_d9_d10_c7_right_c8_left_a4_scheme()
     {
         constexpr size_t all_count { 29 };
         constexpr size_t processor_count { 5 };
 
-        SchemeDto<all_count, processor_count> scheme
+        return SchemeDto<all_count, processor_count>
         {
+            .scheme_name = "s29-d9-d10-c7-right-c8-left-a4",
             .elements =
             {
                 ElementDto { .name = "a1", .p = ppa, .q = qpa },
@@ -982,8 +1069,14 @@ namespace research
                 bool f6 = (s[5] + s[27]) * (s[6] + s[28]) * (s[21] + s[22]);
 
                 return f1 * f3 * f4 * f5 * f6;
-            }
+            },
+            .brute_options = { .is_pruning_transitions = true }
         };
+    }
+
+    void s29_d9_d10_c7_right_c8_left_a4()
+    {
+        auto scheme { s29_d9_d10_c7_right_c8_left_a4_scheme() };
 
         scheme.scheme_name = "s29-d9-d10-c7-right-c8-left-a4-greedy";
         scheme.type = SchemeType::Greedy;
@@ -994,13 +1087,14 @@ namespace research
         Utils::process_scheme(scheme);
     }
 
-    void s26_final()
+    SchemeDto<26, 5> s26_final_scheme()
     {
         constexpr size_t all_count { 26 };
         constexpr size_t processor_count { 5 };
 
-        SchemeDto<all_count, processor_count> scheme
+        return SchemeDto<all_count, processor_count>
         {
+            .scheme_name = "s26-final",
             .elements =
             {
                 ElementDto { .name = "a1", .p = ppa, .q = qpa },
@@ -1111,8 +1205,14 @@ namespace research
                 bool f6 = (s[5] + s[24]) * (s[6] + s[25]) * (s[21] + s[22]);
 
                 return f1 * f3 * f4 * f5 * f6;
-            }
+            },
+            .brute_options = { .is_pruning_transitions = true }
         };
+    }
+
+    void s26_final()
+    {
+        auto scheme { s26_final_scheme() };
 
         scheme.scheme_name = "s26-final-greedy";
         scheme.type = SchemeType::Greedy;
@@ -0,0 +1,108 @@
+import scheme_reliability;
+using namespace sr;
+
+import std;
+using std::string;
+using std::string_view;
+using std::vector;
+using std::optional, std::nullopt;
+using std::stoul;
+using std::println;
+using std::cerr;
+using std::exception;
+using std::chrono::steady_clock;
+using std::chrono::duration;
+
+void print_summary(const SchemeReliabilitySummaryDto& summary, double elapsed_s)
+{
+    println("path = {}", summary.result_path.string());
+    println("sp = {}, sq = {}", summary.sp, summary.sq);
+    println("state count = {}", summary.state_vector_set_count);
+    if (summary.is_cached)
+        println("cached result");
+    if (summary.is_partial)
+        println("partial run: sp in [{}, {}]", summary.sp_low, summary.sp_high);
+    println("time = {:.2f} s", elapsed_s);
+}
+
+string_view scheme_type_name(SchemeType type)
+{
+    switch (type)
+    {
+    case SchemeType::Brute: return "brute";
+    case SchemeType::Beam: return "beam";
+    default: return "greedy";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    vector<string> scheme_paths { };
+    CalculationOptionsDto options { };
+    optional<SchemeType> type { };
+    optional<size_t> beam_width { };
+    bool is_valid { true };
+
+    for (int i = 1; i < argc; i++)
+    {
+        string_view arg { argv[i] };
+        if (arg == "--threads" && i + 1 < argc)
+            options.thread_count = stoul(argv[++i]);
+        else if (arg == "--type" && i + 1 < argc)
+        {
+            string_view value { argv[++i] };
+            if (value == "greedy")
+                type = SchemeType::Greedy;
+            else if (value == "brute")
+                type = SchemeType::Brute;
+            else if (value == "beam")
+                type = SchemeType::Beam;
+            else
+                is_valid = false;
+        }
+        else if (arg == "--cache" && i + 1 < argc)
+            options.result_cache_path = argv[++i];
+        else if (arg == "--beam-width" && i + 1 < argc)
+            beam_width = stoul(argv[++i]);
+        else if (!arg.starts_with("--"))
+            scheme_paths.push_back(string { arg });
+        else
+            is_valid = false;
+    }
+
+    if (!is_valid || scheme_paths.empty())
+    {
+        println(cerr, "usage: sr-run <scheme-file>... [--threads N] [--type greedy|brute|beam] [--beam-width W] [--cache DIR]");
+        return 1;
+    }
+
+    try
+    {
+        for (const string& scheme_path : scheme_paths)
+        {
+            DynamicSchemeDto scheme { load_scheme_file(scheme_path) };
+            if (type.has_value())
+                scheme.type = type.value();
+            if (beam_width.has_value())
+                scheme.beam_options.width = beam_width.value();
+
+            println("\n=== {} ({}) ===", scheme.scheme_name, scheme_type_name(scheme.type));
+            if (scheme.type == SchemeType::Brute)
+            {
+                TransitionNormalizationReportDto report { normalize_transition_table(scheme) };
+                if (!report.removed_transitions.empty())
+                    println("pruned {} of {} transitions", report.removed_transitions.size(), report.transition_count);
+            }
+            steady_clock::time_point start { steady_clock::now() };
+            SchemeReliabilitySummaryDto summary { calculate_scheme_reliability(scheme, options) };
+            print_summary(summary, duration<double>(steady_clock::now() - start).count());
+        }
+    }
+    catch (const exception& e)
+    {
+        println(cerr, "{}", e.what());
+        return 1;
+    }
+
+    return 0;
+}
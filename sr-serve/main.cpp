@@ -0,0 +1,200 @@
+#if defined(_WIN32)
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+import scheme_reliability;
+using namespace sr;
+
+import std;
+using std::string;
+using std::string_view;
+using std::optional;
+using std::filesystem::path;
+using std::array;
+using std::stoul;
+using std::println;
+using std::cin, std::cout, std::cerr, std::endl;
+using std::getline;
+using std::exception;
+using std::runtime_error;
+using std::format;
+using std::thread, std::jthread;
+using std::stop_token;
+using std::mutex, std::unique_lock;
+using std::condition_variable_any;
+using std::chrono::milliseconds;
+
+#if defined(_WIN32)
+using Socket = SOCKET;
+constexpr Socket INVALID_SOCKET_HANDLE { INVALID_SOCKET };
+constexpr int SEND_FLAGS { 0 };
+void close_socket(Socket socket_handle) { closesocket(socket_handle); }
+#else
+using Socket = int;
+constexpr Socket INVALID_SOCKET_HANDLE { -1 };
+constexpr int SEND_FLAGS { MSG_NOSIGNAL };
+void close_socket(Socket socket_handle) { close(socket_handle); }
+#endif
+
+bool send_line(Socket client, const string& line)
+{
+    string data { line + "\n" };
+    size_t sent { 0 };
+    while (sent < data.size())
+    {
+        int count { static_cast<int>(send(client, data.data() + sent, static_cast<int>(data.size() - sent), SEND_FLAGS)) };
+        if (count <= 0)
+            return false;
+        sent += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+// Longer query lines are answered with an error and the connection is closed.
+constexpr size_t MAX_LINE_LENGTH { 64 * 1024 };
+
+// Newline-delimited JSON: one query per line, one response line per query.
+void serve_client(WhatIfSession& session, Socket client)
+{
+    string buffer { };
+    array<char, 4096> chunk { };
+    while (true)
+    {
+        int count { static_cast<int>(recv(client, chunk.data(), static_cast<int>(chunk.size()), 0)) };
+        if (count <= 0)
+            break;
+        buffer.append(chunk.data(), static_cast<size_t>(count));
+
+        size_t end { buffer.find('\n') };
+        for (; end != string::npos; end = buffer.find('\n'))
+        {
+            string line { buffer.substr(0, end) };
+            buffer.erase(0, end + 1);
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (!line.empty() && !send_line(client, session.answer(line)))
+            {
+                close_socket(client);
+                return;
+            }
+        }
+        if (buffer.size() > MAX_LINE_LENGTH)
+        {
+            send_line(client, format(R"({{"ok":false,"error":"Error: query lines are limited to {} bytes"}})", MAX_LINE_LENGTH));
+            break;
+        }
+    }
+    close_socket(client);
+}
+
+void serve_tcp(WhatIfSession& session, unsigned short port)
+{
+#if defined(_WIN32)
+    WSADATA wsa_data { };
+    if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0)
+        throw runtime_error("Error: can't initialize Winsock");
+#endif
+
+    Socket listener { socket(AF_INET, SOCK_STREAM, 0) };
+    if (listener == INVALID_SOCKET_HANDLE)
+        throw runtime_error("Error: can't create a socket");
+    int reuse { 1 };
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+    // Loopback only: the queries are not authenticated.
+    sockaddr_in address { };
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0)
+        throw runtime_error(format("Error: can't listen on 127.0.0.1:{}", port));
+    println(cerr, "listening on 127.0.0.1:{}", port);
+
+    while (true)
+    {
+        Socket client { accept(listener, nullptr, nullptr) };
+        if (client == INVALID_SOCKET_HANDLE)
+            continue;
+        thread { [&session, client]() { serve_client(session, client); } }.detach();
+    }
+}
+
+void serve_stdio(WhatIfSession& session)
+{
+    string line { };
+    while (getline(cin, line))
+        if (!line.empty())
+            cout << session.answer(line) << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    string scheme_path { };
+    unsigned short port { 7878 };
+    bool is_stdio { false };
+    size_t thread_count { 0 };
+    optional<path> cache_path { };
+    milliseconds watch_interval { 1000 };
+    bool is_valid { true };
+
+    for (int i = 1; i < argc; i++)
+    {
+        string_view arg { argv[i] };
+        if (arg == "--port" && i + 1 < argc)
+            port = static_cast<unsigned short>(stoul(argv[++i]));
+        else if (arg == "--stdio")
+            is_stdio = true;
+        else if (arg == "--threads" && i + 1 < argc)
+            thread_count = stoul(argv[++i]);
+        else if (arg == "--cache" && i + 1 < argc)
+            cache_path = argv[++i];
+        else if (arg == "--watch-ms" && i + 1 < argc)
+            watch_interval = milliseconds { stoul(argv[++i]) };
+        else if (!arg.starts_with("--") && scheme_path.empty())
+            scheme_path = arg;
+        else
+            is_valid = false;
+    }
+
+    if (!is_valid || scheme_path.empty())
+    {
+        println(cerr, "usage: sr-serve <scheme-file> [--port N | --stdio] [--threads N] [--watch-ms N] [--cache DIR]");
+        return 1;
+    }
+
+    try
+    {
+        WhatIfSession session { scheme_path, thread_count, cache_path };
+        println(cerr, "{}", session.answer(R"({"query": "info"})"));
+
+        // Rebuilds in the background after the file changes, so queries rarely wait.
+        jthread watcher { [&session, watch_interval](stop_token stop)
+        {
+            mutex watcher_mutex { };
+            condition_variable_any wake { };
+            unique_lock<mutex> lock { watcher_mutex };
+            while (!wake.wait_for(lock, stop, watch_interval, [&stop]() { return stop.stop_requested(); }))
+                if (session.refresh())
+                    println(cerr, "reloaded {}", session.answer(R"({"query": "info"})"));
+        } };
+
+        if (is_stdio)
+            serve_stdio(session);
+        else
+            serve_tcp(session, port);
+    }
+    catch (const exception& e)
+    {
+        println(cerr, "{}", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -12,58 +12,108 @@ using std::span;
 using std::array;
 using std::vector;
 using std::fabs;
-using std::string;
+using std::string, std::to_string, std::stod;
+using std::stringstream, std::getline;
 using std::count_if;
+using std::stop_source;
+using std::ifstream, std::ofstream;
+using std::filesystem::file_size, std::filesystem::exists, std::filesystem::remove_all;
 
 namespace sr::tests
 {
-    TEST_CLASS(SchemeTests)
-    {
-    private:
-
-        static constexpr size_t processor_count { 4 };
-        static constexpr size_t all_count { 8 };
+    constexpr size_t processor_count { 4 };
+    constexpr size_t all_count { 8 };
 
-        const SchemeDto<all_count, processor_count> greedy_scheme_dto
+    const SchemeDto<all_count, processor_count> greedy_scheme_dto
+    {
+        .scheme_name = "simple",
+        .elements =
+        {
+            ElementDto { .name = "c1", .p = 0.8, .q = 0.2 },
+            ElementDto { .name = "d1", .p = 0.8, .q = 0.2 },
+            ElementDto { .name = "d2", .p = 0.8, .q = 0.2 },
+            ElementDto { .name = "c2", .p = 0.8, .q = 0.2 }
+        },
+        .processors =
         {
-            .scheme_name = "simple",
-            .elements =
+            ProcessorDto
             {
-                ElementDto { .name = "c1", .p = 0.8, .q = 0.2 },
-                ElementDto { .name = "d1", .p = 0.8, .q = 0.2 },
-                ElementDto { .name = "d2", .p = 0.8, .q = 0.2 },
-                ElementDto { .name = "c2", .p = 0.8, .q = 0.2 }
+                .name = "p1", .p = 0.9, .q = 0.1, .normal_load = 40, .max_load = 100,
+                .transitions = { { TrUnit(1, 40) }, { TrUnit(1, 20), TrUnit(2, 10), TrUnit(3, 10) } }
             },
-            .processors =
+            ProcessorDto
             {
-                ProcessorDto
-                {
-                    .name = "p1", .p = 0.9, .q = 0.1, .normal_load = 40, .max_load = 100,
-                    .transitions = { { TrUnit(1, 40) }, { TrUnit(1, 20), TrUnit(2, 10), TrUnit(3, 10) } }
-                },
-                ProcessorDto
-                {
-                    .name = "p2", .p = 0.9, .q = 0.1, .normal_load = 20, .max_load = 100,
-                    .transitions = { { TrUnit(0, 20) }, { TrUnit(0, 10), TrUnit(2, 10) }, { TrUnit(0, 10), TrUnit(3, 10) } } 
-                },
-                ProcessorDto
-                {
-                    .name = "p3", .p = 0.9, .q = 0.1, .normal_load = 30, .max_load = 50,
-                    .transitions = { { TrUnit(0, 20), TrUnit(1, 10) }, { TrUnit(0, 10), TrUnit(1, 20) } } 
-                },
-                ProcessorDto
-                {
-                    .name = "p4", .p = 0.9, .q = 0.1, .normal_load = 30, .max_load = 50,
-                    .transitions = { { TrUnit(0, 20), TrUnit(1, 10) }, { TrUnit(0, 10), TrUnit(1, 20) } } 
-                }
+                .name = "p2", .p = 0.9, .q = 0.1, .normal_load = 20, .max_load = 100,
+                .transitions = { { TrUnit(0, 20) }, { TrUnit(0, 10), TrUnit(2, 10) }, { TrUnit(0, 10), TrUnit(3, 10) } }
             },
-            .scheme_function = [](const StateVectorDto<all_count, processor_count>& sv)
+            ProcessorDto
             {
-                return sv.all[0] && sv.all[1] && (sv.all[2] || sv.all[3]) && sv.all[4] && (sv.all[5] || sv.all[6]) && sv.all[7];
+                .name = "p3", .p = 0.9, .q = 0.1, .normal_load = 30, .max_load = 50,
+                .transitions = { { TrUnit(0, 20), TrUnit(1, 10) }, { TrUnit(0, 10), TrUnit(1, 20) } }
             },
-            .type = SchemeType::Greedy
-        };
-        
+            ProcessorDto
+            {
+                .name = "p4", .p = 0.9, .q = 0.1, .normal_load = 30, .max_load = 50,
+                .transitions = { { TrUnit(0, 20), TrUnit(1, 10) }, { TrUnit(0, 10), TrUnit(1, 20) } }
+            }
+        },
+        .scheme_function = [](const StateVectorDto<all_count, processor_count>& sv)
+        {
+            return sv.all[0] && sv.all[1] && (sv.all[2] || sv.all[3]) && sv.all[4] && (sv.all[5] || sv.all[6]) && sv.all[7];
+        },
+        .type = SchemeType::Greedy
+    };
+
+    // greedy_scheme_dto as a scheme file.
+    const string simple_scheme_text
+    {
+        "scheme simple-dynamic\n"
+        "processor p1 p=0.9 q=0.1 normal=40 max=100\n"
+        "processor p2 p=0.9 q=0.1 normal=20 max=100\n"
+        "processor p3 p=0.9 q=0.1 normal=30 max=50\n"
+        "processor p4 p=0.9 q=0.1 normal=30 max=50\n"
+        "transition p1 p2:40\n"
+        "transition p1 p2:20 p3:10 p4:10\n"
+        "transition p2 p1:20\n"
+        "transition p2 p1:10 p3:10\n"
+        "transition p2 p1:10 p4:10\n"
+        "transition p3 p1:20 p2:10\n"
+        "transition p3 p1:10 p2:20\n"
+        "transition p4 p1:20 p2:10\n"
+        "transition p4 p1:10 p2:20\n"
+        "element c1 p=0.8 q=0.2\n"
+        "element d1 p=0.8 q=0.2\n"
+        "element d2 p=0.8 q=0.2\n"
+        "element c2 p=0.8 q=0.2\n"
+        "function p1 & p2 & (p3 | p4) & c1 & (d1 | d2) & c2\n"
+    };
+
+    // Greedy moves p1's load to p3 first, which leaves no room for p2's.
+    const string beam_trap_scheme_text
+    {
+        "scheme beam-trap\n"
+        "processor p1 q=0.1 normal=40 max=100\n"
+        "processor p2 q=0.1 normal=70 max=100\n"
+        "processor p3 q=0.1 normal=100 max=200\n"
+        "processor p4 q=0.1 normal=50 max=100\n"
+        "transition p1 p3:40\n"
+        "transition p1 p4:40\n"
+        "transition p2 p3:70\n"
+        "element c1 q=0.1\n"
+        "function p1 & p2 & p3 & p4 & c1\n"
+    };
+
+    // greedy_scheme_dto under brute force, in a result directory of its own.
+    SchemeDto<all_count, processor_count> make_brute_scheme_dto()
+    {
+        SchemeDto<all_count, processor_count> brute_scheme_dto { greedy_scheme_dto };
+        brute_scheme_dto.scheme_name = "simple-brute";
+        brute_scheme_dto.type = SchemeType::Brute;
+        return brute_scheme_dto;
+    }
+
+    TEST_CLASS(SchemeTests)
+    {
     public:
 
         TEST_METHOD(calculate_scheme_reliability_brute_force)
@@ -80,4 +130,785 @@ namespace sr::tests
             Assert::AreEqual((size_t)256, result.state_vector_set_count);
         }
     };
-}
\ No newline at end of file
+
+    TEST_CLASS(MetricsTests)
+    {
+    public:
+
+        TEST_METHOD(calculate_scheme_reliability_metrics)
+        {
+            MetricsSnapshotDto last_snapshot { };
+            CalculationOptionsDto options
+            {
+                .thread_count = 2,
+                .metrics_callback = [&last_snapshot](const MetricsSnapshotDto& snapshot) { last_snapshot = snapshot; }
+            };
+
+            SchemeReliabilitySummaryDto result
+            {
+                calculate_scheme_reliability<all_count, processor_count>(greedy_scheme_dto, options)
+            };
+
+            Assert::AreEqual(result.state_vector_set_count, last_snapshot.states_processed);
+            Assert::AreEqual((size_t)2, last_snapshot.workers.size());
+            Assert::AreEqual((size_t)0, last_snapshot.queue_depth);
+            Assert::AreEqual(
+                last_snapshot.states_processed,
+                last_snapshot.reconfiguration_noop_count +
+                last_snapshot.reconfiguration_success_count +
+                last_snapshot.reconfiguration_best_zero_count
+            );
+        }
+    };
+
+    TEST_CLASS(RunControlTests)
+    {
+    public:
+
+        TEST_METHOD(calculate_scheme_reliability_cancelled)
+        {
+            stop_source cancellation { };
+            cancellation.request_stop();
+
+            SchemeReliabilitySummaryDto result
+            {
+                calculate_scheme_reliability<all_count, processor_count>(
+                    greedy_scheme_dto,
+                    CalculationOptionsDto { .cancellation_token = cancellation.get_token() }
+                )
+            };
+
+            Assert::IsTrue(result.is_partial);
+            Assert::IsTrue(result.state_vector_set_count < 256);
+            Assert::IsTrue(result.sp_low <= 0.60715008000000004 + 1e-12);
+            Assert::IsTrue(result.sp_high >= 0.60715008000000004 - 1e-12);
+            Assert::IsTrue(fabs(result.sp + result.sq + result.unvisited_probability - 1.0) <= 1e-9);
+        }
+    };
+
+    TEST_CLASS(AnalysisTests)
+    {
+    public:
+
+        TEST_METHOD(analyze_scheme_result_matches_run)
+        {
+            SchemeReliabilitySummaryDto result
+            {
+                calculate_scheme_reliability<all_count, processor_count>(greedy_scheme_dto, { .thread_count = 2 })
+            };
+
+            ResultAnalysisDto analysis
+            {
+                analyze_scheme_result(result.result_path, { .thread_count = 2, .group_elements = { "p1", "p2" } })
+            };
+
+            Assert::AreEqual(result.state_vector_set_count, analysis.record_count);
+            Assert::IsTrue(fabs(result.sp - analysis.sp) <= 1e-12);
+            Assert::IsTrue(fabs(result.sq - analysis.sq) <= 1e-12);
+            Assert::AreEqual((size_t)0, analysis.inconsistent_count);
+            Assert::AreEqual(all_count, analysis.elements.size());
+            Assert::AreEqual((size_t)4, analysis.groups.size());
+
+            size_t sv1_group_total { 0 };
+            for (const MaskGroupStatisticsDto& group : analysis.groups)
+                sv1_group_total += group.sv1_count;
+            Assert::AreEqual(analysis.record_count, sv1_group_total);
+            Assert::AreEqual((size_t)64, analysis.groups[0b11].sv1_count);
+        }
+    };
+
+    TEST_CLASS(ArrowOutputTests)
+    {
+    public:
+
+        TEST_METHOD(calculate_scheme_reliability_arrow_output)
+        {
+            CalculationOptionsDto options
+            {
+                .thread_count = 1,
+                .output_format = OutputFormat::Arrow
+            };
+
+            SchemeReliabilitySummaryDto result
+            {
+                calculate_scheme_reliability<all_count, processor_count>(greedy_scheme_dto, options)
+            };
+
+            auto arrow_file_path { result.result_path / "simple-0.arrow" };
+            size_t size { static_cast<size_t>(file_size(arrow_file_path)) };
+            ifstream arrow_file { arrow_file_path, std::ios::binary };
+            string head(6, '\0');
+            string tail(6, '\0');
+            arrow_file.read(head.data(), 6);
+            arrow_file.seekg(size - 6);
+            arrow_file.read(tail.data(), 6);
+
+            Assert::AreEqual(string { "ARROW1" }, head);
+            Assert::AreEqual(string { "ARROW1" }, tail);
+            Assert::IsTrue(fabs(result.sp - 0.60715008000000004) <= 1e-9);
+        }
+    };
+
+    TEST_CLASS(CutSetTests)
+    {
+    public:
+
+        TEST_METHOD(find_minimal_cut_sets_up_to_order_2)
+        {
+            CutSetReportDto report
+            {
+                find_minimal_cut_sets<all_count, processor_count>(greedy_scheme_dto, { .max_order = 2 })
+            };
+
+            Assert::AreEqual((size_t)4, report.cut_sets.size());
+            Assert::AreEqual(string { "c1" }, report.cut_sets[0].elements[0]);
+            Assert::AreEqual(string { "c2" }, report.cut_sets[1].elements[0]);
+            Assert::AreEqual((size_t)2, report.cut_sets[2].elements.size());
+            Assert::AreEqual(string { "d1" }, report.cut_sets[2].elements[0]);
+            Assert::AreEqual(string { "d2" }, report.cut_sets[2].elements[1]);
+            Assert::IsTrue(fabs(report.cut_sets[0].probability - 0.2) <= 1e-12);
+            Assert::IsTrue(report.skipped_superset_count > 0);
+        }
+    };
+
+    TEST_CLASS(TopFailureStateTests)
+    {
+    public:
+
+        TEST_METHOD(calculate_scheme_reliability_top_failure_states)
+        {
+            CalculationOptionsDto options
+            {
+                .thread_count = 3,
+                .top_failure_state_count = 3
+            };
+
+            SchemeReliabilitySummaryDto result
+            {
+                calculate_scheme_reliability<all_count, processor_count>(greedy_scheme_dto, options)
+            };
+
+            Assert::AreEqual((size_t)3, result.top_failure_states.size());
+            double sum { 0 };
+            for (size_t i = 0; i < result.top_failure_states.size(); i++)
+            {
+                const FailureStateDto& state { result.top_failure_states[i] };
+                Assert::AreEqual(all_count, state.sv1.size());
+                if (i > 0)
+                    Assert::IsTrue(result.top_failure_states[i - 1].probability >= state.probability);
+                sum += state.probability;
+            }
+            Assert::IsTrue(sum <= 1 - result.sp + 1e-12);
+            Assert::IsTrue(fabs(result.sp - 0.60715008000000004) <= 1e-9);
+        }
+    };
+
+    TEST_CLASS(ReliabilityBoundsTests)
+    {
+    public:
+
+        TEST_METHOD(estimate_reliability_bounds_contain_sp)
+        {
+            const double sp { 0.60715008000000004 };
+            for (size_t max_order = 0; max_order <= all_count; max_order++)
+            {
+                ReliabilityBoundsDto bounds
+                {
+                    estimate_reliability_bounds<all_count, processor_count>(greedy_scheme_dto, { .max_order = max_order })
+                };
+                Assert::IsTrue(bounds.sp_low <= sp + 1e-12);
+                Assert::IsTrue(bounds.sp_high >= sp - 1e-12);
+            }
+
+            CalculationOptionsDto options
+            {
+                .thread_count = 1,
+                .target_reliability = 0.6,
+                .bound_options = { .max_order = 3 },
+                .skip_decided_run = true
+            };
+            SchemeReliabilitySummaryDto result
+            {
+                calculate_scheme_reliability<all_count, processor_count>(greedy_scheme_dto, options)
+            };
+            Assert::IsTrue(result.is_decided_by_bounds);
+            Assert::IsTrue(result.meets_target_reliability.value());
+
+            options.target_reliability = 0.62;
+            result = calculate_scheme_reliability<all_count, processor_count>(greedy_scheme_dto, options);
+            Assert::IsFalse(result.is_decided_by_bounds);
+            Assert::IsFalse(result.meets_target_reliability.value());
+            Assert::IsTrue(fabs(result.sp - sp) <= 1e-9);
+        }
+    };
+
+    TEST_CLASS(SchemeFileTests)
+    {
+    public:
+
+        TEST_METHOD(calculate_dynamic_scheme_reliability)
+        {
+            for (SchemeType type : { SchemeType::Greedy, SchemeType::Brute, SchemeType::Beam })
+            {
+                DynamicSchemeDto scheme { parse_scheme(simple_scheme_text) };
+                scheme.type = type;
+                Assert::AreEqual(all_count, scheme.all_count());
+
+                SchemeReliabilitySummaryDto result { calculate_scheme_reliability(scheme, { .thread_count = 2 }) };
+                Assert::AreEqual((size_t)256, result.state_vector_set_count);
+                Assert::IsTrue(fabs(result.sp - 0.60715008000000004) <= 1e-9);
+            }
+
+            Assert::ExpectException<std::runtime_error>([]() { parse_scheme(simple_scheme_text + "function p1 & x9\n"); });
+            // The name becomes a result directory that each run removes.
+            Assert::ExpectException<std::runtime_error>([]() { parse_scheme(simple_scheme_text + "scheme ..\n"); });
+            Assert::ExpectException<std::runtime_error>([]() { parse_scheme(simple_scheme_text + "scheme results/simple\n"); });
+
+            // Options only the templated engines implement are refused, not ignored.
+            DynamicSchemeDto scheme { parse_scheme(simple_scheme_text) };
+            Assert::ExpectException<std::runtime_error>([&scheme]() { calculate_scheme_reliability(scheme, { .output_format = OutputFormat::Arrow }); });
+            Assert::ExpectException<std::runtime_error>([&scheme]() { calculate_scheme_reliability(scheme, { .top_failure_state_count = 3 }); });
+            Assert::ExpectException<std::runtime_error>([&scheme]() { calculate_scheme_reliability(scheme, { .target_reliability = 0.5 }); });
+            Assert::ExpectException<std::runtime_error>([&scheme]() { calculate_scheme_reliability(scheme, { .collect_load_statistics = true }); });
+        }
+    };
+
+    TEST_CLASS(VariantTests)
+    {
+    public:
+
+        TEST_METHOD(calculate_scheme_variants_reliability_in_one_enumeration)
+        {
+            SchemeDto<all_count, processor_count> brute_scheme_dto { make_brute_scheme_dto() };
+
+            SchemeDto<all_count, processor_count> processors_only_scheme_dto { greedy_scheme_dto };
+            processors_only_scheme_dto.scheme_name = "simple-processors-only";
+            processors_only_scheme_dto.scheme_function = [](const StateVectorDto<all_count, processor_count>& sv)
+            {
+                return sv.all[0] && sv.all[1] && (sv.all[2] || sv.all[3]);
+            };
+
+            MultiVariantSummaryDto result
+            {
+                calculate_scheme_variants_reliability<all_count, processor_count>(
+                    { greedy_scheme_dto, brute_scheme_dto, processors_only_scheme_dto },
+                    { .thread_count = 2 }
+                )
+            };
+
+            Assert::AreEqual((size_t)3, result.variants.size());
+            Assert::IsTrue(fabs(result.variants[0].sp - 0.60715008000000004) <= 1e-9);
+            Assert::IsTrue(fabs(result.variants[1].sp - 0.60715008000000004) <= 1e-9);
+            Assert::IsTrue(fabs(result.variants[2].sp - 0.9882) <= 1e-9);
+
+            Assert::AreEqual((size_t)3, result.pairwise_disagreements.size());
+            Assert::AreEqual((size_t)0, result.pairwise_disagreements[0].state_count);
+            Assert::IsTrue(fabs(result.pairwise_disagreements[1].probability - (0.9882 - 0.60715008000000004)) <= 1e-9);
+            Assert::AreEqual(result.pairwise_disagreements[1].state_count, result.disagreement_state_count);
+        }
+    };
+
+    TEST_CLASS(StrategyComparisonTests)
+    {
+    public:
+
+        TEST_METHOD(compare_reconfiguration_strategies_on_simple_scheme)
+        {
+            StrategyComparisonDto result
+            {
+                compare_reconfiguration_strategies<all_count, processor_count>(greedy_scheme_dto, { .thread_count = 2 })
+            };
+
+            Assert::IsTrue(fabs(result.greedy.sp - 0.60715008000000004) <= 1e-9);
+            Assert::IsTrue(fabs(result.brute.sp - 0.60715008000000004) <= 1e-9);
+            Assert::AreEqual((size_t)256, result.brute.state_vector_set_count);
+            Assert::AreEqual((size_t)0, result.divergent_state_count);
+            Assert::IsTrue(result.top_divergent_masks.empty());
+            Assert::IsTrue(result.skipped_brute_count > 0);
+        }
+    };
+
+    TEST_CLASS(BeamSearchTests)
+    {
+    public:
+
+        TEST_METHOD(calculate_beam_scheme_reliability)
+        {
+            SchemeDto<all_count, processor_count> beam_scheme_dto { greedy_scheme_dto };
+            beam_scheme_dto.type = SchemeType::Beam;
+            SchemeReliabilitySummaryDto result
+            {
+                calculate_scheme_reliability<all_count, processor_count>(beam_scheme_dto, { .thread_count = 2 })
+            };
+            Assert::IsTrue(fabs(result.sp - 0.60715008000000004) <= 1e-9);
+
+            DynamicSchemeDto scheme { parse_scheme(beam_trap_scheme_text) };
+            double greedy_sp { calculate_scheme_reliability(scheme).sp };
+            scheme.type = SchemeType::Brute;
+            double brute_sp { calculate_scheme_reliability(scheme).sp };
+            scheme.type = SchemeType::Beam;
+            scheme.beam_options.width = 1;
+            double narrow_beam_sp { calculate_scheme_reliability(scheme).sp };
+            scheme.beam_options.width = 2;
+            double beam_sp { calculate_scheme_reliability(scheme).sp };
+
+            Assert::IsTrue(fabs(greedy_sp - 0.72171) <= 1e-9);
+            Assert::IsTrue(fabs(brute_sp - 0.729) <= 1e-9);
+            Assert::IsTrue(fabs(narrow_beam_sp - greedy_sp) <= 1e-12);
+            Assert::IsTrue(fabs(beam_sp - brute_sp) <= 1e-12);
+        }
+    };
+
+    TEST_CLASS(BruteForceTests)
+    {
+    public:
+
+        TEST_METHOD(brute_force_starts_from_greedy_choice)
+        {
+            SchemeDto<all_count, processor_count> brute_scheme_dto { make_brute_scheme_dto() };
+
+            SchemeReliabilitySummaryDto greedy_result
+            {
+                calculate_scheme_reliability<all_count, processor_count>(greedy_scheme_dto, { .thread_count = 1 })
+            };
+            SchemeReliabilitySummaryDto brute_result
+            {
+                calculate_scheme_reliability<all_count, processor_count>(brute_scheme_dto, { .thread_count = 1 })
+            };
+
+            // Greedy is optimal for the simple scheme, so brute force settles on the very
+            // same reconfigured states.
+            auto read_file = [](const auto& file_path)
+            {
+                ifstream file { file_path, std::ios::binary };
+                return string { std::istreambuf_iterator<char> { file }, { } };
+            };
+            Assert::IsTrue(fabs(greedy_result.sp - brute_result.sp) <= 1e-12);
+            Assert::IsTrue(
+                read_file(greedy_result.result_path / "simple-0.ssv") ==
+                read_file(brute_result.result_path / "simple-brute-0.ssv")
+            );
+        }
+    };
+
+    TEST_CLASS(TransitionTableTests)
+    {
+    public:
+
+        TEST_METHOD(normalize_transition_table_removals)
+        {
+            DynamicSchemeDto scheme
+            {
+                parse_scheme(
+                    "scheme normalized\n"
+                    "processor p1 q=0.1 normal=40 max=100\n"
+                    "processor p2 q=0.1 normal=70 max=100\n"
+                    "processor p3 q=0.1 normal=100 max=200\n"
+                    "transition p1 p3:40\n"
+                    "transition p1 p3:40\n"
+                    "transition p1 p2:20 p3:50\n"
+                    "transition p1 p2:40\n"
+                    "transition p2 p3:70\n"
+                    "transition p3 p3:10\n"
+                    "element c1 q=0.1\n"
+                    "function p1 & p2 & p3 & c1\n"
+                )
+            };
+
+            TransitionNormalizationReportDto report { sr::normalize_transition_table(scheme) };
+            Assert::AreEqual((size_t)6, report.transition_count);
+            Assert::AreEqual((size_t)5, report.kept_transition_count);
+            Assert::AreEqual((size_t)1, report.removed_transitions.size());
+            Assert::IsTrue(report.removed_transitions[0].reason == TransitionRemovalReason::Duplicate);
+
+            scheme.brute_options.is_dropping_impossible_transitions = true;
+            report = sr::normalize_transition_table(scheme);
+            Assert::AreEqual((size_t)3, report.kept_transition_count);
+            Assert::AreEqual((size_t)4, report.removed_transitions.size());
+            Assert::IsTrue(report.removed_transitions[0].reason == TransitionRemovalReason::Impossible);
+            Assert::AreEqual((size_t)3, report.removed_transitions[0].transition_idx);
+            Assert::IsTrue(report.removed_transitions[1].reason == TransitionRemovalReason::Duplicate);
+            Assert::IsTrue(report.removed_transitions[2].reason == TransitionRemovalReason::Dominated);
+            Assert::AreEqual((size_t)2, report.removed_transitions[3].processor_idx);
+
+            // Dominance doesn't hold for a negated scheme function.
+            scheme.brute_options.is_dropping_impossible_transitions = false;
+            scheme.scheme_expression.push_back(ExpressionOpDto { .code = ExpressionOpCode::Not, .element_idx = 0 });
+            Assert::AreEqual((size_t)0, sr::normalize_transition_table(scheme).removed_transitions.size());
+
+            Assert::AreEqual((size_t)0, sr::normalize_transition_table<all_count, processor_count>(greedy_scheme_dto).removed_transitions.size());
+
+            // A templated scheme function may be non-monotone, so pruning is opt-in.
+            SchemeDto<all_count, processor_count> duplicated_scheme_dto { greedy_scheme_dto };
+            duplicated_scheme_dto.processors[0].transitions.push_back(duplicated_scheme_dto.processors[0].transitions[0]);
+            Assert::AreEqual((size_t)0, sr::normalize_transition_table<all_count, processor_count>(duplicated_scheme_dto).removed_transitions.size());
+            duplicated_scheme_dto.brute_options.is_pruning_transitions = true;
+            Assert::AreEqual((size_t)1, sr::normalize_transition_table<all_count, processor_count>(duplicated_scheme_dto).removed_transitions.size());
+        }
+    };
+
+    TEST_CLASS(ConditionalTests)
+    {
+    public:
+
+        TEST_METHOD(calculate_conditional_reliability_matches_breakdown)
+        {
+            ConditionalBreakdownDto breakdown
+            {
+                calculate_conditional_breakdown<all_count, processor_count>(greedy_scheme_dto, { "p1", "p2", "p3" }, { .thread_count = 2 })
+            };
+
+            Assert::AreEqual((size_t)8, breakdown.assignments.size());
+            Assert::IsTrue(fabs(breakdown.sp - 0.60715008000000004) <= 1e-12);
+            Assert::IsTrue(fabs(breakdown.assignments[0].assignment_probability - 0.729) <= 1e-12);
+            Assert::IsTrue(fabs(breakdown.assignments[0].conditional_sp - 0.6144) <= 1e-12);
+            Assert::IsTrue(fabs(breakdown.assignments[0b011].conditional_sp - 0.55296) <= 1e-12);
+            Assert::IsTrue(breakdown.assignments[0b110].conditional_sp == 0);
+
+            ConditionalReliabilityDto conditional
+            {
+                calculate_conditional_reliability<all_count, processor_count>(
+                    greedy_scheme_dto,
+                    { { .name = "p1", .is_working = true }, { .name = "p2", .is_working = false }, { .name = "p3", .is_working = false } }
+                )
+            };
+            Assert::AreEqual((size_t)32, conditional.state_vector_set_count);
+            Assert::IsTrue(fabs(conditional.conditional_sp - breakdown.assignments[0b011].conditional_sp) <= 1e-12);
+            Assert::IsTrue(fabs(conditional.sp - breakdown.assignments[0b011].sp) <= 1e-12);
+            Assert::IsTrue(fabs(conditional.conditional_sp + conditional.conditional_sq - 1.0) <= 1e-12);
+        }
+    };
+
+    TEST_CLASS(ResultCacheTests)
+    {
+    public:
+
+        TEST_METHOD(calculate_scheme_reliability_cached)
+        {
+            SchemeDto<all_count, processor_count> scheme_dto { greedy_scheme_dto };
+            scheme_dto.scheme_function_version = "1";
+            const CalculationOptionsDto options { .thread_count = 1, .result_cache_path = "sr-test-cache" };
+
+            SchemeReliabilitySummaryDto first { calculate_scheme_reliability<all_count, processor_count>(scheme_dto, options) };
+            SchemeReliabilitySummaryDto second { calculate_scheme_reliability<all_count, processor_count>(scheme_dto, options) };
+            Assert::IsFalse(first.is_cached);
+            Assert::IsTrue(second.is_cached);
+            Assert::AreEqual(first.sp, second.sp);
+            Assert::AreEqual(first.state_vector_set_count, second.state_vector_set_count);
+
+            scheme_dto.elements[0].p = 0.7;
+            scheme_dto.elements[0].q = 0.3;
+            Assert::IsFalse(calculate_scheme_reliability<all_count, processor_count>(scheme_dto, options).is_cached);
+
+            // The run above rewrote the result directory the first entry points to.
+            scheme_dto.elements[0] = greedy_scheme_dto.elements[0];
+            Assert::IsFalse(calculate_scheme_reliability<all_count, processor_count>(scheme_dto, options).is_cached);
+        }
+    };
+
+    TEST_CLASS(WhatIfTests)
+    {
+    public:
+
+        TEST_METHOD(reweight_outcome_bitmap_and_answer_what_if)
+        {
+            DynamicSchemeDto scheme { parse_scheme(beam_trap_scheme_text) };
+            OutcomeBitmapDto bitmap { calculate_outcome_bitmap(scheme, 1) };
+            vector<double> p(scheme.all_count(), 0.9);
+            vector<double> q(scheme.all_count(), 0.1);
+            ReweightedReliabilityDto reliability { reweight_outcome_bitmap(bitmap, p, q) };
+            Assert::IsTrue(fabs(reliability.sp - 0.72171) <= 1e-12);
+            Assert::IsTrue(fabs(reliability.sp + reliability.sq - 1.0) <= 1e-12);
+
+            // New p/q only re-weight the states, the outcome stays.
+            scheme.processors[2].p = p[2] = 0.6;
+            scheme.processors[2].q = q[2] = 0.4;
+            reliability = reweight_outcome_bitmap(bitmap, p, q);
+            Assert::IsTrue(fabs(reliability.sp - calculate_scheme_reliability(scheme).sp) <= 1e-12);
+
+            // The cached bitmap is keyed without p/q.
+            remove_all("sr-test-outcome-cache");
+            Assert::IsTrue(calculate_outcome_bitmap(scheme, 1, "sr-test-outcome-cache").words == bitmap.words);
+            Assert::IsTrue(calculate_outcome_bitmap(parse_scheme(beam_trap_scheme_text), 1, "sr-test-outcome-cache").words == bitmap.words);
+
+            ReweightedImportanceDto importance { reweight_outcome_importance(bitmap, p, q) };
+            Assert::IsTrue(fabs(importance.sp - reliability.sp) <= 1e-12);
+            vector<double> failed_p { p };
+            vector<double> failed_q { q };
+            failed_p[2] = 0.0;
+            failed_q[2] = 1.0;
+            Assert::IsTrue(fabs(importance.sp_failed[2] - reweight_outcome_bitmap(bitmap, failed_p, failed_q).sp) <= 1e-12);
+
+            {
+                ofstream scheme_file { "whatif-test.scheme" };
+                scheme_file << beam_trap_scheme_text;
+            }
+            WhatIfSession session { "whatif-test.scheme", 1 };
+            Assert::IsTrue(session.answer(R"({"query": "reliability", "failed": ["c1"]})").starts_with(R"({"ok":true,"query":"reliability","sp":0,)"));
+            Assert::IsTrue(session.answer(R"({"query": "importance", "max_load": {"p3": 150}})").starts_with(R"({"ok":true)"));
+            Assert::IsTrue(session.answer(R"({"failed": ["x9"]})").starts_with(R"({"ok":false)"));
+            Assert::IsTrue(session.answer(R"({"query": "importance", "max_load": {"p3": 150}})").find(R"("topology_built":false)") != string::npos);
+            Assert::IsTrue(session.answer(string(100, '[')).find("nested deeper") != string::npos);
+        }
+    };
+
+    TEST_CLASS(OutcomeBitmapTests)
+    {
+    public:
+
+        TEST_METHOD(calculate_scheme_reliability_bitmap_output)
+        {
+            CalculationOptionsDto options
+            {
+                .thread_count = 2,
+                .output_format = OutputFormat::Bitmap
+            };
+
+            SchemeReliabilitySummaryDto result
+            {
+                calculate_scheme_reliability<all_count, processor_count>(greedy_scheme_dto, options)
+            };
+
+            OutcomeBitmapDto bitmap { read_outcome_bitmap(result.result_path / "simple.outcome") };
+            vector<double> p(all_count);
+            vector<double> q(all_count);
+            for (size_t i = 0; i < all_count; i++)
+            {
+                p[i] = i < processor_count ? greedy_scheme_dto.processors[i].p : greedy_scheme_dto.elements[i - processor_count].p;
+                q[i] = 1.0 - p[i];
+            }
+            ReweightedReliabilityDto reweighted { reweight_outcome_bitmap(bitmap, p, q) };
+
+            Assert::AreEqual(all_count, bitmap.all_count);
+            Assert::IsTrue(fabs(reweighted.sp - result.sp) <= 1e-12);
+        }
+
+        TEST_METHOD(calculate_scheme_reliability_cancelled_bitmap_output)
+        {
+            stop_source cancellation { };
+            cancellation.request_stop();
+            CalculationOptionsDto options
+            {
+                .thread_count = 2,
+                .output_format = OutputFormat::Bitmap,
+                .cancellation_token = cancellation.get_token()
+            };
+
+            SchemeReliabilitySummaryDto result
+            {
+                calculate_scheme_reliability<all_count, processor_count>(greedy_scheme_dto, options)
+            };
+            Assert::IsTrue(result.is_partial);
+            Assert::IsFalse(exists(result.result_path / "simple.outcome"));
+
+            DynamicSchemeDto scheme { parse_scheme(simple_scheme_text) };
+            result = calculate_scheme_reliability(scheme, options);
+            Assert::IsTrue(result.is_partial);
+            Assert::IsFalse(exists(result.result_path / "simple-dynamic.outcome"));
+        }
+    };
+
+    TEST_CLASS(SummationTests)
+    {
+    public:
+
+        TEST_METHOD(calculate_scheme_reliability_thread_count_independent)
+        {
+            // 2^18 states in 64 chunks, so the workers share the chunks differently per run.
+            string scheme_text
+            {
+                "scheme wide-dynamic\n"
+                "processor p1 q=0.1 normal=40 max=100\n"
+                "processor p2 q=0.1 normal=20 max=100\n"
+                "processor p3 q=0.1 normal=30 max=50\n"
+                "processor p4 q=0.1 normal=30 max=50\n"
+                "transition p1 p2:40\n"
+                "transition p3 p1:20 p2:10\n"
+                "transition p4 p1:10 p2:20\n"
+                "function p1 & p2 & (p3 | p4)\n"
+            };
+            for (size_t i = 1; i <= 14; i += 2)
+            {
+                scheme_text += "element e" + to_string(i) + " q=1.7e-" + to_string(i % 5 + 1) + "\n";
+                scheme_text += "element e" + to_string(i + 1) + " q=3.1e-" + to_string(i % 3 + 2) + "\n";
+                scheme_text += "function e" + to_string(i) + " | e" + to_string(i + 1) + "\n";
+            }
+
+            DynamicSchemeDto scheme { parse_scheme(scheme_text) };
+            SchemeReliabilitySummaryDto first { calculate_scheme_reliability(scheme, { .thread_count = 1 }) };
+            for (size_t thread_count : { 2, 3, 5 })
+            {
+                SchemeReliabilitySummaryDto result { calculate_scheme_reliability(scheme, { .thread_count = thread_count }) };
+                Assert::AreEqual(first.sp, result.sp);
+                Assert::AreEqual(first.sq, result.sq);
+            }
+        }
+    };
+
+    TEST_CLASS(MaskMapTests)
+    {
+    public:
+
+        TEST_METHOD(calculate_scheme_reliability_mask_map_output)
+        {
+            CalculationOptionsDto options
+            {
+                .thread_count = 2,
+                .output_format = OutputFormat::MaskMap
+            };
+
+            SchemeReliabilitySummaryDto result
+            {
+                calculate_scheme_reliability<all_count, processor_count>(greedy_scheme_dto, options)
+            };
+
+            ifstream mask_map_file { result.result_path / "simple.masks.csv" };
+            string line { };
+            getline(mask_map_file, line);
+            Assert::AreEqual(string { "sv1,sv2,state_count,probability,sp,sq,transitions,load" }, line);
+
+            // Greedy maps every sv1 mask to a single sv2 mask.
+            size_t row_count { 0 };
+            double sp { 0 };
+            while (getline(mask_map_file, line))
+            {
+                vector<string> fields { };
+                stringstream row { line };
+                for (string field { }; getline(row, field, ',');)
+                    fields.push_back(field);
+                Assert::AreEqual((size_t)8, fields.size());
+                sp += stod(fields[4]);
+                row_count++;
+            }
+            Assert::AreEqual((size_t)16, row_count);
+            Assert::IsTrue(fabs(sp - result.sp) <= 1e-12);
+        }
+    };
+
+    TEST_CLASS(LoadStatisticsTests)
+    {
+    public:
+
+        TEST_METHOD(calculate_scheme_reliability_load_statistics)
+        {
+            SchemeReliabilitySummaryDto result
+            {
+                calculate_scheme_reliability<all_count, processor_count>(greedy_scheme_dto, { .thread_count = 2, .collect_load_statistics = true })
+            };
+
+            const LoadStatisticsDto& statistics { result.load_statistics.value() };
+            Assert::AreEqual(processor_count, statistics.processors.size());
+            Assert::AreEqual((size_t)9, statistics.transitions.size());
+            for (const ProcessorLoadStatisticsDto& processor : statistics.processors)
+            {
+                double working_probability { 0 };
+                for (double probability : processor.load_histogram)
+                    working_probability += probability;
+                Assert::IsTrue(fabs(working_probability - 0.9) <= 1e-12);
+                Assert::AreEqual(0.0, processor.overload_probability);
+            }
+            Assert::IsTrue(fabs(statistics.processors[0].expected_load - 38.529) <= 1e-9);
+
+            // p3 always prefers its second transition, which leaves p1 less loaded.
+            Assert::AreEqual((size_t)0, statistics.transitions[5].state_count);
+            Assert::IsTrue(fabs(statistics.transitions[6].probability - 0.081) <= 1e-12);
+
+            // Brute force searches a normalized table; usage still follows the declared one.
+            SchemeDto<all_count, processor_count> brute_scheme_dto { make_brute_scheme_dto() };
+            brute_scheme_dto.brute_options.is_pruning_transitions = true;
+            brute_scheme_dto.processors[0].transitions.push_back(brute_scheme_dto.processors[0].transitions[0]);
+            size_t duplicate_idx { brute_scheme_dto.processors[0].transitions.size() - 1 };
+            result = calculate_scheme_reliability<all_count, processor_count>(brute_scheme_dto, { .thread_count = 2, .collect_load_statistics = true });
+            const LoadStatisticsDto& brute_statistics { result.load_statistics.value() };
+            Assert::AreEqual((size_t)10, brute_statistics.transitions.size());
+            Assert::AreEqual(duplicate_idx, brute_statistics.transitions[duplicate_idx].transition_idx);
+            Assert::AreEqual((size_t)0, brute_statistics.transitions[duplicate_idx].state_count);
+            Assert::IsTrue(brute_statistics.transitions[0].state_count > 0);
+        }
+    };
+
+    TEST_CLASS(GeneratorTests)
+    {
+    public:
+
+        TEST_METHOD(generate_scheme_round_trips_through_scheme_file)
+        {
+            GeneratorOptionsDto options { };
+            options.element_count = 14;
+            options.processor_count = 5;
+            options.seed = 7;
+
+            DynamicSchemeDto scheme { generate_scheme(options) };
+            Assert::AreEqual((size_t)19, scheme.all_count());
+            Assert::AreEqual(format_scheme(scheme), format_scheme(generate_scheme(options)));
+
+            DynamicSchemeDto parsed { parse_scheme(format_scheme(scheme)) };
+            Assert::AreEqual(format_scheme(scheme), format_scheme(parsed));
+            for (SchemeType type : { SchemeType::Greedy, SchemeType::Brute })
+            {
+                scheme.type = type;
+                parsed.type = type;
+                SchemeReliabilitySummaryDto result { calculate_scheme_reliability(scheme, { .thread_count = 2 }) };
+                Assert::AreEqual(result.sp, calculate_scheme_reliability(parsed, { .thread_count = 2 }).sp);
+                Assert::IsTrue(fabs(result.sp + result.sq - 1.0) <= 1e-12);
+            }
+
+            options.processor_count = 1;
+            Assert::ExpectException<std::runtime_error>([&options]() { generate_scheme(options); });
+            // Within 63 elements, but more processors than a dynamic scheme packs.
+            options.element_count = 20;
+            options.processor_count = 33;
+            Assert::ExpectException<std::runtime_error>([&options]() { generate_scheme(options); });
+        }
+    };
+
+    TEST_CLASS(BatchTests)
+    {
+    public:
+
+        TEST_METHOD(run_batch_matches_separate_runs)
+        {
+            GeneratorOptionsDto generator_options { };
+            generator_options.element_count = 14;
+            generator_options.processor_count = 5;
+            generator_options.seed = 3;
+            DynamicSchemeDto large_scheme { generate_scheme(generator_options) };
+            generator_options.element_count = 6;
+            generator_options.processor_count = 3;
+            DynamicSchemeDto small_scheme { generate_scheme(generator_options) };
+
+            vector<BatchJobDto> jobs { };
+            for (SchemeType type : { SchemeType::Greedy, SchemeType::Brute })
+                for (const DynamicSchemeDto& scheme : { large_scheme, small_scheme })
+                {
+                    BatchJobDto job { .scheme = scheme };
+                    job.scheme.type = type;
+                    job.scheme.scheme_name += type == SchemeType::Brute ? "-brute" : "-greedy";
+                    jobs.push_back(job);
+                }
+            jobs.back().options.output_format = OutputFormat::Bitmap;
+            BatchJobDto failing_job { .scheme = small_scheme };
+            failing_job.scheme.scheme_name = "batch-failing";
+            failing_job.scheme.elements.clear();
+            jobs.push_back(failing_job);
+
+            BatchSummaryDto summary { run_batch(jobs, { .thread_count = 3, .active_job_count = 2 }) };
+            Assert::AreEqual(jobs.size(), summary.jobs.size());
+            for (size_t i = 0; i + 1 < jobs.size(); i++)
+            {
+                Assert::IsTrue(summary.jobs[i].summary.has_value());
+                CalculationOptionsDto options { jobs[i].options };
+                options.thread_count = 1;
+                SchemeReliabilitySummaryDto separate { calculate_scheme_reliability(jobs[i].scheme, options) };
+                Assert::AreEqual(separate.sp, summary.jobs[i].summary->sp);
+                Assert::AreEqual(separate.sq, summary.jobs[i].summary->sq);
+                Assert::AreEqual(separate.state_vector_set_count, summary.jobs[i].summary->state_vector_set_count);
+            }
+            Assert::IsFalse(summary.jobs.back().summary.has_value());
+            Assert::IsFalse(summary.jobs.back().error.empty());
+
+            jobs[1].scheme.scheme_name = jobs[0].scheme.scheme_name;
+            Assert::ExpectException<std::runtime_error>([&jobs]() { run_batch(jobs); });
+        }
+    };
+}
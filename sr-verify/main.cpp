@@ -0,0 +1,92 @@
+import verify;
+
+import std;
+using std::string;
+using std::string_view;
+using std::vector;
+using std::stoul, std::stoull, std::stod;
+using std::println;
+using std::cerr;
+using std::exception;
+
+vector<string> split(const string& value)
+{
+    vector<string> result { };
+    size_t start { 0 };
+    while (start <= value.size())
+    {
+        size_t end { value.find(',', start) };
+        if (end == string::npos)
+            end = value.size();
+        if (end > start)
+            result.push_back(value.substr(start, end - start));
+        start = end + 1;
+    }
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    verify::VerificationConfig config
+    {
+        .filters = { },
+        .include_large = false,
+        .random_scheme_count = 16,
+        .seed = 1,
+        .thread_count = 0,
+        .relative_tolerance = 1e-12,
+        .max_reference_element_count = 23,
+        .max_state_element_count = 20,
+        .scheme_path = "schemes",
+        .keep_results = false
+    };
+
+    for (int i = 1; i < argc; i++)
+    {
+        string_view arg { argv[i] };
+        if (arg == "--all")
+            config.include_large = true;
+        else if (arg == "--keep-results")
+            config.keep_results = true;
+        else if (arg == "--filter" && i + 1 < argc)
+            config.filters = split(argv[++i]);
+        else if (arg == "--random" && i + 1 < argc)
+            config.random_scheme_count = stoul(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc)
+            config.seed = stoull(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc)
+            config.thread_count = stoul(argv[++i]);
+        else if (arg == "--tolerance" && i + 1 < argc)
+            config.relative_tolerance = stod(argv[++i]);
+        else if (arg == "--reference-limit" && i + 1 < argc)
+            config.max_reference_element_count = stoul(argv[++i]);
+        else if (arg == "--schemes" && i + 1 < argc)
+            config.scheme_path = argv[++i];
+        else
+        {
+            println(
+                cerr,
+                "usage: sr-verify [--all] [--filter simple,s23] [--random N] [--seed S] [--threads N] "
+                "[--tolerance 1e-12] [--reference-limit 23] [--schemes DIR] [--keep-results]"
+            );
+            return 1;
+        }
+    }
+
+    try
+    {
+        auto records { verify::run_verification(config) };
+        size_t failed_count { 0 };
+        for (const verify::VerificationRecord& record : records)
+            if (!record.is_passed)
+                failed_count++;
+
+        println("\n{} checks, {} failed", records.size(), failed_count);
+        return failed_count == 0 ? 0 : 1;
+    }
+    catch (const exception& e)
+    {
+        println(cerr, "{}", e.what());
+        return 1;
+    }
+}
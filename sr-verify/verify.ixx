@@ -0,0 +1,980 @@
+export module verify;
+
+import scheme_reliability;
+using namespace sr;
+
+import research;
+
+import std;
+
+using std::string;
+using std::vector;
+using std::array;
+using std::span;
+using std::optional, std::nullopt;
+using std::function;
+using std::format;
+using std::println;
+using std::ifstream;
+using std::filesystem::path;
+using std::filesystem::directory_iterator;
+using std::filesystem::exists, std::filesystem::remove_all;
+using std::runtime_error;
+using std::thread;
+using std::atomic, std::memory_order_relaxed;
+using std::mt19937_64;
+using std::fabs;
+using std::max, std::min;
+using std::memcpy;
+using std::move;
+
+export namespace verify
+{
+    struct VerificationConfig
+    {
+        vector<string> filters;
+        bool include_large;
+        size_t random_scheme_count;
+        unsigned long long seed;
+        size_t thread_count;
+        double relative_tolerance;
+        // The naive reference runs up to this many elements, states are compared up to
+        // max_state_element_count.
+        size_t max_reference_element_count;
+        size_t max_state_element_count;
+        path scheme_path;
+        bool keep_results;
+    };
+
+    // One check of one engine run: against the naive reference, the recorded baseline,
+    // the reference state by state, or the engine's own earlier run.
+    struct VerificationRecord
+    {
+        string case_name;
+        string engine;
+        size_t thread_count;
+        string check;
+        double sp;
+        double sq;
+        double expected_sp;
+        double expected_sq;
+        size_t mismatched_state_count;
+        bool is_passed;
+    };
+
+    vector<VerificationRecord> run_verification(const VerificationConfig& config);
+}
+
+module : private;
+
+namespace verify
+{
+    // sp/sq of the research schemes as recorded in final-run-log.txt; greedy and brute
+    // force agree on every one of them.
+    struct ReliabilityBaseline
+    {
+        double sp;
+        double sq;
+    };
+
+    // Bit (all_count - 1 - i) of a state index is set when element i failed.
+    vector<bool> state_vector(size_t state_idx, size_t all_count)
+    {
+        vector<bool> sv(all_count);
+        for (size_t i = 0; i < all_count; i++)
+            sv[i] = ((state_idx >> (all_count - 1 - i)) & 1) == 0;
+        return sv;
+    }
+
+    template<typename States>
+    bool evaluate_expression(const vector<ExpressionOpDto>& expression, const States& states)
+    {
+        vector<bool> stack { };
+        for (const ExpressionOpDto& op : expression)
+        {
+            switch (op.code)
+            {
+            case ExpressionOpCode::Element: stack.push_back(states[op.element_idx]); break;
+            case ExpressionOpCode::True: stack.push_back(true); break;
+            case ExpressionOpCode::False: stack.push_back(false); break;
+            case ExpressionOpCode::Not: stack.back() = !stack.back(); break;
+            case ExpressionOpCode::And:
+            case ExpressionOpCode::Or:
+            {
+                bool right { stack.back() };
+                stack.pop_back();
+                stack.back() = op.code == ExpressionOpCode::And ? stack.back() && right : stack.back() || right;
+                break;
+            }
+            }
+        }
+        return stack.back();
+    }
+
+    // The reconfiguration rules written out over vector<bool> states, one state at a
+    // time and sharing no code with the engines. Brute force is the existence of any
+    // assignment of one valid transition per failed processor, or none when one of its
+    // transitions is invalid, under which the scheme works; greedy picks, processor by
+    // processor, the valid transition of least load score, later ones winning ties.
+    // With is_dropping_impossible_transitions, brute force takes an impossible
+    // transition as an invalid one.
+    struct ReferenceScheme
+    {
+        vector<double> p;
+        vector<double> q;
+        vector<ProcessorDto> processors;
+        function<bool(const vector<bool>&)> scheme_function;
+        bool is_dropping_impossible_transitions;
+
+        size_t all_count() const
+        {
+            return p.size();
+        }
+    };
+
+    ReferenceScheme make_reference_scheme(const DynamicSchemeDto& scheme)
+    {
+        ReferenceScheme reference
+        {
+            .p = { }, .q = { }, .processors = scheme.processors,
+            .scheme_function = [expression = scheme.scheme_expression](const vector<bool>& sv) { return evaluate_expression(expression, sv); },
+            .is_dropping_impossible_transitions = scheme.brute_options.is_dropping_impossible_transitions
+        };
+        for (const ProcessorDto& processor : scheme.processors)
+        {
+            reference.p.push_back(processor.p);
+            reference.q.push_back(processor.q);
+        }
+        for (const ElementDto& element : scheme.elements)
+        {
+            reference.p.push_back(element.p);
+            reference.q.push_back(element.q);
+        }
+        return reference;
+    }
+
+    template<size_t all_count, size_t processor_count>
+    ReferenceScheme make_reference_scheme(const SchemeDto<all_count, processor_count>& scheme)
+    {
+        ReferenceScheme reference
+        {
+            .p = { }, .q = { }, .processors = { scheme.processors.begin(), scheme.processors.end() },
+            .scheme_function = [scheme_function = scheme.scheme_function](const vector<bool>& sv)
+            {
+                StateVectorDto<all_count, processor_count> state { };
+                for (size_t i = 0; i < all_count; i++)
+                    state.all[i] = sv[i];
+                return scheme_function(state);
+            },
+            .is_dropping_impossible_transitions = scheme.brute_options.is_dropping_impossible_transitions
+        };
+        for (const ProcessorDto& processor : scheme.processors)
+        {
+            reference.p.push_back(processor.p);
+            reference.q.push_back(processor.q);
+        }
+        for (const ElementDto& element : scheme.elements)
+        {
+            reference.p.push_back(element.p);
+            reference.q.push_back(element.q);
+        }
+        return reference;
+    }
+
+    class ReferenceReconfiguration
+    {
+    private:
+
+        static constexpr double OVERLOAD_COEFFICIENT { 1e6 };
+
+        const ReferenceScheme& scheme;
+
+    public:
+
+        ReferenceReconfiguration(const ReferenceScheme& scheme):
+            scheme { scheme }
+        { }
+
+        vector<bool> greedy_sv2(const vector<bool>& sv1) const
+        {
+            vector<double> load { normal_loads() };
+            vector<const TransitionDto*> chosen(scheme.processors.size(), nullptr);
+            bool is_reconfigured { false };
+            for (size_t i = 0; i < scheme.processors.size(); i++)
+            {
+                if (sv1[i] || scheme.processors[i].transitions.empty())
+                    continue;
+                is_reconfigured = true;
+
+                double best_score { 0 };
+                for (const TransitionDto& transition : scheme.processors[i].transitions)
+                {
+                    if (!is_valid(sv1, transition))
+                        continue;
+                    double score { load_score(with_transition(load, transition), transition.size()) };
+                    if (chosen[i] == nullptr || score <= best_score)
+                    {
+                        chosen[i] = &transition;
+                        best_score = score;
+                    }
+                }
+                if (chosen[i] != nullptr)
+                    load = with_transition(load, *chosen[i]);
+            }
+            if (!is_reconfigured)
+                return sv1;
+            return apply(sv1, load, chosen);
+        }
+
+        bool is_brute_working(const vector<bool>& sv1) const
+        {
+            vector<size_t> failed { };
+            for (size_t i = 0; i < scheme.processors.size(); i++)
+                if (!sv1[i] && !scheme.processors[i].transitions.empty())
+                    failed.push_back(i);
+            if (failed.empty())
+                return scheme.scheme_function(sv1);
+            return has_working_assignment(sv1, failed, 0, normal_loads(), vector<const TransitionDto*>(scheme.processors.size(), nullptr));
+        }
+
+    private:
+
+        bool has_working_assignment(
+            const vector<bool>& sv1,
+            const vector<size_t>& failed,
+            size_t depth,
+            const vector<double>& load,
+            vector<const TransitionDto*> chosen
+        ) const {
+            if (depth == failed.size())
+                return scheme.scheme_function(apply(sv1, load, chosen));
+
+            size_t processor_idx { failed[depth] };
+            bool has_invalid { false };
+            for (const TransitionDto& transition : scheme.processors[processor_idx].transitions)
+            {
+                if (!is_valid(sv1, transition) || (scheme.is_dropping_impossible_transitions && is_impossible(processor_idx, transition)))
+                {
+                    has_invalid = true;
+                    continue;
+                }
+                chosen[processor_idx] = &transition;
+                if (has_working_assignment(sv1, failed, depth + 1, with_transition(load, transition), chosen))
+                    return true;
+            }
+            chosen[processor_idx] = nullptr;
+            return has_invalid && has_working_assignment(sv1, failed, depth + 1, load, chosen);
+        }
+
+        vector<bool> apply(const vector<bool>& sv1, const vector<double>& load, const vector<const TransitionDto*>& chosen) const
+        {
+            vector<bool> sv2 { sv1 };
+            for (size_t i = 0; i < scheme.processors.size(); i++)
+            {
+                if (sv1[i] && load[i] > scheme.processors[i].max_load)
+                    sv2[i] = false;
+                if (!sv1[i] && chosen[i] != nullptr && is_successful(sv1, *chosen[i], load))
+                    sv2[i] = true;
+            }
+            return sv2;
+        }
+
+        vector<double> normal_loads() const
+        {
+            vector<double> load { };
+            for (const ProcessorDto& processor : scheme.processors)
+                load.push_back(processor.normal_load);
+            return load;
+        }
+
+        static vector<double> with_transition(vector<double> load, const TransitionDto& transition)
+        {
+            for (const TrUnit& unit : transition)
+                load[unit.index] += unit.load;
+            return load;
+        }
+
+        bool is_impossible(size_t processor_idx, const TransitionDto& transition) const
+        {
+            for (const TrUnit& unit : transition)
+                if (unit.index == processor_idx || scheme.processors[unit.index].normal_load + unit.load > scheme.processors[unit.index].max_load)
+                    return true;
+            return false;
+        }
+
+        static bool is_valid(const vector<bool>& sv1, const TransitionDto& transition)
+        {
+            if (transition.empty())
+                return false;
+            for (const TrUnit& unit : transition)
+                if (!sv1[unit.index])
+                    return false;
+            return true;
+        }
+
+        bool is_successful(const vector<bool>& sv1, const TransitionDto& transition, const vector<double>& load) const
+        {
+            if (!is_valid(sv1, transition))
+                return false;
+            for (const TrUnit& unit : transition)
+                if (load[unit.index] > scheme.processors[unit.index].max_load)
+                    return false;
+            return true;
+        }
+
+        double load_score(const vector<double>& load, size_t transition_size) const
+        {
+            double score { 0 };
+            for (size_t i = 0; i < scheme.processors.size(); i++)
+            {
+                double relative_load { load[i] / scheme.processors[i].max_load };
+                if (relative_load > 1.0)
+                    relative_load *= OVERLOAD_COEFFICIENT;
+                score += relative_load;
+            }
+            return score / static_cast<double>(transition_size);
+        }
+    };
+
+    // Kahan-Babuska summation, kept apart from the library's on purpose.
+    struct ReferenceSum
+    {
+        double sum { 0 };
+        double compensation { 0 };
+
+        void add(double value)
+        {
+            double total { sum + value };
+            compensation += fabs(sum) >= fabs(value) ? (sum - total) + value : (value - total) + sum;
+            sum = total;
+        }
+
+        double value() const
+        {
+            return sum + compensation;
+        }
+    };
+
+    constexpr unsigned char GREEDY_WORKS { 1 };
+    constexpr unsigned char BRUTE_WORKS { 2 };
+
+    struct ReferenceOutcome
+    {
+        ReliabilityBaseline greedy;
+        ReliabilityBaseline brute;
+        vector<double> probabilities;
+        // GREEDY_WORKS / BRUTE_WORKS per state.
+        vector<unsigned char> flags;
+        // Processors working in greedy's sv2, bit i for processor i.
+        vector<unsigned long long> greedy_processor_masks;
+    };
+
+    ReferenceOutcome calculate_reference(const ReferenceScheme& scheme, size_t thread_count, bool is_keeping_states)
+    {
+        constexpr size_t BLOCK_SIZE { 4096 };
+
+        size_t all_count { scheme.all_count() };
+        size_t state_count { static_cast<size_t>(1) << all_count };
+        size_t block_count { (state_count + BLOCK_SIZE - 1) / BLOCK_SIZE };
+        ReferenceReconfiguration reconfiguration { scheme };
+
+        ReferenceOutcome outcome
+        {
+            .greedy = { }, .brute = { },
+            .probabilities = vector<double>(is_keeping_states ? state_count : 0),
+            .flags = vector<unsigned char>(state_count),
+            .greedy_processor_masks = vector<unsigned long long>(is_keeping_states ? state_count : 0)
+        };
+        vector<ReferenceSum> block_sums(4 * block_count);
+        atomic<size_t> next_block { 0 };
+
+        auto process_blocks = [&]()
+        {
+            for (size_t b = next_block.fetch_add(1, memory_order_relaxed); b < block_count; b = next_block.fetch_add(1, memory_order_relaxed))
+                for (size_t s = b * BLOCK_SIZE; s < min(state_count, (b + 1) * BLOCK_SIZE); s++)
+                {
+                    vector<bool> sv1 { state_vector(s, all_count) };
+                    double probability { 1.0 };
+                    for (size_t i = 0; i < all_count; i++)
+                        probability *= sv1[i] ? scheme.p[i] : scheme.q[i];
+
+                    vector<bool> greedy_sv2 { reconfiguration.greedy_sv2(sv1) };
+                    bool is_greedy_working { scheme.scheme_function(greedy_sv2) };
+                    bool is_brute_working { reconfiguration.is_brute_working(sv1) };
+                    block_sums[4 * b + (is_greedy_working ? 0 : 1)].add(probability);
+                    block_sums[4 * b + (is_brute_working ? 2 : 3)].add(probability);
+
+                    outcome.flags[s] = (is_greedy_working ? GREEDY_WORKS : 0) | (is_brute_working ? BRUTE_WORKS : 0);
+                    if (!is_keeping_states)
+                        continue;
+                    outcome.probabilities[s] = probability;
+                    for (size_t i = 0; i < scheme.processors.size(); i++)
+                        if (greedy_sv2[i])
+                            outcome.greedy_processor_masks[s] |= 1ull << i;
+                }
+        };
+
+        vector<thread> workers { };
+        for (size_t i = 0; i < max<size_t>(1, thread_count); i++)
+            workers.emplace_back(process_blocks);
+        for (thread& worker : workers)
+            worker.join();
+
+        array<ReferenceSum, 4> totals { };
+        for (size_t b = 0; b < block_count; b++)
+            for (size_t k = 0; k < 4; k++)
+                totals[k].add(block_sums[4 * b + k].value());
+        outcome.greedy = { .sp = totals[0].value(), .sq = totals[1].value() };
+        outcome.brute = { .sp = totals[2].value(), .sq = totals[3].value() };
+        return outcome;
+    }
+
+    struct RunSettings
+    {
+        size_t thread_count;
+        OutputFormat output_format;
+    };
+
+    struct EngineResult
+    {
+        string engine;
+        SchemeType type;
+        double sp;
+        double sq;
+        // Empty when the engine keeps no per-state result.
+        path result_path;
+        optional<OutcomeBitmapDto> outcome_bitmap;
+    };
+
+    using EngineRunner = function<vector<EngineResult>(const RunSettings&)>;
+
+    struct VerificationCase
+    {
+        string name;
+        size_t all_count;
+        bool is_large;
+        optional<ReliabilityBaseline> baseline;
+        function<ReferenceScheme()> make_reference;
+        vector<EngineRunner> runners;
+    };
+
+    string type_name(SchemeType type)
+    {
+        switch (type)
+        {
+        case SchemeType::Brute: return "brute";
+        case SchemeType::Beam: return "beam";
+        default: return "greedy";
+        }
+    }
+
+    constexpr SchemeType SCHEME_TYPES[] { SchemeType::Greedy, SchemeType::Brute, SchemeType::Beam };
+
+    template<size_t all_count, size_t processor_count>
+    vector<EngineRunner> templated_runners(const SchemeDto<all_count, processor_count>& scheme)
+    {
+        vector<EngineRunner> runners { };
+        for (SchemeType type : SCHEME_TYPES)
+            runners.push_back([scheme, type](const RunSettings& settings)
+            {
+                SchemeDto<all_count, processor_count> run_scheme { scheme };
+                run_scheme.type = type;
+                SchemeReliabilitySummaryDto summary
+                {
+                    calculate_scheme_reliability<all_count, processor_count>(run_scheme, { .thread_count = settings.thread_count, .output_format = settings.output_format })
+                };
+                return vector<EngineResult> { { format("templated-{}", type_name(type)), type, summary.sp, summary.sq, summary.result_path, nullopt } };
+            });
+
+        // All strategies as variants of one enumeration.
+        runners.push_back([scheme](const RunSettings& settings)
+        {
+            vector<SchemeDto<all_count, processor_count>> variants { };
+            for (SchemeType type : SCHEME_TYPES)
+            {
+                variants.push_back(scheme);
+                variants.back().type = type;
+                variants.back().scheme_name = format("{}-variant-{}", scheme.scheme_name, type_name(type));
+            }
+            MultiVariantSummaryDto summary
+            {
+                calculate_scheme_variants_reliability<all_count, processor_count>(variants, { .thread_count = settings.thread_count, .output_format = settings.output_format })
+            };
+            vector<EngineResult> results { };
+            for (size_t v = 0; v < variants.size(); v++)
+                results.push_back({ format("variants-{}", type_name(variants[v].type)), variants[v].type, summary.variants[v].sp, summary.variants[v].sq, summary.variants[v].result_path, nullopt });
+            return results;
+        });
+
+        runners.push_back([scheme](const RunSettings& settings)
+        {
+            StrategyComparisonDto comparison { compare_reconfiguration_strategies<all_count, processor_count>(scheme, { .thread_count = settings.thread_count }) };
+            return vector<EngineResult>
+            {
+                { "comparison-greedy", SchemeType::Greedy, comparison.greedy.sp, comparison.greedy.sq, { }, nullopt },
+                { "comparison-brute", SchemeType::Brute, comparison.brute.sp, comparison.brute.sq, { }, nullopt }
+            };
+        });
+        return runners;
+    }
+
+    vector<EngineRunner> dynamic_runners(const DynamicSchemeDto& scheme)
+    {
+        vector<EngineRunner> runners { };
+        for (SchemeType type : SCHEME_TYPES)
+            runners.push_back([scheme, type](const RunSettings& settings)
+            {
+                DynamicSchemeDto run_scheme { scheme };
+                run_scheme.type = type;
+                SchemeReliabilitySummaryDto summary
+                {
+                    calculate_scheme_reliability(run_scheme, { .thread_count = settings.thread_count, .output_format = settings.output_format })
+                };
+                return vector<EngineResult> { { format("dynamic-{}", type_name(type)), type, summary.sp, summary.sq, summary.result_path, nullopt } };
+            });
+
+        // The in-memory outcome bitmap, re-weighted with the scheme's own p/q.
+        runners.push_back([scheme](const RunSettings& settings)
+        {
+            vector<double> p { };
+            vector<double> q { };
+            for (const ProcessorDto& processor : scheme.processors)
+            {
+                p.push_back(processor.p);
+                q.push_back(processor.q);
+            }
+            for (const ElementDto& element : scheme.elements)
+            {
+                p.push_back(element.p);
+                q.push_back(element.q);
+            }
+
+            vector<EngineResult> results { };
+            for (SchemeType type : { SchemeType::Greedy, SchemeType::Brute })
+            {
+                DynamicSchemeDto run_scheme { scheme };
+                run_scheme.type = type;
+                OutcomeBitmapDto bitmap { calculate_outcome_bitmap(run_scheme, settings.thread_count) };
+                ReweightedReliabilityDto reliability { reweight_outcome_bitmap(bitmap, p, q) };
+                results.push_back({ format("outcome-{}", type_name(type)), type, reliability.sp, reliability.sq, { }, move(bitmap) });
+            }
+            return results;
+        });
+        return runners;
+    }
+
+    template<size_t all_count, size_t processor_count>
+    SchemeDto<all_count, processor_count> to_templated_scheme(const DynamicSchemeDto& dynamic_scheme)
+    {
+        SchemeDto<all_count, processor_count> scheme { };
+        scheme.scheme_name = dynamic_scheme.scheme_name;
+        for (size_t i = 0; i < processor_count; i++)
+            scheme.processors[i] = dynamic_scheme.processors[i];
+        for (size_t i = 0; i < all_count - processor_count; i++)
+            scheme.elements[i] = dynamic_scheme.elements[i];
+        scheme.scheme_function = [expression = dynamic_scheme.scheme_expression](const StateVectorDto<all_count, processor_count>& sv)
+        {
+            return evaluate_expression(expression, sv.all);
+        };
+        scheme.type = dynamic_scheme.type;
+        scheme.brute_options = dynamic_scheme.brute_options;
+        // The dynamic engine sees the negation in the expression, the lambda doesn't.
+        for (const ExpressionOpDto& op : dynamic_scheme.scheme_expression)
+            if (op.code == ExpressionOpCode::Not)
+                scheme.brute_options.is_pruning_transitions = false;
+        return scheme;
+    }
+
+    template<size_t all_count, size_t processor_count>
+    VerificationCase research_case(
+        const string& name,
+        bool is_large,
+        optional<ReliabilityBaseline> baseline,
+        const SchemeDto<all_count, processor_count>& scheme,
+        const VerificationConfig& config
+    ) {
+        VerificationCase verification_case
+        {
+            .name = name,
+            .all_count = all_count,
+            .is_large = is_large,
+            .baseline = baseline,
+            .make_reference = [scheme]() { return make_reference_scheme<all_count, processor_count>(scheme); },
+            .runners = templated_runners<all_count, processor_count>(scheme)
+        };
+
+        path scheme_file_path { config.scheme_path / (name + ".scheme") };
+        if (exists(scheme_file_path))
+            for (EngineRunner& runner : dynamic_runners(load_scheme_file(scheme_file_path)))
+                verification_case.runners.push_back(move(runner));
+        return verification_case;
+    }
+
+    // Small generated schemes over the whole option space, run by the templated
+    // engines at a few fixed sizes and by the dynamic engine.
+    template<size_t all_count, size_t processor_count>
+    VerificationCase random_case(unsigned long long seed)
+    {
+        mt19937_64 random { seed };
+        GeneratorOptionsDto options { };
+        options.element_count = all_count - processor_count;
+        options.processor_count = processor_count;
+        options.transitions_per_processor = 1 + random() % 3;
+        options.load_headroom = 0.25 * static_cast<double>(random() % 5);
+        options.expression_depth = 1 + random() % 4;
+        options.series_weight = static_cast<double>(random() % 3);
+        options.parallel_weight = static_cast<double>(random() % 3);
+        options.k_of_n_weight = static_cast<double>(1 + random() % 2);
+        // Large q, so that multi-failure states carry weight.
+        options.min_q = 0.01;
+        options.max_q = 0.2;
+        options.seed = seed;
+        DynamicSchemeDto scheme { generate_scheme(options) };
+        scheme.brute_options.is_dropping_impossible_transitions = random() % 2 == 0;
+
+        VerificationCase verification_case
+        {
+            .name = scheme.scheme_name,
+            .all_count = all_count,
+            .is_large = false,
+            .baseline = nullopt,
+            .make_reference = [scheme]() { return make_reference_scheme(scheme); },
+            .runners = templated_runners<all_count, processor_count>(to_templated_scheme<all_count, processor_count>(scheme))
+        };
+        for (EngineRunner& runner : dynamic_runners(scheme))
+            verification_case.runners.push_back(move(runner));
+        return verification_case;
+    }
+
+    vector<VerificationCase> verification_cases(const VerificationConfig& config)
+    {
+        vector<VerificationCase> cases
+        {
+            research_case("simple", false, nullopt, research::simple_scheme(), config),
+            research_case("s23-original", false, ReliabilityBaseline { 0.9990208569798796, 0.000979143020119051 }, research::s23_original_scheme(), config),
+            research_case("s23-77788", true, ReliabilityBaseline { 0.9992607082975051, 0.0007392917024915616 }, research::s23_rt_7_7_7_8_8_scheme(), config),
+            research_case(
+                "s23-77788-modified-connections", true, ReliabilityBaseline { 0.999737721521635, 0.0002622784783607316 },
+                research::s23_rt_7_7_7_8_8_modified_connections_scheme(), config
+            ),
+            research_case("s24-d9-right", true, ReliabilityBaseline { 0.9997597157515095, 0.00024028424848725232 }, research::s24_d9_right_scheme(), config),
+            research_case("s25-d9-d10-right", true, ReliabilityBaseline { 0.9997597162353798, 0.00024028376461419955 }, research::s25_d9_d10_right_scheme(), config),
+            research_case("s26-final", true, nullopt, research::s26_final_scheme(), config),
+            research_case(
+                "s27-d9-d10-c7-right-c8-left", true, ReliabilityBaseline { 0.9997598842949585, 0.00024011570500589362 },
+                research::s27_d9_d10_c7_right_c8_left_scheme(), config
+            ),
+            research_case(
+                "s29-d9-d10-c7-right-c8-left-a4", true, ReliabilityBaseline { 0.999999841063663, 1.5893623277066473e-07 },
+                research::s29_d9_d10_c7_right_c8_left_a4_scheme(), config
+            )
+        };
+
+        for (size_t i = 0; i < config.random_scheme_count; i++)
+        {
+            unsigned long long seed { config.seed + i };
+            switch (i % 4)
+            {
+            case 0: cases.push_back(random_case<9, 3>(seed)); break;
+            case 1: cases.push_back(random_case<12, 4>(seed)); break;
+            case 2: cases.push_back(random_case<14, 5>(seed)); break;
+            default: cases.push_back(random_case<16, 6>(seed)); break;
+            }
+        }
+        return cases;
+    }
+
+    bool is_selected(const VerificationConfig& config, const VerificationCase& verification_case)
+    {
+        if (config.filters.empty())
+            return config.include_large || !verification_case.is_large;
+
+        for (const string& filter : config.filters)
+            if (verification_case.name.find(filter) != string::npos)
+                return true;
+        return false;
+    }
+
+    bool is_close(double value, double expected, double relative_tolerance)
+    {
+        return fabs(value - expected) <= relative_tolerance * max(fabs(value), fabs(expected));
+    }
+
+    // Decisions an engine wrote to its result directory or kept in memory, checked
+    // against the reference: every state present once with the reference probability,
+    // sv2 only differing from sv1 in processors, scheme_state_sv2 matching the scheme
+    // function of sv2 and the reference outcome, and greedy's sv2 matching exactly.
+    class StateComparison
+    {
+    private:
+
+        const ReferenceScheme& scheme;
+        const ReferenceOutcome& reference;
+        const EngineResult& result;
+
+        size_t mismatched_state_count;
+
+    public:
+
+        StateComparison(const ReferenceScheme& scheme, const ReferenceOutcome& reference, const EngineResult& result):
+            scheme { scheme }, reference { reference }, result { result }, mismatched_state_count { 0 }
+        { }
+
+        // nullopt when the engine kept nothing to compare.
+        optional<size_t> compare()
+        {
+            if (result.outcome_bitmap.has_value())
+            {
+                compare_bitmap(result.outcome_bitmap.value());
+                return mismatched_state_count;
+            }
+            if (result.result_path.empty() || !exists(result.result_path))
+                return nullopt;
+
+            vector<path> ssv_file_paths { };
+            optional<path> outcome_file_path { };
+            for (const auto& entry : directory_iterator(result.result_path))
+            {
+                if (entry.path().extension() == ".ssv")
+                    ssv_file_paths.push_back(entry.path());
+                else if (entry.path().extension() == ".outcome")
+                    outcome_file_path = entry.path();
+            }
+
+            if (outcome_file_path.has_value())
+                compare_bitmap(read_outcome_bitmap(outcome_file_path.value()));
+            else if (!ssv_file_paths.empty())
+                compare_records(ssv_file_paths);
+            else
+                return nullopt;
+            return mismatched_state_count;
+        }
+
+    private:
+
+        bool is_expected_working(size_t state_idx, bool is_working) const
+        {
+            unsigned char flags { reference.flags[state_idx] };
+            switch (result.type)
+            {
+            case SchemeType::Greedy: return is_working == ((flags & GREEDY_WORKS) != 0);
+            case SchemeType::Brute: return is_working == ((flags & BRUTE_WORKS) != 0);
+            default: return (is_working || (flags & GREEDY_WORKS) == 0) && (!is_working || (flags & BRUTE_WORKS) != 0);
+            }
+        }
+
+        void compare_bitmap(const OutcomeBitmapDto& bitmap)
+        {
+            if (bitmap.all_count != scheme.all_count())
+            {
+                mismatched_state_count = reference.flags.size();
+                return;
+            }
+            for (size_t s = 0; s < reference.flags.size(); s++)
+                if (!is_expected_working(s, (bitmap.words[s / 64] >> (s % 64) & 1) != 0))
+                    mismatched_state_count++;
+        }
+
+        void compare_records(const vector<path>& ssv_file_paths)
+        {
+            size_t all_count { scheme.all_count() };
+            size_t record_size { 3 * sizeof(bool) + sizeof(double) + 2 * all_count * sizeof(bool) };
+            vector<unsigned char> is_seen(reference.flags.size());
+            vector<char> records { };
+            for (const path& ssv_file_path : ssv_file_paths)
+            {
+                ifstream file { ssv_file_path, std::ios::binary | std::ios::ate };
+                if (!file.is_open())
+                    throw runtime_error(format("Error: can't open result file {} for reading", ssv_file_path.string()));
+                records.resize(static_cast<size_t>(file.tellg()));
+                file.seekg(0);
+                file.read(records.data(), static_cast<std::streamsize>(records.size()));
+
+                for (size_t offset = 0; offset + record_size <= records.size(); offset += record_size)
+                    compare_record(span<const char> { records.data() + offset, record_size }, is_seen);
+                if (records.size() % record_size != 0)
+                    mismatched_state_count++;
+            }
+            for (unsigned char seen : is_seen)
+                if (seen == 0)
+                    mismatched_state_count++;
+        }
+
+        void compare_record(span<const char> record, vector<unsigned char>& is_seen)
+        {
+            size_t all_count { scheme.all_count() };
+            bool scheme_state_sv2 { record[sizeof(bool)] != 0 };
+            double probability { };
+            memcpy(&probability, record.data() + 3 * sizeof(bool), sizeof(double));
+            const char* sv1_bytes { record.data() + 3 * sizeof(bool) + sizeof(double) };
+            const char* sv2_bytes { sv1_bytes + all_count };
+
+            size_t state_idx { 0 };
+            vector<bool> sv2(all_count);
+            bool is_matching { true };
+            for (size_t i = 0; i < all_count; i++)
+            {
+                if (sv1_bytes[i] == 0)
+                    state_idx |= static_cast<size_t>(1) << (all_count - 1 - i);
+                sv2[i] = sv2_bytes[i] != 0;
+                if (i >= scheme.processors.size() && sv2_bytes[i] != sv1_bytes[i])
+                    is_matching = false;
+            }
+
+            if (is_seen[state_idx]++ != 0)
+            {
+                mismatched_state_count++;
+                return;
+            }
+
+            is_matching = is_matching
+                && is_close(probability, reference.probabilities[state_idx], 1e-12)
+                && scheme_state_sv2 == scheme.scheme_function(sv2)
+                && is_expected_working(state_idx, scheme_state_sv2);
+            if (result.type == SchemeType::Greedy)
+                for (size_t i = 0; i < scheme.processors.size(); i++)
+                    is_matching = is_matching && sv2[i] == ((reference.greedy_processor_masks[state_idx] >> i & 1) != 0);
+            if (!is_matching)
+                mismatched_state_count++;
+        }
+    };
+
+    class CaseVerifier
+    {
+    private:
+
+        const VerificationConfig& config;
+        const VerificationCase& verification_case;
+
+        optional<ReferenceScheme> reference_scheme;
+        optional<ReferenceOutcome> reference;
+        // First run of each engine; later runs must repeat it bit for bit.
+        vector<EngineResult> first_results;
+
+        vector<VerificationRecord>& records;
+
+    public:
+
+        CaseVerifier(const VerificationConfig& config, const VerificationCase& verification_case, vector<VerificationRecord>& records):
+            config { config }, verification_case { verification_case },
+            reference_scheme { }, reference { }, first_results { },
+            records { records }
+        { }
+
+        void verify()
+        {
+            bool is_keeping_states { verification_case.all_count <= config.max_state_element_count };
+            if (verification_case.all_count <= config.max_reference_element_count)
+            {
+                reference_scheme = verification_case.make_reference();
+                reference = calculate_reference(reference_scheme.value(), thread_count(), is_keeping_states);
+                println(
+                    "{} reference: greedy sp = {}, brute sp = {}",
+                    verification_case.name, reference.value().greedy.sp, reference.value().brute.sp
+                );
+            }
+
+            // Small schemes run once per thread count with per-state records, large
+            // ones once with outcome bitmaps only.
+            vector<RunSettings> runs { };
+            if (is_keeping_states)
+            {
+                runs.push_back({ .thread_count = 1, .output_format = OutputFormat::Ssv });
+                runs.push_back({ .thread_count = thread_count(), .output_format = OutputFormat::Bitmap });
+            }
+            else
+                runs.push_back({ .thread_count = thread_count(), .output_format = OutputFormat::Bitmap });
+
+            for (const EngineRunner& runner : verification_case.runners)
+                for (const RunSettings& settings : runs)
+                    for (const EngineResult& result : runner(settings))
+                    {
+                        check(result, settings);
+                        if (!config.keep_results && !result.result_path.empty() && exists(result.result_path))
+                            remove_all(result.result_path);
+                    }
+        }
+
+    private:
+
+        size_t thread_count() const
+        {
+            return config.thread_count == 0 ? max<size_t>(1, thread::hardware_concurrency()) : config.thread_count;
+        }
+
+        void add_record(const EngineResult& result, const RunSettings& settings, const string& check, ReliabilityBaseline expected, bool is_passed, size_t mismatched_state_count = 0)
+        {
+            records.push_back(VerificationRecord
+            {
+                .case_name = verification_case.name,
+                .engine = result.engine,
+                .thread_count = settings.thread_count,
+                .check = check,
+                .sp = result.sp,
+                .sq = result.sq,
+                .expected_sp = expected.sp,
+                .expected_sq = expected.sq,
+                .mismatched_state_count = mismatched_state_count,
+                .is_passed = is_passed
+            });
+            const VerificationRecord& record { records.back() };
+            println(
+                "{} {} {} threads = {} {}: sp = {}, expected {}{}",
+                record.is_passed ? "ok  " : "FAIL", record.case_name, record.engine, record.thread_count, record.check,
+                record.sp, record.expected_sp,
+                record.check == "states" ? format(", {} mismatched states", record.mismatched_state_count) : ""
+            );
+        }
+
+        bool is_matching(const EngineResult& result, ReliabilityBaseline expected) const
+        {
+            return is_close(result.sp, expected.sp, config.relative_tolerance) && is_close(result.sq, expected.sq, config.relative_tolerance);
+        }
+
+        void check(const EngineResult& result, const RunSettings& settings)
+        {
+            if (reference.has_value())
+            {
+                const ReferenceOutcome& outcome { reference.value() };
+                if (result.type == SchemeType::Beam)
+                {
+                    // Beam search keeps every state greedy keeps, and only states brute force keeps.
+                    double tolerance { config.relative_tolerance * result.sp };
+                    bool is_bounded { result.sp >= outcome.greedy.sp - tolerance && result.sp <= outcome.brute.sp + tolerance };
+                    add_record(result, settings, "reference bounds", outcome.brute, is_bounded);
+                }
+                else
+                    add_record(result, settings, "reference", result.type == SchemeType::Greedy ? outcome.greedy : outcome.brute, is_matching(result, result.type == SchemeType::Greedy ? outcome.greedy : outcome.brute));
+
+                optional<size_t> mismatched_state_count { StateComparison { reference_scheme.value(), outcome, result }.compare() };
+                if (mismatched_state_count.has_value())
+                    add_record(result, settings, "states", result.type == SchemeType::Brute ? outcome.brute : outcome.greedy, mismatched_state_count.value() == 0, mismatched_state_count.value());
+            }
+
+            if (verification_case.baseline.has_value())
+                add_record(result, settings, "baseline", verification_case.baseline.value(), is_matching(result, verification_case.baseline.value()));
+
+            for (const EngineResult& first : first_results)
+                if (first.engine == result.engine)
+                {
+                    add_record(result, settings, "repeat", { first.sp, first.sq }, result.sp == first.sp && result.sq == first.sq);
+                    return;
+                }
+            first_results.push_back({ result.engine, result.type, result.sp, result.sq, { }, nullopt });
+        }
+    };
+
+    vector<VerificationRecord> run_verification(const VerificationConfig& config)
+    {
+        vector<VerificationRecord> records { };
+        for (const VerificationCase& verification_case : verification_cases(config))
+        {
+            if (!is_selected(config, verification_case))
+                continue;
+
+            CaseVerifier verifier { config, verification_case, records };
+            verifier.verify();
+        }
+        return records;
+    }
+}